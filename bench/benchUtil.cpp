@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/23
+ * All rights reserved. No one may copy or transfer.
+ * Description: 微基准公共部分
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "benchUtil.h"
+#include "zmallocDf.h"
+using namespace REDIS_BASE;
+
+#ifndef REDIS_BENCH_BUILD_TYPE
+#define REDIS_BENCH_BUILD_TYPE "unknown"
+#endif
+
+static double bench_min_time = BENCH_DEFAULT_MIN_TIME;
+static int bench_repetitions = BENCH_DEFAULT_REPETITIONS;
+static const char *bench_filter = NULL;
+static const char *bench_out = NULL;
+static int bench_json = 0;
+static benchResult bench_results[BENCH_MAX_RESULTS];
+static int bench_numresults = 0;
+static sdsCreate benchSdsCrt;
+
+int benchParseArgs(int argc, char **argv)
+{
+    int j;
+    for (j = 1; j < argc; j++) {
+        const char *arg = argv[j];
+        if (strncmp(arg, "--", 2)) break;
+        if (!strncmp(arg, "--filter=", 9)) {
+            bench_filter = arg + 9;
+        } else if (!strncmp(arg, "--min-time=", 11)) {
+            bench_min_time = atof(arg + 11);
+        } else if (!strncmp(arg, "--repetitions=", 14)) {
+            bench_repetitions = atoi(arg + 14);
+            if (bench_repetitions <= 0) bench_repetitions = 1;
+        } else if (!strncmp(arg, "--out=", 6)) {
+            bench_out = arg + 6;
+        } else if (!strcmp(arg, "--format=json")) {
+            bench_json = 1;
+        } else if (!strcmp(arg, "--format=console")) {
+            bench_json = 0;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", arg);
+            exit(1);
+        }
+    }
+    return j;
+}
+
+long long benchNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int benchSelected(const char *name)
+{
+    return bench_filter == NULL || strstr(name, bench_filter) != NULL;
+}
+
+int benchRepetitions(void)
+{
+    return bench_repetitions;
+}
+
+static void benchRecord(const char *name, long long iterations, long long best_ns, long long total_ns,
+                        long long total_ops, double bytes_per_item, double allocs_per_op)
+{
+    if (bench_numresults == BENCH_MAX_RESULTS) return;
+    benchResult *r = &bench_results[bench_numresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->iterations = iterations;
+    r->ns_per_op = iterations ? (double)best_ns / iterations : 0;
+    r->mean_ns_per_op = total_ops ? (double)total_ns / total_ops : 0;
+    r->bytes_per_item = bytes_per_item;
+    r->allocs_per_op = allocs_per_op;
+    r->repetitions = bench_repetitions;
+    if (bench_json) return;
+    printf("%-48s %12lld %10.2f ns/op %10.2f ns/op(mean)",
+        r->name, r->iterations, r->ns_per_op, r->mean_ns_per_op);
+    if (r->allocs_per_op >= 0) printf(" %8.2f allocs/op", r->allocs_per_op);
+    if (r->bytes_per_item > 0) printf(" %8.1f B/item", r->bytes_per_item);
+    printf("\n");
+}
+
+void benchAddResult(const char *name, long long iterations, long long best_ns, long long total_ns, long long total_ops)
+{
+    benchRecord(name, iterations, best_ns, total_ns, total_ops, 0, -1);
+}
+
+/* 所有标签累计的zmalloc分配次数 */
+static long long benchAllocCount(void)
+{
+    zmallocTagStats stats[ZMALLOC_TAG_COUNT];
+    long long allocs = 0;
+    zmalloc_get_tag_stats(stats);
+    for (int j = 0; j < ZMALLOC_TAG_COUNT; j++) allocs += stats[j].allocs;
+    return allocs;
+}
+
+/* splitmix64：把下标打散成互不相同的64位值，保证键可复现 */
+static uint64_t benchMix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* 键的前16个字符是打散后下标的十六进制，后面用'x'补齐，keylen需不小于16 */
+static void benchGenKeys(benchCtx *ctx)
+{
+    char buf[17];
+    ctx->keys = NULL;
+    if (ctx->keylen == 0) return;
+    ctx->keys = static_cast<sds*>(zmalloc(sizeof(sds) * ctx->n));
+    for (long long j = 0; j < ctx->n; j++) {
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)benchMix(j));
+        sds key = benchSdsCrt.sdsnewlen(NULL, ctx->keylen);
+        memset(key, 'x', ctx->keylen);
+        memcpy(key, buf, ctx->keylen < 16 ? ctx->keylen : 16);
+        ctx->keys[j] = key;
+    }
+}
+
+static void benchGenOrder(benchCtx *ctx)
+{
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    ctx->order = static_cast<long long*>(zmalloc(sizeof(long long) * ctx->n));
+    for (long long j = 0; j < ctx->n; j++) ctx->order[j] = j;
+    for (long long j = ctx->n - 1; j > 0; j--) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        long long k = (long long)(seed % (uint64_t)(j + 1));
+        long long tmp = ctx->order[j];
+        ctx->order[j] = ctx->order[k];
+        ctx->order[k] = tmp;
+    }
+}
+
+static void benchFreeCtx(benchCtx *ctx)
+{
+    if (ctx->keys) {
+        for (long long j = 0; j < ctx->n; j++) benchSdsCrt.sdsfree(ctx->keys[j]);
+        zfree(ctx->keys);
+    }
+    zfree(ctx->order);
+}
+
+static void benchRunCase(const benchDef *def, long long n, int keylen)
+{
+    char name[BENCH_NAME_LEN];
+    benchCtx ctx;
+    long long min_ns = (long long)(bench_min_time * 1e9);
+    long long best_ns = -1, best_ops = 0, total_ns = 0, total_ops = 0, allocs = 0;
+    int batches = 0;
+
+    if (keylen)
+        snprintf(name, sizeof(name), "%s/keylen:%d/n:%lld", def->name, keylen, n);
+    else
+        snprintf(name, sizeof(name), "%s/n:%lld", def->name, n);
+    if (!benchSelected(name)) return;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.n = n;
+    ctx.keylen = keylen;
+    benchGenKeys(&ctx);
+    benchGenOrder(&ctx);
+    def->prepare(&ctx);
+    for (int rep = 0; rep < bench_repetitions; rep++) {
+        long long elapsed = 0, ops = 0;
+        /* 至少执行一批，直到累计计时达到min_time */
+        do {
+            if (batches++ && def->reset) def->reset(&ctx);
+            long long allocs_before = benchAllocCount();
+            long long start = benchNanoseconds();
+            ops += def->run(&ctx);
+            elapsed += benchNanoseconds() - start;
+            allocs += benchAllocCount() - allocs_before;
+        } while (elapsed < min_ns);
+        if (best_ns < 0 || (double)elapsed / ops < (double)best_ns / best_ops) {
+            best_ns = elapsed;
+            best_ops = ops;
+        }
+        total_ns += elapsed;
+        total_ops += ops;
+    }
+    def->cleanup(&ctx);
+    benchFreeCtx(&ctx);
+    benchRecord(name, best_ops, best_ns, total_ns, total_ops, ctx.bytes_per_item,
+                total_ops ? (double)allocs / total_ops : 0);
+}
+
+void benchRunDef(const benchDef *def)
+{
+    for (int i = 0; i < BENCH_MAX_PARAMS && def->cards[i]; i++) {
+        if (def->keylens[0] == 0) {
+            benchRunCase(def, def->cards[i], 0);
+            continue;
+        }
+        for (int k = 0; k < BENCH_MAX_PARAMS && def->keylens[k]; k++)
+            benchRunCase(def, def->cards[i], def->keylens[k]);
+    }
+}
+
+/* 用例名只含字母数字和/:_，不需要转义 */
+static void benchWriteJson(FILE *fp, const char *suite)
+{
+    char date[64], host[256];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "unknown");
+    host[sizeof(host)-1] = '\0';
+
+    fprintf(fp, "{\n  \"context\": {\n");
+    fprintf(fp, "    \"suite\": \"%s\",\n", suite);
+    fprintf(fp, "    \"date\": \"%s\",\n", date);
+    fprintf(fp, "    \"host_name\": \"%s\",\n", host);
+    fprintf(fp, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(fp, "    \"allocator\": \"%s\",\n", ZMALLOC_LIB);
+    fprintf(fp, "    \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(fp, "    \"build_type\": \"%s\",\n", REDIS_BENCH_BUILD_TYPE);
+    fprintf(fp, "    \"min_time\": %g,\n", bench_min_time);
+    fprintf(fp, "    \"repetitions\": %d\n", bench_repetitions);
+    fprintf(fp, "  },\n  \"benchmarks\": [\n");
+    for (int j = 0; j < bench_numresults; j++) {
+        benchResult *r = &bench_results[j];
+        fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %lld, \"real_time\": %.3f, "
+                    "\"mean_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.1f, ",
+            r->name, r->iterations, r->ns_per_op, r->mean_ns_per_op,
+            r->ns_per_op > 0 ? 1e9 / r->ns_per_op : 0.0);
+        if (r->allocs_per_op >= 0) fprintf(fp, "\"allocs_per_op\": %.3f, ", r->allocs_per_op);
+        if (r->bytes_per_item > 0) fprintf(fp, "\"bytes_per_item\": %.1f, ", r->bytes_per_item);
+        fprintf(fp, "\"repetitions\": %d}%s\n", r->repetitions, j == bench_numresults - 1 ? "" : ",");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+int benchReport(const char *suite)
+{
+    if (bench_json) benchWriteJson(stdout, suite);
+    if (bench_out) {
+        FILE *fp = fopen(bench_out, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "can't open %s\n", bench_out);
+            return -1;
+        }
+        benchWriteJson(fp, suite);
+        fclose(fp);
+    }
+    return 0;
+}
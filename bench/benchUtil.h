@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/23
+ * All rights reserved. No one may copy or transfer.
+ * Description: 微基准公共部分：命令行参数、计时、按参数组合运行用例，
+ * 以及结果输出（控制台表格 + JSON，JSON格式与google benchmark的输出接近，
+ * 便于在不同版本之间对比回归）。
+ * 通用参数：
+ *   --filter=SUBSTR     只运行名称包含SUBSTR的用例
+ *   --min-time=SECONDS  每次重复的最短计时（默认0.1秒）
+ *   --repetitions=N     重复次数，取最快的一次（默认3）
+ *   --out=FILE          把JSON结果写到FILE
+ *   --format=json       JSON输出到标准输出（默认console）
+ */
+#ifndef REDIS_BENCH_BENCHUTIL_H
+#define REDIS_BENCH_BENCHUTIL_H
+#include <stdio.h>
+#include <stdint.h>
+#include "sds.h"
+
+#define BENCH_MAX_RESULTS 1024
+#define BENCH_NAME_LEN 128
+#define BENCH_DEFAULT_MIN_TIME 0.1
+#define BENCH_DEFAULT_REPETITIONS 3
+#define BENCH_MAX_PARAMS 4
+
+/* 一个用例的结果 */
+typedef struct benchResult {
+    char name[BENCH_NAME_LEN];  /* 用例名/参数，例如 dictFind/keylen:16/n:100000 */
+    long long iterations;       /* 最快一次重复里执行的操作数 */
+    double ns_per_op;           /* 最快一次重复的每操作耗时 */
+    double mean_ns_per_op;      /* 所有重复的平均每操作耗时 */
+    double bytes_per_item;      /* 用例报告的每元素内存占用，0表示不报告 */
+    double allocs_per_op;       /* run里每操作的zmalloc分配次数（所有标签），负数表示未统计 */
+    int repetitions;
+} benchResult;
+
+/* 一个参数组合的运行上下文 */
+typedef struct benchCtx {
+    long long n;                /* 基数：每批插入/查找的元素个数 */
+    int keylen;                 /* 键长度，0表示用例不使用字符串键 */
+    sds *keys;                  /* n个互不相同、长度为keylen的键 */
+    long long *order;           /* 0..n-1的固定随机排列，查找按此顺序访问 */
+    void *obj;                  /* 被测的结构 */
+    void *aux;                  /* 用例自己的额外数据 */
+    double bytes_per_item;      /* 用例在prepare里测得的每元素内存占用（可选） */
+} benchCtx;
+
+/* 一个基准用例。run计时，其余不计时；两批之间调用reset（可为NULL）。 */
+typedef struct benchDef {
+    const char *name;
+    long long cards[BENCH_MAX_PARAMS];  /* 基数取值，0结束 */
+    int keylens[BENCH_MAX_PARAMS];      /* 键长取值，0结束；全为0表示不生成键 */
+    void (*prepare)(benchCtx *ctx);
+    long long (*run)(benchCtx *ctx);    /* 返回本批执行的操作数 */
+    void (*reset)(benchCtx *ctx);
+    void (*cleanup)(benchCtx *ctx);
+} benchDef;
+
+/**
+ * 解析通用参数。
+ * @param argc main的argc
+ * @param argv main的argv
+ * @return 第一个非"--"开头参数的下标，没有则返回argc
+ */
+int benchParseArgs(int argc, char **argv);
+
+/**
+ * 获取单调时钟纳秒数。
+ */
+long long benchNanoseconds(void);
+
+/**
+ * 用例名是否匹配--filter。
+ */
+int benchSelected(const char *name);
+
+/**
+ * 当前配置的重复次数
+ */
+int benchRepetitions(void);
+
+/**
+ * 记录一个结果。
+ * @param name 用例名
+ * @param iterations 最快一次重复的操作数
+ * @param best_ns 最快一次重复的总耗时（纳秒）
+ * @param total_ns 所有重复的总耗时（纳秒）
+ * @param total_ops 所有重复的总操作数
+ */
+void benchAddResult(const char *name, long long iterations, long long best_ns, long long total_ns, long long total_ops);
+
+/**
+ * 对def的每个基数/键长组合运行一次：生成键、prepare、重复计时、cleanup。
+ * @param def 用例
+ */
+void benchRunDef(const benchDef *def);
+
+/**
+ * 输出所有结果：控制台表格或JSON到标准输出，以及--out指定的JSON文件。
+ * @param suite 基准程序名，写入JSON的context
+ * @return 成功返回0，写文件失败返回-1
+ */
+int benchReport(const char *suite);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/08/04
+ * All rights reserved. No one may copy or transfer.
+ * Description: 全键空间遍历的基准：单游标dictScan与dictScanParallel分区并行扫描。
+ * 默认5000万个键（按摘要计算的方式对每个键做一次哈希累加），
+ * 对比单游标与1到16个线程的并行扫描，结果为每个键的耗时。
+ * 用法：benchDictScan [--filter=...] [--out=result.json] [--format=json] [键数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "zmallocDf.h"
+#include "sds.h"
+#include "dict.h"
+#include "zskiplist.h"
+#include "zset.h"
+#include "benchUtil.h"
+using namespace REDIS_BASE;
+
+#define BENCH_DEFAULT_KEYS 50000000
+#define BENCH_MAX_THREADS 16
+
+static sdsCreate sdsCrt;
+static dictionaryCreate dictCrt;
+static zsetCreate zsetCrt;
+
+static long long bench_keys = BENCH_DEFAULT_KEYS;
+
+// 每个线程一份累加结果，按缓存行对齐避免伪共享
+typedef struct benchScanAcc {
+    uint64_t digest;
+    long long visited;
+    char pad[64 - sizeof(uint64_t) - sizeof(long long)];
+} benchScanAcc;
+
+// 类似computeDatasetDigest：对键内容做一次哈希，再异或进摘要
+static void benchScanCallback(void *privdata, const dictEntry *de)
+{
+    benchScanAcc *acc = static_cast<benchScanAcc*>(privdata);
+    sds key = static_cast<sds>(dictGetKey(de));
+    acc->digest ^= dictCrt.dictGenHashFunction(key, sdsCrt.sdslen(key));
+    acc->visited++;
+}
+
+typedef struct benchBulkSource {
+    long long next;
+} benchBulkSource;
+
+static int benchBulkNext(void *privdata, void **key, void **val)
+{
+    benchBulkSource *src = static_cast<benchBulkSource*>(privdata);
+    if (src->next == bench_keys) return 0;
+    *key = sdsCrt.sdsfromlonglong(src->next++ * 7919);
+    *val = NULL;
+    return 1;
+}
+
+// threads为0表示单游标dictScan
+static long long benchScanOnce(dict *d, int threads)
+{
+    benchScanAcc accs[BENCH_MAX_THREADS];
+    void *privdata[BENCH_MAX_THREADS];
+    long long visited = 0;
+
+    memset(accs, 0, sizeof(accs));
+    for (int t = 0; t < BENCH_MAX_THREADS; t++) privdata[t] = &accs[t];
+
+    long long start = benchNanoseconds();
+    if (threads == 0) {
+        unsigned long v = 0;
+        do {
+            v = dictCrt.dictScan(d, v, benchScanCallback, NULL, &accs[0]);
+        } while (v);
+        threads = 1;
+    } else {
+        threads = dictCrt.dictScanParallel(d, threads, benchScanCallback, privdata);
+    }
+    long long elapsed = benchNanoseconds() - start;
+
+    for (int t = 0; t < threads; t++) visited += accs[t].visited;
+    if (visited != bench_keys) {
+        fprintf(stderr, "scan visited %lld of %lld keys\n", visited, bench_keys);
+        exit(1);
+    }
+    return elapsed;
+}
+
+static void benchCase(dict *d, const char *kind, int threads)
+{
+    char name[BENCH_NAME_LEN];
+
+    if (threads == 0)
+        snprintf(name, sizeof(name), "%s/keys:%lld", kind, bench_keys);
+    else
+        snprintf(name, sizeof(name), "%s/keys:%lld/threads:%d", kind, bench_keys, threads);
+    if (!benchSelected(name)) return;
+
+    long long best = -1, total = 0;
+    for (int r = 0; r < benchRepetitions(); r++) {
+        long long elapsed = benchScanOnce(d, threads);
+        if (best < 0 || elapsed < best) best = elapsed;
+        total += elapsed;
+    }
+    benchAddResult(name, bench_keys, best, total, bench_keys * benchRepetitions());
+}
+
+int main(int argc, char **argv)
+{
+    int argj = benchParseArgs(argc, argv);
+    if (argj < argc) bench_keys = atoll(argv[argj]);
+    if (bench_keys <= 0) bench_keys = BENCH_DEFAULT_KEYS;
+
+    dict *d = dictCrt.dictCreate(&zsetCrt.hashDictType, NULL);
+    benchBulkSource src = {0};
+    dictCrt.dictBulkLoad(d, bench_keys, benchBulkNext, &src, DICT_BULK_UNIQUE, 1);
+
+    benchCase(d, "dictScan", 0);
+    for (int threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2)
+        benchCase(d, "dictScanParallel", threads);
+
+    dictCrt.dictRelease(d);
+    return benchReport("benchDictScan") == 0 ? 0 : 1;
+}
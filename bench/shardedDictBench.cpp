@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/28
+ * All rights reserved. No one may copy or transfer.
+ * Description: 分片字典的多线程扩展性基准
+ * 1到32个线程并发访问同一个键空间，对比"一个dict + 一把全局锁"与分片字典，
+ * 负载为纯查找（find）以及90%查找+10%替换（mixed）。
+ * 结果是总耗时除以所有线程的总操作数，线程数翻倍而ns/op减半即线性扩展。
+ * 用法：benchShardedDict [--filter=...] [--out=result.json] [--format=json] [每线程操作数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "zmallocDf.h"
+#include "sds.h"
+#include "dict.h"
+#include "zskiplist.h"
+#include "zset.h"
+#include "shardedDict.h"
+#include "benchUtil.h"
+using namespace REDIS_BASE;
+
+#define BENCH_KEYS 1000000
+#define BENCH_DEFAULT_OPS_PER_THREAD 1000000
+#define BENCH_MAX_THREADS 32
+#define BENCH_MIXED_WRITE_PERCENT 10
+
+static sdsCreate sdsCrt;
+static dictionaryCreate dictCrt;
+static shardedDictionaryCreate shardedCrt;
+static zsetCreate zsetCrt;
+
+static long long bench_ops_per_thread = BENCH_DEFAULT_OPS_PER_THREAD;
+static sds *bench_keys;
+
+// 被测的键空间：global非NULL时是一个dict加一把全局锁，否则是分片字典
+typedef struct benchKeyspace {
+    dict *global;
+    pthread_mutex_t global_lock;
+    shardedDict *sd;
+} benchKeyspace;
+
+typedef struct benchThreadArg {
+    benchKeyspace *ks;
+    int id;
+    int write_percent;
+    volatile int *go;
+    uintptr_t sink;
+} benchThreadArg;
+
+static void *benchThreadMain(void *arg)
+{
+    benchThreadArg *a = static_cast<benchThreadArg*>(arg);
+    benchKeyspace *ks = a->ks;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL * (a->id + 1);
+    uintptr_t sink = 0;
+
+    while (!__atomic_load_n(a->go, __ATOMIC_ACQUIRE));
+    for (long long j = 0; j < bench_ops_per_thread; j++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        sds key = bench_keys[seed % BENCH_KEYS];
+        int write = (int)((seed >> 32) % 100) < a->write_percent;
+        if (ks->global) {
+            pthread_mutex_lock(&ks->global_lock);
+            if (write) dictCrt.dictReplace(ks->global, key, (void*)(uintptr_t)j);
+            else sink += (uintptr_t)dictCrt.dictFind(ks->global, key);
+            pthread_mutex_unlock(&ks->global_lock);
+        } else {
+            if (write) shardedCrt.shardedDictReplace(ks->sd, key, (void*)(uintptr_t)j);
+            else sink += (uintptr_t)shardedCrt.shardedDictFetchValue(ks->sd, key);
+        }
+    }
+    a->sink = sink;
+    return NULL;
+}
+
+// 所有线程就绪后同时开始，计时不包括创建线程
+static long long benchRunThreads(benchKeyspace *ks, int threads, int write_percent)
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+    benchThreadArg args[BENCH_MAX_THREADS];
+    volatile int go = 0;
+
+    for (int t = 0; t < threads; t++) {
+        args[t].ks = ks;
+        args[t].id = t;
+        args[t].write_percent = write_percent;
+        args[t].go = &go;
+        pthread_create(&tids[t], NULL, benchThreadMain, &args[t]);
+    }
+    long long start = benchNanoseconds();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    return benchNanoseconds() - start;
+}
+
+static void benchCase(const char *kind, unsigned long shards, const char *load, int write_percent)
+{
+    char name[BENCH_NAME_LEN];
+    benchKeyspace ks;
+
+    memset(&ks, 0, sizeof(ks));
+    if (shards == 0) {
+        ks.global = dictCrt.dictCreate(&zsetCrt.zsetDictType, NULL);
+        pthread_mutex_init(&ks.global_lock, NULL);
+        for (long long j = 0; j < BENCH_KEYS; j++) dictCrt.dictAdd(ks.global, bench_keys[j], NULL);
+    } else {
+        ks.sd = shardedCrt.shardedDictCreate(&zsetCrt.zsetDictType, NULL, shards);
+        for (long long j = 0; j < BENCH_KEYS; j++) shardedCrt.shardedDictAdd(ks.sd, bench_keys[j], NULL);
+    }
+
+    for (int threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        if (shards == 0)
+            snprintf(name, sizeof(name), "%s/%s/threads:%d", kind, load, threads);
+        else
+            snprintf(name, sizeof(name), "%s/%s/shards:%lu/threads:%d", kind, load, shards, threads);
+        if (!benchSelected(name)) continue;
+
+        long long ops = bench_ops_per_thread * threads, best = -1, total = 0;
+        for (int r = 0; r < benchRepetitions(); r++) {
+            long long elapsed = benchRunThreads(&ks, threads, write_percent);
+            if (best < 0 || elapsed < best) best = elapsed;
+            total += elapsed;
+        }
+        benchAddResult(name, ops, best, total, ops * benchRepetitions());
+    }
+
+    if (shards == 0) {
+        dictCrt.dictRelease(ks.global);
+        pthread_mutex_destroy(&ks.global_lock);
+    } else {
+        shardedCrt.shardedDictRelease(ks.sd);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int argj = benchParseArgs(argc, argv);
+    if (argj < argc) bench_ops_per_thread = atoll(argv[argj]);
+    if (bench_ops_per_thread <= 0) bench_ops_per_thread = BENCH_DEFAULT_OPS_PER_THREAD;
+
+    bench_keys = static_cast<sds*>(zmalloc(sizeof(sds) * BENCH_KEYS));
+    for (long long j = 0; j < BENCH_KEYS; j++) bench_keys[j] = sdsCrt.sdsfromlonglong(j * 7919);
+
+    benchCase("globalLockDict", 0, "find", 0);
+    benchCase("globalLockDict", 0, "mixed", BENCH_MIXED_WRITE_PERCENT);
+    benchCase("shardedDict", 16, "find", 0);
+    benchCase("shardedDict", 16, "mixed", BENCH_MIXED_WRITE_PERCENT);
+    benchCase("shardedDict", DICT_SHARDS_DEFAULT, "find", 0);
+    benchCase("shardedDict", DICT_SHARDS_DEFAULT, "mixed", BENCH_MIXED_WRITE_PERCENT);
+    benchCase("shardedDict", 1024, "find", 0);
+    benchCase("shardedDict", 1024, "mixed", BENCH_MIXED_WRITE_PERCENT);
+
+    for (long long j = 0; j < BENCH_KEYS; j++) sdsCrt.sdsfree(bench_keys[j]);
+    zfree(bench_keys);
+    return benchReport("benchShardedDict") == 0 ? 0 : 1;
+}
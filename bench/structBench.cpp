@@ -0,0 +1,1014 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/23
+ * All rights reserved. No one may copy or transfer.
+ * Description: 基础结构微基准：dict、sds、ziplist、listpack、quicklist、intset、
+ * zskiplist、rax、stream的插入与查找，按键长和基数组合运行。
+ * 用法：benchStructs [--filter=dictFind] [--out=result.json] [--format=json]
+ * 每个xxxAdd/Push用例一批从空结构插入n个元素，xxxFind/Index用例一批按固定的随机
+ * 顺序查找n次，结果均为每个元素的耗时。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "zmallocDf.h"
+#include "sds.h"
+#include "dict.h"
+#include "zskiplist.h"
+#include "zset.h"
+#include "ziplist.h"
+#include "listPack.h"
+#include "quicklist.h"
+#include "intset.h"
+#include "rax.h"
+#include "stream.h"
+#include "redisObject.h"
+#include "toolFunc.h"
+#include "benchUtil.h"
+using namespace REDIS_BASE;
+
+static sdsCreate sdsCrt;
+static dictionaryCreate dictCrt;
+static zsetCreate zsetCrt;
+static ziplistCreate ziplistCrt;
+static listPackCreate lpCrt;
+static quicklistCreate quicklistCrt;
+static intsetCreate intsetCrt;
+static zskiplistCreate zslCrt;
+static raxCreate raxCrt;
+static streamCreate streamCrt;
+static redisObjectCreate objCrt;
+
+// 防止编译器把查找结果整体优化掉
+static volatile uintptr_t bench_sink;
+
+/*------------------------------ dict ------------------------------*/
+// 键由上下文持有，dict只保存指针，不复制也不释放
+static void dictPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = dictCrt.dictCreate(&zsetCrt.zsetDictType, NULL);
+}
+
+static void dictPrepareFull(benchCtx *ctx)
+{
+    size_t before = zmalloc_used_memory();
+    dictPrepareEmpty(ctx);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictAdd(static_cast<dict*>(ctx->obj), ctx->keys[j], NULL);
+    ctx->bytes_per_item = (double)(zmalloc_used_memory() - before) / ctx->n;
+}
+
+// 条目从字典自己的slab分配（DICT_TYPE_ENTRY_POOL）
+static dictType dict_pool_type;
+
+static void dictPoolPrepareEmpty(benchCtx *ctx)
+{
+    dict_pool_type = zsetCrt.zsetDictType;
+    dict_pool_type.flags = DICT_TYPE_ENTRY_POOL;
+    ctx->obj = dictCrt.dictCreate(&dict_pool_type, NULL);
+}
+
+static void dictPoolPrepareFull(benchCtx *ctx)
+{
+    size_t before = zmalloc_used_memory();
+    dictPoolPrepareEmpty(ctx);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictAdd(static_cast<dict*>(ctx->obj), ctx->keys[j], NULL);
+    ctx->bytes_per_item = (double)(zmalloc_used_memory() - before) / ctx->n;
+}
+
+static void dictPoolReset(benchCtx *ctx)
+{
+    dictCrt.dictRelease(static_cast<dict*>(ctx->obj));
+    dictPoolPrepareEmpty(ctx);
+}
+
+// 一批删除全部n个键再按原顺序插回，条目在slab间反复释放和分配
+static long long dictRunDeleteAdd(benchCtx *ctx)
+{
+    dict *d = static_cast<dict*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictDelete(d, ctx->keys[ctx->order[j]]);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictAdd(d, ctx->keys[j], NULL);
+    return ctx->n * 2;
+}
+
+typedef struct benchBulkSource {
+    benchCtx *ctx;
+    long long next;
+} benchBulkSource;
+
+static int dictBulkNext(void *privdata, void **key, void **val)
+{
+    benchBulkSource *src = static_cast<benchBulkSource*>(privdata);
+    if (src->next == src->ctx->n) return 0;
+    *key = src->ctx->keys[src->next++];
+    *val = NULL;
+    return 1;
+}
+
+// 用dictBulkLoad从空字典一次装入n个键，与dictAdd/dictSwissAdd逐个插入对比
+static long long dictRunBulkLoad(benchCtx *ctx, int threads)
+{
+    benchBulkSource src = {ctx, 0};
+    dictCrt.dictBulkLoad(static_cast<dict*>(ctx->obj), ctx->n, dictBulkNext, &src, DICT_BULK_UNIQUE, threads);
+    return ctx->n;
+}
+
+static long long dictRunBulkLoad1(benchCtx *ctx)
+{
+    return dictRunBulkLoad(ctx, 1);
+}
+
+static long long dictRunBulkLoad4(benchCtx *ctx)
+{
+    return dictRunBulkLoad(ctx, 4);
+}
+
+static void dictSwissPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = dictCrt.dictCreateSwiss(&zsetCrt.zsetDictType, NULL);
+}
+
+static void dictSwissPrepareFull(benchCtx *ctx)
+{
+    dictSwissPrepareEmpty(ctx);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictAdd(static_cast<dict*>(ctx->obj), ctx->keys[j], NULL);
+}
+
+static void dictCleanup(benchCtx *ctx)
+{
+    dictCrt.dictRelease(static_cast<dict*>(ctx->obj));
+}
+
+static void dictReset(benchCtx *ctx)
+{
+    dictCleanup(ctx);
+    dictPrepareEmpty(ctx);
+}
+
+static void dictSwissReset(benchCtx *ctx)
+{
+    dictCleanup(ctx);
+    dictSwissPrepareEmpty(ctx);
+}
+
+static long long dictRunAdd(benchCtx *ctx)
+{
+    dict *d = static_cast<dict*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        dictCrt.dictAdd(d, ctx->keys[j], NULL);
+    return ctx->n;
+}
+
+static long long dictRunFind(benchCtx *ctx)
+{
+    dict *d = static_cast<dict*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = (uintptr_t)dictCrt.dictFind(d, ctx->keys[ctx->order[j]]);
+    return ctx->n;
+}
+
+// 按与dictFind相同的随机顺序，每batch个键调用一次dictFindBatch
+static long long dictRunFindBatch(benchCtx *ctx, unsigned long batch)
+{
+    dict *d = static_cast<dict*>(ctx->obj);
+    const void *keys[DICT_FIND_BATCH_MAX];
+    dictEntry *results[DICT_FIND_BATCH_MAX];
+    for (long long j = 0; j < ctx->n; j += batch) {
+        unsigned long cnt = ctx->n - j < (long long)batch ? ctx->n - j : batch;
+        for (unsigned long i = 0; i < cnt; i++) keys[i] = ctx->keys[ctx->order[j + i]];
+        dictCrt.dictFindBatch(d, keys, cnt, results);
+        bench_sink = (uintptr_t)results[0];
+    }
+    return ctx->n;
+}
+
+static long long dictRunFindBatch16(benchCtx *ctx)
+{
+    return dictRunFindBatch(ctx, 16);
+}
+
+static long long dictRunFindBatch64(benchCtx *ctx)
+{
+    return dictRunFindBatch(ctx, 64);
+}
+
+/*------------------------------ dict hash ------------------------------*/
+// 只计算dictGenHashFunction，以及换用wyhash/XXH3后的dictFind；清理时恢复SipHash
+static void hashPrepareSiphash(benchCtx *ctx)
+{
+    DICT_NOTUSED(ctx);
+    dictCrt.dictSetHashBackend(DICT_HASH_SIPHASH);
+}
+
+static void hashPrepareWyhash(benchCtx *ctx)
+{
+    DICT_NOTUSED(ctx);
+    dictCrt.dictSetHashBackend(DICT_HASH_WYHASH);
+}
+
+static void hashPrepareXxh3(benchCtx *ctx)
+{
+    DICT_NOTUSED(ctx);
+    dictCrt.dictSetHashBackend(DICT_HASH_XXH3);
+}
+
+static void hashCleanup(benchCtx *ctx)
+{
+    DICT_NOTUSED(ctx);
+    dictCrt.dictSetHashBackend(DICT_HASH_SIPHASH);
+}
+
+static long long hashRun(benchCtx *ctx)
+{
+    uint64_t h = 0;
+    for (long long j = 0; j < ctx->n; j++)
+        h ^= dictCrt.dictGenHashFunction(ctx->keys[j], ctx->keylen);
+    bench_sink = (uintptr_t)h;
+    return ctx->n;
+}
+
+static void dictPrepareFullWyhash(benchCtx *ctx)
+{
+    hashPrepareWyhash(ctx);
+    dictPrepareFull(ctx);
+}
+
+static void dictPrepareFullXxh3(benchCtx *ctx)
+{
+    hashPrepareXxh3(ctx);
+    dictPrepareFull(ctx);
+}
+
+static void dictCleanupHash(benchCtx *ctx)
+{
+    dictCleanup(ctx);
+    hashCleanup(ctx);
+}
+
+/*------------------------------ dict entry layout ------------------------------*/
+// 字典拥有键的副本：普通布局、短键内嵌进条目（hashDictType）、内嵌且不存值（setDictType），
+// prepare里统计每个键的内存占用（条目+键+桶数组），查找与dictFind相同
+static dictType dict_plain_type;
+
+static void layoutPrepare(benchCtx *ctx, dictType *type)
+{
+    size_t before = zmalloc_used_memory();
+    dict *d = dictCrt.dictCreate(type, NULL);
+    for (long long j = 0; j < ctx->n; j++) {
+        sds key = sdsCrt.sdsdup(ctx->keys[j]);
+        if (dictCrt.dictAdd(d, key, NULL) != DICT_OK) sdsCrt.sdsfree(key);
+    }
+    ctx->bytes_per_item = (double)(zmalloc_used_memory() - before) / dictSize(d);
+    ctx->obj = d;
+}
+
+static void layoutPreparePlain(benchCtx *ctx)
+{
+    dict_plain_type = zsetCrt.hashDictType;
+    dict_plain_type.flags = 0;
+    layoutPrepare(ctx, &dict_plain_type);
+}
+
+static void layoutPrepareEmbed(benchCtx *ctx)
+{
+    layoutPrepare(ctx, &zsetCrt.hashDictType);
+}
+
+static void layoutPrepareSet(benchCtx *ctx)
+{
+    layoutPrepare(ctx, &objCrt.setDictType);
+}
+
+/*------------------------------ sds ------------------------------*/
+// 一批往同一个sds上追加n次keylen字节
+static void sdsPrepare(benchCtx *ctx)
+{
+    ctx->obj = sdsCrt.sdsempty();
+}
+
+static void sdsCleanup(benchCtx *ctx)
+{
+    sdsCrt.sdsfree(static_cast<sds>(ctx->obj));
+}
+
+static void sdsReset(benchCtx *ctx)
+{
+    sdsCleanup(ctx);
+    sdsPrepare(ctx);
+}
+
+static long long sdsRunCatlen(benchCtx *ctx)
+{
+    sds s = static_cast<sds>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        s = sdsCrt.sdscatlen(s, ctx->keys[j], ctx->keylen);
+    ctx->obj = s;
+    return ctx->n;
+}
+
+// 与sdscatlen相同的追加，但按指定增长模式扩容，allocs/op即每次追加的平均分配次数
+static long long sdsRunGrow(benchCtx *ctx, int mode)
+{
+    sds s = static_cast<sds>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++) {
+        s = sdsCrt.sdsMakeRoomForMode(s, ctx->keylen, mode);
+        memcpy(s + sdsCrt.sdslen(s), ctx->keys[j], ctx->keylen);
+        sdsCrt.sdsIncrLen(s, ctx->keylen);
+    }
+    ctx->obj = s;
+    return ctx->n;
+}
+
+static long long sdsRunGrowExact(benchCtx *ctx)
+{
+    return sdsRunGrow(ctx, SDS_GROW_EXACT);
+}
+
+static long long sdsRunGrowBounded(benchCtx *ctx)
+{
+    return sdsRunGrow(ctx, SDS_GROW_BOUNDED);
+}
+
+// 由n个键拼成的一整行，键之间用sep分隔，按每个token计时
+static void sdsPrepareLine(benchCtx *ctx, const char *sep)
+{
+    sds line = sdsCrt.sdsempty();
+    for (long long j = 0; j < ctx->n; j++) {
+        if (j) line = sdsCrt.sdscat(line, sep);
+        line = sdsCrt.sdscatlen(line, ctx->keys[j], ctx->keylen);
+    }
+    ctx->obj = line;
+}
+
+static void sdsPrepareSpaceLine(benchCtx *ctx)
+{
+    sdsPrepareLine(ctx, " ");
+}
+
+static void sdsPrepareCommaLine(benchCtx *ctx)
+{
+    sdsPrepareLine(ctx, ", ");
+}
+
+static long long sdsRunSplitlen(benchCtx *ctx, const char *sep, int seplen)
+{
+    sds line = static_cast<sds>(ctx->obj);
+    int count;
+    sds *tokens = sdsCrt.sdssplitlen(line, sdsCrt.sdslen(line), sep, seplen, &count);
+    sdsCrt.sdsfreesplitres(tokens, count);
+    return count;
+}
+
+static long long sdsRunSplitSpace(benchCtx *ctx)
+{
+    return sdsRunSplitlen(ctx, " ", 1);
+}
+
+static long long sdsRunSplitComma(benchCtx *ctx)
+{
+    return sdsRunSplitlen(ctx, ", ", 2);
+}
+
+static long long sdsRunSplitargs(benchCtx *ctx)
+{
+    int argc;
+    sds *argv = sdsCrt.sdssplitargs(static_cast<sds>(ctx->obj), &argc);
+    sdsCrt.sdsfreesplitres(argv, argc);
+    return argc;
+}
+
+// 去掉首字节取子串（类似解析"[member"这样的范围参数）：复制成新sds与只取视图对比
+static long long sdsRunSubstrCopy(benchCtx *ctx)
+{
+    for (long long j = 0; j < ctx->n; j++) {
+        sds sub = sdsCrt.sdsnewlen(ctx->keys[j] + 1, ctx->keylen - 1);
+        bench_sink = (uintptr_t)sub[0];
+        sdsCrt.sdsfree(sub);
+    }
+    return ctx->n;
+}
+
+static long long sdsRunSubstrView(benchCtx *ctx)
+{
+    for (long long j = 0; j < ctx->n; j++) {
+        sdsview sub = sdsCrt.sdsviewrange(sdsCrt.sdsviewfromsds(ctx->keys[j]), 1, -1);
+        bench_sink = (uintptr_t)sub.ptr[0];
+    }
+    return ctx->n;
+}
+
+// 把一整行切成视图，token数组在prepare里分配
+static void sdsPrepareSplitView(benchCtx *ctx)
+{
+    sdsPrepareSpaceLine(ctx);
+    ctx->aux = zmalloc(sizeof(sdsview) * ctx->n);
+}
+
+static void sdsCleanupSplitView(benchCtx *ctx)
+{
+    sdsCleanup(ctx);
+    zfree(ctx->aux);
+}
+
+static long long sdsRunSplitView(benchCtx *ctx)
+{
+    sdsview *tokens = static_cast<sdsview*>(ctx->aux);
+    int count = sdsCrt.sdssplitview(sdsCrt.sdsviewfromsds(static_cast<sds>(ctx->obj)), " ", 1,
+                                    tokens, (int)ctx->n);
+    bench_sink = (uintptr_t)tokens[count - 1].ptr;
+    return count;
+}
+
+// 整行放进共享缓冲区，按token切片后各自释放
+static void sdsPrepareShared(benchCtx *ctx)
+{
+    sdsPrepareSpaceLine(ctx);
+    ctx->obj = sdsCrt.sdssharednew(static_cast<sds>(ctx->obj));
+}
+
+static void sdsCleanupShared(benchCtx *ctx)
+{
+    sdsCrt.sdssharedrelease(static_cast<sdsshared*>(ctx->obj));
+}
+
+static long long sdsRunSlice(benchCtx *ctx)
+{
+    sdsshared *sh = static_cast<sdsshared*>(ctx->obj);
+    size_t stride = ctx->keylen + 1;
+    for (long long j = 0; j < ctx->n; j++) {
+        sdsslice sl = sdsCrt.sdsslicenew(sh, j * stride, ctx->keylen);
+        bench_sink = (uintptr_t)sdsCrt.sdssliceview(&sl).ptr;
+        sdsCrt.sdsslicefree(&sl);
+    }
+    return ctx->n;
+}
+
+/*------------------------------ 数字格式化 ------------------------------*/
+// n个数值，整数的位数从1到19均匀分布，浮点数是两位小数的分数（类似zset的score）
+static void numPrepare(benchCtx *ctx)
+{
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    long long *ints = static_cast<long long*>(zmalloc(sizeof(long long) * ctx->n));
+    double *dbls = static_cast<double*>(zmalloc(sizeof(double) * ctx->n));
+    for (long long j = 0; j < ctx->n; j++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        ints[j] = (long long)((seed >> 1) >> (seed % 60));
+        if (j & 1) ints[j] = -ints[j];
+        dbls[j] = (double)(long long)(seed % 100000000) / 100;
+    }
+    ctx->obj = ints;
+    ctx->aux = dbls;
+}
+
+static void numCleanup(benchCtx *ctx)
+{
+    zfree(ctx->obj);
+    zfree(ctx->aux);
+}
+
+static long long numRunLl2string(benchCtx *ctx)
+{
+    const long long *ints = static_cast<long long*>(ctx->obj);
+    char buf[32];
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = toolFunc::ll2string(buf, sizeof(buf), ints[j]);
+    return ctx->n;
+}
+
+static long long numRunSnprintfLl(benchCtx *ctx)
+{
+    const long long *ints = static_cast<long long*>(ctx->obj);
+    char buf[32];
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = snprintf(buf, sizeof(buf), "%lld", ints[j]);
+    return ctx->n;
+}
+
+static long long numRunD2string(benchCtx *ctx)
+{
+    const double *dbls = static_cast<double*>(ctx->aux);
+    char buf[TOOL_D2STRING_MAX];
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = toolFunc::d2string(buf, sizeof(buf), dbls[j]);
+    return ctx->n;
+}
+
+static long long numRunSnprintfDouble(benchCtx *ctx)
+{
+    const double *dbls = static_cast<double*>(ctx->aux);
+    char buf[TOOL_D2STRING_MAX];
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = snprintf(buf, sizeof(buf), "%.17g", dbls[j]);
+    return ctx->n;
+}
+
+// 回复序列化的典型形态：往同一个sds追加":<整数>\r\n"
+static long long numRunCatfmt(benchCtx *ctx)
+{
+    const long long *ints = static_cast<long long*>(ctx->obj);
+    sds s = sdsCrt.sdsempty();
+    for (long long j = 0; j < ctx->n; j++)
+        s = sdsCrt.sdscatfmt(s, ":%I\r\n", ints[j]);
+    bench_sink = sdsCrt.sdslen(s);
+    sdsCrt.sdsfree(s);
+    return ctx->n;
+}
+
+static long long numRunFromLonglong(benchCtx *ctx)
+{
+    const long long *ints = static_cast<long long*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++) {
+        sds s = sdsCrt.sdsfromlonglong(ints[j]);
+        bench_sink = (uintptr_t)s[0];
+        sdsCrt.sdsfree(s);
+    }
+    return ctx->n;
+}
+
+/*------------------------------ ziplist ------------------------------*/
+static void ziplistPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = ziplistCrt.ziplistNew();
+}
+
+static void ziplistPrepareFull(benchCtx *ctx)
+{
+    unsigned char *zl = ziplistCrt.ziplistNew();
+    for (long long j = 0; j < ctx->n; j++)
+        zl = ziplistCrt.ziplistPush(zl, (unsigned char*)ctx->keys[j], ctx->keylen, ZIPLIST_TAIL);
+    ctx->obj = zl;
+}
+
+static void ziplistCleanup(benchCtx *ctx)
+{
+    zfree(ctx->obj);
+}
+
+static void ziplistReset(benchCtx *ctx)
+{
+    ziplistCleanup(ctx);
+    ziplistPrepareEmpty(ctx);
+}
+
+static long long ziplistRunPush(benchCtx *ctx)
+{
+    unsigned char *zl = static_cast<unsigned char*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        zl = ziplistCrt.ziplistPush(zl, (unsigned char*)ctx->keys[j], ctx->keylen, ZIPLIST_TAIL);
+    ctx->obj = zl;
+    return ctx->n;
+}
+
+static long long ziplistRunFind(benchCtx *ctx)
+{
+    unsigned char *zl = static_cast<unsigned char*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++) {
+        sds key = ctx->keys[ctx->order[j]];
+        bench_sink = (uintptr_t)ziplistCrt.ziplistFind(zl, ziplistCrt.ziplistIndex(zl, 0),
+            (unsigned char*)key, ctx->keylen, 0);
+    }
+    return ctx->n;
+}
+
+/*------------------------------ listpack ------------------------------*/
+static void lpPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = lpCrt.lpNew(0);
+}
+
+static void lpPrepareFull(benchCtx *ctx)
+{
+    unsigned char *lp = lpCrt.lpNew(0);
+    for (long long j = 0; j < ctx->n; j++)
+        lp = lpCrt.lpAppend(lp, (unsigned char*)ctx->keys[j], ctx->keylen);
+    ctx->obj = lp;
+}
+
+static void lpCleanup(benchCtx *ctx)
+{
+    lpCrt.lpFree(static_cast<unsigned char*>(ctx->obj));
+}
+
+static void lpReset(benchCtx *ctx)
+{
+    lpCleanup(ctx);
+    lpPrepareEmpty(ctx);
+}
+
+static long long lpRunAppend(benchCtx *ctx)
+{
+    unsigned char *lp = static_cast<unsigned char*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        lp = lpCrt.lpAppend(lp, (unsigned char*)ctx->keys[j], ctx->keylen);
+    ctx->obj = lp;
+    return ctx->n;
+}
+
+static long long lpRunSeek(benchCtx *ctx)
+{
+    unsigned char *lp = static_cast<unsigned char*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = (uintptr_t)lpCrt.lpSeek(lp, (long)ctx->order[j]);
+    return ctx->n;
+}
+
+/*------------------------------ quicklist ------------------------------*/
+#define BENCH_QUICKLIST_FILL -2     /* 每个节点最多8KB，与redis默认配置一致 */
+
+static void quicklistPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = quicklistCrt.quicklistNew(BENCH_QUICKLIST_FILL, 0);
+}
+
+static void quicklistPrepareFull(benchCtx *ctx)
+{
+    quicklist *ql = quicklistCrt.quicklistNew(BENCH_QUICKLIST_FILL, 0);
+    for (long long j = 0; j < ctx->n; j++)
+        quicklistCrt.quicklistPushTail(ql, ctx->keys[j], ctx->keylen);
+    ctx->obj = ql;
+}
+
+static void quicklistCleanup(benchCtx *ctx)
+{
+    quicklistCrt.quicklistRelease(static_cast<quicklist*>(ctx->obj));
+}
+
+static void quicklistReset(benchCtx *ctx)
+{
+    quicklistCleanup(ctx);
+    quicklistPrepareEmpty(ctx);
+}
+
+static long long quicklistRunPush(benchCtx *ctx)
+{
+    quicklist *ql = static_cast<quicklist*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        quicklistCrt.quicklistPush(ql, ctx->keys[j], ctx->keylen, QUICKLIST_TAIL);
+    return ctx->n;
+}
+
+static long long quicklistRunIndex(benchCtx *ctx)
+{
+    quicklist *ql = static_cast<quicklist*>(ctx->obj);
+    quicklistEntry entry;
+    for (long long j = 0; j < ctx->n; j++) {
+        quicklistCrt.quicklistIndex(ql, ctx->order[j], &entry);
+        bench_sink = (uintptr_t)entry.zi;
+    }
+    return ctx->n;
+}
+
+/*------------------------------ intset ------------------------------*/
+// 下标乘以奇数常数得到互不相同、分布在整个int64范围的值，intset使用64位编码
+static int64_t intsetValue(long long j)
+{
+    return (int64_t)((uint64_t)j * 0x9e3779b97f4a7c15ULL);
+}
+
+static void intsetPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = intsetCrt.intsetNew();
+}
+
+static void intsetPrepareFull(benchCtx *ctx)
+{
+    intset *is = intsetCrt.intsetNew();
+    for (long long j = 0; j < ctx->n; j++)
+        is = intsetCrt.intsetAdd(is, intsetValue(j), NULL);
+    ctx->obj = is;
+}
+
+static void intsetCleanup(benchCtx *ctx)
+{
+    zfree(ctx->obj);
+}
+
+static void intsetReset(benchCtx *ctx)
+{
+    intsetCleanup(ctx);
+    intsetPrepareEmpty(ctx);
+}
+
+static long long intsetRunAdd(benchCtx *ctx)
+{
+    intset *is = static_cast<intset*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        is = intsetCrt.intsetAdd(is, intsetValue(j), NULL);
+    ctx->obj = is;
+    return ctx->n;
+}
+
+static long long intsetRunFind(benchCtx *ctx)
+{
+    intset *is = static_cast<intset*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        bench_sink = intsetCrt.intsetFind(is, intsetValue(ctx->order[j]));
+    return ctx->n;
+}
+
+/*------------------------------ zskiplist ------------------------------*/
+// 跳跃表接管插入的sds，插入用例每批之前复制一份键（不计时）
+static void zslDupKeys(benchCtx *ctx)
+{
+    sds *copies = static_cast<sds*>(zmalloc(sizeof(sds) * ctx->n));
+    for (long long j = 0; j < ctx->n; j++) copies[j] = sdsCrt.sdsdup(ctx->keys[j]);
+    ctx->aux = copies;
+}
+
+static void zslPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = zslCrt.zslCreate();
+    zslDupKeys(ctx);
+}
+
+static void zslPrepareFull(benchCtx *ctx)
+{
+    zskiplist *zsl = zslCrt.zslCreate();
+    for (long long j = 0; j < ctx->n; j++)
+        zslCrt.zslInsert(zsl, (double)(j % 1000), sdsCrt.sdsdup(ctx->keys[j]));
+    ctx->obj = zsl;
+    ctx->aux = NULL;
+}
+
+static void zslCleanup(benchCtx *ctx)
+{
+    zslCrt.zslFree(static_cast<zskiplist*>(ctx->obj));
+    zfree(ctx->aux);
+}
+
+static void zslReset(benchCtx *ctx)
+{
+    zslCleanup(ctx);
+    zslPrepareEmpty(ctx);
+}
+
+static long long zslRunInsert(benchCtx *ctx)
+{
+    zskiplist *zsl = static_cast<zskiplist*>(ctx->obj);
+    sds *copies = static_cast<sds*>(ctx->aux);
+    for (long long j = 0; j < ctx->n; j++)
+        zslCrt.zslInsert(zsl, (double)(j % 1000), copies[j]);
+    return ctx->n;
+}
+
+static long long zslRunGetRank(benchCtx *ctx)
+{
+    zskiplist *zsl = static_cast<zskiplist*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++) {
+        long long idx = ctx->order[j];
+        bench_sink = zslCrt.zslGetRank(zsl, (double)(idx % 1000), ctx->keys[idx]);
+    }
+    return ctx->n;
+}
+
+// LRANGE整个列表：逐个元素sdscatlen到一个回复缓冲区，对照quicklistRangeToRope
+static long long quicklistRunRangeCatlen(benchCtx *ctx)
+{
+    quicklist *ql = static_cast<quicklist*>(ctx->obj);
+    quicklistIter *iter = quicklistCrt.quicklistGetIteratorAtIdx(ql, AL_START_HEAD, 0);
+    quicklistEntry entry;
+    char hdr[SDS_ROPE_LENHDR_MAX];
+    sds reply = sdsCrt.sdsempty();
+
+    hdr[0] = '*';
+    int len = 1 + toolFunc::ll2string(hdr + 1, SDS_LLSTR_SIZE, ctx->n);
+    reply = sdsCrt.sdscatlen(reply, hdr, len);
+    reply = sdsCrt.sdscatlen(reply, "\r\n", 2);
+    while (quicklistCrt.quicklistNext(iter, &entry)) {
+        char longstr[SDS_LLSTR_SIZE];
+        const void *val = entry.value;
+        size_t vlen = entry.sz;
+        if (val == NULL) {
+            vlen = toolFunc::ll2string(longstr, sizeof(longstr), entry.longval);
+            val = longstr;
+        }
+        hdr[0] = '$';
+        len = 1 + toolFunc::ll2string(hdr + 1, SDS_LLSTR_SIZE, vlen);
+        reply = sdsCrt.sdscatlen(reply, hdr, len);
+        reply = sdsCrt.sdscatlen(reply, "\r\n", 2);
+        reply = sdsCrt.sdscatlen(reply, val, vlen);
+        reply = sdsCrt.sdscatlen(reply, "\r\n", 2);
+    }
+    quicklistCrt.quicklistReleaseIterator(iter);
+    bench_sink = sdsCrt.sdslen(reply);
+    sdsCrt.sdsfree(reply);
+    return ctx->n;
+}
+
+// 模拟writev：每次取最多BENCH_IOV_MAX个iovec并全部"写出"
+#define BENCH_IOV_MAX 64
+static void benchDrainRope(sdsrope *r)
+{
+    struct iovec iov[BENCH_IOV_MAX];
+    int cnt;
+    while ((cnt = sdsCrt.sdsropeiov(r, iov, BENCH_IOV_MAX)) > 0) {
+        size_t nwritten = 0;
+        for (int j = 0; j < cnt; j++) nwritten += iov[j].iov_len;
+        sdsCrt.sdsropeconsume(r, nwritten);
+    }
+}
+
+static long long quicklistRunRangeRope(benchCtx *ctx)
+{
+    sdsrope r;
+    sdsCrt.sdsropeinit(&r);
+    quicklistCrt.quicklistRangeToRope(static_cast<quicklist*>(ctx->obj), 0, -1, &r);
+    bench_sink = sdsCrt.sdsropelen(&r);
+    benchDrainRope(&r);
+    sdsCrt.sdsropefree(&r);
+    return ctx->n;
+}
+
+static long long quicklistRunRangeRopeFlatten(benchCtx *ctx)
+{
+    sdsrope r;
+    sdsCrt.sdsropeinit(&r);
+    quicklistCrt.quicklistRangeToRope(static_cast<quicklist*>(ctx->obj), 0, -1, &r);
+    sds reply = sdsCrt.sdsropeflatten(&r);
+    bench_sink = sdsCrt.sdslen(reply);
+    sdsCrt.sdsfree(reply);
+    return ctx->n;
+}
+
+/*------------------------------ rax ------------------------------*/
+static void raxPrepareEmpty(benchCtx *ctx)
+{
+    ctx->obj = raxCrt.raxNew();
+}
+
+static void raxPrepareFull(benchCtx *ctx)
+{
+    rax *rt = raxCrt.raxNew();
+    for (long long j = 0; j < ctx->n; j++)
+        raxCrt.raxInsert(rt, (unsigned char*)ctx->keys[j], ctx->keylen, NULL, NULL);
+    ctx->obj = rt;
+}
+
+static void raxCleanup(benchCtx *ctx)
+{
+    raxCrt.raxFree(static_cast<rax*>(ctx->obj));
+}
+
+static void raxReset(benchCtx *ctx)
+{
+    raxCleanup(ctx);
+    raxPrepareEmpty(ctx);
+}
+
+static long long raxRunInsert(benchCtx *ctx)
+{
+    rax *rt = static_cast<rax*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++)
+        raxCrt.raxInsert(rt, (unsigned char*)ctx->keys[j], ctx->keylen, NULL, NULL);
+    return ctx->n;
+}
+
+static long long raxRunFind(benchCtx *ctx)
+{
+    rax *rt = static_cast<rax*>(ctx->obj);
+    for (long long j = 0; j < ctx->n; j++) {
+        sds key = ctx->keys[ctx->order[j]];
+        bench_sink = (uintptr_t)raxCrt.raxFind(rt, (unsigned char*)key, ctx->keylen);
+    }
+    return ctx->n;
+}
+
+/*------------------------------ stream ------------------------------*/
+// 每条消息一个字段，字段名固定，值为键；robj在prepare里创建一次
+static void streamPrepare(benchCtx *ctx)
+{
+    robj **argv = static_cast<robj**>(zmalloc(sizeof(robj*) * ctx->n * 2));
+    for (long long j = 0; j < ctx->n; j++) {
+        argv[j*2] = objCrt.createStringObject("field", 5);
+        argv[j*2+1] = objCrt.createStringObject(ctx->keys[j], ctx->keylen);
+    }
+    ctx->aux = argv;
+    ctx->obj = streamCrt.streamNew();
+}
+
+static void streamCleanup(benchCtx *ctx)
+{
+    robj **argv = static_cast<robj**>(ctx->aux);
+    streamCrt.freeStream(static_cast<stream*>(ctx->obj));
+    for (long long j = 0; j < ctx->n * 2; j++) objCrt.decrRefCount(argv[j]);
+    zfree(argv);
+}
+
+static void streamReset(benchCtx *ctx)
+{
+    streamCrt.freeStream(static_cast<stream*>(ctx->obj));
+    ctx->obj = streamCrt.streamNew();
+}
+
+static long long streamRunAppend(benchCtx *ctx)
+{
+    stream *s = static_cast<stream*>(ctx->obj);
+    robj **argv = static_cast<robj**>(ctx->aux);
+    streamID id;
+    for (long long j = 0; j < ctx->n; j++)
+        streamCrt.streamAppendItem(s, argv + j*2, 1, &id, NULL);
+    return ctx->n;
+}
+
+static void streamPrepareFull(benchCtx *ctx)
+{
+    streamPrepare(ctx);
+    streamRunAppend(ctx);
+}
+
+// XRANGE整个stream，按iovec写出
+static long long streamRunRange(benchCtx *ctx, int borrow)
+{
+    sdsrope r;
+    sdsCrt.sdsropeinit(&r);
+    streamCrt.streamRangeToRope(static_cast<stream*>(ctx->obj), NULL, NULL, 0, 0, &r, borrow);
+    bench_sink = sdsCrt.sdsropelen(&r);
+    benchDrainRope(&r);
+    sdsCrt.sdsropefree(&r);
+    return ctx->n;
+}
+
+static long long streamRunRangeRope(benchCtx *ctx)
+{
+    return streamRunRange(ctx, 0);
+}
+
+static long long streamRunRangeRopeBorrow(benchCtx *ctx)
+{
+    return streamRunRange(ctx, 1);
+}
+
+/* 紧凑编码（ziplist、listpack、intset）只测小基数，与实际转换阈值相当 */
+static const benchDef bench_defs[] = {
+    {"dictAdd",           {1000, 100000, 1000000}, {16, 64}, dictPrepareEmpty, dictRunAdd, dictReset, dictCleanup},
+    {"dictFind",          {1000, 100000, 1000000, 4000000}, {16, 64}, dictPrepareFull, dictRunFind, NULL, dictCleanup},
+    {"dictFindBatch16",   {1000, 100000, 1000000, 4000000}, {16, 64}, dictPrepareFull, dictRunFindBatch16, NULL, dictCleanup},
+    {"dictFindBatch64",   {1000, 100000, 1000000, 4000000}, {16, 64}, dictPrepareFull, dictRunFindBatch64, NULL, dictCleanup},
+    {"dictDeleteAdd",     {1000, 100000, 1000000}, {16},     dictPrepareFull, dictRunDeleteAdd, NULL, dictCleanup},
+    {"dictPoolAdd",       {1000, 100000, 1000000}, {16, 64}, dictPoolPrepareEmpty, dictRunAdd, dictPoolReset, dictCleanup},
+    {"dictPoolFind",      {1000, 100000, 1000000, 4000000}, {16, 64}, dictPoolPrepareFull, dictRunFind, NULL, dictCleanup},
+    {"dictPoolDeleteAdd", {1000, 100000, 1000000}, {16},     dictPoolPrepareFull, dictRunDeleteAdd, NULL, dictCleanup},
+    {"dictSwissAdd",      {1000, 100000, 1000000}, {16, 64}, dictSwissPrepareEmpty, dictRunAdd, dictSwissReset, dictCleanup},
+    {"dictBulkLoad",      {1000, 100000, 1000000}, {16, 64}, dictPrepareEmpty, dictRunBulkLoad1, dictReset, dictCleanup},
+    {"dictBulkLoad4",     {1000, 100000, 1000000}, {16, 64}, dictPrepareEmpty, dictRunBulkLoad4, dictReset, dictCleanup},
+    {"dictSwissBulkLoad", {1000, 100000, 1000000}, {16, 64}, dictSwissPrepareEmpty, dictRunBulkLoad1, dictSwissReset, dictCleanup},
+    {"dictSwissFind",     {1000, 100000, 1000000, 4000000}, {16, 64}, dictSwissPrepareFull, dictRunFind, NULL, dictCleanup},
+    {"dictSwissFindBatch16", {1000, 100000, 1000000, 4000000}, {16, 64}, dictSwissPrepareFull, dictRunFindBatch16, NULL, dictCleanup},
+    {"dictSwissFindBatch64", {1000, 100000, 1000000, 4000000}, {16, 64}, dictSwissPrepareFull, dictRunFindBatch64, NULL, dictCleanup},
+    {"dictHashSiphash",   {1000},                  {8, 16, 64, 256}, hashPrepareSiphash, hashRun, NULL, hashCleanup},
+    {"dictHashWyhash",    {1000},                  {8, 16, 64, 256}, hashPrepareWyhash, hashRun, NULL, hashCleanup},
+    {"dictHashXxh3",      {1000},                  {8, 16, 64, 256}, hashPrepareXxh3, hashRun, NULL, hashCleanup},
+    {"dictFindWyhash",    {1000, 1000000},         {16, 64}, dictPrepareFullWyhash, dictRunFind, NULL, dictCleanupHash},
+    {"dictFindXxh3",      {1000, 1000000},         {16, 64}, dictPrepareFullXxh3, dictRunFind, NULL, dictCleanupHash},
+    {"dictLayoutPlain",   {100000, 1000000},       {6, 16, 64}, layoutPreparePlain, dictRunFind, NULL, dictCleanup},
+    {"dictLayoutEmbed",   {100000, 1000000},       {6, 16, 64}, layoutPrepareEmbed, dictRunFind, NULL, dictCleanup},
+    {"dictLayoutSet",     {100000, 1000000},       {6, 16, 64}, layoutPrepareSet, dictRunFind, NULL, dictCleanup},
+    {"sdscatlen",         {1000, 100000},          {16, 64}, sdsPrepare, sdsRunCatlen, sdsReset, sdsCleanup},
+    {"sdscatlen",         {1000000},               {64},     sdsPrepare, sdsRunCatlen, sdsReset, sdsCleanup},
+    {"sdsGrowExact",      {1000, 100000},          {16, 64}, sdsPrepare, sdsRunGrowExact, sdsReset, sdsCleanup},
+    {"sdsGrowBounded",    {1000, 100000, 1000000}, {16, 64}, sdsPrepare, sdsRunGrowBounded, sdsReset, sdsCleanup},
+    {"sdssplitlen",       {64, 1024, 16384},       {16, 64}, sdsPrepareSpaceLine, sdsRunSplitSpace, NULL, sdsCleanup},
+    {"sdssplitlenMulti",  {64, 1024, 16384},       {16, 64}, sdsPrepareCommaLine, sdsRunSplitComma, NULL, sdsCleanup},
+    {"sdssplitargs",      {64, 1024, 16384},       {16, 64}, sdsPrepareSpaceLine, sdsRunSplitargs, NULL, sdsCleanup},
+    {"sdssplitview",      {64, 1024, 16384},       {16, 64}, sdsPrepareSplitView, sdsRunSplitView, NULL, sdsCleanupSplitView},
+    {"sdsSubstrCopy",     {1000},                  {16, 64}, sdsPrepare, sdsRunSubstrCopy, NULL, sdsCleanup},
+    {"sdsSubstrView",     {1000},                  {16, 64}, sdsPrepare, sdsRunSubstrView, NULL, sdsCleanup},
+    {"sdsSlice",          {1000},                  {16, 64}, sdsPrepareShared, sdsRunSlice, NULL, sdsCleanupShared},
+    {"ll2string",         {1000},                  {0},      numPrepare, numRunLl2string, NULL, numCleanup},
+    {"snprintfLl",        {1000},                  {0},      numPrepare, numRunSnprintfLl, NULL, numCleanup},
+    {"d2string",          {1000},                  {0},      numPrepare, numRunD2string, NULL, numCleanup},
+    {"snprintfDouble",    {1000},                  {0},      numPrepare, numRunSnprintfDouble, NULL, numCleanup},
+    {"sdscatfmtInt",      {1000},                  {0},      numPrepare, numRunCatfmt, NULL, numCleanup},
+    {"sdsfromlonglong",   {1000},                  {0},      numPrepare, numRunFromLonglong, NULL, numCleanup},
+    {"ziplistPush",       {64, 512, 4096},         {16, 64}, ziplistPrepareEmpty, ziplistRunPush, ziplistReset, ziplistCleanup},
+    {"ziplistFind",       {64, 512, 4096},         {16, 64}, ziplistPrepareFull, ziplistRunFind, NULL, ziplistCleanup},
+    {"lpAppend",          {64, 512, 4096},         {16, 64}, lpPrepareEmpty, lpRunAppend, lpReset, lpCleanup},
+    {"lpSeek",            {64, 512, 4096},         {16, 64}, lpPrepareFull, lpRunSeek, NULL, lpCleanup},
+    {"quicklistPush",     {1000, 100000},          {16, 64}, quicklistPrepareEmpty, quicklistRunPush, quicklistReset, quicklistCleanup},
+    {"quicklistIndex",    {1000, 100000},          {16, 64}, quicklistPrepareFull, quicklistRunIndex, NULL, quicklistCleanup},
+    {"quicklistRangeCatlen", {1000, 100000, 1000000}, {16, 256}, quicklistPrepareFull, quicklistRunRangeCatlen, NULL, quicklistCleanup},
+    {"quicklistRangeRope",   {1000, 100000, 1000000}, {16, 256}, quicklistPrepareFull, quicklistRunRangeRope, NULL, quicklistCleanup},
+    {"quicklistRangeRopeFlatten", {1000, 100000, 1000000}, {16, 256}, quicklistPrepareFull, quicklistRunRangeRopeFlatten, NULL, quicklistCleanup},
+    {"intsetAdd",         {64, 512, 4096},         {0},      intsetPrepareEmpty, intsetRunAdd, intsetReset, intsetCleanup},
+    {"intsetFind",        {64, 512, 4096},         {0},      intsetPrepareFull, intsetRunFind, NULL, intsetCleanup},
+    {"zslInsert",         {1000, 100000},          {16, 64}, zslPrepareEmpty, zslRunInsert, zslReset, zslCleanup},
+    {"zslGetRank",        {1000, 100000},          {16, 64}, zslPrepareFull, zslRunGetRank, NULL, zslCleanup},
+    {"raxInsert",         {1000, 100000},          {16, 64}, raxPrepareEmpty, raxRunInsert, raxReset, raxCleanup},
+    {"raxFind",           {1000, 100000},          {16, 64}, raxPrepareFull, raxRunFind, NULL, raxCleanup},
+    {"streamAppendItem",  {1000, 100000},          {16, 64}, streamPrepare, streamRunAppend, streamReset, streamCleanup},
+    {"streamRangeRope",   {1000, 100000},          {16, 256}, streamPrepareFull, streamRunRangeRope, NULL, streamCleanup},
+    {"streamRangeRopeBorrow", {1000, 100000},      {16, 256}, streamPrepareFull, streamRunRangeRopeBorrow, NULL, streamCleanup},
+};
+
+int main(int argc, char **argv)
+{
+    benchParseArgs(argc, argv);
+    for (size_t j = 0; j < sizeof(bench_defs)/sizeof(bench_defs[0]); j++)
+        benchRunDef(&bench_defs[j]);
+    return benchReport("benchStructs") == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/22
+ * All rights reserved. No one may copy or transfer.
+ * Description: zmalloc microbenchmark
+ * 测量单次分配+释放的开销：libc基线、zmallocDf.h宏（静态接口）、
+ * 以及旧的"延迟构造单例 + 判空"调用方式，
+ * 用法：benchZmalloc [--filter=...] [--out=result.json] [--format=json] [迭代次数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "zmallocDf.h"
+#include "benchUtil.h"
+using namespace REDIS_BASE;
+
+#define BENCH_DEFAULT_ITERATIONS 10000000
+#define BENCH_THREADS 4
+#define BENCH_ALLOC_SIZE 64
+
+static long long bench_iterations = BENCH_DEFAULT_ITERATIONS;
+
+// 旧的访问方式：每次调用都要读取全局指针并判空
+static zmalloc *legacy_instance = nullptr;
+static inline zmalloc *legacyGetInstance()
+{
+    if (legacy_instance == nullptr) legacy_instance = zmalloc::getInstance();
+    return legacy_instance;
+}
+
+// 防止编译器把分配和释放整体优化掉
+static void * volatile bench_sink;
+
+static void benchLibc(long long n)
+{
+    for (long long j = 0; j < n; j++) {
+        void *p = malloc(BENCH_ALLOC_SIZE);
+        bench_sink = p;
+        free(p);
+    }
+}
+
+static void benchStatic(long long n)
+{
+    for (long long j = 0; j < n; j++) {
+        void *p = zmalloc(BENCH_ALLOC_SIZE);
+        bench_sink = p;
+        zfree(p);
+    }
+}
+
+static void benchLegacy(long long n)
+{
+    for (long long j = 0; j < n; j++) {
+        void *p = legacyGetInstance()->zzmalloc(BENCH_ALLOC_SIZE);
+        bench_sink = p;
+        (legacyGetInstance()->zfree)(p);
+    }
+}
+
+static void benchCalloc(long long n)
+{
+    for (long long j = 0; j < n; j++) {
+        void *p = zcalloc(BENCH_ALLOC_SIZE);
+        bench_sink = p;
+        zfree(p);
+    }
+}
+
+static void benchRealloc(long long n)
+{
+    void *p = zmalloc(BENCH_ALLOC_SIZE);
+    for (long long j = 0; j < n; j++)
+        p = zrealloc(p, (j & 1) ? BENCH_ALLOC_SIZE : BENCH_ALLOC_SIZE*4);
+    bench_sink = p;
+    zfree(p);
+}
+
+static void *benchThreadMain(void *arg)
+{
+    benchStatic(*(long long*)arg);
+    return NULL;
+}
+
+static void benchThreads(long long n)
+{
+    pthread_t tids[BENCH_THREADS];
+    long long per_thread = n / BENCH_THREADS;
+    for (int j = 0; j < BENCH_THREADS; j++)
+        pthread_create(&tids[j], NULL, benchThreadMain, &per_thread);
+    for (int j = 0; j < BENCH_THREADS; j++)
+        pthread_join(tids[j], NULL);
+}
+
+// 重复多次取最快的一次，排除调度和其他进程的干扰
+static void benchRun(const char *name, void (*fn)(long long))
+{
+    long long best = -1, total = 0;
+    if (!benchSelected(name)) return;
+    fn(bench_iterations / 10);    // 预热：填满线程缓存、加载页
+    for (int j = 0; j < benchRepetitions(); j++) {
+        long long start = benchNanoseconds();
+        fn(bench_iterations);
+        long long elapsed = benchNanoseconds() - start;
+        if (best < 0 || elapsed < best) best = elapsed;
+        total += elapsed;
+    }
+    benchAddResult(name, bench_iterations, best, total, bench_iterations * benchRepetitions());
+}
+
+int main(int argc, char **argv)
+{
+    int argj = benchParseArgs(argc, argv);
+    if (argj < argc) bench_iterations = atoll(argv[argj]);
+    if (bench_iterations <= 0) bench_iterations = BENCH_DEFAULT_ITERATIONS;
+
+    benchRun("libcMalloc/size:64", benchLibc);
+    benchRun("zmalloc/size:64", benchStatic);
+    benchRun("zmallocLazySingleton/size:64", benchLegacy);
+    benchRun("zcalloc/size:64", benchCalloc);
+    benchRun("zrealloc/size:64-256", benchRealloc);
+    benchRun("zmalloc/size:64/threads:4", benchThreads);
+    return benchReport("benchZmalloc") == 0 ? 0 : 1;
+}
@@ -1,12 +1,30 @@
-#/* 
-# * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> 
+#!/bin/bash
+#/*
+# * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com>
 # * All rights reserved.
 # * Date: 2025/06/13
 # * Description: build project using this shell
+# * usage: ./build.sh [Release|RelWithDebInfo|Debug|MinSizeRel|pgo] [extra cmake args...]
+# *   pgo: 插桩构建 -> 运行基准程序采集profile -> 用profile重新构建（Release）
 # */
 
-sudo mkdir build
+BUILD_TYPE=${1:-Release}
+[ $# -gt 0 ] && shift
+
+if [ "$BUILD_TYPE" = "pgo" ]; then
+    sudo mkdir -p build-pgo
+    cd build-pgo
+    sudo cmake ../ -DCMAKE_BUILD_TYPE=Release -DREDIS_BUILD_BENCH=ON -DREDIS_PGO=GENERATE "$@" || exit 1
+    sudo make -j8 || exit 1
+    sudo make pgo-train || exit 1
+    sudo cmake ../ -DREDIS_PGO=USE || exit 1
+    sudo make -j8 || exit 1
+    sudo make install
+    exit 0
+fi
+
+sudo mkdir -p build
 cd build
-sudo cmake ../
+sudo cmake ../ -DCMAKE_BUILD_TYPE=$BUILD_TYPE "$@"
 sudo make -j8
 sudo make install
@@ -83,9 +83,11 @@
 #if __GNUC__ >= 3
 #define likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
+#define redis_prefetch(addr) __builtin_prefetch(addr)
 #else
 #define likely(x) (x)
 #define unlikely(x) (x)
+#define redis_prefetch(addr) ((void)(addr))
 #endif
 
 /* Define rdb_fsync_range to sync_file_range() on Linux, otherwise we use
@@ -37,10 +37,12 @@
 #define DICT_HT_INITIAL_SIZE     4
 
 #define dictFreeVal(d, entry) \
-    if ((d)->type->valDestructor) \
+    if ((d)->type->valDestructor && !((d)->type->flags & DICT_TYPE_NO_VALUE)) \
         (d)->type->valDestructor((d)->privdata, (entry)->v.val)
 
 #define dictSetVal(d, entry, _val_) do { \
+    if ((d)->type->flags & DICT_TYPE_NO_VALUE) \
+        break; \
     if ((d)->type->valDup) \
         (entry)->v.val = (d)->type->valDup((d)->privdata, _val_); \
     else \
@@ -55,7 +57,7 @@
 #define dictSetDoubleVal(entry, _val_) \
     do { (entry)->v.d = _val_; } while(0)
 #define dictFreeKey(d, entry) \
-    if ((d)->type->keyDestructor) \
+    if ((d)->type->keyDestructor && !dictEntryKeyIsEmbedded(d, entry)) \
         (d)->type->keyDestructor((d)->privdata, (entry)->key)
 #define dictSetKey(d, entry, _key_) do { \
     if ((d)->type->keyDup) \
@@ -76,10 +78,103 @@
 #define dictSlots(d) ((d)->ht[0].size+(d)->ht[1].size)
 #define dictSize(d) ((d)->ht[0].used+(d)->ht[1].used)
 #define dictIsRehashing(d) ((d)->rehashidx != -1)
+#define dictIsSwiss(d) ((d)->engine == DICT_ENGINE_SWISS)
+#define dictIsBgRehashing(d) ((d)->bgrehash == DICT_BG_REHASH_RUNNING)
 #define dictPauseRehashing(d) (d)->pauserehash++
 #define dictResumeRehashing(d) (d)->pauserehash--
 
 #define DICT_STATS_VECTLEN 50
+
+/* dictFindBatch每轮流水线处理的键数，更多的键分多轮处理 */
+#define DICT_FIND_BATCH_MAX 64
+
+/* dictBulkLoad的标志：DICT_BULK_UNIQUE表示调用方保证键互不相同且字典中不存在，跳过查重 */
+#define DICT_BULK_UNIQUE (1<<0)
+/* dictBulkLoad每次从迭代器取出、计算哈希并插入的键数；
+ * 多线程算哈希时每个线程至少分到DICT_BULK_THREAD_MIN个键，最多DICT_BULK_THREADS_MAX个线程 */
+#define DICT_BULK_CHUNK 65536
+#define DICT_BULK_THREAD_MIN 4096
+#define DICT_BULK_THREADS_MAX 16
+/* 插入时提前预取第i+DICT_BULK_PREFETCH个键的桶（或控制字节组） */
+#define DICT_BULK_PREFETCH 8
+
+/* dictScanParallel最多的线程数，以及每个线程平均分到的扫描分区数（分区多一些，线程间负载更均衡） */
+#define DICT_SCAN_THREADS_MAX 64
+#define DICT_SCAN_PARTS_PER_THREAD 16
+
+/* dictMetrics中dictFind探测长度直方图的格数，最后一格统计不短于DICT_METRICS_PROBE_BUCKETS-1的探测 */
+#define DICT_METRICS_PROBE_BUCKETS 8
+
+/* 后台rehash状态：PENDING表示已分配ht[1]、等下一次访问时交给后台线程 */
+#define DICT_BG_REHASH_NONE 0
+#define DICT_BG_REHASH_PENDING 1
+#define DICT_BG_REHASH_RUNNING 2
+/* 前台与后台线程交接用的条带锁个数（2的幂） */
+#define DICT_BG_REHASH_STRIPES 1024
+
+/* 分片字典：默认分片数与上限（2的幂）。哈希值先乘黄金分割常数再取高位选分片，
+ * 只有低32位有效的哈希函数也能均匀分散，且与分片内字典所用的低位不相关 */
+#define DICT_SHARDS_DEFAULT 64
+#define DICT_SHARDS_MAX 4096
+#define DICT_SHARD_MIX 0x9E3779B97F4A7C15ULL
+#define shardedDictNumShards(sd) ((sd)->numshards)
+#define shardedDictShardOf(sd, h) \
+    ((sd)->shardbits ? (unsigned long)(((uint64_t)(h) * DICT_SHARD_MIX) >> (64 - (sd)->shardbits)) : 0UL)
+
+/* dictType.flags
+ * DICT_TYPE_EMBED_KEYS：键是sds，不超过DICT_EMBED_KEY_MAX字节的键复制进条目尾部（sdshdr8），
+ *   查找时少一次指针跳转、每个键少一次分配。键的归属：字典拥有键（有keyDestructor、没有keyDup）时，
+ *   新增成功的dictAdd/dictAddRaw/dictReplace可能在返回前就释放传入的sds，调用者之后不能再用它，
+ *   需要的话从dictGetKey取；键已存在（没有新增）时传入的键不会被动，仍归调用者。
+ *   有keyDup或没有keyDestructor时只复制，传入的键保持不变；
+ * DICT_TYPE_NO_VALUE：集合类字典，条目不存值，dictSetVal不生效、dictGetVal不可用，
+ *   与EMBED_KEYS同用时不超过DICT_EMBED_VAL_KEY_MAX字节的键（sds type5）直接放在值字段里。
+ * DICT_TYPE_ENTRY_POOL：24字节的条目从字典自己的slab里分配，slab空了就归还，
+ *   dictRelease/dictEmpty按slab整块释放。内嵌在尾部的键使条目变长，这类条目仍用zmalloc。
+ * swiss引擎的槽位只有键和值，忽略这些标志。 */
+#define DICT_TYPE_EMBED_KEYS (1<<0)
+#define DICT_TYPE_NO_VALUE (1<<1)
+#define DICT_TYPE_ENTRY_POOL (1<<2)
+/* 条目池的slab从DICT_POOL_SLAB_MIN个条目开始，随总容量翻倍，最大DICT_POOL_SLAB_MAX个 */
+#define DICT_POOL_SLAB_MIN 16
+#define DICT_POOL_SLAB_MAX 1024
+#define DICT_EMBED_KEY_MAX 64
+#define DICT_EMBED_VAL_KEY_MAX 6
+/* 内嵌键的sdshdr8头部长度，以及写在flags高位、区分内嵌键与独立分配的sds的标记 */
+#define DICT_EMBED_KEY_HDR 3
+#define DICT_EMBED_KEY_MARK (1<<SDS_TYPE_BITS)
+#define dictEntryKeyIsTrailing(d, he) \
+    (((d)->type->flags & DICT_TYPE_EMBED_KEYS) && \
+     (char*)(he)->key == (char*)((he) + 1) + DICT_EMBED_KEY_HDR && \
+     (((unsigned char*)(he)->key)[-1] & DICT_EMBED_KEY_MARK))
+#define dictEntryKeyIsEmbedded(d, he) \
+    ((((d)->type->flags & DICT_TYPE_EMBED_KEYS) && (char*)(he)->key == (char*)&(he)->v + 1) || \
+     dictEntryKeyIsTrailing(d, he))
+/* 条目是否从条目池分配（不是独立的zmalloc内存块） */
+#define dictEntryIsPooled(d, he) ((d)->entrypool != NULL && !dictEntryKeyIsTrailing(d, he))
+
+/* 默认扩缩容策略（dictType.resizePolicy为NULL时），装载率为元素数/桶数的百分比：
+ * 装载率到100%扩容，dictDisableResize或内存吃紧时放宽到500%；删除后低于HASHTABLE_MIN_FILL缩容，
+ * 缩到装载率约50%，离两个阈值都远，增删少量元素不会来回扩缩 */
+#define DICT_GROW_FILL 100
+#define DICT_FORCE_GROW_FILL 500
+#define DICT_SHRINK_FILL HASHTABLE_MIN_FILL
+#define DICT_SHRINK_TARGET_FILL 50
+#define DICT_PRESSURE_WATERMARK 90
+
+/* dictGenHashFunction的哈希算法，见dictSetHashBackend */
+#define DICT_HASH_SIPHASH 0
+#define DICT_HASH_WYHASH 1
+#define DICT_HASH_XXH3 2
+/* 非SipHash算法做大小写不敏感哈希时，不超过该长度的键在栈上转小写 */
+#define DICT_HASH_NOCASE_STACK 256
+
+/* dict的存储引擎：链式哈希（dictCreate）或开放寻址的swiss table（dictCreateSwiss） */
+#define DICT_ENGINE_CHAINED 0
+#define DICT_ENGINE_SWISS 1
+/* swiss table的最小槽数（2的幂，不小于一个控制字节组）和最大装载率7/8 */
+#define DICT_SWISS_MIN_SIZE 16
+#define DICT_SWISS_MAX_LOAD(size) ((size) - (size)/8)
 /* Test of the CPU is Little Endian and supports not aligned accesses.
  * Two interesting conditions to speedup the function that happen to be
  * in most of x86 servers. */
@@ -221,6 +316,15 @@
 #define SDS_TYPE_MASK 7
 #define SDS_TYPE_BITS 3
 #define SDS_MAX_PREALLOC (1024*1024)
+//sdsMakeRoomForMode的增长模式
+#define SDS_GROW_GREEDY 0   //小于max_prealloc时翻倍，之后多分配max(max_prealloc, 新长度/large_div)
+#define SDS_GROW_EXACT 1    //只按需要的长度分配（分配器size class的富余仍记入alloc）
+#define SDS_GROW_BOUNDED 2  //预留不超过新长度/bounded_div且不超过max_prealloc，适合长期保留的字符串
+//超过max_prealloc后按新长度的1/8继续预分配，大字符串的realloc次数从线性变为对数
+#define SDS_GROW_LARGE_DIV 8
+#define SDS_BOUNDED_SLACK_DIV 8
+//sdsSweepFreeSpace只回收空闲空间不少于这么多字节的字符串
+#define SDS_SWEEP_MIN_FREE (64*1024)
 
 //用于从 SDS 字符串的数据区指针反推其头部结构体的地址,就是buf地址
 #define SDS_HDR_VAR(T,s) struct sdshdr##T *sh = static_cast<sdshdr##T*>((void*)((s)-(sizeof(struct sdshdr##T))));
@@ -235,6 +339,20 @@
 typedef char *sds;
 typedef sds (*sdstemplate_callback_t)(const sds variable, void *arg);
 #define SDS_LLSTR_SIZE 21
+//sdssplitargs成段查找时字符集的最大长度
+#define SDS_SPLIT_SET_MAX 8
+//sdssplitargs参数数组的初始容量，之后按2倍增长
+#define SDS_SPLITARGS_INIT_SLOTS 8
+//sdsrope暂存块的初始大小，小段数据拷贝到暂存块里，块写满后另起一块，已有数据不再移动。
+//新块按已有总长度的1/4增长，上限取zmalloc走mmap大块（透明大页）的阈值
+#define SDS_ROPE_CHUNK (16*1024)
+#define SDS_ROPE_CHUNK_MAX (2*1024*1024)
+//短于这个长度的借用缓冲区和sds直接拷贝进暂存块，避免iovec里出现大量碎片
+#define SDS_ROPE_BORROW_MIN 64
+//sdsrope段数组的初始容量，之后按2倍增长
+#define SDS_ROPE_INIT_SEGS 16
+//RESP长度头的最大长度：前缀 + 20位数字 + "\r\n"
+#define SDS_ROPE_LENHDR_MAX 24
 
 
 
@@ -369,6 +487,25 @@ typedef sds (*sdstemplate_callback_t)(const sds variable, void *arg);
 
 
 
+//================================defrag=========================//
+/* 整理任务类型 */
+#define DEFRAG_JOB_DICT 0
+#define DEFRAG_JOB_QUICKLIST 1
+#define DEFRAG_JOB_ZSET 2
+#define DEFRAG_JOB_RAX 3
+
+/* dict/rax中键和值的类型，决定整理时是否一并搬迁 */
+#define DEFRAG_DICT_KEY_SDS (1<<0)      /* dict的键是sds */
+#define DEFRAG_DICT_VAL_SDS (1<<1)      /* dict的值是sds */
+#define DEFRAG_DICT_VAL_PTR (1<<2)      /* dict的值是zmalloc分配的普通内存块 */
+#define DEFRAG_RAX_VAL_PTR (1<<0)       /* rax的值是zmalloc分配的普通内存块 */
+#define DEFRAG_RAX_VAL_LISTPACK (1<<1)  /* rax的值是listpack（如stream） */
+
+#define DEFRAG_TIME_CHECK_INTERVAL 16   /* 每处理多少项检查一次CPU时间 */
+#define DEFRAG_QUICKLIST_BOOKMARK "_AD" /* quicklist断点书签名 */
+
+
+
 //================================toolFunc=========================//    
 
 #define STANDALONE 1 /* at the moment, this is ok. */
@@ -0,0 +1,618 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/20
+ * All rights reserved. No one may copy or transfer.
+ * Description: 增量式主动碎片整理（active defrag）。
+ */
+#include <string.h>
+#include <time.h>
+#include "defrag.h"
+#include "sds.h"
+#include "dict.h"
+#include "quicklist.h"
+#include "rax.h"
+#include "zmalloc.h"
+#include "zmallocDf.h"
+#include "debugDf.h"
+//=====================================================================//
+BEGIN_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+static sdsCreate sdsCreatel;
+static dictionaryCreate dictionaryCreatel;
+static quicklistCreate quicklistCreatel;
+static raxCreate raxCreatel;
+
+/* rax的节点回调没有privdata，整理rax期间通过它找到当前的整理器。 */
+static defragCreate *defrag_rax_current = NULL;
+
+/* dictScan回调的上下文 */
+typedef struct defragCtx {
+    defragCreate *defrag;
+    defragJob *job;
+    dict *d;
+    zset *zs;
+} defragCtx;
+
+/* 当前线程消耗的CPU时间（微秒），整理预算按CPU时间而不是墙上时间计算，
+ * 线程被调度出去的时间不算在预算里。 */
+static long long defragCpuUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+defragCreate::defragCreate()
+{
+    jobs = NULL;
+    numjobs = 0;
+    curjob = 0;
+    force = 0;
+    memset(&stats, 0, sizeof(stats));
+    sdsCreateInstance = &sdsCreatel;
+    dictionaryCreateInstance = &dictionaryCreatel;
+    quicklistCreateInstance = &quicklistCreatel;
+    raxCreateInstance = &raxCreatel;
+}
+
+defragCreate::~defragCreate()
+{
+    for (int j = 0; j < numjobs; j++)
+        if (jobs[j].last_key) sdsCreateInstance->sdsfree(jobs[j].last_key);
+    zfree(jobs);
+}
+
+/**
+ * 按分配器提示搬迁一个内存块。
+ *
+ * @param ptr 待搬迁的内存块
+ * @param tag 内存归属标签（zmallocTag）
+ * @return 搬迁成功返回新地址（旧地址已释放），否则返回 NULL
+ */
+void *defragCreate::activeDefragAlloc(void *ptr, int tag)
+{
+    void *newptr;
+    if (ptr == NULL) return NULL;
+    if (!force && !zmalloc::zmalloc_defrag_hint(ptr)) {
+        stats.misses++;
+        return NULL;
+    }
+    newptr = zmalloc::zmalloc_defrag_move(ptr, tag);
+    if (newptr) stats.hits++;
+    else stats.misses++;
+    return newptr;
+}
+
+/**
+ * 搬迁一个sds字符串（连同头部）。
+ *
+ * @param sdsptr 待搬迁的sds
+ * @return 搬迁成功返回新的sds，否则返回 NULL
+ */
+sds defragCreate::activeDefragSds(sds sdsptr)
+{
+    void *ptr = sdsCreateInstance->sdsAllocPtr(sdsptr);
+    void *newptr = activeDefragAlloc(ptr, ZMALLOC_TAG_SDS);
+    if (newptr) {
+        size_t offset = sdsptr - (char*)ptr;
+        return (char*)newptr + offset;
+    }
+    return NULL;
+}
+
+int defragCreate::defragAddJob(int type, void **ref, int flags)
+{
+    for (int j = 0; j < numjobs; j++)
+        if (jobs[j].ref == ref) return C_ERR;
+    jobs = static_cast<defragJob*>(zrealloc(jobs, sizeof(defragJob)*(numjobs+1)));
+    defragJob *job = &jobs[numjobs++];
+    memset(job, 0, sizeof(*job));
+    job->type = type;
+    job->flags = flags;
+    job->ref = ref;
+    return C_OK;
+}
+
+/**
+ * 注册一个dict。
+ *
+ * @param d     dict指针的地址，dict结构体被搬迁后会写回
+ * @param flags 键值类型
+ * @return 成功返回 C_OK，已注册返回 C_ERR
+ */
+int defragCreate::defragAddDict(dict **d, int flags)
+{
+    return defragAddJob(DEFRAG_JOB_DICT, (void**)d, flags);
+}
+
+/**
+ * 注册一个quicklist。
+ *
+ * @param ql quicklist指针的地址
+ * @return 成功返回 C_OK，已注册返回 C_ERR
+ */
+int defragCreate::defragAddQuicklist(quicklist **ql)
+{
+    return defragAddJob(DEFRAG_JOB_QUICKLIST, (void**)ql, 0);
+}
+
+/**
+ * 注册一个跳跃表编码的zset。
+ *
+ * @param zs zset指针的地址
+ * @return 成功返回 C_OK，已注册返回 C_ERR
+ */
+int defragCreate::defragAddZset(zset **zs)
+{
+    return defragAddJob(DEFRAG_JOB_ZSET, (void**)zs, 0);
+}
+
+/**
+ * 注册一个rax。
+ *
+ * @param rt    rax指针的地址
+ * @param flags 值类型
+ * @return 成功返回 C_OK，已注册返回 C_ERR
+ */
+int defragCreate::defragAddRax(rax **rt, int flags)
+{
+    return defragAddJob(DEFRAG_JOB_RAX, (void**)rt, flags);
+}
+
+/**
+ * 取消注册。
+ *
+ * @param ref 注册时传入的地址
+ * @return 成功返回 C_OK，未注册返回 C_ERR
+ */
+int defragCreate::defragRemove(void *ref)
+{
+    for (int j = 0; j < numjobs; j++) {
+        defragJob *job = &jobs[j];
+        if (job->ref != ref) continue;
+        if (job->type == DEFRAG_JOB_QUICKLIST && job->started)
+            quicklistCreateInstance->quicklistBookmarkDelete((quicklist*)*job->ref, DEFRAG_QUICKLIST_BOOKMARK);
+        if (job->last_key) sdsCreateInstance->sdsfree(job->last_key);
+        memmove(job, job+1, sizeof(defragJob)*(numjobs-j-1));
+        numjobs--;
+        if (curjob > j) curjob--;
+        if (curjob >= numjobs) curjob = 0;
+        if (numjobs == 0) {
+            /* 数组清空后释放，置空让下次defragAddJob从NULL重新分配 */
+            zfree(jobs);
+            jobs = NULL;
+        }
+        return C_OK;
+    }
+    return C_ERR;
+}
+
+/**
+ * 搬迁dict的两张哈希表数组。
+ *
+ * @param d 目标dict
+ */
+void defragCreate::defragDictTables(dict *d)
+{
+    dictEntry **newtable;
+    dictionaryCreateInstance->dictBackgroundRehashWait(d); /* 后台线程可能正在读写桶数组 */
+    for (int j = 0; j < 2; j++) {
+        if (d->ht[j].table &&
+            (newtable = static_cast<dictEntry**>(activeDefragAlloc(d->ht[j].table, ZMALLOC_TAG_DICT))))
+            d->ht[j].table = newtable;
+    }
+}
+
+/* 搬迁一个桶里的所有dictEntry，前驱的next指针（或桶本身）指向新地址。
+ * 内嵌在条目里的键随条目一起搬走，键指针按相同的偏移改到新条目上；
+ * 条目池里的条目已经紧密排列，不是独立的内存块，原地不动。 */
+void defragCreate::defragDictBucketCallback(void *privdata, dictEntry **bucketref)
+{
+    defragCtx *ctx = static_cast<defragCtx*>(privdata);
+    while (*bucketref) {
+        dictEntry *de = *bucketref;
+        if (dictEntryIsPooled(ctx->d, de)) {
+            bucketref = &de->next;
+            continue;
+        }
+        int embedded = dictEntryKeyIsEmbedded(ctx->d, de);
+        dictEntry *newde = static_cast<dictEntry*>(ctx->defrag->activeDefragAlloc(de, ZMALLOC_TAG_DICT));
+        if (newde) {
+            if (embedded) newde->key = (char*)newde + ((char*)newde->key - (char*)de);
+            *bucketref = newde;
+        }
+        bucketref = &(*bucketref)->next;
+    }
+}
+
+/* 按注册时的flags搬迁dict元素的键和值。 */
+void defragCreate::defragDictCallback(void *privdata, const dictEntry *_de)
+{
+    defragCtx *ctx = static_cast<defragCtx*>(privdata);
+    dictEntry *de = (dictEntry*)_de;
+    defragCreate *defrag = ctx->defrag;
+    int flags = ctx->job->flags;
+    void *newptr;
+
+    if ((flags & DEFRAG_DICT_KEY_SDS) && !dictEntryKeyIsEmbedded(ctx->d, de)) {
+        if ((newptr = defrag->activeDefragSds(static_cast<sds>(de->key))))
+            de->key = newptr;
+    }
+    if (flags & DEFRAG_DICT_VAL_SDS) {
+        if ((newptr = defrag->activeDefragSds(static_cast<sds>(de->v.val))))
+            de->v.val = newptr;
+    } else if (flags & DEFRAG_DICT_VAL_PTR) {
+        if ((newptr = defrag->activeDefragAlloc(de->v.val, ZMALLOC_TAG_OTHER)))
+            de->v.val = newptr;
+    }
+    defrag->stats.scanned++;
+}
+
+/* 在跳跃表中定位(score, oldele)对应的节点并搬迁它，返回新节点score的地址。
+ * 元素sds由dict和跳跃表共享，newele非NULL表示sds已被搬迁。 */
+double *defragCreate::defragZslNode(zskiplist *zsl, double score, sds oldele, sds newele)
+{
+    zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x, *newx;
+    int i;
+    sds ele = newele ? newele : oldele;
+
+    /* find the skiplist node referring to the object that was moved,
+     * and all pointers that need to be updated if we'll end up moving the skiplist node. */
+    x = zsl->header;
+    for (i = zsl->level-1; i >= 0; i--) {
+        while (x->level[i].forward &&
+            x->level[i].forward->ele != oldele && /* make sure not to access the
+                                                     ->obj pointer if it matches
+                                                     oldele */
+            (x->level[i].forward->score < score ||
+                (x->level[i].forward->score == score &&
+                sdsCreateInstance->sdscmp(x->level[i].forward->ele,ele) < 0)))
+            x = x->level[i].forward;
+        update[i] = x;
+    }
+
+    /* update the robj pointer, defrag the skiplist struct and return the new score reference. */
+    x = x->level[0].forward;
+    serverAssert(x && score == x->score && x->ele==oldele);
+    if (newele)
+        x->ele = newele;
+
+    /* try to defrag the skiplist struct */
+    newx = static_cast<zskiplistNode*>(activeDefragAlloc(x, ZMALLOC_TAG_SKIPLIST));
+    if (newx) {
+        defragZslUpdateNode(zsl, x, newx, update);
+        return &newx->score;
+    }
+    return NULL;
+}
+
+/* 跳跃表节点被搬迁后，修正各层前驱的forward指针以及后继的backward指针。 */
+void defragCreate::defragZslUpdateNode(zskiplist *zsl, zskiplistNode *oldnode, zskiplistNode *newnode, zskiplistNode **update)
+{
+    int i;
+    for (i = 0; i < zsl->level; i++) {
+        if (update[i]->level[i].forward == oldnode)
+            update[i]->level[i].forward = newnode;
+    }
+    serverAssert(zsl->header!=oldnode);
+    if (newnode->level[0].forward) {
+        serverAssert(newnode->level[0].forward->backward==oldnode);
+        newnode->level[0].forward->backward = newnode;
+    } else {
+        serverAssert(zsl->tail==oldnode);
+        zsl->tail = newnode;
+    }
+}
+
+/* zset的dict元素：搬迁共享的sds和跳跃表节点，并把dict的值指向新节点的score。 */
+void defragCreate::defragZsetCallback(void *privdata, const dictEntry *_de)
+{
+    defragCtx *ctx = static_cast<defragCtx*>(privdata);
+    dictEntry *de = (dictEntry*)_de;
+    defragCreate *defrag = ctx->defrag;
+    zset *zs = ctx->zs;
+    sds sdsele = static_cast<sds>(dictGetKey(de));
+    sds newsds;
+    double *newscore;
+
+    if ((newsds = defrag->activeDefragSds(sdsele)))
+        de->key = newsds;
+    newscore = defrag->defragZslNode(zs->zsl, *(double*)dictGetVal(de), sdsele, newsds);
+    if (newscore) de->v.val = newscore;
+    defrag->stats.scanned++;
+}
+
+/* rax迭代器的节点回调：搬迁节点，返回1让迭代器修正父节点里的指针。 */
+int defragCreate::defragRaxNodeCallback(raxNode **noderef)
+{
+    raxNode *newnode = static_cast<raxNode*>(defrag_rax_current->activeDefragAlloc(*noderef, ZMALLOC_TAG_RAX));
+    if (newnode) {
+        *noderef = newnode;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * 整理一个dict：先搬迁dict结构体和哈希表数组，再用dictScan逐桶搬迁元素。
+ *
+ * @param job     整理任务
+ * @param endtime CPU时间截止点
+ * @return 本轮完成返回 1，时间用完返回 0
+ */
+int defragCreate::defragDictJob(defragJob *job, long long endtime)
+{
+    dict *d = static_cast<dict*>(*job->ref);
+    dict *newd;
+    long iterations = 0;
+
+    if (!job->started) {
+        /* 后台线程持有dict结构体的地址，搬迁之前先等它搬完并换表 */
+        dictionaryCreateInstance->dictBackgroundRehashWait(d);
+        if ((newd = static_cast<dict*>(activeDefragAlloc(d, ZMALLOC_TAG_DICT))))
+            *job->ref = d = newd;
+        defragDictTables(d);
+        job->started = 1;
+        job->cursor = 0;
+    }
+
+    defragCtx ctx = {this, job, d, NULL};
+    do {
+        job->cursor = dictionaryCreateInstance->dictScan(d, job->cursor,
+            defragDictCallback, defragDictBucketCallback, &ctx);
+        if (++iterations >= DEFRAG_TIME_CHECK_INTERVAL) {
+            iterations = 0;
+            if (job->cursor && defragCpuUs() >= endtime) return 0;
+        }
+    } while (job->cursor);
+    return 1;
+}
+
+/**
+ * 整理一个zset：zset、跳跃表和表头在每轮开始时搬迁，
+ * 元素随dictScan逐桶搬迁，dict和跳跃表两边的指针同时修正。
+ *
+ * @param job     整理任务
+ * @param endtime CPU时间截止点
+ * @return 本轮完成返回 1，时间用完返回 0
+ */
+int defragCreate::defragZsetJob(defragJob *job, long long endtime)
+{
+    zset *zs = static_cast<zset*>(*job->ref);
+    long iterations = 0;
+    void *newptr;
+
+    if (!job->started) {
+        if ((newptr = activeDefragAlloc(zs, ZMALLOC_TAG_OTHER)))
+            *job->ref = zs = static_cast<zset*>(newptr);
+        if ((newptr = activeDefragAlloc(zs->zsl, ZMALLOC_TAG_SKIPLIST)))
+            zs->zsl = static_cast<zskiplist*>(newptr);
+        if ((newptr = activeDefragAlloc(zs->zsl->header, ZMALLOC_TAG_SKIPLIST)))
+            zs->zsl->header = static_cast<zskiplistNode*>(newptr);
+        dictionaryCreateInstance->dictBackgroundRehashWait(zs->dictl);
+        if ((newptr = activeDefragAlloc(zs->dictl, ZMALLOC_TAG_DICT)))
+            zs->dictl = static_cast<dict*>(newptr);
+        defragDictTables(zs->dictl);
+        job->started = 1;
+        job->cursor = 0;
+    }
+
+    defragCtx ctx = {this, job, zs->dictl, zs};
+    do {
+        job->cursor = dictionaryCreateInstance->dictScan(zs->dictl, job->cursor,
+            defragZsetCallback, defragDictBucketCallback, &ctx);
+        if (++iterations >= DEFRAG_TIME_CHECK_INTERVAL) {
+            iterations = 0;
+            if (job->cursor && defragCpuUs() >= endtime) return 0;
+        }
+    } while (job->cursor);
+    return 1;
+}
+
+/* 搬迁quicklist节点及其ziplist/LZF数据，修正前后节点和书签里的指针。 */
+void defragCreate::defragQuicklistNode(quicklist *ql, quicklistNode **node_ref)
+{
+    quicklistNode *newnode, *node = *node_ref;
+    unsigned char *newzl;
+
+    if ((newnode = static_cast<quicklistNode*>(activeDefragAlloc(node, ZMALLOC_TAG_QUICKLIST)))) {
+        if (newnode->prev)
+            newnode->prev->next = newnode;
+        else
+            ql->head = newnode;
+        if (newnode->next)
+            newnode->next->prev = newnode;
+        else
+            ql->tail = newnode;
+        for (unsigned int j = 0; j < ql->bookmark_count; j++)
+            if (ql->bookmarks[j].node == node) ql->bookmarks[j].node = newnode;
+        *node_ref = node = newnode;
+    }
+    int tag = quicklistNodeIsCompressed(node) ? ZMALLOC_TAG_QUICKLIST : ZMALLOC_TAG_ZIPLIST;
+    if ((newzl = static_cast<unsigned char*>(activeDefragAlloc(node->zl, tag))))
+        node->zl = newzl;
+}
+
+/**
+ * 整理一个quicklist：时间用完时在当前节点上打书签，下次从书签的下一个节点继续。
+ * 书签所在节点被删除时quicklist会把书签移到后继节点；书签不存在说明
+ * 断点之后的节点都已删除，本轮结束。
+ *
+ * @param job     整理任务
+ * @param endtime CPU时间截止点
+ * @return 本轮完成返回 1，时间用完返回 0
+ */
+int defragCreate::defragQuicklistJob(defragJob *job, long long endtime)
+{
+    quicklist *ql = static_cast<quicklist*>(*job->ref);
+    quicklistNode *node;
+    long iterations = 0;
+    int bookmark_failed = 0;
+
+    if (!job->started) {
+        quicklist *newql;
+        if ((newql = static_cast<quicklist*>(activeDefragAlloc(ql, ZMALLOC_TAG_QUICKLIST))))
+            *job->ref = ql = newql;
+        job->started = 1;
+        node = ql->head;
+    } else {
+        node = quicklistCreateInstance->quicklistBookmarkFind(ql, DEFRAG_QUICKLIST_BOOKMARK);
+        if (!node) return 1;
+        node = node->next;
+    }
+
+    while (node) {
+        defragQuicklistNode(ql, &node);
+        stats.scanned++;
+        if (++iterations >= DEFRAG_TIME_CHECK_INTERVAL && !bookmark_failed) {
+            iterations = 0;
+            if (node->next && defragCpuUs() >= endtime) {
+                if (quicklistCreateInstance->quicklistBookmarkCreate(&ql, DEFRAG_QUICKLIST_BOOKMARK, node)) {
+                    *job->ref = ql;
+                    return 0;
+                }
+                /* 书签用完了，只能把这个quicklist一次做完。 */
+                bookmark_failed = 1;
+            }
+        }
+        node = node->next;
+    }
+    quicklistCreateInstance->quicklistBookmarkDelete(ql, DEFRAG_QUICKLIST_BOOKMARK);
+    return 1;
+}
+
+/**
+ * 整理一个rax：节点通过迭代器的node_cb搬迁，值按flags搬迁。
+ * 时间用完时记下当前键，下次从大于该键的位置继续。
+ *
+ * @param job     整理任务
+ * @param endtime CPU时间截止点
+ * @return 本轮完成返回 1，时间用完返回 0
+ */
+int defragCreate::defragRaxJob(defragJob *job, long long endtime)
+{
+    rax *rt = static_cast<rax*>(*job->ref);
+    raxIterator ri;
+    long iterations = 0;
+    int valtag = (job->flags & DEFRAG_RAX_VAL_LISTPACK) ? ZMALLOC_TAG_LISTPACK : ZMALLOC_TAG_OTHER;
+    int defrag_data = job->flags & (DEFRAG_RAX_VAL_PTR|DEFRAG_RAX_VAL_LISTPACK);
+
+    defrag_rax_current = this;
+    if (!job->started) {
+        rax *newrax;
+        if ((newrax = static_cast<rax*>(activeDefragAlloc(rt, ZMALLOC_TAG_RAX))))
+            *job->ref = rt = newrax;
+        defragRaxNodeCallback(&rt->head);
+        job->started = 1;
+        raxCreateInstance->raxStart(&ri, rt);
+        ri.node_cb = defragRaxNodeCallback;
+        raxCreateInstance->raxSeek(&ri, "^", NULL, 0);
+    } else {
+        raxCreateInstance->raxStart(&ri, rt);
+        ri.node_cb = defragRaxNodeCallback;
+        raxCreateInstance->raxSeek(&ri, ">", (unsigned char*)job->last_key,
+            sdsCreateInstance->sdslen(job->last_key));
+    }
+
+    while (raxCreateInstance->raxNext(&ri)) {
+        void *newdata;
+        if (defrag_data && ri.data && (newdata = activeDefragAlloc(ri.data, valtag))) {
+            ri.data = newdata;
+            raxCreateInstance->raxSetData(ri.node, newdata);
+        }
+        stats.scanned++;
+        if (++iterations >= DEFRAG_TIME_CHECK_INTERVAL) {
+            iterations = 0;
+            if (defragCpuUs() >= endtime) {
+                if (!job->last_key) job->last_key = sdsCreateInstance->sdsempty();
+                job->last_key = sdsCreateInstance->sdscpylen(job->last_key, (char*)ri.key, ri.key_len);
+                raxCreateInstance->raxStop(&ri);
+                defrag_rax_current = NULL;
+                return 0;
+            }
+        }
+    }
+    raxCreateInstance->raxStop(&ri);
+    defrag_rax_current = NULL;
+    return 1;
+}
+
+/**
+ * 执行一次增量整理。
+ *
+ * @param budget_us 本次CPU时间预算（微秒）
+ * @return 本次调用完成了一轮完整遍历返回 1，否则返回 0
+ */
+int defragCreate::defragCycle(long long budget_us)
+{
+    long long start = defragCpuUs();
+    long long endtime = start + budget_us;
+    int done = 0;
+
+    while (numjobs) {
+        defragJob *job = &jobs[curjob];
+        int finished = 0;
+        switch (job->type) {
+        case DEFRAG_JOB_DICT: finished = defragDictJob(job, endtime); break;
+        case DEFRAG_JOB_ZSET: finished = defragZsetJob(job, endtime); break;
+        case DEFRAG_JOB_QUICKLIST: finished = defragQuicklistJob(job, endtime); break;
+        case DEFRAG_JOB_RAX: finished = defragRaxJob(job, endtime); break;
+        default: serverPanic("Unknown defrag job type");
+        }
+        if (!finished) break;
+
+        /* 这个结构做完了，下一轮从头开始。 */
+        job->started = 0;
+        job->cursor = 0;
+        if (++curjob == numjobs) {
+            curjob = 0;
+            stats.passes++;
+            done = 1;
+            break;
+        }
+        if (defragCpuUs() >= endtime) break;
+    }
+    stats.time_used_us += defragCpuUs() - start;
+    return done;
+}
+
+/**
+ * 计算分配器层面的碎片率。
+ *
+ * @param frag_bytes 输出碎片字节数，可为 NULL
+ * @return 碎片百分比
+ */
+float defragCreate::defragGetFragmentation(size_t *frag_bytes)
+{
+    size_t allocated = 0, active = 0, resident = 0;
+    zmalloc::zmalloc_get_allocator_info(&allocated, &active, &resident);
+    if (allocated == 0 || active < allocated) {
+        if (frag_bytes) *frag_bytes = 0;
+        return 0;
+    }
+    if (frag_bytes) *frag_bytes = active - allocated;
+    return ((float)active / allocated)*100 - 100;
+}
+
+/**
+ * 强制模式：忽略分配器提示，搬迁遇到的每一个内存块。
+ *
+ * @param force 非0开启
+ */
+void defragCreate::defragSetForce(int force)
+{
+    this->force = force;
+}
+
+/**
+ * 获取整理统计。
+ *
+ * @param stats 输出统计
+ */
+void defragCreate::defragGetStats(defragStats *stats)
+{
+    *stats = this->stats;
+}
+//=====================================================================//
+END_NAMESPACE(REDIS_BASE)
+//=====================================================================//
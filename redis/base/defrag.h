@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/20
+ * All rights reserved. No one may copy or transfer.
+ * Description: 增量式主动碎片整理（active defrag）。
+ * 遍历注册的dict、quicklist、zset（跳跃表编码）和rax，根据分配器给出的碎片信息
+ * 把位于低使用率slab里的内存块搬到新位置，并修正所有指向它们的指针。
+ * 每次调用defragCycle只消耗给定的CPU时间，未完成的部分从断点（dictScan游标、
+ * quicklist书签、rax键）继续。
+ */
+#ifndef REDIS_BASE_DEFRAG_H
+#define REDIS_BASE_DEFRAG_H
+#include "define.h"
+#include "dict.h"
+#include "quicklist.h"
+#include "zskiplist.h"
+#include "zset.h"
+#include "rax.h"
+//=====================================================================//
+BEGIN_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+class sdsCreate;
+class dictionaryCreate;
+class quicklistCreate;
+class raxCreate;
+
+/* 一个整理任务：一棵结构体及其断点 */
+typedef struct defragJob {
+    int type;               /* DEFRAG_JOB_xxx */
+    int flags;              /* DEFRAG_DICT_xxx / DEFRAG_RAX_xxx */
+    void **ref;             /* 指向结构体根指针的地址，根被搬迁后会写回 */
+    int started;            /* 本轮是否已开始（根结构已整理） */
+    unsigned long cursor;   /* dictScan游标 */
+    sds last_key;           /* rax断点：上次处理到的键 */
+} defragJob;
+
+/* 整理统计 */
+typedef struct defragStats {
+    long long hits;         /* 搬迁成功的内存块数 */
+    long long misses;       /* 检查过但不需要（或无法）搬迁的内存块数 */
+    long long scanned;      /* 访问过的元素/节点数 */
+    long long passes;       /* 完整遍历所有任务的轮数 */
+    long long time_used_us; /* 累计消耗的CPU时间（微秒） */
+} defragStats;
+
+class defragCreate
+{
+public:
+    defragCreate();
+    ~defragCreate();
+public:
+    /**
+     * 按分配器提示搬迁一个内存块。
+     * @param ptr 待搬迁的内存块
+     * @param tag 内存归属标签（zmallocTag）
+     * @return 搬迁成功返回新地址（旧地址已释放），否则返回 NULL
+     */
+    void *activeDefragAlloc(void *ptr, int tag);
+
+    /**
+     * 搬迁一个sds字符串（连同头部）。
+     * @param sdsptr 待搬迁的sds
+     * @return 搬迁成功返回新的sds，否则返回 NULL
+     */
+    sds activeDefragSds(sds sdsptr);
+
+    /**
+     * 注册一个dict。
+     * @param d     dict指针的地址，dict结构体被搬迁后会写回
+     * @param flags DEFRAG_DICT_KEY_SDS / DEFRAG_DICT_VAL_SDS / DEFRAG_DICT_VAL_PTR 的组合
+     * @return 成功返回 C_OK，已注册返回 C_ERR
+     */
+    int defragAddDict(dict **d, int flags);
+
+    /**
+     * 注册一个quicklist，断点用书签 DEFRAG_QUICKLIST_BOOKMARK 保存。
+     * @param ql quicklist指针的地址
+     * @return 成功返回 C_OK，已注册返回 C_ERR
+     */
+    int defragAddQuicklist(quicklist **ql);
+
+    /**
+     * 注册一个跳跃表编码的zset（dict和跳跃表共享元素sds）。
+     * @param zs zset指针的地址
+     * @return 成功返回 C_OK，已注册返回 C_ERR
+     */
+    int defragAddZset(zset **zs);
+
+    /**
+     * 注册一个rax。
+     * @param rt    rax指针的地址
+     * @param flags DEFRAG_RAX_VAL_PTR / DEFRAG_RAX_VAL_LISTPACK，0表示值不搬迁
+     * @return 成功返回 C_OK，已注册返回 C_ERR
+     */
+    int defragAddRax(rax **rt, int flags);
+
+    /**
+     * 取消注册。结构体释放前必须调用，quicklist上的断点书签会被删除。
+     * @param ref 注册时传入的地址
+     * @return 成功返回 C_OK，未注册返回 C_ERR
+     */
+    int defragRemove(void *ref);
+
+    /**
+     * 执行一次增量整理，最多消耗 budget_us 微秒的线程CPU时间。
+     * 按 hz 次/秒调用、每次预算为 1000000*cpu_pct/hz/100，
+     * 即可把整理的CPU占用限制在 cpu_pct% 以内。
+     * @param budget_us 本次CPU时间预算（微秒）
+     * @return 本次调用完成了一轮完整遍历返回 1，否则返回 0
+     */
+    int defragCycle(long long budget_us);
+
+    /**
+     * 计算分配器层面的碎片率：active相对allocated多出的百分比。
+     * 非jemalloc构建拿不到分配器信息，返回0。
+     * @param frag_bytes 输出碎片字节数，可为 NULL
+     * @return 碎片百分比
+     */
+    float defragGetFragmentation(size_t *frag_bytes);
+
+    /**
+     * 强制模式：忽略分配器提示，搬迁遇到的每一个内存块。
+     * 用于测试以及没有碎片提示的分配器。
+     * @param force 非0开启
+     */
+    void defragSetForce(int force);
+
+    /**
+     * 获取整理统计。
+     * @param stats 输出统计
+     */
+    void defragGetStats(defragStats *stats);
+
+private:
+    int defragDictJob(defragJob *job, long long endtime);
+    int defragZsetJob(defragJob *job, long long endtime);
+    int defragQuicklistJob(defragJob *job, long long endtime);
+    int defragRaxJob(defragJob *job, long long endtime);
+    void defragDictTables(dict *d);
+    void defragQuicklistNode(quicklist *ql, quicklistNode **node_ref);
+    double *defragZslNode(zskiplist *zsl, double score, sds oldele, sds newele);
+    void defragZslUpdateNode(zskiplist *zsl, zskiplistNode *oldnode, zskiplistNode *newnode, zskiplistNode **update);
+    int defragAddJob(int type, void **ref, int flags);
+
+    static void defragDictBucketCallback(void *privdata, dictEntry **bucketref);
+    static void defragDictCallback(void *privdata, const dictEntry *de);
+    static void defragZsetCallback(void *privdata, const dictEntry *de);
+    static int defragRaxNodeCallback(raxNode **noderef);
+
+private:
+    defragJob *jobs;
+    int numjobs;
+    int curjob;
+    int force;
+    defragStats stats;
+    sdsCreate *sdsCreateInstance;
+    dictionaryCreate *dictionaryCreateInstance;
+    quicklistCreate *quicklistCreateInstance;
+    raxCreate *raxCreateInstance;
+};
+//=====================================================================//
+END_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+#endif
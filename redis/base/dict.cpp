@@ -5,23 +5,34 @@
  * Description: dict.h 是实现哈希表（字典）的核心头文件，提供了高效的键值对存储和查找功能。
  * 哈希表是 Redis 最基础的数据结构之一，被广泛用于实现数据库键空间、哈希类型（Hash）、集群节点信息等核心组件。
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_DICT
 #include "fmacros.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
 #include <limits.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "dict.h"
 #include "zmallocDf.h"
 #include "config.h"
 #include "toolFunc.h"
+#include "sds.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 static int dict_can_resize = 1;
-static unsigned int dict_force_resize_ratio = 5;
 static uint8_t dict_hash_function_seed[16];
+#ifndef DICT_HASH_DEFAULT
+#define DICT_HASH_DEFAULT DICT_HASH_SIPHASH
+#endif
+static int dict_hash_backend = DICT_HASH_DEFAULT;
+static REDIS_BASE::sdsCreate dict_sds;
 
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
@@ -37,6 +48,349 @@ dictionaryCreate::~dictionaryCreate()
 }  
 
 
+/* ------------------------- fast hash backends ------------------------------ */
+/* dictSetHashBackend可以把dictGenHashFunction从SipHash换成wyhash或XXH3。
+ * 这两个只适合键来自可信来源的场景：它们不是带密钥的PRF，种子只能打乱分布，
+ * 挡不住有意构造的碰撞。两者都用16字节种子折叠出的64位种子，XXH3处理240字节以上
+ * 的键时还需要由种子派生的192字节secret，在设置种子时一并算好。 */
+static uint64_t dict_hash_seed64 = 0;
+
+/* 一次把8个字节中的'A'-'Z'转成小写（SWAR），结果与逐字节的siptlw相同 */
+static inline uint64_t dictToLower64(uint64_t x)
+{
+    uint64_t heptets = x & 0x7f7f7f7f7f7f7f7fULL;
+    uint64_t ge_a = heptets + 0x3f3f3f3f3f3f3f3fULL;    /* 字节 >= 'A' 时最高位为1 */
+    uint64_t gt_z = heptets + 0x2525252525252525ULL;    /* 字节 >  'Z' 时最高位为1 */
+    uint64_t upper = (ge_a ^ gt_z) & ~x & 0x8080808080808080ULL;
+    return x | (upper >> 2);
+}
+
+static inline uint64_t dictRead64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t dictRead32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline void dictWrite64(uint8_t *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+/* 64x64->128位乘法，返回低64位和高64位 */
+static inline void dictMul128(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b;
+    *lo = (uint64_t)r;
+    *hi = (uint64_t)(r >> 64);
+#else
+    uint64_t lolo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hilo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lohi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hihi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lolo >> 32) + (hilo & 0xffffffff) + lohi;
+    *hi = (hilo >> 32) + (cross >> 32) + hihi;
+    *lo = (cross << 32) | (lolo & 0xffffffff);
+#endif
+}
+
+static inline uint64_t dictMulFold64(uint64_t a, uint64_t b)
+{
+    uint64_t lo, hi;
+    dictMul128(a, b, &lo, &hi);
+    return lo ^ hi;
+}
+
+/* wyhash（final version 4） */
+static const uint64_t dict_wyp[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline uint64_t dictWyr3(const uint8_t *p, size_t k)
+{
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static uint64_t dictWyhash(const uint8_t *p, size_t len, uint64_t seed)
+{
+    const uint64_t *secret = dict_wyp;
+    uint64_t a, b;
+
+    seed ^= dictMulFold64(seed ^ secret[0], secret[1]);
+    if (likely(len <= 16)) {
+        if (likely(len >= 4)) {
+            a = (dictRead32(p) << 32) | dictRead32(p + ((len >> 3) << 2));
+            b = (dictRead32(p + len - 4) << 32) | dictRead32(p + len - 4 - ((len >> 3) << 2));
+        } else if (likely(len > 0)) {
+            a = dictWyr3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (unlikely(i >= 48)) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = dictMulFold64(dictRead64(p) ^ secret[1], dictRead64(p + 8) ^ seed);
+                see1 = dictMulFold64(dictRead64(p + 16) ^ secret[2], dictRead64(p + 24) ^ see1);
+                see2 = dictMulFold64(dictRead64(p + 32) ^ secret[3], dictRead64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (likely(i >= 48));
+            seed ^= see1 ^ see2;
+        }
+        while (unlikely(i > 16)) {
+            seed = dictMulFold64(dictRead64(p) ^ secret[1], dictRead64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = dictRead64(p + i - 16);
+        b = dictRead64(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    dictMul128(a, b, &a, &b);
+    return dictMulFold64(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/* XXH3 64位（带种子），与xxHash 0.8的XXH3_64bits_withSeed结果一致 */
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+#define XXH_PRIME_MX1 0x165667919E3779F9ULL
+#define XXH_PRIME_MX2 0x9FB21C651E98DF25ULL
+#define XXH_SECRET_SIZE 192
+#define XXH_STRIPE_LEN 64
+#define XXH_SECRET_CONSUME_RATE 8
+#define XXH_MIDSIZE_MAX 240
+
+static const uint8_t dict_xxh3_ksecret[XXH_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+/* 长键用的secret：kSecret按种子派生，种子为0时就是kSecret本身 */
+static uint8_t dict_xxh3_secret[XXH_SECRET_SIZE];
+static const uint8_t *dict_xxh3_long_secret = dict_xxh3_ksecret;
+
+static inline uint64_t dictXxh64Avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t dictXxh3Avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= XXH_PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t dictXxh3Rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= ROTL(h, 49) ^ ROTL(h, 24);
+    h *= XXH_PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= XXH_PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t dictXxh3Mix16B(const uint8_t *in, const uint8_t *sec, uint64_t seed)
+{
+    return dictMulFold64(dictRead64(in) ^ (dictRead64(sec) + seed),
+                         dictRead64(in + 8) ^ (dictRead64(sec + 8) - seed));
+}
+
+/* 长键的累加和打散：SSE2下一次处理两个64位累加器，结果与标量版本相同 */
+static inline void dictXxh3Accumulate512(uint64_t *acc, const uint8_t *in, const uint8_t *sec)
+{
+#if defined(__SSE2__)
+    __m128i *xacc = reinterpret_cast<__m128i*>(acc);
+    for (int i = 0; i < 4; i++) {
+        __m128i data_vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + i);
+        __m128i key_vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sec) + i);
+        __m128i data_key = _mm_xor_si128(data_vec, key_vec);
+        __m128i data_key_lo = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(data_key, data_key_lo);
+        __m128i data_swap = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+        xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], data_swap));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        uint64_t data_val = dictRead64(in + 8 * i);
+        uint64_t data_key = data_val ^ dictRead64(sec + 8 * i);
+        acc[i ^ 1] += data_val;
+        acc[i] += (data_key & 0xffffffff) * (data_key >> 32);
+    }
+#endif
+}
+
+static inline void dictXxh3ScrambleAcc(uint64_t *acc, const uint8_t *sec)
+{
+#if defined(__SSE2__)
+    __m128i *xacc = reinterpret_cast<__m128i*>(acc);
+    const __m128i prime32 = _mm_set1_epi32((int)XXH_PRIME32_1);
+    for (int i = 0; i < 4; i++) {
+        __m128i acc_vec = xacc[i];
+        __m128i data_vec = _mm_xor_si128(acc_vec, _mm_srli_epi64(acc_vec, 47));
+        __m128i key_vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sec) + i);
+        __m128i data_key = _mm_xor_si128(data_vec, key_vec);
+        __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i prod_lo = _mm_mul_epu32(data_key, prime32);
+        __m128i prod_hi = _mm_mul_epu32(data_key_hi, prime32);
+        xacc[i] = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= dictRead64(sec + 8 * i);
+        acc[i] = a * XXH_PRIME32_1;
+    }
+#endif
+}
+
+static uint64_t dictXxh3Long(const uint8_t *in, size_t len, const uint8_t *sec)
+{
+    alignas(16) uint64_t acc[8] = { XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+                                    XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1 };
+    const size_t stripes_per_block = (XXH_SECRET_SIZE - XXH_STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+    const size_t block_len = XXH_STRIPE_LEN * stripes_per_block;
+    const size_t nb_blocks = (len - 1) / block_len;
+    size_t n, s;
+
+    for (n = 0; n < nb_blocks; n++) {
+        for (s = 0; s < stripes_per_block; s++)
+            dictXxh3Accumulate512(acc, in + n * block_len + s * XXH_STRIPE_LEN, sec + s * XXH_SECRET_CONSUME_RATE);
+        dictXxh3ScrambleAcc(acc, sec + XXH_SECRET_SIZE - XXH_STRIPE_LEN);
+    }
+    const size_t nb_stripes = ((len - 1) - block_len * nb_blocks) / XXH_STRIPE_LEN;
+    for (s = 0; s < nb_stripes; s++)
+        dictXxh3Accumulate512(acc, in + nb_blocks * block_len + s * XXH_STRIPE_LEN, sec + s * XXH_SECRET_CONSUME_RATE);
+    dictXxh3Accumulate512(acc, in + len - XXH_STRIPE_LEN, sec + XXH_SECRET_SIZE - XXH_STRIPE_LEN - 7);
+
+    uint64_t result = len * XXH_PRIME64_1;
+    for (int i = 0; i < 4; i++)
+        result += dictMulFold64(acc[2 * i] ^ dictRead64(sec + 11 + 16 * i),
+                                acc[2 * i + 1] ^ dictRead64(sec + 11 + 16 * i + 8));
+    return dictXxh3Avalanche(result);
+}
+
+static uint64_t dictXxh3(const uint8_t *in, size_t len, uint64_t seed)
+{
+    const uint8_t *sec = dict_xxh3_ksecret;
+
+    if (len <= 16) {
+        if (len > 8) {
+            uint64_t lo = dictRead64(in) ^ ((dictRead64(sec + 24) ^ dictRead64(sec + 32)) + seed);
+            uint64_t hi = dictRead64(in + len - 8) ^ ((dictRead64(sec + 40) ^ dictRead64(sec + 48)) - seed);
+            uint64_t acc = len + __builtin_bswap64(lo) + hi + dictMulFold64(lo, hi);
+            return dictXxh3Avalanche(acc);
+        }
+        if (len >= 4) {
+            seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+            uint64_t input64 = dictRead32(in + len - 4) + (dictRead32(in) << 32);
+            uint64_t bitflip = (dictRead64(sec + 8) ^ dictRead64(sec + 16)) - seed;
+            return dictXxh3Rrmxmx(input64 ^ bitflip, len);
+        }
+        if (len > 0) {
+            uint32_t combined = ((uint32_t)in[0] << 16) | ((uint32_t)in[len >> 1] << 24) |
+                                ((uint32_t)in[len - 1]) | ((uint32_t)len << 8);
+            uint64_t bitflip = (dictRead32(sec) ^ dictRead32(sec + 4)) + seed;
+            return dictXxh64Avalanche((uint64_t)combined ^ bitflip);
+        }
+        return dictXxh64Avalanche(seed ^ dictRead64(sec + 56) ^ dictRead64(sec + 64));
+    }
+    if (len <= 128) {
+        uint64_t acc = len * XXH_PRIME64_1;
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += dictXxh3Mix16B(in + 48, sec + 96, seed);
+                    acc += dictXxh3Mix16B(in + len - 64, sec + 112, seed);
+                }
+                acc += dictXxh3Mix16B(in + 32, sec + 64, seed);
+                acc += dictXxh3Mix16B(in + len - 48, sec + 80, seed);
+            }
+            acc += dictXxh3Mix16B(in + 16, sec + 32, seed);
+            acc += dictXxh3Mix16B(in + len - 32, sec + 48, seed);
+        }
+        acc += dictXxh3Mix16B(in, sec, seed);
+        acc += dictXxh3Mix16B(in + len - 16, sec + 16, seed);
+        return dictXxh3Avalanche(acc);
+    }
+    if (len <= XXH_MIDSIZE_MAX) {
+        uint64_t acc = len * XXH_PRIME64_1, acc_end;
+        int rounds = (int)len / 16, i;
+        for (i = 0; i < 8; i++) acc += dictXxh3Mix16B(in + 16 * i, sec + 16 * i, seed);
+        acc_end = dictXxh3Mix16B(in + len - 16, sec + 136 - 17, seed);
+        acc = dictXxh3Avalanche(acc);
+        for (i = 8; i < rounds; i++) acc_end += dictXxh3Mix16B(in + 16 * i, sec + 16 * (i - 8) + 3, seed);
+        return dictXxh3Avalanche(acc + acc_end);
+    }
+    return dictXxh3Long(in, len, dict_xxh3_long_secret);
+}
+
+/* 16字节种子折叠成wyhash/XXH3的64位种子，并派生XXH3长键用的secret */
+static void dictHashSeedUpdate(void)
+{
+    uint64_t k0 = dictRead64(dict_hash_function_seed);
+    uint64_t k1 = dictRead64(dict_hash_function_seed + 8);
+    dict_hash_seed64 = k0 ^ ROTL(k1, 32);
+    if (dict_hash_seed64 == 0) {
+        dict_xxh3_long_secret = dict_xxh3_ksecret;
+        return;
+    }
+    for (int i = 0; i < XXH_SECRET_SIZE / 16; i++) {
+        dictWrite64(dict_xxh3_secret + 16 * i, dictRead64(dict_xxh3_ksecret + 16 * i) + dict_hash_seed64);
+        dictWrite64(dict_xxh3_secret + 16 * i + 8, dictRead64(dict_xxh3_ksecret + 16 * i + 8) - dict_hash_seed64);
+    }
+    dict_xxh3_long_secret = dict_xxh3_secret;
+}
+
+static inline uint64_t dictFastHash(int backend, const uint8_t *in, size_t len)
+{
+    return backend == DICT_HASH_WYHASH ? dictWyhash(in, len, dict_hash_seed64)
+                                       : dictXxh3(in, len, dict_hash_seed64);
+}
+
 /**
  * SipHash-2-4 算法实现
  * 输入: in - 输入数据指针
@@ -126,7 +480,11 @@ uint64_t dictionaryCreate::siphash_nocase(const uint8_t *in, const size_t inlen,
     v0 ^= k0;
 
     for (; in != end; in += 8) {
+#ifdef UNALIGNED_LE_CPU
+        m = dictToLower64(U8TO64_LE(in));
+#else
         m = U8TO64_LE_NOCASE(in);
+#endif
         v3 ^= m;
 
         SIPROUND;
@@ -164,6 +522,736 @@ uint64_t dictionaryCreate::siphash_nocase(const uint8_t *in, const size_t inlen,
 #endif
 }
 
+/* ------------------------- entry pool ------------------------------------ */
+/* DICT_TYPE_ENTRY_POOL的字典把24字节的条目分配在自己的slab里：条目紧密排列，没有malloc头。
+ * 每个slab有自己的空闲链表（借用条目的next字段）和使用计数，有空位的slab挂在partial链表上；
+ * slab按地址有序登记在数组里，释放条目时二分查找所属slab，slab用空后整块归还（只剩一个时保留）。
+ * 条目池只由持有字典的线程访问：后台rehash线程只搬动条目，不分配也不释放。 */
+typedef struct dictEntrySlab {
+    struct dictEntrySlab *prev, *next;  // partial链表
+    dictEntry *free;                    // slab内的空闲链表
+    unsigned int used;                  // 正在使用的条目数
+    unsigned int top;                   // 从未分配过的条目从这里开始
+    unsigned int capacity;              // 条目数
+    dictEntry entries[];
+} dictEntrySlab;
+
+typedef struct dictEntryPool {
+    dictEntrySlab **slabs;              // 按地址升序
+    unsigned long numslabs;
+    unsigned long slabs_alloc;
+    dictEntrySlab *partial;             // 有空位的slab
+    unsigned long capacity;             // 所有slab的条目总数
+    unsigned long used;
+} dictEntryPool;
+
+static dictEntrySlab *dictPoolNewSlab(dictEntryPool *pool)
+{
+    unsigned long cap = pool->capacity < DICT_POOL_SLAB_MIN ? DICT_POOL_SLAB_MIN : pool->capacity;
+    if (cap > DICT_POOL_SLAB_MAX) cap = DICT_POOL_SLAB_MAX;
+    dictEntrySlab *slab = static_cast<dictEntrySlab *>(zmalloc(sizeof(*slab) + cap * sizeof(dictEntry)));
+    slab->prev = NULL;
+    slab->next = pool->partial;
+    if (pool->partial) pool->partial->prev = slab;
+    pool->partial = slab;
+    slab->free = NULL;
+    slab->used = 0;
+    slab->top = 0;
+    slab->capacity = cap;
+
+    if (pool->numslabs == pool->slabs_alloc) {
+        pool->slabs_alloc = pool->slabs_alloc ? pool->slabs_alloc * 2 : 8;
+        pool->slabs = static_cast<dictEntrySlab **>(zrealloc(pool->slabs, pool->slabs_alloc * sizeof(dictEntrySlab *)));
+    }
+    unsigned long i = pool->numslabs;
+    while (i > 0 && pool->slabs[i-1] > slab) {
+        pool->slabs[i] = pool->slabs[i-1];
+        i--;
+    }
+    pool->slabs[i] = slab;
+    pool->numslabs++;
+    pool->capacity += cap;
+    return slab;
+}
+
+static void dictPoolUnlinkPartial(dictEntryPool *pool, dictEntrySlab *slab)
+{
+    if (slab->prev) slab->prev->next = slab->next;
+    else pool->partial = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+static dictEntry *dictPoolAlloc(dict *d)
+{
+    dictEntryPool *pool = d->entrypool;
+    if (pool == NULL) {
+        pool = d->entrypool = static_cast<dictEntryPool *>(zcalloc(sizeof(*pool)));
+    }
+    dictEntrySlab *slab = pool->partial ? pool->partial : dictPoolNewSlab(pool);
+    dictEntry *he;
+    if (slab->free) {
+        he = slab->free;
+        slab->free = he->next;
+    } else {
+        he = &slab->entries[slab->top++];
+    }
+    if (++slab->used == slab->capacity) dictPoolUnlinkPartial(pool, slab);
+    pool->used++;
+    return he;
+}
+
+static void dictPoolFree(dict *d, dictEntry *he)
+{
+    dictEntryPool *pool = d->entrypool;
+    unsigned long lo = 0, hi = pool->numslabs;
+
+    /* 最后一个起始地址不大于he的slab */
+    while (hi - lo > 1) {
+        unsigned long mid = (lo + hi) / 2;
+        if ((char*)pool->slabs[mid] <= (char*)he) lo = mid;
+        else hi = mid;
+    }
+    dictEntrySlab *slab = pool->slabs[lo];
+    assert((char*)he >= (char*)slab->entries && he < slab->entries + slab->capacity);
+
+    if (slab->used-- == slab->capacity) {
+        slab->next = pool->partial;
+        if (pool->partial) pool->partial->prev = slab;
+        pool->partial = slab;
+    }
+    he->next = slab->free;
+    slab->free = he;
+    pool->used--;
+
+    if (slab->used == 0 && pool->numslabs > 1) {
+        dictPoolUnlinkPartial(pool, slab);
+        memmove(pool->slabs + lo, pool->slabs + lo + 1, (pool->numslabs - lo - 1) * sizeof(dictEntrySlab *));
+        pool->numslabs--;
+        pool->capacity -= slab->capacity;
+        zfree(slab);
+    }
+}
+
+/* 整块释放所有slab，字典回到还没有条目池的状态 */
+static void dictPoolRelease(dict *d)
+{
+    dictEntryPool *pool = d->entrypool;
+    if (pool == NULL) return;
+    for (unsigned long j = 0; j < pool->numslabs; j++) zfree(pool->slabs[j]);
+    zfree(pool->slabs);
+    zfree(pool);
+    d->entrypool = NULL;
+}
+
+/* 释放链式引擎的条目（键和值已经处理过），与zfree一样把指针置空 */
+#define dictFreeEntry(d, he) do { \
+    if (dictEntryIsPooled(d, he)) dictPoolFree(d, he); \
+    else zfree(he); \
+    (he) = NULL; \
+} while (0)
+
+/* ------------------------- entry layout ---------------------------------- */
+/* 链式引擎分配新条目并设置键。DICT_TYPE_EMBED_KEYS的字典把短sds键复制进条目：
+ * NO_VALUE字典里不超过DICT_EMBED_VAL_KEY_MAX字节的键以sds type5写进值字段，条目仍是24字节；
+ * 其余不超过DICT_EMBED_KEY_MAX字节的键以sdshdr8跟在条目后面，flags带DICT_EMBED_KEY_MARK；
+ * 字典拥有的键只在合并分配不多占内存时才这样内嵌，否则照旧单独存放。
+ * 键指针指向条目内部，dictGetKey、keyCompare照常工作。 */
+static_assert(sizeof(struct sdshdr8) == DICT_EMBED_KEY_HDR, "embedded key header size");
+
+/* 条目和键合成一块是否不比分开两块占得多，取决于分配器的档位：首次使用时按键长试分配。
+ * 比较的是独立sds键按最紧凑类型分配的大小。试分配前清空线程缓存、所有块都分配完再释放，
+ * 量到的是底层分配器的档位，而不是缓存里恰好剩下的块；底层分配器从稍大的空闲块切分时
+ * 可能整块给出，所以每个大小试DICT_EMBED_PROBE_ROUNDS次取最小值 */
+#define DICT_EMBED_PROBE_ROUNDS 4
+static pthread_once_t dict_embed_probe_once = PTHREAD_ONCE_INIT;
+static unsigned char dict_embed_saves[DICT_EMBED_KEY_MAX + 1];
+
+static void dictEmbedProbe(void)
+{
+    void *blocks[DICT_EMBED_PROBE_ROUNDS * (2 * (DICT_EMBED_KEY_MAX + 1) + 1)];
+    size_t entry = SIZE_MAX, key[DICT_EMBED_KEY_MAX + 1], both[DICT_EMBED_KEY_MAX + 1], usable;
+    int n = 0;
+
+    zmalloc_thread_cache_flush();
+    for (size_t len = 0; len <= DICT_EMBED_KEY_MAX; len++) key[len] = both[len] = SIZE_MAX;
+    for (int round = 0; round < DICT_EMBED_PROBE_ROUNDS; round++) {
+        blocks[n++] = zmalloc_usable(sizeof(dictEntry), &usable);
+        if (usable < entry) entry = usable;
+        for (size_t len = 0; len <= DICT_EMBED_KEY_MAX; len++) {
+            char type = dict_sds.sdsReqType(len);
+            if (type == SDS_TYPE_5 && len == 0) type = SDS_TYPE_8;
+            blocks[n++] = zmalloc_usable(dict_sds.sdsHdrSize(type) + len + 1, &usable);
+            if (usable < key[len]) key[len] = usable;
+            blocks[n++] = zmalloc_usable(sizeof(dictEntry) + DICT_EMBED_KEY_HDR + len + 1, &usable);
+            if (usable < both[len]) both[len] = usable;
+        }
+    }
+    for (size_t len = 0; len <= DICT_EMBED_KEY_MAX; len++)
+        dict_embed_saves[len] = both[len] <= entry + key[len];
+    for (int j = 0; j < n; j++) zfree(blocks[j]);
+}
+
+/* 键拷贝到条目尾部是否划算：字典原本就要持有独立的键（有keyDup或keyDestructor）时，
+ * 只在合并后不多占内存的键长内嵌；借用调用者的键时内嵌只为少一次指针跳转，总是内嵌 */
+static int dictEmbedTrailingKey(dict *d, size_t len)
+{
+    if (!d->type->keyDup && !d->type->keyDestructor) return 1;
+    pthread_once(&dict_embed_probe_once, dictEmbedProbe);
+    return dict_embed_saves[len];
+}
+
+static dictEntry *dictCreateEntry(dict *d, void *key)
+{
+    dictEntry *he;
+    size_t len = 0;
+    int embed = 0;
+
+    if (d->type->flags & DICT_TYPE_EMBED_KEYS) {
+        len = dict_sds.sdslen(static_cast<sds>(key));
+        if ((d->type->flags & DICT_TYPE_NO_VALUE) && len <= DICT_EMBED_VAL_KEY_MAX)
+            embed = 1;
+        else
+            embed = len <= DICT_EMBED_KEY_MAX && dictEmbedTrailingKey(d, len);
+    }
+    if (!embed) {
+        he = (d->type->flags & DICT_TYPE_ENTRY_POOL) ? dictPoolAlloc(d) :
+             static_cast<dictEntry *>(zmalloc(sizeof(*he)));
+        dictSetKey(d, he, key);
+        if (d->type->flags & DICT_TYPE_NO_VALUE) he->v.val = NULL;
+        return he;
+    }
+
+    if ((d->type->flags & DICT_TYPE_NO_VALUE) && len <= DICT_EMBED_VAL_KEY_MAX) {
+        he = (d->type->flags & DICT_TYPE_ENTRY_POOL) ? dictPoolAlloc(d) :
+             static_cast<dictEntry *>(zmalloc(sizeof(*he)));
+        unsigned char *p = reinterpret_cast<unsigned char *>(&he->v);
+        p[0] = SDS_TYPE_5 | (len << SDS_TYPE_BITS);
+        memcpy(p + 1, key, len);
+        p[len + 1] = '\0';
+        he->key = p + 1;
+    } else {
+        he = static_cast<dictEntry *>(zmalloc(sizeof(*he) + DICT_EMBED_KEY_HDR + len + 1));
+        struct sdshdr8 *sh = reinterpret_cast<struct sdshdr8 *>(he + 1);
+        sh->len = len;
+        sh->alloc = len;
+        sh->flags = SDS_TYPE_8 | DICT_EMBED_KEY_MARK;
+        memcpy(sh->buf, key, len);
+        sh->buf[len] = '\0';
+        he->key = sh->buf;
+        if (d->type->flags & DICT_TYPE_NO_VALUE) he->v.val = NULL;
+    }
+    /* 字典拥有传入的键：内容已复制，原来的sds不再需要 */
+    if (d->type->keyDestructor && !d->type->keyDup)
+        d->type->keyDestructor(d->privdata, key);
+    return he;
+}
+
+/* ------------------------------- 运行指标 ---------------------------------*/
+/* 编译时定义DICT_METRICS才有埋点；打开了dictEnableMetrics的字典才累加，其余字典只多一次指针判断 */
+#ifdef DICT_METRICS
+#include <time.h>
+
+static inline long long dictNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void dictMetricsRecordFind(REDIS_BASE::dictMetrics *m, int hit, unsigned long probes)
+{
+    if (hit) m->find_hits++;
+    else m->find_misses++;
+    m->probe_hist[probes < DICT_METRICS_PROBE_BUCKETS ? probes : DICT_METRICS_PROBE_BUCKETS - 1]++;
+    m->probe_sum += probes;
+}
+
+/* 开始rehash时按新旧大小记一次扩容、缩容或重建 */
+static void dictMetricsRecordResize(REDIS_BASE::dictMetrics *m, unsigned long oldsize, unsigned long newsize)
+{
+    if (newsize > oldsize) m->expands++;
+    else if (newsize < oldsize) m->shrinks++;
+    else m->rebuilds++;
+}
+
+#define dictMetricsIncr(d, field) do { if ((d)->metrics) (d)->metrics->field++; } while (0)
+#define dictMetricsAdd(d, field, n) do { if ((d)->metrics) (d)->metrics->field += (n); } while (0)
+#define dictMetricsProbe(n) ((n)++)
+#define dictMetricsFind(d, he, probes) do { \
+    if ((d)->metrics) dictMetricsRecordFind((d)->metrics, (he) != NULL, (probes)); \
+} while (0)
+#define dictMetricsResize(d, oldsize, newsize) do { \
+    if ((d)->metrics) dictMetricsRecordResize((d)->metrics, (oldsize), (newsize)); \
+} while (0)
+#else
+#define dictMetricsIncr(d, field) ((void)0)
+#define dictMetricsAdd(d, field, n) ((void)0)
+#define dictMetricsProbe(n) ((void)0)
+#define dictMetricsFind(d, he, probes) ((void)(probes))
+#define dictMetricsResize(d, oldsize, newsize) ((void)0)
+#endif
+
+/* ------------------------- swiss table engine ------------------------------ */
+/* dictCreateSwiss创建的字典使用开放寻址的swiss table：
+ * 每张表是一整块内存 = dictSwissTable头 + size个控制字节 + size个16字节槽位（key和v，没有next）。
+ * 控制字节为EMPTY/DELETED或者哈希值的高7位（h2），查找时一次比较一组控制字节，
+ * 只对h2相同的槽位比较键。探测以组为单位，从 hash & 组掩码 开始按三角数跳组，
+ * 遇到含EMPTY的组结束。ht[].size是槽位数，sizemask仍是size-1，used是元素个数，
+ * rehashidx是ht[0]中下一个待搬迁的组下标。 */
+#if defined(__SSE2__)
+#define DICT_SWISS_GROUP 16
+#else
+#define DICT_SWISS_GROUP 8
+#endif
+#define DICT_SWISS_EMPTY ((int8_t)-128)
+#define DICT_SWISS_DELETED ((int8_t)-2)
+#define DICT_SWISS_GROUP_BITS ((uint32_t)((1UL << DICT_SWISS_GROUP) - 1))
+#define DICT_SWISS_SLOT_SIZE offsetof(dictEntry, next)
+#define dictSwissIsFull(c) ((c) >= 0)
+#define dictSwissH2(h) ((int8_t)((h) >> 57))
+
+typedef struct dictSwissTable {
+    unsigned long growth_left;  /* 不超过最大装载率的前提下还能占用的EMPTY槽数 */
+    unsigned long deleted;      /* 墓碑（DELETED）数 */
+    int8_t ctrl[];              /* size个控制字节，其后紧跟槽位 */
+} dictSwissTable;
+
+#define dictSwissHeader(ht) ((dictSwissTable*)(ht)->table)
+#define dictSwissSlot(ht, i) \
+    ((dictEntry*)(dictSwissHeader(ht)->ctrl + (ht)->size + (i)*DICT_SWISS_SLOT_SIZE))
+#define dictSwissSlotIndex(ht, de) \
+    ((unsigned long)(((char*)(de) - (char*)dictSwissSlot(ht, 0)) / DICT_SWISS_SLOT_SIZE))
+#define dictSwissGroupMask(ht) ((ht)->sizemask / DICT_SWISS_GROUP)
+
+/* 组内控制字节等于c的槽位掩码，第i位对应组内第i个槽位 */
+static inline uint32_t dictSwissMatch(const int8_t *grp, int8_t c)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(grp));
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(c)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < DICT_SWISS_GROUP; i++)
+        mask |= (uint32_t)(grp[i] == c) << i;
+    return mask;
+#endif
+}
+
+/* 组内EMPTY或DELETED（最高位为1）的槽位掩码 */
+static inline uint32_t dictSwissMatchFree(const int8_t *grp)
+{
+#if defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(grp)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < DICT_SWISS_GROUP; i++)
+        mask |= (uint32_t)(grp[i] < 0) << i;
+    return mask;
+#endif
+}
+
+/* 能容纳n个元素的最小槽数，溢出返回0 */
+static unsigned long dictSwissCapacity(unsigned long n)
+{
+    unsigned long size = DICT_SWISS_MIN_SIZE;
+    while (DICT_SWISS_MAX_LOAD(size) < n) {
+        if (size > LONG_MAX / (DICT_SWISS_SLOT_SIZE + 1)) return 0;
+        size *= 2;
+    }
+    return size;
+}
+
+/* 分配size个槽位的空表，malloc_failed非NULL时分配失败不panic */
+static int dictSwissAlloc(dictht *n, unsigned long size, int *malloc_failed)
+{
+    size_t bytes = sizeof(dictSwissTable) + size * (DICT_SWISS_SLOT_SIZE + 1);
+    dictSwissTable *t;
+    if (malloc_failed) {
+        t = static_cast<dictSwissTable*>(ztrymalloc(bytes));
+        *malloc_failed = t == NULL;
+        if (t == NULL) return DICT_ERR;
+    } else {
+        t = static_cast<dictSwissTable*>(zmalloc(bytes));
+    }
+    t->growth_left = DICT_SWISS_MAX_LOAD(size);
+    t->deleted = 0;
+    memset(t->ctrl, DICT_SWISS_EMPTY, size);
+    n->table = reinterpret_cast<dictEntry**>(t);
+    n->size = size;
+    n->sizemask = size - 1;
+    n->used = 0;
+    return DICT_OK;
+}
+
+/* 在一张表里查找key */
+static dictEntry *dictSwissFindIn(dict *d, dictht *ht, const void *key, uint64_t h,
+                                  unsigned long *probes = NULL)
+{
+    if (ht->size == 0) return NULL;
+    const int8_t *ctrl = dictSwissHeader(ht)->ctrl;
+    unsigned long gmask = dictSwissGroupMask(ht), g = h & gmask, step = 0;
+    int8_t h2 = dictSwissH2(h);
+
+    while (1) {
+        const int8_t *grp = ctrl + g * DICT_SWISS_GROUP;
+        uint32_t m = dictSwissMatch(grp, h2);
+        if (probes) (*probes)++;
+        while (m) {
+            dictEntry *de = dictSwissSlot(ht, g * DICT_SWISS_GROUP + __builtin_ctz(m));
+            if (key == de->key || dictCompareKeys(d, key, de->key)) return de;
+            m &= m - 1;
+        }
+        /* 含EMPTY的组说明探测序列到此为止 */
+        if (dictSwissMatch(grp, DICT_SWISS_EMPTY)) return NULL;
+        if (++step > gmask) return NULL;
+        g = (g + step) & gmask;
+    }
+}
+
+/* 为哈希值为h的新元素占一个槽位（调用方保证键不存在且growth_left > 0），返回槽位 */
+static dictEntry *dictSwissInsertSlot(dictht *ht, uint64_t h)
+{
+    dictSwissTable *t = dictSwissHeader(ht);
+    unsigned long gmask = dictSwissGroupMask(ht), g = h & gmask, step = 0;
+
+    while (1) {
+        uint32_t m = dictSwissMatchFree(t->ctrl + g * DICT_SWISS_GROUP);
+        if (m) {
+            unsigned long idx = g * DICT_SWISS_GROUP + __builtin_ctz(m);
+            if (t->ctrl[idx] == DICT_SWISS_DELETED)
+                t->deleted--;
+            else
+                t->growth_left--;
+            t->ctrl[idx] = dictSwissH2(h);
+            ht->used++;
+            return dictSwissSlot(ht, idx);
+        }
+        step++;
+        g = (g + step) & gmask;
+    }
+}
+
+/* 把槽位标记为空。组内还有EMPTY时没有探测序列经过这个组，可以直接置EMPTY，
+ * 否则要留下墓碑，保证后面组里的元素仍能被找到。 */
+static void dictSwissErase(dictht *ht, dictEntry *de)
+{
+    dictSwissTable *t = dictSwissHeader(ht);
+    unsigned long idx = dictSwissSlotIndex(ht, de);
+    const int8_t *grp = t->ctrl + (idx & ~(unsigned long)(DICT_SWISS_GROUP - 1));
+
+    if (dictSwissMatch(grp, DICT_SWISS_EMPTY)) {
+        t->ctrl[idx] = DICT_SWISS_EMPTY;
+        t->growth_left++;
+    } else {
+        t->ctrl[idx] = DICT_SWISS_DELETED;
+        t->deleted++;
+    }
+    ht->used--;
+}
+
+/* 分配新表：ht[0]为空时直接作为ht[0]，否则作为rehash目标ht[1]。
+ * 与链式引擎不同，允许与ht[0]同样大小，用于清理墓碑。 */
+static int dictSwissInstall(dict *d, unsigned long size, int *malloc_failed)
+{
+    dictht n;
+    if (dictSwissAlloc(&n, size, malloc_failed) != DICT_OK) return DICT_ERR;
+    if (d->ht[0].table == NULL) {
+        d->ht[0] = n;
+        return DICT_OK;
+    }
+    dictMetricsResize(d, d->ht[0].size, size);
+    d->ht[1] = n;
+    d->rehashidx = 0;
+    return DICT_OK;
+}
+
+/* rehash暂停时ht[1]放不下ht[0]剩下的元素：按两张表的元素总数重建ht[1]，ht[0]保持不动 */
+static void dictSwissRegrowTarget(dict *d)
+{
+    dictht *t1 = &d->ht[1], n;
+    unsigned long size = dictSwissCapacity((d->ht[0].used + t1->used + 1) * 2);
+
+    dictSwissAlloc(&n, size, NULL);
+    for (unsigned long i = 0; i < t1->size; i++) {
+        if (!dictSwissIsFull(dictSwissHeader(t1)->ctrl[i])) continue;
+        dictEntry *de = dictSwissSlot(t1, i);
+        dictEntry *nde = dictSwissInsertSlot(&n, dictHashKey(d, de->key));
+        nde->key = de->key;
+        nde->v = de->v;
+    }
+    zfree(t1->table);
+    *t1 = n;
+}
+
+/* 扫描：发出所有"家组"为g的元素，它们位于从g开始的探测序列上 */
+static void dictSwissScanGroup(dict *d, dictht *ht, unsigned long g, dictScanFunction *fn, void *privdata)
+{
+    const int8_t *ctrl = dictSwissHeader(ht)->ctrl;
+    unsigned long gmask = dictSwissGroupMask(ht), pos = g, step = 0;
+
+    while (1) {
+        const int8_t *grp = ctrl + pos * DICT_SWISS_GROUP;
+        uint32_t m = ~dictSwissMatchFree(grp) & DICT_SWISS_GROUP_BITS;
+        while (m) {
+            dictEntry *de = dictSwissSlot(ht, pos * DICT_SWISS_GROUP + __builtin_ctz(m));
+            if ((dictHashKey(d, de->key) & gmask) == g) fn(privdata, de);
+            m &= m - 1;
+        }
+        if (dictSwissMatch(grp, DICT_SWISS_EMPTY)) break;
+        if (++step > gmask) break;
+        pos = (pos + step) & gmask;
+    }
+}
+
+/* ------------------------- background rehash ------------------------------ */
+/* dictEnableBackgroundRehash打开后，链式字典扩缩容到不小于阈值的大小时，由一个辅助线程
+ * 把ht[0]的桶搬到ht[1]。同一时刻只有一个字典在后台rehash，其余的照旧在前台分步rehash。
+ *
+ * 交接协议：按 hash & min(ht[0].sizemask, ht[1].sizemask) 把桶分到DICT_BG_REHASH_STRIPES个
+ * 条带，一个条带同时覆盖ht[0]的桶和它在ht[1]中对应的所有桶（缩容时反过来）。后台线程持条带锁
+ * 搬一个桶，前台的查找/插入/删除持同一把锁访问两张表，双方都看不到搬了一半的链表。
+ * 遍历整表的操作先等后台搬完。搬完后由前台在下一次访问时换表，后台线程只改桶和used，
+ * 从不改dict结构体里的表指针。 */
+typedef struct dictBgRehashState {
+    int thread_started;
+    dict *d;                        /* 正在后台rehash的字典，NULL表示空闲 */
+    int done;                       /* 后台已搬完，等待前台换表 */
+    unsigned long stripemask;       /* hash & stripemask 即条带号 */
+    unsigned long buckets_total;    /* 本次任务ht[0]的桶数 */
+    long long start_us;
+    unsigned char locks[DICT_BG_REHASH_STRIPES];
+} dictBgRehashState;
+
+static pthread_mutex_t dict_bg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dict_bg_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t dict_bg_thread;
+static dictBgRehashState dict_bg;
+static dictRehashStats dict_bg_stats;
+static unsigned long dict_bg_rehash_threshold = 0; /* 0表示关闭 */
+
+static long long dictUstime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec)*1000000 + tv.tv_usec;
+}
+
+static inline void dictStripeLock(unsigned char *lock)
+{
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED));
+}
+
+static inline void dictStripeUnlock(unsigned char *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+#define dictBgStripe(h) (&dict_bg.locks[(h) & dict_bg.stripemask])
+
+/* 后台线程：从rehashidx开始依次搬迁ht[0]的每个桶 */
+static void dictBgRehashRun(dict *d)
+{
+    dictht *t0 = &d->ht[0], *t1 = &d->ht[1];
+    unsigned long start = d->rehashidx, idx, moved = 0;
+
+    for (idx = start; idx < t0->size; idx++) {
+        unsigned char *lock = dictBgStripe(idx);
+        unsigned long n = 0;
+        dictEntry *de, *nextde;
+
+        dictStripeLock(lock);
+        de = t0->table[idx];
+        while (de) {
+            nextde = de->next;
+            uint64_t h = dictHashKey(d, de->key) & t1->sizemask;
+            de->next = t1->table[h];
+            t1->table[h] = de;
+            n++;
+            de = nextde;
+        }
+        t0->table[idx] = NULL;
+        /* 先加后减，前台不持锁读dictSize时只会多算，不会误判为空 */
+        if (n) {
+            __atomic_fetch_add(&t1->used, n, __ATOMIC_RELAXED);
+            __atomic_fetch_sub(&t0->used, n, __ATOMIC_RELAXED);
+        }
+        dictStripeUnlock(lock);
+        __atomic_store_n(&d->rehashidx, (long)idx + 1, __ATOMIC_RELAXED);
+        moved += n;
+    }
+    __atomic_fetch_add(&dict_bg_stats.buckets_moved, idx - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dict_bg_stats.entries_moved, moved, __ATOMIC_RELAXED);
+}
+
+static void *dictBgRehashMain(void *arg)
+{
+    DICT_NOTUSED(arg);
+    pthread_mutex_lock(&dict_bg_mutex);
+    while (1) {
+        while (dict_bg.d == NULL || dict_bg.done)
+            pthread_cond_wait(&dict_bg_cond, &dict_bg_mutex);
+        dict *d = dict_bg.d;
+        pthread_mutex_unlock(&dict_bg_mutex);
+
+        dictBgRehashRun(d);
+
+        pthread_mutex_lock(&dict_bg_mutex);
+        dict_bg_stats.last_duration_us = dictUstime() - dict_bg.start_us;
+        __atomic_store_n(&dict_bg.done, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&dict_bg_cond);
+    }
+    return NULL;
+}
+
+/* 把PENDING的字典交给后台线程；后台正忙时保持PENDING，本次仍在前台rehash */
+static void dictBgRehashTryStart(dict *d)
+{
+    pthread_mutex_lock(&dict_bg_mutex);
+    if (dict_bg.d != NULL) {
+        pthread_mutex_unlock(&dict_bg_mutex);
+        return;
+    }
+    if (!dict_bg.thread_started) {
+        if (pthread_create(&dict_bg_thread, NULL, dictBgRehashMain, NULL) != 0) {
+            pthread_mutex_unlock(&dict_bg_mutex);
+            d->bgrehash = DICT_BG_REHASH_NONE;
+            return;
+        }
+        pthread_detach(dict_bg_thread);
+        dict_bg.thread_started = 1;
+    }
+    unsigned long minmask = d->ht[0].sizemask < d->ht[1].sizemask ? d->ht[0].sizemask : d->ht[1].sizemask;
+    dict_bg.d = d;
+    dict_bg.done = 0;
+    dict_bg.stripemask = minmask & (DICT_BG_REHASH_STRIPES - 1);
+    dict_bg.buckets_total = d->ht[0].size;
+    dict_bg.start_us = dictUstime();
+    dict_bg_stats.started++;
+    d->bgrehash = DICT_BG_REHASH_RUNNING;
+    pthread_cond_broadcast(&dict_bg_cond);
+    pthread_mutex_unlock(&dict_bg_mutex);
+}
+
+/* 前台换表：后台已搬完，ht[1]成为新的ht[0] */
+static void dictBgRehashFinish(dict *d)
+{
+    zfree(d->ht[0].table);
+    d->ht[0] = d->ht[1];
+    d->ht[1].table = NULL;
+    d->ht[1].size = 0;
+    d->ht[1].sizemask = 0;
+    d->ht[1].used = 0;
+    d->rehashidx = -1;
+    d->bgrehash = DICT_BG_REHASH_NONE;
+
+    pthread_mutex_lock(&dict_bg_mutex);
+    dict_bg.d = NULL;
+    dict_bg.done = 0;
+    dict_bg_stats.completed++;
+    pthread_mutex_unlock(&dict_bg_mutex);
+}
+
+/* 后台搬完则换表。返回1表示仍在后台rehash */
+static int dictBgRehashPoll(dict *d)
+{
+    if (!dictIsBgRehashing(d)) return 0;
+    if (!__atomic_load_n(&dict_bg.done, __ATOMIC_ACQUIRE)) return 1;
+    dictBgRehashFinish(d);
+    return 0;
+}
+
+/* 遍历整表之前调用：等后台搬完并换表 */
+static void dictBgRehashWait(dict *d)
+{
+    if (!dictIsBgRehashing(d)) return;
+    if (!__atomic_load_n(&dict_bg.done, __ATOMIC_ACQUIRE)) {
+        long long start = dictUstime();
+        pthread_mutex_lock(&dict_bg_mutex);
+        while (!dict_bg.done)
+            pthread_cond_wait(&dict_bg_cond, &dict_bg_mutex);
+        dict_bg_stats.fg_waits++;
+        dict_bg_stats.fg_wait_us += dictUstime() - start;
+        pthread_mutex_unlock(&dict_bg_mutex);
+    }
+    dictBgRehashFinish(d);
+}
+
+/* 后台rehash期间的查找/插入/删除：持条带锁访问两张表，新元素总是插入ht[1] */
+static dictEntry *dictBgFind(dict *d, const void *key)
+{
+    uint64_t h = dictHashKey(d, key);
+    unsigned char *lock = dictBgStripe(h);
+    dictEntry *he = NULL;
+    unsigned long probes = 0;
+
+    dictStripeLock(lock);
+    for (int table = 0; table <= 1 && he == NULL; table++) {
+        for (he = d->ht[table].table[h & d->ht[table].sizemask]; he; he = he->next) {
+            dictMetricsProbe(probes);
+            if (key == he->key || dictCompareKeys(d, key, he->key)) break;
+        }
+    }
+    dictStripeUnlock(lock);
+    /* 指标只由前台线程读写，放到锁外记录 */
+    dictMetricsFind(d, he, probes);
+    return he;
+}
+
+static dictEntry *dictBgAddRaw(dict *d, void *key, dictEntry **existing)
+{
+    uint64_t h = dictHashKey(d, key);
+    unsigned char *lock = dictBgStripe(h);
+    dictht *ht = &d->ht[1];
+    dictEntry *he;
+
+    if (existing) *existing = NULL;
+    dictStripeLock(lock);
+    for (int table = 0; table <= 1; table++) {
+        for (he = d->ht[table].table[h & d->ht[table].sizemask]; he; he = he->next) {
+            if (key == he->key || dictCompareKeys(d, key, he->key)) {
+                dictStripeUnlock(lock);
+                if (existing) *existing = he;
+                return NULL;
+            }
+        }
+    }
+    he = dictCreateEntry(d, key);
+    he->next = ht->table[h & ht->sizemask];
+    ht->table[h & ht->sizemask] = he;
+    __atomic_fetch_add(&ht->used, 1, __ATOMIC_RELAXED);
+    dictStripeUnlock(lock);
+    return he;
+}
+
+static dictEntry *dictBgDelete(dict *d, const void *key, int nofree)
+{
+    uint64_t h = dictHashKey(d, key);
+    unsigned char *lock = dictBgStripe(h);
+    dictEntry *he = NULL, **ref;
+
+    dictStripeLock(lock);
+    for (int table = 0; table <= 1 && he == NULL; table++) {
+        for (ref = &d->ht[table].table[h & d->ht[table].sizemask]; *ref; ref = &(*ref)->next) {
+            if (key == (*ref)->key || dictCompareKeys(d, key, (*ref)->key)) {
+                he = *ref;
+                *ref = he->next;
+                __atomic_fetch_sub(&d->ht[table].used, 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+    dictStripeUnlock(lock);
+    /* 条目已从表里摘下，释放时不必持锁 */
+    if (he && !nofree) {
+        dictFreeKey(d, he);
+        dictFreeVal(d, he);
+        dictFreeEntry(d, he);
+    }
+    return he;
+}
+
 /* Reset a hash table already initialized with ht_init().
  * NOTE: This function should only be called by ht_destroy(). */
 void dictionaryCreate::_dictReset(dictht *ht)
@@ -183,6 +1271,10 @@ int dictionaryCreate::_dictInit(dict *d, dictType *type,void *privDataPtr)
     d->privdata = privDataPtr;
     d->rehashidx = -1;
     d->pauserehash = 0;
+    d->engine = DICT_ENGINE_CHAINED;
+    d->bgrehash = DICT_BG_REHASH_NONE;
+    d->entrypool = NULL;
+    d->metrics = NULL;
     return DICT_OK;
 }
 
@@ -199,6 +1291,13 @@ int dictionaryCreate::_dictExpand(dict *d, unsigned long size, int* malloc_faile
     if (dictIsRehashing(d) || d->ht[0].used > size)
         return DICT_ERR;
 
+    /* swiss引擎的size是要容纳的元素个数，按最大装载率换算成槽数 */
+    if (dictIsSwiss(d)) {
+        unsigned long slots = dictSwissCapacity(size);
+        if (slots == 0 || slots == d->ht[0].size) return DICT_ERR;
+        return dictSwissInstall(d, slots, malloc_failed);
+    }
+
     dictht n; /* the new hash table */
     unsigned long realsize = _dictNextPower(size);
 
@@ -230,8 +1329,13 @@ int dictionaryCreate::_dictExpand(dict *d, unsigned long size, int* malloc_faile
     }
 
     /* Prepare a second hash table for incremental rehashing */
+    dictMetricsResize(d, d->ht[0].size, realsize);
     d->ht[1] = n;
     d->rehashidx = 0;
+    /* 大表交给后台线程搬迁，在下一次访问字典时启动 */
+    if (dict_bg_rehash_threshold &&
+        (realsize >= dict_bg_rehash_threshold || d->ht[0].size >= dict_bg_rehash_threshold))
+        d->bgrehash = DICT_BG_REHASH_PENDING;
     return DICT_OK;
 }
 
@@ -248,6 +1352,26 @@ int dictionaryCreate::_dictClear(dict *d, dictht *ht, void(callback)(void *))
 {
     unsigned long i;
 
+    if (dictIsSwiss(d)) {
+        const int8_t *ctrl = ht->table ? dictSwissHeader(ht)->ctrl : NULL;
+        for (i = 0; i < ht->size && ht->used > 0; i++) {
+            if (callback && (i & 65535) == 0) callback(d->privdata);
+            if (!dictSwissIsFull(ctrl[i])) continue;
+            dictEntry *he = dictSwissSlot(ht, i);
+            dictFreeKey(d, he);
+            dictFreeVal(d, he);
+            ht->used--;
+        }
+        zfree(ht->table);
+        _dictReset(ht);
+        return DICT_OK;
+    }
+
+    /* 条目池里的条目由调用者随slab整块释放；没有析构函数、也没有单独分配的内嵌键时不必遍历 */
+    if (d->entrypool && !d->type->keyDestructor && !d->type->valDestructor &&
+        !(d->type->flags & DICT_TYPE_EMBED_KEYS))
+        ht->used = 0;
+
     /* Free all the elements */
     for (i = 0; i < ht->size && ht->used > 0; i++) {
         dictEntry *he, *nextHe;
@@ -259,7 +1383,7 @@ int dictionaryCreate::_dictClear(dict *d, dictht *ht, void(callback)(void *))
             nextHe = he->next;
             dictFreeKey(d, he);
             dictFreeVal(d, he);
-            zfree(he);
+            if (!dictEntryIsPooled(d, he)) zfree(he);
             ht->used--;
             he = nextHe;
         }
@@ -320,12 +1444,46 @@ long long dictionaryCreate::dictFingerprint(dict *d) {
  * while it is actively used. */
 void dictionaryCreate::_dictRehashStep(dict *d) 
 {
-    if (d->pauserehash == 0) 
-            dictRehash(d,1);
+    if (d->bgrehash == DICT_BG_REHASH_PENDING && d->pauserehash == 0)
+        dictBgRehashTryStart(d);
+    if (dictIsBgRehashing(d)) {
+        dictBgRehashPoll(d);
+        return;
+    }
+    if (d->pauserehash > 0) {
+        dictMetricsIncr(d, rehash_steps_paused);
+        return;
+    }
+#ifdef DICT_METRICS
+    if (d->metrics) {
+        long long start = dictNanoseconds();
+        dictRehash(d,1);
+        d->metrics->rehash_steps++;
+        d->metrics->rehash_step_ns += dictNanoseconds() - start;
+        return;
+    }
+#endif
+    dictRehash(d,1);
 }
 
 
 
+/* dictType没有指定resizePolicy时使用的策略 */
+static const REDIS_BASE::dictResizePolicy dict_default_resize_policy = {
+    DICT_GROW_FILL, DICT_FORCE_GROW_FILL, DICT_SHRINK_FILL, DICT_SHRINK_TARGET_FILL, DICT_PRESSURE_WATERMARK
+};
+#define dictGetResizePolicy(d) \
+    ((d)->type->resizePolicy ? (d)->type->resizePolicy : &dict_default_resize_policy)
+
+/* 设置了内存软上限、且used_memory超过其pressure_watermark%时视为内存吃紧 */
+static int dictUnderMemoryPressure(const REDIS_BASE::dictResizePolicy *policy)
+{
+    size_t limit;
+    if (policy->pressure_watermark == 0 ||
+        (limit = REDIS_BASE::zmalloc::zmalloc_get_soft_limit()) == 0) return 0;
+    return zmalloc_used_memory() > limit / 100 * policy->pressure_watermark;
+}
+
 /* Because we may need to allocate huge memory chunk at once when dict
  * expands, we will check this allocation is allowed or not if the dict
  * type has expandAllowed member function. */
@@ -345,20 +1503,43 @@ int dictionaryCreate::_dictExpandIfNeeded(dict *d)
     /* If the hash table is empty expand it to the initial size. */
     if (d->ht[0].size == 0) return dictExpand(d, DICT_HT_INITIAL_SIZE);
 
-    /* If we reached the 1:1 ratio, and we are allowed to resize the hash
-     * table (global setting) or we should avoid it but the ratio between
-     * elements/buckets is over the "safe" threshold, we resize doubling
-     * the number of buckets. */
-    if (d->ht[0].used >= d->ht[0].size &&
-        (dict_can_resize ||
-         d->ht[0].used/d->ht[0].size > dict_force_resize_ratio) &&
+    /* 装载率达到grow_fill时扩容；dictDisableResize期间或内存吃紧时，
+     * 要等装载率超过force_grow_fill才扩容。 */
+    const dictResizePolicy *policy = dictGetResizePolicy(d);
+    unsigned long long used = d->ht[0].used, size = d->ht[0].size;
+    if (used * 100 >= size * policy->grow_fill &&
+        ((dict_can_resize && !dictUnderMemoryPressure(policy)) ||
+         used * 100 > size * policy->force_grow_fill) &&
         dictTypeExpandAllowed(d))
     {
+        /* 被迫扩容时也按used+1取整：_dictExpand不接受小于used的目标，
+         * 只翻一倍会失败，表就永远停在force_grow_fill之上 */
         return dictExpand(d, d->ht[0].used + 1);
     }
     return DICT_OK;
 }
 
+/**
+ * 按扩缩容策略判断是否缩容
+ * @param d 字典指针
+ * @return 开始缩容返回DICT_OK，否则返回DICT_ERR
+ */
+int dictionaryCreate::dictShrinkIfNeeded(dict *d)
+{
+    const dictResizePolicy *policy = dictGetResizePolicy(d);
+    unsigned long long used = d->ht[0].used, size = d->ht[0].size;
+    unsigned long minsize = dictIsSwiss(d) ? DICT_SWISS_MIN_SIZE : DICT_HT_INITIAL_SIZE;
+
+    if (policy->shrink_fill == 0 || !dict_can_resize ||
+        dictIsRehashing(d) || d->pauserehash > 0) return DICT_ERR;
+    if (size <= minsize || used * 100 >= size * policy->shrink_fill) return DICT_ERR;
+
+    /* 缩到装载率约为shrink_target，而不是刚好装下，留出滞后区间 */
+    unsigned long target = (unsigned long)(used * 100 / (policy->shrink_target ? policy->shrink_target : 100));
+    if (target < DICT_HT_INITIAL_SIZE) target = DICT_HT_INITIAL_SIZE;
+    return dictExpand(d, target);
+}
+
 /* Our hash table capability is a power of two */
 unsigned long dictionaryCreate::_dictNextPower(unsigned long size)
 {
@@ -475,6 +1656,7 @@ size_t dictionaryCreate::_dictGetStatsHt(char *buf, size_t bufsize, dictht *ht,
  */
 void dictionaryCreate::dictSetHashFunctionSeed(uint8_t *seed) {
     memcpy(dict_hash_function_seed,seed,sizeof(dict_hash_function_seed));
+    dictHashSeedUpdate();
 }
 /**
  * 获取哈希函数种子
@@ -490,6 +1672,8 @@ uint8_t *dictionaryCreate::dictGetHashFunctionSeed(void) {
  * @return 哈希值
  */
 uint64_t dictionaryCreate::dictGenHashFunction(const void *key, int len) {
+    if (dict_hash_backend != DICT_HASH_SIPHASH)
+        return dictFastHash(dict_hash_backend, static_cast<const uint8_t *>(key), len);
     return siphash(static_cast<const uint8_t *>(key),len,dict_hash_function_seed);
 }
 
@@ -500,7 +1684,39 @@ uint64_t dictionaryCreate::dictGenHashFunction(const void *key, int len) {
  * @return 哈希值
  */
 uint64_t dictionaryCreate::dictGenCaseHashFunction(const unsigned char *buf, int len) {
-    return siphash_nocase(buf,len,dict_hash_function_seed);
+    if (dict_hash_backend == DICT_HASH_SIPHASH)
+        return siphash_nocase(buf,len,dict_hash_function_seed);
+
+    /* 先转成小写再哈希，短键用栈上的缓冲区 */
+    uint8_t stackbuf[DICT_HASH_NOCASE_STACK];
+    uint8_t *lower = len <= DICT_HASH_NOCASE_STACK ? stackbuf : static_cast<uint8_t*>(zmalloc(len));
+    int j = 0;
+    for (; j + 8 <= len; j += 8) dictWrite64(lower + j, dictToLower64(dictRead64(buf + j)));
+    for (; j < len; j++) lower[j] = siptlw(buf[j]);
+    uint64_t h = dictFastHash(dict_hash_backend, lower, len);
+    if (lower != stackbuf) zfree(lower);
+    return h;
+}
+
+/**
+ * 选择dictGenHashFunction/dictGenCaseHashFunction使用的哈希算法
+ * @param backend DICT_HASH_SIPHASH、DICT_HASH_WYHASH或DICT_HASH_XXH3
+ * @return 成功返回DICT_OK，未知的算法返回DICT_ERR
+ */
+int dictionaryCreate::dictSetHashBackend(int backend) {
+    if (backend != DICT_HASH_SIPHASH && backend != DICT_HASH_WYHASH && backend != DICT_HASH_XXH3)
+        return DICT_ERR;
+    dict_hash_backend = backend;
+    dictHashSeedUpdate();
+    return DICT_OK;
+}
+
+/**
+ * 获取当前的哈希算法
+ * @return DICT_HASH_xxx
+ */
+int dictionaryCreate::dictGetHashBackend(void) {
+    return dict_hash_backend;
 }
 
 
@@ -520,6 +1736,19 @@ dict *dictionaryCreate::dictCreate(dictType *type,
     return d;
 }
 
+/**
+ * 创建使用swiss table引擎的字典
+ * @param type 字典类型（定义回调函数）
+ * @param privDataPtr 私有数据指针（传递给回调函数）
+ * @return 成功返回字典指针，失败返回NULL
+ */
+dict *dictionaryCreate::dictCreateSwiss(dictType *type, void *privDataPtr)
+{
+    dict *d = dictCreate(type, privDataPtr);
+    d->engine = DICT_ENGINE_SWISS;
+    return d;
+}
+
 
 /**
  * 调整字典大小为刚好容纳所有元素（优化内存）
@@ -580,6 +1809,8 @@ int dictionaryCreate::dictTryExpand(dict *d, unsigned long size) {
 int dictionaryCreate::dictRehash(dict *d, int n) {
     int empty_visits = n*10; /* Max number of empty buckets to visit. */
     if (!dictIsRehashing(d)) return 0;
+    if (dictIsBgRehashing(d)) return dictBgRehashPoll(d);
+    if (dictIsSwiss(d)) return _dictSwissRehash(d, n);
 
     while(n-- && d->ht[0].used != 0) {
         dictEntry *de, *nextde;
@@ -615,6 +1846,7 @@ int dictionaryCreate::dictRehash(dict *d, int n) {
         d->ht[0] = d->ht[1];
         _dictReset(&d->ht[1]);
         d->rehashidx = -1;
+        d->bgrehash = DICT_BG_REHASH_NONE;
         return 0;
     }
 
@@ -634,6 +1866,11 @@ int dictionaryCreate::dictRehash(dict *d, int n) {
  */
 int dictionaryCreate::dictRehashMilliseconds(dict *d, int ms) {
     if (d->pauserehash > 0) return 0;
+    /* 后台线程在搬，前台不必占用时间片 */
+    if (dictIsBgRehashing(d)) {
+        dictBgRehashPoll(d);
+        return 0;
+    }
 
     long long start = timeInMilliseconds();
     int rehashes = 0;
@@ -695,6 +1932,23 @@ int dictionaryCreate::dictAdd(dict *d, void *key, void *val)
     dictht *ht;
 
     if (dictIsRehashing(d)) _dictRehashStep(d);
+    if (dictIsBgRehashing(d)) return dictBgAddRaw(d, key, existing);
+
+    if (dictIsSwiss(d)) {
+        uint64_t h = dictHashKey(d, key);
+        if (existing) *existing = NULL;
+        if ((entry = dictSwissFindIn(d, &d->ht[0], key, h)) == NULL && dictIsRehashing(d))
+            entry = dictSwissFindIn(d, &d->ht[1], key, h);
+        if (entry) {
+            if (existing) *existing = entry;
+            return NULL;
+        }
+        _dictSwissExpandIfNeeded(d);
+        ht = dictIsRehashing(d) ? &d->ht[1] : &d->ht[0];
+        entry = dictSwissInsertSlot(ht, h);
+        dictSetKey(d, entry, key);
+        return entry;
+    }
 
     /* Get the index of the new element, or -1 if
      * the element already exists. */
@@ -707,13 +1961,10 @@ int dictionaryCreate::dictAdd(dict *d, void *key, void *val)
      * system it is more likely that recently added entries are accessed
      * more frequently. */
     ht = dictIsRehashing(d) ? &d->ht[1] : &d->ht[0];
-    entry = static_cast<dictEntry *>(zmalloc(sizeof(*entry)));
+    entry = dictCreateEntry(d, key);
     entry->next = ht->table[index];
     ht->table[index] = entry;
     ht->used++;
-
-    /* Set the hash entry fields. */
-    dictSetKey(d, entry, key);
     return entry;
 }
 
@@ -747,7 +1998,8 @@ int dictionaryCreate::dictReplace(dict *d, void *key, void *val)
      * as the previous one. In this context, think to reference counting,
      * you want to increment (set), and then decrement (free), and not the
      * reverse. */
-    auxentry = *existing;
+    /* swiss引擎的槽位没有next字段，只复制值 */
+    auxentry.v = existing->v;
     dictSetVal(d, existing, val);
     dictFreeVal(d, &auxentry);
     return 0;
@@ -772,6 +2024,162 @@ dictEntry *dictionaryCreate::dictAddOrFind(dict *d, void *key) {
     return entry ? entry : existing;
 }
 
+/* ------------------------------- 批量加载 ---------------------------------*/
+
+/* 重复键的键值对不插入：字典本会接管的键、值按析构函数释放 */
+static void dictBulkDropPair(dict *d, void *key, void *val)
+{
+    if (d->type->keyDestructor && !d->type->keyDup)
+        d->type->keyDestructor(d->privdata, key);
+    if (d->type->valDestructor && !d->type->valDup && !(d->type->flags & DICT_TYPE_NO_VALUE))
+        d->type->valDestructor(d->privdata, val);
+}
+
+typedef struct dictBulkHashJob {
+    dict *d;
+    void **keys;
+    uint64_t *hashes;
+    unsigned long n;
+} dictBulkHashJob;
+
+static void *dictBulkHashMain(void *arg)
+{
+    dictBulkHashJob *job = static_cast<dictBulkHashJob*>(arg);
+    for (unsigned long i = 0; i < job->n; i++)
+        job->hashes[i] = dictHashKey(job->d, job->keys[i]);
+    return NULL;
+}
+
+/* 计算一批键的哈希。键数够多时切成连续的几段，调用线程算第一段，其余交给临时线程；
+ * hashFunction只读键和全局种子，可以并发调用。建线程失败的段由调用线程补算 */
+static void dictBulkHash(dict *d, void **keys, uint64_t *hashes, unsigned long n, int threads)
+{
+    pthread_t tids[DICT_BULK_THREADS_MAX];
+    dictBulkHashJob jobs[DICT_BULK_THREADS_MAX];
+    int started[DICT_BULK_THREADS_MAX];
+    unsigned long per;
+
+    if ((unsigned long)threads > n / DICT_BULK_THREAD_MIN) threads = (int)(n / DICT_BULK_THREAD_MIN);
+    if (threads > DICT_BULK_THREADS_MAX) threads = DICT_BULK_THREADS_MAX;
+    if (threads <= 1) {
+        dictBulkHashJob job = {d, keys, hashes, n};
+        dictBulkHashMain(&job);
+        return;
+    }
+
+    per = n / threads;
+    for (int t = 0; t < threads; t++) {
+        jobs[t].d = d;
+        jobs[t].keys = keys + t * per;
+        jobs[t].hashes = hashes + t * per;
+        jobs[t].n = t == threads - 1 ? n - t * per : per;
+        started[t] = t > 0 && pthread_create(&tids[t], NULL, dictBulkHashMain, &jobs[t]) == 0;
+    }
+    dictBulkHashMain(&jobs[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else dictBulkHashMain(&jobs[t]);
+    }
+}
+
+void dictionaryCreate::_dictBulkReserve(dict *d, unsigned long n)
+{
+    unsigned long need = d->ht[0].used + d->ht[1].used + n;
+
+    dictBgRehashWait(d);
+    while (dictRehash(d, 100));
+    if (dictIsSwiss(d)) {
+        /* 复用墓碑不消耗growth_left，按growth_left判断是保守的 */
+        if (d->ht[0].size == 0 || dictSwissHeader(&d->ht[0])->growth_left < n) {
+            unsigned long size = dictSwissCapacity(need);
+            if (size < d->ht[0].size) size = d->ht[0].size;
+            dictSwissInstall(d, size, NULL);
+        }
+    } else if (d->ht[0].size < need) {
+        dictExpand(d, need);
+    }
+    while (dictRehash(d, 100));
+}
+
+unsigned long dictionaryCreate::_dictBulkInsert(dict *d, void **keys, void **vals, const uint64_t *hashes,
+                                                unsigned long n, int flags)
+{
+    dictht *ht = &d->ht[0];
+    unsigned long added = 0;
+
+    for (unsigned long i = 0; i < n; i++) {
+        dictEntry *entry;
+
+        if (i + DICT_BULK_PREFETCH < n) {
+            uint64_t h = hashes[i + DICT_BULK_PREFETCH];
+            if (dictIsSwiss(d))
+                redis_prefetch(dictSwissHeader(ht)->ctrl + (h & dictSwissGroupMask(ht)) * DICT_SWISS_GROUP);
+            else
+                redis_prefetch(&ht->table[h & ht->sizemask]);
+        }
+
+        if (dictIsSwiss(d)) {
+            if (!(flags & DICT_BULK_UNIQUE) && dictSwissFindIn(d, ht, keys[i], hashes[i])) {
+                dictBulkDropPair(d, keys[i], vals[i]);
+                continue;
+            }
+            entry = dictSwissInsertSlot(ht, hashes[i]);
+            dictSetKey(d, entry, keys[i]);
+        } else {
+            unsigned long idx = hashes[i] & ht->sizemask;
+            if (!(flags & DICT_BULK_UNIQUE)) {
+                for (entry = ht->table[idx]; entry; entry = entry->next)
+                    if (keys[i] == entry->key || dictCompareKeys(d, keys[i], entry->key)) break;
+                if (entry) {
+                    dictBulkDropPair(d, keys[i], vals[i]);
+                    continue;
+                }
+            }
+            entry = dictCreateEntry(d, keys[i]);
+            entry->next = ht->table[idx];
+            ht->table[idx] = entry;
+            ht->used++;
+        }
+        dictSetVal(d, entry, vals[i]);
+        added++;
+    }
+    return added;
+}
+
+unsigned long dictionaryCreate::dictBulkLoad(dict *d, unsigned long count, dictBulkNextFunction *next,
+                                             void *privdata, int flags, int threads)
+{
+    unsigned long added = 0, n, cap;
+    void *key, *val;
+
+    /* 安全迭代器要求期间不搬迁条目，只能逐个插入 */
+    if (d->pauserehash > 0) {
+        while (next(privdata, &key, &val)) {
+            if (dictAdd(d, key, val) == DICT_OK) added++;
+            else dictBulkDropPair(d, key, val);
+        }
+        return added;
+    }
+
+    cap = count < DICT_BULK_CHUNK ? count : DICT_BULK_CHUNK;
+    if (cap < DICT_FIND_BATCH_MAX) cap = DICT_FIND_BATCH_MAX;
+    void **keys = static_cast<void**>(zmalloc(cap * (2 * sizeof(void*) + sizeof(uint64_t))));
+    void **vals = keys + cap;
+    uint64_t *hashes = reinterpret_cast<uint64_t*>(vals + cap);
+
+    _dictBulkReserve(d, count);
+    do {
+        for (n = 0; n < cap && next(privdata, &keys[n], &vals[n]); n++);
+        if (n == 0) break;
+        /* 没超出count时已经预留过，这里什么都不做 */
+        _dictBulkReserve(d, n);
+        dictBulkHash(d, keys, hashes, n, threads);
+        added += _dictBulkInsert(d, keys, vals, hashes, n, flags);
+    } while (n == cap);
+    zfree(keys);
+    return added;
+}
+
 /* Search and remove an element. This is an helper function for
  * dictDelete() and dictUnlink(), please check the top comment
  * of those functions. */
@@ -781,11 +2189,34 @@ dictEntry *dictionaryCreate::dictGenericDelete(dict *d, const void *key, int nof
     dictEntry *he, *prevHe;
     int table;
 
+    /* 同dictFind，后台rehash期间不做不持锁的判空 */
+    if (dictIsBgRehashing(d)) {
+        _dictRehashStep(d);
+        if (dictIsBgRehashing(d)) return dictBgDelete(d, key, nofree);
+    }
     if (d->ht[0].used == 0 && d->ht[1].used == 0) return NULL;
 
     if (dictIsRehashing(d)) _dictRehashStep(d);
     h = dictHashKey(d, key);
 
+    if (dictIsSwiss(d)) {
+        /* 槽位内容在下一次插入前保持不变，unlink的调用方仍可读取 */
+        for (table = 0; table <= 1; table++) {
+            if ((he = dictSwissFindIn(d, &d->ht[table], key, h)) != NULL) {
+                dictSwissErase(&d->ht[table], he);
+                if (!nofree) {
+                    dictFreeKey(d, he);
+                    dictFreeVal(d, he);
+                    he = NULL;
+                    dictShrinkIfNeeded(d);
+                }
+                return he;
+            }
+            if (!dictIsRehashing(d)) break;
+        }
+        return NULL;
+    }
+
     for (table = 0; table <= 1; table++) {
         idx = h & d->ht[table].sizemask;
         he = d->ht[table].table[idx];
@@ -797,12 +2228,13 @@ dictEntry *dictionaryCreate::dictGenericDelete(dict *d, const void *key, int nof
                     prevHe->next = he->next;
                 else
                     d->ht[table].table[idx] = he->next;
+                d->ht[table].used--;
                 if (!nofree) {
                     dictFreeKey(d, he);
                     dictFreeVal(d, he);
-                    zfree(he);
+                    dictFreeEntry(d, he);
+                    dictShrinkIfNeeded(d);
                 }
-                d->ht[table].used--;
                 return he;
             }
             prevHe = he;
@@ -868,7 +2300,8 @@ void dictionaryCreate::dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
     if (he == NULL) return;
     dictFreeKey(d, he);
     dictFreeVal(d, he);
-    zfree(he);
+    if (!dictIsSwiss(d)) dictFreeEntry(d, he); /* swiss的槽位属于表本身 */
+    dictShrinkIfNeeded(d);
 }
 
 
@@ -879,8 +2312,11 @@ void dictionaryCreate::dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
  */
 void dictionaryCreate::dictRelease(dict *d)
 {
+    dictBgRehashWait(d);
     _dictClear(d,&d->ht[0],NULL);
     _dictClear(d,&d->ht[1],NULL);
+    dictPoolRelease(d);
+    zfree(d->metrics);
     zfree(d);
 }
 /**
@@ -894,21 +2330,139 @@ dictEntry *dictionaryCreate::dictFind(dict *d, const void *key)
     dictEntry *he;
     uint64_t h, idx, table;
 
-    if (dictSize(d) == 0) return NULL; /* dict is empty */
-    if (dictIsRehashing(d)) _dictRehashStep(d);
-    h = dictHashKey(d, key);
-    for (table = 0; table <= 1; table++) {
-        idx = h & d->ht[table].sizemask;
-        he = d->ht[table].table[idx];
-        while(he) {
-            if (key==he->key || dictCompareKeys(d, key, he->key))
-                return he;
-            he = he->next;
+    /* 后台rehash期间used由后台线程改写，判空交给持锁的dictBgFind */
+    if (dictIsBgRehashing(d)) {
+        _dictRehashStep(d);
+        if (dictIsBgRehashing(d)) return dictBgFind(d, key);
+    }
+    if (dictSize(d) == 0) return NULL; /* dict is empty */
+    if (dictIsSwiss(d)) {
+        /* 查找不推进rehash，保证返回的槽位在下一次写操作前有效 */
+        unsigned long probes = 0, *pprobes = d->metrics ? &probes : NULL;
+        h = dictHashKey(d, key);
+        he = dictSwissFindIn(d, &d->ht[0], key, h, pprobes);
+        if (he == NULL && dictIsRehashing(d))
+            he = dictSwissFindIn(d, &d->ht[1], key, h, pprobes);
+        dictMetricsFind(d, he, probes);
+        return he;
+    }
+    if (dictIsRehashing(d)) _dictRehashStep(d);
+    if (dictIsBgRehashing(d)) return dictBgFind(d, key);
+    h = dictHashKey(d, key);
+    unsigned long probes = 0;
+    for (table = 0; table <= 1; table++) {
+        idx = h & d->ht[table].sizemask;
+        he = d->ht[table].table[idx];
+        while(he) {
+            dictMetricsProbe(probes);
+            if (key==he->key || dictCompareKeys(d, key, he->key)) {
+                dictMetricsFind(d, he, probes);
+                return he;
+            }
+            he = he->next;
+        }
+        if (!dictIsRehashing(d)) break;
+    }
+    dictMetricsFind(d, NULL, probes);
+    return NULL;
+}
+/**
+ * 批量查找多个键
+ * @param d 字典指针
+ * @param keys 待查找的键数组
+ * @param n 键的个数
+ * @param results 输出数组，results[i]为keys[i]的条目，不存在为NULL
+ * @return 找到的键个数
+ */
+unsigned long dictionaryCreate::dictFindBatch(dict *d, const void **keys, unsigned long n, dictEntry **results)
+{
+    uint64_t hashes[DICT_FIND_BATCH_MAX];
+    dictEntry *heads[2][DICT_FIND_BATCH_MAX];
+    unsigned long base, i, cnt, found = 0;
+    int table, tables;
+
+    if (dictSize(d) == 0 && !dictIsBgRehashing(d)) {
+        for (i = 0; i < n; i++) results[i] = NULL;
+        return 0;
+    }
+    /* 和dictFind一样，链式引擎每次调用推进一步rehash */
+    if (dictIsRehashing(d) && !dictIsSwiss(d)) _dictRehashStep(d);
+    /* 后台rehash期间每个键都要持条带锁，退化为逐个查找 */
+    if (dictIsBgRehashing(d)) {
+        for (i = 0; i < n; i++)
+            if ((results[i] = dictFind(d, keys[i])) != NULL) found++;
+        return found;
+    }
+    tables = dictIsRehashing(d) ? 2 : 1;
+
+    for (base = 0; base < n; base += cnt) {
+        const void **k = keys + base;
+        dictEntry **res = results + base;
+        cnt = n - base < DICT_FIND_BATCH_MAX ? n - base : DICT_FIND_BATCH_MAX;
+
+        if (dictIsSwiss(d)) {
+            /* 1. 计算哈希，预取家组的控制字节 */
+            for (i = 0; i < cnt; i++) {
+                hashes[i] = dictHashKey(d, k[i]);
+                for (table = 0; table < tables; table++) {
+                    dictht *ht = &d->ht[table];
+                    redis_prefetch(dictSwissHeader(ht)->ctrl +
+                        (hashes[i] & dictSwissGroupMask(ht)) * DICT_SWISS_GROUP);
+                }
+            }
+            /* 2. 在家组里找第一个h2相同的槽位并预取 */
+            for (i = 0; i < cnt; i++) {
+                for (table = 0; table < tables; table++) {
+                    dictht *ht = &d->ht[table];
+                    unsigned long g = hashes[i] & dictSwissGroupMask(ht);
+                    uint32_t m = dictSwissMatch(dictSwissHeader(ht)->ctrl + g * DICT_SWISS_GROUP,
+                                                dictSwissH2(hashes[i]));
+                    heads[table][i] = m ? dictSwissSlot(ht, g * DICT_SWISS_GROUP + __builtin_ctz(m)) : NULL;
+                    if (heads[table][i]) redis_prefetch(heads[table][i]);
+                }
+            }
+        } else {
+            /* 1. 计算哈希，预取桶 */
+            for (i = 0; i < cnt; i++) {
+                hashes[i] = dictHashKey(d, k[i]);
+                for (table = 0; table < tables; table++)
+                    redis_prefetch(&d->ht[table].table[hashes[i] & d->ht[table].sizemask]);
+            }
+            /* 2. 读桶，预取链首条目 */
+            for (i = 0; i < cnt; i++) {
+                for (table = 0; table < tables; table++) {
+                    heads[table][i] = d->ht[table].table[hashes[i] & d->ht[table].sizemask];
+                    if (heads[table][i]) redis_prefetch(heads[table][i]);
+                }
+            }
+        }
+
+        /* 3. 预取候选条目的键，比较时要读它 */
+        for (i = 0; i < cnt; i++) {
+            for (table = 0; table < tables; table++)
+                if (heads[table][i]) redis_prefetch(heads[table][i]->key);
+        }
+
+        /* 4. 比较键，此时数据大多已在cache里 */
+        for (i = 0; i < cnt; i++) {
+            dictEntry *he = NULL;
+            for (table = 0; table < tables && he == NULL; table++) {
+                if (dictIsSwiss(d)) {
+                    he = dictSwissFindIn(d, &d->ht[table], k[i], hashes[i]);
+                    continue;
+                }
+                for (he = heads[table][i]; he; he = he->next)
+                    if (k[i] == he->key || dictCompareKeys(d, k[i], he->key)) break;
+            }
+            res[i] = he;
+            if (he) found++;
         }
-        if (!dictIsRehashing(d)) return NULL;
     }
-    return NULL;
+    dictMetricsAdd(d, find_hits, found);
+    dictMetricsAdd(d, find_misses, n - found);
+    return found;
 }
+
 /**
  * 获取指定键的值
  * @param d 字典指针
@@ -956,14 +2510,40 @@ dictIterator *dictionaryCreate::dictGetSafeIterator(dict *d) {
  */
 dictEntry *dictionaryCreate::dictNext(dictIterator *iter)
 {
+    /* swiss引擎：index是当前表的槽位下标，依次访问ht[0]、ht[1]中已占用的槽位 */
+    while (dictIsSwiss(iter->d)) {
+        dictht *ht = &iter->d->ht[iter->table];
+        if (iter->index == -1 && iter->table == 0) {
+            if (iter->safe) {
+                dictPauseRehashing(iter->d);
+                dictMetricsIncr(iter->d, rehash_pauses);
+            } else {
+                iter->fingerprint = dictFingerprint(iter->d);
+            }
+        }
+        iter->index++;
+        if (iter->index >= (long) ht->size) {
+            if (dictIsRehashing(iter->d) && iter->table == 0) {
+                iter->table++;
+                iter->index = -1;
+                continue;
+            }
+            return NULL;
+        }
+        if (dictSwissIsFull(dictSwissHeader(ht)->ctrl[iter->index]))
+            return iter->entry = dictSwissSlot(ht, iter->index);
+    }
     while (1) {
         if (iter->entry == NULL) {
             dictht *ht = &iter->d->ht[iter->table];
             if (iter->index == -1 && iter->table == 0) {
-                if (iter->safe)
+                dictBgRehashWait(iter->d);
+                if (iter->safe) {
                     dictPauseRehashing(iter->d);
-                else
+                    dictMetricsIncr(iter->d, rehash_pauses);
+                } else {
                     iter->fingerprint = dictFingerprint(iter->d);
+                }
             }
             iter->index++;
             if (iter->index >= (long) ht->size) {
@@ -1017,6 +2597,8 @@ dictEntry *dictionaryCreate::dictGetRandomKey(dict *d)
     int listlen, listele;
 
     if (dictSize(d) == 0) return NULL;
+    if (dictIsSwiss(d)) return _dictSwissGetRandomKey(d);
+    dictBgRehashWait(d);
     if (dictIsRehashing(d)) _dictRehashStep(d);
     if (dictIsRehashing(d)) {
         do {
@@ -1086,6 +2668,8 @@ dictEntry *dictionaryCreate::dictGetRandomKey(dict *d)
     unsigned long maxsteps;
 
     if (dictSize(d) < count) count = dictSize(d);
+    if (dictIsSwiss(d)) return _dictSwissGetSomeKeys(d, des, count);
+    dictBgRehashWait(d);
     maxsteps = count*10;
 
     /* Try to do a rehashing work proportional to 'count'. */
@@ -1289,14 +2873,28 @@ unsigned long dictionaryCreate::dictScan(dict *d,
                        dictScanBucketFunction* bucketfn,
                        void *privdata)
 {
-    dictht *t0, *t1;
-    const dictEntry *de, *next;
-    unsigned long m0, m1;
-
     if (dictSize(d) == 0) return 0;
+    dictBgRehashWait(d);
 
     /* This is needed in case the scan callback tries to do dictFind or alike. */
     dictPauseRehashing(d);
+    dictMetricsIncr(d, rehash_pauses);
+    v = _dictScanStep(d, v, fn, bucketfn, privdata);
+    dictResumeRehashing(d);
+    return v;
+}
+
+unsigned long dictionaryCreate::_dictScanStep(dict *d,
+                       unsigned long v,
+                       dictScanFunction *fn,
+                       dictScanBucketFunction* bucketfn,
+                       void *privdata)
+{
+    dictht *t0, *t1;
+    const dictEntry *de, *next;
+    unsigned long m0, m1;
+
+    if (dictIsSwiss(d)) return _dictSwissScan(d, v, fn, privdata);
 
     if (!dictIsRehashing(d)) {
         t0 = &(d->ht[0]);
@@ -1364,11 +2962,108 @@ unsigned long dictionaryCreate::dictScan(dict *d,
         } while (v & (m0 ^ m1));
     }
 
-    dictResumeRehashing(d);
-
     return v;
 }
 
+/**
+ * 分区扫描：推进分区内的游标
+ * @param d 字典指针
+ * @param v 游标，分区p从p开始
+ * @param nparts 分区数（2的幂）
+ * @param fn 条目处理回调函数
+ * @param bucketfn 桶处理回调函数（可为NULL）
+ * @param privdata 传递给回调函数的私有数据
+ * @return 下一次调用的游标，0表示本分区扫描结束
+ */
+unsigned long dictionaryCreate::dictScanPartition(dict *d, unsigned long v, unsigned long nparts,
+                                                  dictScanFunction *fn, dictScanBucketFunction *bucketfn,
+                                                  void *privdata)
+{
+    unsigned long part = v & (nparts - 1);
+
+    /* 反向游标自增时低位变化最慢，低log2(nparts)位变了说明本分区的游标都已走完 */
+    v = dictScan(d, v, fn, bucketfn, privdata);
+    return (v & (nparts - 1)) == part ? v : 0;
+}
+
+typedef struct dictScanParallelCtx {
+    REDIS_BASE::dictionaryCreate *crt;
+    dict *d;
+    unsigned long nparts;
+    unsigned long nextpart;         /* 下一个待领取的分区，原子自增 */
+    dictScanFunction *fn;
+} dictScanParallelCtx;
+
+typedef struct dictScanParallelJob {
+    dictScanParallelCtx *ctx;
+    void *privdata;
+} dictScanParallelJob;
+
+void *dictionaryCreate::_dictScanWorker(void *arg)
+{
+    dictScanParallelJob *job = static_cast<dictScanParallelJob*>(arg);
+    dictScanParallelCtx *ctx = job->ctx;
+    unsigned long part, mask = ctx->nparts - 1;
+
+    while ((part = __atomic_fetch_add(&ctx->nextpart, 1, __ATOMIC_RELAXED)) < ctx->nparts) {
+        unsigned long v = part;
+        do {
+            v = ctx->crt->_dictScanStep(ctx->d, v, ctx->fn, NULL, job->privdata);
+        } while ((v & mask) == part && v != 0);
+    }
+    return NULL;
+}
+
+/**
+ * 并行扫描整个字典
+ * @param d 字典指针
+ * @param threads 线程数（含调用线程）
+ * @param fn 条目处理回调函数，在各线程中并发调用
+ * @param privdata 每个线程一个私有数据指针
+ * @return 实际使用的线程数
+ */
+int dictionaryCreate::dictScanParallel(dict *d, int threads, dictScanFunction *fn, void **privdata)
+{
+    pthread_t tids[DICT_SCAN_THREADS_MAX];
+    dictScanParallelJob jobs[DICT_SCAN_THREADS_MAX];
+    int started[DICT_SCAN_THREADS_MAX];
+    dictScanParallelCtx ctx;
+    unsigned long buckets;
+
+    if (threads < 1) threads = 1;
+    if (threads > DICT_SCAN_THREADS_MAX) threads = DICT_SCAN_THREADS_MAX;
+    if (dictSize(d) == 0) return threads;
+    dictBgRehashWait(d);
+    dictPauseRehashing(d);
+    dictMetricsIncr(d, rehash_pauses);
+
+    /* 分区数不超过较小那张表的桶数（swiss为组数），每个桶只属于一个分区，每个元素恰好返回一次 */
+    buckets = d->ht[0].size;
+    if (dictIsRehashing(d) && d->ht[1].size < buckets) buckets = d->ht[1].size;
+    if (dictIsSwiss(d)) buckets /= DICT_SWISS_GROUP;
+    ctx.nparts = 1;
+    while (ctx.nparts < (unsigned long)threads * DICT_SCAN_PARTS_PER_THREAD && ctx.nparts * 2 <= buckets)
+        ctx.nparts *= 2;
+    if ((unsigned long)threads > ctx.nparts) threads = (int)ctx.nparts;
+    ctx.crt = this;
+    ctx.d = d;
+    ctx.nextpart = 0;
+    ctx.fn = fn;
+
+    for (int t = 0; t < threads; t++) {
+        jobs[t].ctx = &ctx;
+        jobs[t].privdata = privdata[t];
+        started[t] = t > 0 && pthread_create(&tids[t], NULL, _dictScanWorker, &jobs[t]) == 0;
+    }
+    /* 建线程失败时其余线程多领分区，结果不变 */
+    _dictScanWorker(&jobs[0]);
+    for (int t = 1; t < threads; t++)
+        if (started[t]) pthread_join(tids[t], NULL);
+
+    dictResumeRehashing(d);
+    return threads;
+}
+
 /* ------------------------- private functions ------------------------------ */
 
 /**
@@ -1377,8 +3072,10 @@ unsigned long dictionaryCreate::dictScan(dict *d,
  * @param callback 清空时调用的回调函数（可为NULL）
  */
 void dictionaryCreate::dictEmpty(dict *d, void(callback)(void*)) {
+    dictBgRehashWait(d);
     _dictClear(d,&d->ht[0],callback);
     _dictClear(d,&d->ht[1],callback);
+    dictPoolRelease(d);
     d->rehashidx = -1;
     d->pauserehash = 0;
 }
@@ -1395,6 +3092,153 @@ void dictionaryCreate::dictEnableResize(void) {
 void dictionaryCreate::dictDisableResize(void) {
     dict_can_resize = 0;
 }
+/**
+ * 打开后台rehash
+ * @param min_buckets 使用后台rehash的最小桶数
+ */
+void dictionaryCreate::dictEnableBackgroundRehash(unsigned long min_buckets) {
+    dict_bg_rehash_threshold = min_buckets ? min_buckets : 1;
+}
+
+/**
+ * 关闭后台rehash
+ */
+void dictionaryCreate::dictDisableBackgroundRehash(void) {
+    dict_bg_rehash_threshold = 0;
+}
+
+/**
+ * 等待字典的后台rehash搬完并换表
+ * @param d 字典指针
+ */
+void dictionaryCreate::dictBackgroundRehashWait(dict *d) {
+    dictBgRehashWait(d);
+}
+
+/**
+ * 获取rehash进度
+ * @param d 字典指针
+ * @return ht[0]中已搬迁的比例，0~1，不在rehash时返回1
+ */
+double dictionaryCreate::dictRehashProgress(dict *d) {
+    long idx = __atomic_load_n(&d->rehashidx, __ATOMIC_RELAXED);
+    if (idx == -1 || d->ht[0].size == 0) return 1.0;
+    /* swiss引擎的rehashidx是组下标 */
+    unsigned long total = dictIsSwiss(d) ? d->ht[0].size / DICT_SWISS_GROUP : d->ht[0].size;
+    return (double)idx / total;
+}
+
+/**
+ * 获取后台rehash的统计
+ * @param stats 输出参数
+ */
+void dictionaryCreate::dictGetRehashStats(dictRehashStats *stats) {
+    pthread_mutex_lock(&dict_bg_mutex);
+    *stats = dict_bg_stats;
+    stats->buckets_moved = __atomic_load_n(&dict_bg_stats.buckets_moved, __ATOMIC_RELAXED);
+    stats->entries_moved = __atomic_load_n(&dict_bg_stats.entries_moved, __ATOMIC_RELAXED);
+    stats->active = dict_bg.d != NULL && !dict_bg.done;
+    stats->active_buckets_total = stats->active ? dict_bg.buckets_total : 0;
+    if (stats->active) {
+        long idx = __atomic_load_n(&dict_bg.d->rehashidx, __ATOMIC_RELAXED);
+        stats->active_buckets_done = idx < 0 ? dict_bg.buckets_total : (unsigned long)idx;
+    } else {
+        stats->active_buckets_done = 0;
+    }
+    pthread_mutex_unlock(&dict_bg_mutex);
+}
+
+/**
+ * 获取字典的条目池统计
+ * @param d 字典指针
+ * @param stats 输出参数
+ */
+void dictionaryCreate::dictGetEntryPoolStats(dict *d, dictEntryPoolStats *stats) {
+    dictEntryPool *pool = d->entrypool;
+    memset(stats, 0, sizeof(*stats));
+    if (pool == NULL) return;
+    stats->slabs = pool->numslabs;
+    stats->capacity = pool->capacity;
+    stats->used = pool->used;
+    stats->bytes = sizeof(*pool) + pool->slabs_alloc * sizeof(dictEntrySlab *) +
+                   pool->numslabs * sizeof(dictEntrySlab) + pool->capacity * sizeof(dictEntry);
+}
+
+/**
+ * 为字典打开运行指标采集
+ * @param d 字典指针
+ * @return 成功返回DICT_OK，编译时未打开指标返回DICT_ERR
+ */
+int dictionaryCreate::dictEnableMetrics(dict *d) {
+#ifdef DICT_METRICS
+    if (d->metrics == NULL) d->metrics = static_cast<dictMetrics*>(zcalloc(sizeof(dictMetrics)));
+    return DICT_OK;
+#else
+    DICT_NOTUSED(d);
+    return DICT_ERR;
+#endif
+}
+
+/**
+ * 清零字典的指标计数器
+ * @param d 字典指针
+ */
+void dictionaryCreate::dictResetMetrics(dict *d) {
+    if (d->metrics) memset(d->metrics, 0, sizeof(*d->metrics));
+}
+
+/**
+ * 获取字典的指标快照
+ * @param d 字典指针
+ * @param metrics 输出参数
+ */
+void dictionaryCreate::dictGetMetrics(dict *d, dictMetrics *metrics) {
+    if (d->metrics)
+        *metrics = *d->metrics;
+    else
+        memset(metrics, 0, sizeof(*metrics));
+    /* 后台rehash期间used由后台线程修改，读到的是近似值 */
+    metrics->keys = __atomic_load_n(&d->ht[0].used, __ATOMIC_RELAXED) +
+                    __atomic_load_n(&d->ht[1].used, __ATOMIC_RELAXED);
+    metrics->slots = dictSlots(d);
+    metrics->rehashing = dictIsRehashing(d);
+    metrics->engine = d->engine;
+}
+
+/**
+ * 把字典的指标格式化为一行JSON
+ * @param d 字典指针
+ * @param name 字典名
+ * @param buf 输出缓冲区
+ * @param bufsize 缓冲区大小
+ * @return 完整输出需要的长度（不含结尾的'\0'）
+ */
+size_t dictionaryCreate::dictFormatMetrics(dict *d, const char *name, char *buf, size_t bufsize) {
+    dictMetrics m;
+    char hist[DICT_METRICS_PROBE_BUCKETS * 21 + 1];
+    char esc[128];
+    size_t hl = 0, el = 0;
+
+    dictGetMetrics(d, &m);
+    for (int j = 0; j < DICT_METRICS_PROBE_BUCKETS; j++)
+        hl += snprintf(hist + hl, sizeof(hist) - hl, "%s%llu", j ? "," : "", m.probe_hist[j]);
+    /* 名字里的引号、反斜杠和控制字符不输出，保证JSON合法 */
+    for (const char *p = name; *p && el < sizeof(esc) - 1; p++)
+        if (*p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) esc[el++] = *p;
+    esc[el] = '\0';
+
+    int len = snprintf(buf, bufsize,
+        "{\"name\":\"%s\",\"engine\":\"%s\",\"keys\":%lu,\"slots\":%lu,\"rehashing\":%d,"
+        "\"find_hits\":%llu,\"find_misses\":%llu,\"probe_hist\":[%s],\"probe_sum\":%llu,"
+        "\"rehash_steps\":%llu,\"rehash_steps_paused\":%llu,\"rehash_step_ns\":%llu,"
+        "\"expands\":%llu,\"shrinks\":%llu,\"rebuilds\":%llu,\"rehash_pauses\":%llu}\n",
+        esc, m.engine == DICT_ENGINE_SWISS ? "swiss" : "chained", m.keys, m.slots, m.rehashing,
+        m.find_hits, m.find_misses, hist, m.probe_sum,
+        m.rehash_steps, m.rehash_steps_paused, m.rehash_step_ns,
+        m.expands, m.shrinks, m.rebuilds, m.rehash_pauses);
+    return len < 0 ? 0 : (size_t)len;
+}
+
 /**
  * 计算键的哈希值
  * @param d 字典指针
@@ -1422,6 +3266,8 @@ dictEntry **dictionaryCreate::dictFindEntryRefByPtrAndHash(dict *d, const void *
     unsigned long idx, table;
 
     if (dictSize(d) == 0) return NULL; /* dict is empty */
+    if (dictIsSwiss(d)) return NULL; /* 槽位内联在表里，没有指向条目的指针可以引用 */
+    dictBgRehashWait(d); /* 返回的引用在锁外使用 */
     for (table = 0; table <= 1; table++) {
         idx = hash & d->ht[table].sizemask;
         heref = &d->ht[table].table[idx];
@@ -1448,15 +3294,268 @@ void dictionaryCreate::dictGetStats(char *buf, size_t bufsize, dict *d) {
     char *orig_buf = buf;
     size_t orig_bufsize = bufsize;
 
-    l = _dictGetStatsHt(buf,bufsize,&d->ht[0],0);
+    dictBgRehashWait(d);
+    l = dictIsSwiss(d) ? _dictSwissGetStatsHt(buf,bufsize,d,&d->ht[0],0) :
+                         _dictGetStatsHt(buf,bufsize,&d->ht[0],0);
     buf += l;
     bufsize -= l;
     if (dictIsRehashing(d) && bufsize > 0) {
-        _dictGetStatsHt(buf,bufsize,&d->ht[1],1);
+        if (dictIsSwiss(d))
+            _dictSwissGetStatsHt(buf,bufsize,d,&d->ht[1],1);
+        else
+            _dictGetStatsHt(buf,bufsize,&d->ht[1],1);
+    }
+    if (d->entrypool && orig_bufsize) {
+        l = strlen(orig_buf);
+        if (l < orig_bufsize)
+            snprintf(orig_buf + l, orig_bufsize - l,
+                "Entry pool: %lu slabs, %lu/%lu entries used\n",
+                d->entrypool->numslabs, d->entrypool->used, d->entrypool->capacity);
     }
     /* Make sure there is a NULL term at the end. */
     if (orig_bufsize) orig_buf[orig_bufsize-1] = '\0';
 }
+/* ------------------------- swiss table engine ------------------------------ */
+
+/* 每步搬迁ht[0]中rehashidx指向的一个组，最多跳过n*10个空组 */
+int dictionaryCreate::_dictSwissRehash(dict *d, int n)
+{
+    int empty_visits = n*10;
+    dictht *t0 = &d->ht[0], *t1 = &d->ht[1];
+
+    while (n-- && t0->used != 0) {
+        int8_t *grp;
+        uint32_t m;
+
+        /* ht[0].used != 0，后面一定还有非空的组，rehashidx不会越界 */
+        assert(t0->size / DICT_SWISS_GROUP > (unsigned long)d->rehashidx);
+        while (1) {
+            grp = dictSwissHeader(t0)->ctrl + d->rehashidx * DICT_SWISS_GROUP;
+            if ((m = ~dictSwissMatchFree(grp) & DICT_SWISS_GROUP_BITS) != 0) break;
+            d->rehashidx++;
+            if (--empty_visits == 0) return 1;
+        }
+        while (m) {
+            int i = __builtin_ctz(m);
+            dictEntry *de = dictSwissSlot(t0, d->rehashidx * DICT_SWISS_GROUP + i);
+            dictEntry *nde = dictSwissInsertSlot(t1, dictHashKey(d, de->key));
+            nde->key = de->key;
+            nde->v = de->v;
+            /* 置为墓碑而不是EMPTY：ht[0]里其他元素的探测序列可能经过这个组 */
+            grp[i] = DICT_SWISS_DELETED;
+            t0->used--;
+            m &= m - 1;
+        }
+        d->rehashidx++;
+    }
+
+    if (t0->used == 0) {
+        zfree(t0->table);
+        *t0 = *t1;
+        _dictReset(t1);
+        d->rehashidx = -1;
+        return 0;
+    }
+    return 1;
+}
+
+/* swiss表翻倍前的检查，与_dictExpandIfNeeded相同：dictDisableResize期间、
+ * 内存吃紧或expandAllowed拒绝时不翻倍 */
+static int dictSwissGrowAllowed(dict *d, unsigned long size)
+{
+    if (!dict_can_resize || dictUnderMemoryPressure(dictGetResizePolicy(d))) return 0;
+    if (d->type->expandAllowed == NULL) return 1;
+    return d->type->expandAllowed(sizeof(dictSwissTable) + size * (DICT_SWISS_SLOT_SIZE + 1),
+                                  (double)d->ht[0].used / d->ht[0].size);
+}
+
+/* 开放寻址表不能超过最大装载率，表满时要么翻倍，要么按原大小重建以清理墓碑。
+ * 翻倍被dictSwissGrowAllowed拒绝时，只要墓碑还能腾出1/16的容量就按原大小重建；
+ * 活元素几乎占满整张表时只能翻倍，相当于链式表的force_grow_fill。 */
+void dictionaryCreate::_dictSwissExpandIfNeeded(dict *d)
+{
+    /* rehash期间新元素插入ht[1]，ht[1]必须还放得下ht[0]剩下的元素，否则先做完rehash。
+     * 有安全迭代器时不能搬ht[0]，改为把ht[1]原地换成更大的表，只挪ht[1]里的元素 */
+    if (dictIsRehashing(d)) {
+        if (dictSwissHeader(&d->ht[1])->growth_left > d->ht[0].used) return;
+        if (d->pauserehash > 0) {
+            dictSwissRegrowTarget(d);
+            return;
+        }
+        while (dictRehash(d, 100));
+    }
+
+    if (d->ht[0].size == 0) {
+        dictSwissInstall(d, DICT_SWISS_MIN_SIZE, NULL);
+        return;
+    }
+    if (dictSwissHeader(&d->ht[0])->growth_left > 0) return;
+
+    /* 元素占了超过一半容量就翻倍，否则空间多半被墓碑占着，按原大小重建 */
+    unsigned long size = dictSwissCapacity(d->ht[0].used * 2);
+    if (size > d->ht[0].size && dictSwissHeader(&d->ht[0])->deleted >= d->ht[0].size / 16 &&
+        !dictSwissGrowAllowed(d, size))
+        size = d->ht[0].size;
+    if (size < d->ht[0].size) size = d->ht[0].size;
+    dictSwissInstall(d, size, NULL);
+}
+
+dictEntry *dictionaryCreate::_dictSwissGetRandomKey(dict *d)
+{
+    dictht *t0 = &d->ht[0], *t1 = &d->ht[1];
+    unsigned long h;
+
+    if (dictIsRehashing(d)) {
+        /* ht[0]中rehashidx之前的组已经搬空 */
+        unsigned long start = d->rehashidx * DICT_SWISS_GROUP;
+        while (1) {
+            h = start + (randomULong() % (dictSlots(d) - start));
+            if (h >= t0->size) {
+                h -= t0->size;
+                if (dictSwissIsFull(dictSwissHeader(t1)->ctrl[h])) return dictSwissSlot(t1, h);
+            } else if (dictSwissIsFull(dictSwissHeader(t0)->ctrl[h])) {
+                return dictSwissSlot(t0, h);
+            }
+        }
+    }
+    while (1) {
+        h = randomULong() & t0->sizemask;
+        if (dictSwissIsFull(dictSwissHeader(t0)->ctrl[h])) return dictSwissSlot(t0, h);
+    }
+}
+
+/* 与链式引擎的采样方式相同，只是以槽位代替桶 */
+unsigned int dictionaryCreate::_dictSwissGetSomeKeys(dict *d, dictEntry **des, unsigned int count)
+{
+    unsigned long j, tables = dictIsRehashing(d) ? 2 : 1;
+    unsigned long stored = 0, maxsteps = count*10, emptylen = 0;
+    unsigned long start = dictIsRehashing(d) ? d->rehashidx * DICT_SWISS_GROUP : 0;
+    unsigned long maxsizemask = d->ht[0].sizemask;
+
+    if (tables > 1 && maxsizemask < d->ht[1].sizemask)
+        maxsizemask = d->ht[1].sizemask;
+
+    unsigned long i = randomULong() & maxsizemask;
+    while (stored < count && maxsteps--) {
+        for (j = 0; j < tables; j++) {
+            dictht *ht = &d->ht[j];
+            if (tables == 2 && j == 0 && i < start) {
+                if (i >= d->ht[1].size)
+                    i = start;
+                else
+                    continue;
+            }
+            if (i >= ht->size) continue;
+            if (!dictSwissIsFull(dictSwissHeader(ht)->ctrl[i])) {
+                emptylen++;
+                if (emptylen >= 5 && emptylen > count) {
+                    i = randomULong() & maxsizemask;
+                    emptylen = 0;
+                }
+            } else {
+                emptylen = 0;
+                des[stored++] = dictSwissSlot(ht, i);
+                if (stored == count) return stored;
+            }
+        }
+        i = (i+1) & maxsizemask;
+    }
+    return stored;
+}
+
+/* 游标以组为单位，算法与链式引擎的dictScan相同：元素的"桶"是它的家组
+ * hash & 组掩码，扫描一个家组就是沿探测序列发出家组相同的元素。 */
+unsigned long dictionaryCreate::_dictSwissScan(dict *d, unsigned long v, dictScanFunction *fn, void *privdata)
+{
+    dictht *t0, *t1;
+    unsigned long m0, m1;
+
+    if (!dictIsRehashing(d)) {
+        t0 = &d->ht[0];
+        m0 = dictSwissGroupMask(t0);
+        dictSwissScanGroup(d, t0, v & m0, fn, privdata);
+
+        v |= ~m0;
+        v = rev(v);
+        v++;
+        v = rev(v);
+    } else {
+        t0 = &d->ht[0];
+        t1 = &d->ht[1];
+        if (t0->size > t1->size) {
+            t0 = &d->ht[1];
+            t1 = &d->ht[0];
+        }
+        m0 = dictSwissGroupMask(t0);
+        m1 = dictSwissGroupMask(t1);
+
+        dictSwissScanGroup(d, t0, v & m0, fn, privdata);
+        do {
+            dictSwissScanGroup(d, t1, v & m1, fn, privdata);
+
+            v |= ~m1;
+            v = rev(v);
+            v++;
+            v = rev(v);
+        } while (v & (m0 ^ m1));
+    }
+    return v;
+}
+
+size_t dictionaryCreate::_dictSwissGetStatsHt(char *buf, size_t bufsize, dict *d, dictht *ht, int tableid)
+{
+    unsigned long i, probelen, maxprobelen = 0, totprobelen = 0;
+    unsigned long plvector[DICT_STATS_VECTLEN];
+    size_t l = 0;
+
+    if (ht->used == 0) {
+        return snprintf(buf,bufsize,
+            "No stats available for empty dictionaries\n");
+    }
+
+    /* 探测长度：从家组到元素所在组跳过的组数 */
+    unsigned long gmask = dictSwissGroupMask(ht);
+    const int8_t *ctrl = dictSwissHeader(ht)->ctrl;
+    for (i = 0; i < DICT_STATS_VECTLEN; i++) plvector[i] = 0;
+    for (i = 0; i < ht->size; i++) {
+        if (!dictSwissIsFull(ctrl[i])) continue;
+        unsigned long g = dictHashKey(d, dictSwissSlot(ht, i)->key) & gmask;
+        probelen = 0;
+        while (g != i / DICT_SWISS_GROUP && probelen <= gmask) {
+            probelen++;
+            g = (g + probelen) & gmask;
+        }
+        plvector[(probelen < DICT_STATS_VECTLEN) ? probelen : (DICT_STATS_VECTLEN-1)]++;
+        if (probelen > maxprobelen) maxprobelen = probelen;
+        totprobelen += probelen;
+    }
+
+    l += snprintf(buf+l,bufsize-l,
+        "Hash table %d stats (%s, swiss):\n"
+        " table size: %lu\n"
+        " number of elements: %lu\n"
+        " tombstones: %lu\n"
+        " load factor: %.02f\n"
+        " max probe length: %lu\n"
+        " avg probe length: %.02f\n"
+        " Probe length distribution:\n",
+        tableid, (tableid == 0) ? "main hash table" : "rehashing target",
+        ht->size, ht->used, dictSwissHeader(ht)->deleted,
+        (float)ht->used/ht->size, maxprobelen, (float)totprobelen/ht->used);
+
+    for (i = 0; i < DICT_STATS_VECTLEN; i++) {
+        if (plvector[i] == 0) continue;
+        if (l >= bufsize) break;
+        l += snprintf(buf+l,bufsize-l,
+            "   %s%ld: %ld (%.02f%%)\n",
+            (i == DICT_STATS_VECTLEN-1)?">= ":"",
+            i, plvector[i], ((float)plvector[i]/ht->used)*100);
+    }
+
+    if (bufsize) buf[bufsize-1] = '\0';
+    return strlen(buf);
+}
+
 /**
  * dictionaryCreate::siptlw - 将 ASCII 字符转换为小写
  * @c: 待转换的字符（ASCII 码值，整数形式）
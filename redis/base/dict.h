@@ -16,6 +16,7 @@
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
 class toolFunc;
+struct dictEntryPool;
 /**
  * 哈希表节点结构 - 存储键值对
  */
@@ -29,6 +30,17 @@ typedef struct dictEntry {
     } v;
     struct dictEntry *next;   // 指向下一个节点的指针（处理哈希冲突）
 } dictEntry;
+/**
+ * 扩缩容策略 - 装载率均为元素数/桶数的百分比（swiss引擎只使用缩容部分）
+ */
+typedef struct dictResizePolicy {
+    unsigned int grow_fill;          // 装载率达到该值时扩容（扩到能容纳used+1的2的幂）
+    unsigned int force_grow_fill;    // dictDisableResize期间或内存吃紧时，装载率超过该值才扩容
+    unsigned int shrink_fill;        // 删除后装载率低于该值时自动缩容，0表示不自动缩容
+    unsigned int shrink_target;      // 缩容后的目标装载率，高于shrink_fill，两者之间是滞后区间
+    unsigned int pressure_watermark; // used_memory超过软上限的该百分比时视为内存吃紧，0表示不看内存压力
+} dictResizePolicy;
+
 /**
  * 字典类型特定函数集合 - 用于自定义字典行为
  */
@@ -40,13 +52,15 @@ typedef struct dictType {
     void (*keyDestructor)(void *privdata, void *key);  // 键销毁函数
     void (*valDestructor)(void *privdata, void *obj);  // 值销毁函数
     int (*expandAllowed)(size_t moreMem, double usedRatio); // 扩容允许判断函数
+    int flags;                // 条目布局：DICT_TYPE_EMBED_KEYS、DICT_TYPE_NO_VALUE的组合（EMBED_KEYS下键的归属见define.h）
+    const dictResizePolicy *resizePolicy; // 扩缩容策略，NULL表示默认策略
 } dictType;
 /**
  * 哈希表结构 - 每个字典包含两个用于渐进式rehash
  */
 typedef struct dictht {
-    dictEntry **table;        // 哈希表数组（桶数组）
-    unsigned long size;       // 哈希表大小（桶数量）
+    dictEntry **table;        // 哈希表数组（桶数组；swiss引擎下指向控制字节+槽位的整块内存）
+    unsigned long size;       // 哈希表大小（桶数量；swiss引擎下为槽位数）
     unsigned long sizemask;   // 大小掩码（用于计算索引：size-1）
     unsigned long used;       // 已使用节点数量
 } dictht;
@@ -58,8 +72,12 @@ typedef struct dict {
     dictType *type;           // 字典类型（定义回调函数）
     void *privdata;           // 私有数据（传递给回调函数）
     dictht ht[2];             // 两个哈希表（用于渐进式rehash）
-    long rehashidx;           // 渐进式rehash索引（-1表示未进行rehash）
+    long rehashidx;           // 渐进式rehash索引（-1表示未进行rehash；swiss引擎下为组下标）
     int16_t pauserehash;      // 暂停rehash标记（>0时暂停，<0表示编码错误）
+    int8_t engine;            // 存储引擎：DICT_ENGINE_CHAINED或DICT_ENGINE_SWISS
+    int8_t bgrehash;          // 后台rehash状态：DICT_BG_REHASH_NONE/PENDING/RUNNING
+    struct dictEntryPool *entrypool; // 条目池（DICT_TYPE_ENTRY_POOL，第一次插入时创建）
+    struct dictMetrics *metrics;     // 运行指标（dictEnableMetrics后创建，NULL表示不采集）
 } dict;
 
 /**
@@ -75,11 +93,64 @@ typedef struct dictIterator {
     long long fingerprint;    // 迭代器指纹（用于检测不安全操作）
 } dictIterator;
 
+/**
+ * 后台rehash统计（进程内所有字典累计）
+ */
+typedef struct dictRehashStats {
+    unsigned long long started;          // 后台rehash启动次数
+    unsigned long long completed;        // 完成（已换表）次数
+    unsigned long long buckets_moved;    // 后台累计搬迁的桶数
+    unsigned long long entries_moved;    // 后台累计搬迁的元素数
+    unsigned long long fg_waits;         // 前台整表操作等待后台搬完的次数
+    unsigned long long fg_wait_us;       // 前台累计等待时间（微秒）
+    unsigned long long last_duration_us; // 最近一次后台rehash从启动到搬完的耗时（微秒）
+    int active;                          // 是否有字典正在后台rehash
+    unsigned long active_buckets_done;   // 当前任务已搬迁的桶数
+    unsigned long active_buckets_total;  // 当前任务ht[0]的桶数
+} dictRehashStats;
+
+/**
+ * 条目池统计（单个字典）
+ */
+typedef struct dictEntryPoolStats {
+    unsigned long slabs;      // 当前持有的slab数
+    unsigned long capacity;   // 所有slab的条目总数
+    unsigned long used;       // 正在使用的条目数
+    size_t bytes;             // slab及索引数组占用的字节数
+} dictEntryPoolStats;
+
+/**
+ * 字典运行指标（单个字典）。计数器由dictEnableMetrics打开后累加，
+ * keys之后的字段是dictGetMetrics调用时的表形态
+ */
+typedef struct dictMetrics {
+    unsigned long long find_hits;            // dictFind/dictFindBatch命中次数
+    unsigned long long find_misses;          // 未命中次数
+    unsigned long long probe_hist[DICT_METRICS_PROBE_BUCKETS]; // dictFind探测长度分布：链式为比较的条目数，
+                                                               // swiss为探测的组数，最后一格含更长的
+    unsigned long long probe_sum;            // dictFind探测长度之和
+    unsigned long long rehash_steps;         // _dictRehashStep执行的渐进式rehash步数
+    unsigned long long rehash_steps_paused;  // 因rehash暂停而跳过的步数
+    unsigned long long rehash_step_ns;       // _dictRehashStep累计耗时（纳秒）
+    unsigned long long expands;              // 开始扩容rehash的次数
+    unsigned long long shrinks;              // 开始缩容rehash的次数
+    unsigned long long rebuilds;             // swiss按原大小重建（清理墓碑）的次数
+    unsigned long long rehash_pauses;        // 安全迭代器和dictScan暂停rehash的次数
+    unsigned long keys;                      // 元素数
+    unsigned long slots;                     // 两张表的桶（槽）数之和
+    int rehashing;                           // 是否在rehash
+    int engine;                              // DICT_ENGINE_CHAINED或DICT_ENGINE_SWISS
+} dictMetrics;
+
 /**
  * 字典扫描回调函数类型
  */
 typedef void (dictScanFunction)(void *privdata, const dictEntry *de);
 typedef void (dictScanBucketFunction)(void *privdata, dictEntry **bucketref);
+/**
+ * dictBulkLoad的键值对迭代器：取出下一对存入*key、*val并返回1，没有更多时返回0
+ */
+typedef int (dictBulkNextFunction)(void *privdata, void **key, void **val);
 class dictionaryCreate  // 类名修改为dictionaryCreate以避免与dict冲突
 {
 public:
@@ -99,6 +170,18 @@ public:
          */
         dict *dictCreate(dictType *type, void *privDataPtr);
 
+        /**
+         * 创建使用swiss table引擎的字典（开放寻址，键值内联在槽位里，
+         * 按16字节一组的控制字节用SIMD并行比较）。其余API与dictCreate创建的字典完全相同，区别在于：
+         * - 条目指针指向表内槽位，增删会搬动条目，指针只在下一次写操作前有效（查找不推进rehash）；
+         * - dictScan不调用bucketfn，dictFindEntryRefByPtrAndHash返回NULL；
+         * - 表满时总会扩容，不受dictDisableResize和expandAllowed限制。
+         * @param type 字典类型（定义回调函数）
+         * @param privDataPtr 私有数据指针（传递给回调函数）
+         * @return 成功返回字典指针，失败返回NULL
+         */
+        dict *dictCreateSwiss(dictType *type, void *privDataPtr);
+
         /**
          * 扩展字典到指定大小（强制）
          * @param d 字典指针
@@ -116,7 +199,7 @@ public:
         int dictTryExpand(dict *d, unsigned long size);
 
         /**
-         * 添加键值对（键不存在时）
+         * 添加键值对（键不存在时）。DICT_TYPE_EMBED_KEYS的字典拥有键时，成功后传入的键可能已被释放
          * @param d 字典指针
          * @param key 键指针
          * @param val 值指针
@@ -125,7 +208,9 @@ public:
         int dictAdd(dict *d, void *key, void *val);
 
         /**
-         * 仅添加键（不设置值），用于自定义值初始化
+         * 仅添加键（不设置值），用于自定义值初始化。
+         * DICT_TYPE_EMBED_KEYS的字典把短键复制进条目，字典拥有键（有keyDestructor、没有keyDup）时
+         * 传入的键随即被释放，之后只能通过dictGetKey访问键
          * @param d 字典指针
          * @param key 键指针
          * @param existing 输出参数：若键已存在，返回现有条目指针
@@ -142,7 +227,26 @@ public:
         dictEntry *dictAddOrFind(dict *d, void *key);
 
         /**
-         * 添加或替换键值对（键存在时替换值）
+         * 批量加载：按count一次把表扩到位（有rehash则同步做完），之后分批从迭代器取出键值对，
+         * 先算出整批的哈希（threads > 1且批量够大时多线程计算），再单线程按哈希直接插入，
+         * 不会中途扩容、也不做渐进式rehash。适合加载快照、SUNIONSTORE这类一次写入大量键的场景。
+         * 没有DICT_BULK_UNIQUE时按哈希查重，重复键不插入，其键值对按keyDestructor/valDestructor释放
+         * （设置了keyDup/valDup的除外，与dictAdd失败时一样由调用方负责）；
+         * 有DICT_BULK_UNIQUE时不查重，键重复的结果未定义。count只用于预分配，
+         * 迭代器给出的键多于count时按批追加扩容。有安全迭代器暂停rehash时退化为逐个dictAdd
+         * @param d 字典指针
+         * @param count 预计的键值对个数
+         * @param next 键值对迭代器
+         * @param privdata 传给迭代器的私有数据
+         * @param flags 0或DICT_BULK_UNIQUE
+         * @param threads 计算哈希的线程数（含调用线程），不超过1时单线程
+         * @return 插入的键个数
+         */
+        unsigned long dictBulkLoad(dict *d, unsigned long count, dictBulkNextFunction *next, void *privdata,
+                                   int flags, int threads);
+
+        /**
+         * 添加或替换键值对（键存在时替换值）。新增时键的归属同dictAdd
          * @param d 字典指针
          * @param key 键指针
          * @param val 值指针
@@ -195,6 +299,18 @@ public:
          */
         void *dictFetchValue(dict *d, const void *key);
 
+        /**
+         * 批量查找：先算出所有键的哈希，再分阶段预取桶（或控制字节组）、条目和键，
+         * 让多个键的cache miss重叠，适合MGET、流水线读这类一次查多个键的场景。
+         * rehash期间两张表都会预取。结果与逐个调用dictFind相同。
+         * @param d 字典指针
+         * @param keys 待查找的键数组
+         * @param n 键的个数
+         * @param results 输出数组（至少n个元素），results[i]为keys[i]的条目，不存在为NULL
+         * @return 找到的键个数
+         */
+        unsigned long dictFindBatch(dict *d, const void **keys, unsigned long n, dictEntry **results);
+
         /**
          * 调整字典大小为刚好容纳所有元素（优化内存）
          * @param d 字典指针
@@ -202,6 +318,14 @@ public:
          */
         int dictResize(dict *d);
 
+        /**
+         * 按字典类型的扩缩容策略判断是否缩容，需要时开始一次（渐进式）缩容rehash。
+         * 删除元素后会自动调用，rehash暂停期间和dictDisableResize期间不缩容
+         * @param d 字典指针
+         * @return 开始缩容返回DICT_OK，否则返回DICT_ERR
+         */
+        int dictShrinkIfNeeded(dict *d);
+
         /**
          * 获取字典迭代器（不安全版本）
          * @param d 字典指针
@@ -276,6 +400,24 @@ public:
          */
         uint64_t dictGenCaseHashFunction(const unsigned char *buf, int len);
 
+        /**
+         * 选择dictGenHashFunction/dictGenCaseHashFunction使用的哈希算法。
+         * DICT_HASH_SIPHASH（默认）是带密钥的SipHash-2-4，能抵御哈希洪水攻击；
+         * DICT_HASH_WYHASH和DICT_HASH_XXH3对短键快得多，但只适合键来自可信来源的场景。
+         * 所有算法都使用dictSetHashFunctionSeed设置的种子。
+         * 已有字典的桶位置依赖哈希值，必须在创建字典之前设置。
+         * 编译期默认值由CMake选项REDIS_DICT_HASH决定
+         * @param backend DICT_HASH_SIPHASH、DICT_HASH_WYHASH或DICT_HASH_XXH3
+         * @return 成功返回DICT_OK，未知的算法返回DICT_ERR
+         */
+        int dictSetHashBackend(int backend);
+
+        /**
+         * 获取当前的哈希算法
+         * @return DICT_HASH_xxx
+         */
+        int dictGetHashBackend(void);
+
         /**
          * 清空字典但保留结构（可指定回调函数）
          * @param d 字典指针
@@ -293,6 +435,80 @@ public:
          */
         void dictDisableResize(void);
 
+        /**
+         * 打开后台rehash：链式字典扩缩容到不小于min_buckets个桶时，由辅助线程搬迁ht[0]，
+         * 前台的查找/插入/删除只在桶所在条带上加一把自旋锁，不再分摊搬迁工作。
+         * 同一时刻只有一个字典在后台rehash，其余字典照旧在前台分步rehash；
+         * swiss引擎的字典不使用后台rehash。迭代器、dictScan、随机取键、统计、释放等
+         * 需要遍历整表的操作会先等后台搬完。
+         * @param min_buckets 使用后台rehash的最小桶数
+         */
+        void dictEnableBackgroundRehash(unsigned long min_buckets);
+
+        /**
+         * 关闭后台rehash（已在进行的后台rehash继续完成）
+         */
+        void dictDisableBackgroundRehash(void);
+
+        /**
+         * 等待字典的后台rehash搬完并换表，字典不在后台rehash时立即返回
+         * @param d 字典指针
+         */
+        void dictBackgroundRehashWait(dict *d);
+
+        /**
+         * 获取rehash进度（前台或后台）
+         * @param d 字典指针
+         * @return ht[0]中已搬迁的比例，0~1，不在rehash时返回1
+         */
+        double dictRehashProgress(dict *d);
+
+        /**
+         * 获取后台rehash的统计
+         * @param stats 输出参数
+         */
+        void dictGetRehashStats(dictRehashStats *stats);
+
+        /**
+         * 获取字典的条目池统计，字典没有条目池时各项为0
+         * @param d 字典指针
+         * @param stats 输出参数
+         */
+        void dictGetEntryPoolStats(dict *d, dictEntryPoolStats *stats);
+
+        /**
+         * 为字典打开运行指标采集（dictFind命中率与探测长度、rehash步数与耗时、扩缩容次数、rehash暂停次数）。
+         * 只有编译时定义了DICT_METRICS（CMake选项REDIS_DICT_METRICS）才可用，
+         * 未打开的字典每个埋点只多一次指针判断
+         * @param d 字典指针
+         * @return 成功返回DICT_OK，编译时未打开指标返回DICT_ERR
+         */
+        int dictEnableMetrics(dict *d);
+
+        /**
+         * 清零字典的指标计数器
+         * @param d 字典指针
+         */
+        void dictResetMetrics(dict *d);
+
+        /**
+         * 获取字典的指标快照，未打开采集时计数器为0，表形态字段总是有效
+         * @param d 字典指针
+         * @param metrics 输出参数
+         */
+        void dictGetMetrics(dict *d, dictMetrics *metrics);
+
+        /**
+         * 把字典的指标格式化为一行JSON（以换行结尾），字段名与dictMetrics相同，便于采集端解析。
+         * 字段只增不改，probe_hist的最后一个元素包含所有更长的探测
+         * @param d 字典指针
+         * @param name 字典名，写入"name"字段
+         * @param buf 输出缓冲区
+         * @param bufsize 缓冲区大小
+         * @return 完整输出需要的长度（不含结尾的'\0'），与snprintf相同
+         */
+        size_t dictFormatMetrics(dict *d, const char *name, char *buf, size_t bufsize);
+
         /**
          * 执行n步渐进式rehash
          * @param d 字典指针
@@ -332,6 +548,34 @@ public:
          */
         unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, dictScanBucketFunction *bucketfn, void *privdata);
 
+        /**
+         * 分区扫描：按游标低log2(nparts)位把dictScan的反向二进制游标空间分成nparts个互不相交的分区，
+         * 分区p从游标p开始，每次调用与dictScan一样扫描一个桶，返回0表示本分区结束。
+         * 各分区可以分别推进、交错进行，所有分区都扫完时保证与dictScan相同：
+         * 整个扫描期间都存在的元素至少返回一次（nparts大于表的桶数时重复更多）
+         * @param d 字典指针
+         * @param v 游标
+         * @param nparts 分区数（2的幂）
+         * @param fn 条目处理回调函数
+         * @param bucketfn 桶处理回调函数（可为NULL）
+         * @param privdata 传递给回调函数的私有数据
+         * @return 下一次调用的游标，0表示本分区扫描结束
+         */
+        unsigned long dictScanPartition(dict *d, unsigned long v, unsigned long nparts, dictScanFunction *fn,
+                                        dictScanBucketFunction *bucketfn, void *privdata);
+
+        /**
+         * 并行扫描整个字典：分成若干扫描分区，threads个线程（含调用线程）并发领取并遍历，
+         * 每个元素恰好返回一次。期间暂停rehash，调用方须保证没有其他线程访问该字典；
+         * 回调在各线程中并发执行，第i个线程传入privdata[i]，可以各自累加，结束后由调用方合并
+         * @param d 字典指针
+         * @param threads 线程数，不超过DICT_SCAN_THREADS_MAX，字典太小时会减少
+         * @param fn 条目处理回调函数
+         * @param privdata 至少threads个私有数据指针
+         * @return 实际使用的线程数，只有privdata的前这么多个被使用
+         */
+        int dictScanParallel(dict *d, int threads, dictScanFunction *fn, void **privdata);
+
         /**
          * 计算键的哈希值
          * @param d 字典指针
@@ -466,6 +710,67 @@ private:
         */
         size_t _dictGetStatsHt(char *buf, size_t bufsize, dictht *ht, int tableid);
 
+        /*
+        * swiss引擎：分步rehash，每步搬迁ht[0]的一个控制字节组
+        * 参数：
+        *   d：指向目标字典的指针
+        *   n：搬迁的组数
+        * 返回值：
+        *   仍需rehash返回1，已完成返回0
+        */
+        int _dictSwissRehash(dict *d, int n);
+
+        /*
+        * swiss引擎：插入前保证目标表有空位，必要时开始或做完rehash
+        * 参数：
+        *   d：指向目标字典的指针
+        */
+        void _dictSwissExpandIfNeeded(dict *d);
+
+        /*
+        * 批量加载前保证不经扩容、不经rehash就能再插入n个元素：等后台rehash结束、
+        * 做完渐进式rehash，不够时扩容并同步搬完
+        * 参数：
+        *   d：指向目标字典的指针
+        *   n：将要插入的元素个数
+        */
+        void _dictBulkReserve(dict *d, unsigned long n);
+
+        /*
+        * 批量加载：插入一批已算好哈希的键值对，调用方已用_dictBulkReserve预留空间
+        * 返回值：
+        *   插入的键个数
+        */
+        unsigned long _dictBulkInsert(dict *d, void **keys, void **vals, const uint64_t *hashes,
+                                      unsigned long n, int flags);
+
+        /*
+        * swiss引擎的dictGetRandomKey/dictGetSomeKeys/dictScan实现
+        */
+        dictEntry *_dictSwissGetRandomKey(dict *d);
+        unsigned int _dictSwissGetSomeKeys(dict *d, dictEntry **des, unsigned int count);
+        unsigned long _dictSwissScan(dict *d, unsigned long v, dictScanFunction *fn, void *privdata);
+
+        /*
+        * dictScan的一步，不等待后台rehash、不暂停rehash，由调用方负责，dictScanParallel的各线程共用
+        * 返回值：
+        *   下一次迭代的游标值
+        */
+        unsigned long _dictScanStep(dict *d, unsigned long v, dictScanFunction *fn,
+                                    dictScanBucketFunction *bucketfn, void *privdata);
+
+        /*
+        * dictScanParallel的工作线程：循环领取分区并扫完
+        */
+        static void *_dictScanWorker(void *arg);
+
+        /*
+        * swiss引擎：生成一张表的统计信息（装载率、墓碑数、探测组数分布）
+        * 返回值：
+        *   写入缓冲区的字节数
+        */
+        size_t _dictSwissGetStatsHt(char *buf, size_t bufsize, dict *d, dictht *ht, int tableid);
+
         /*
         * 从字典中删除指定键的条目
         * 参数：
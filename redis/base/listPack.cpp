@@ -5,6 +5,7 @@
  * Description: 实现 List Pack（紧凑列表） 的核心头文件，用于高效存储和操作列表数据。
  * List Pack 是一种紧凑、无冗余、双向可遍历的数据结构，旨在替代早期的 ziplist，解决其在连锁更新（Cascade Update）时的性能问题。
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_LISTPACK
 #include <stdint.h>
 #include <limits.h>
 #include <sys/types.h>
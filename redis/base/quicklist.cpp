@@ -5,12 +5,14 @@
  * Description: Quicklist 是一种双向链表与压缩列表（ziplist）结合的数据结构，用于高效存储和操作列表类型（如 LIST 数据类型）。
  * 它平衡了内存效率和操作性能，是 Redis 列表的默认底层实现。
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_QUICKLIST
 #include <string.h>
 #include "quicklist.h"
 #include "zmallocDf.h"
 #include "config.h"
 #include "ziplist.h"
 #include "toolFunc.h"
+#include "sds.h"
 #include <assert.h>
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
@@ -23,6 +25,7 @@ BEGIN_NAMESPACE(REDIS_BASE)
 #define REDIS_STATIC static
 #endif
 static ziplistCreate ziplistCreatel;
+static sdsCreate sdsCreatel;
 /* Optimization levels for size-based filling.
  * Note that the largest possible limit is 16k, so even if each record takes
  * just one byte, it still won't overflow the 16 bit count field. */
@@ -38,6 +41,11 @@ static const size_t optimization_level[] = {4096, 8192, 16384, 32768, 65536};
 /* Minimum ziplist size in bytes for attempting compression. */
 #define MIN_COMPRESS_BYTES 48
 
+/* node->zl未压缩时是ziplist.cpp分配的ziplist，压缩后是本文件分配的LZF块，
+ * 释放时按编码选择内存标签，保证与分配时的标签一致。 */
+#define QL_NODE_ZL_TAG(n) \
+    (quicklistNodeIsCompressed(n) ? ZMALLOC_TAG_QUICKLIST : ZMALLOC_TAG_ZIPLIST)
+
 /* Minimum size reduction in bytes to store compressed quicklistNode data.
  * This also prevents us from storing compression if the compression
  * resulted in a larger size than the original data. */
@@ -175,7 +183,7 @@ void quicklistCreate::quicklistRelease(quicklist *quicklist)
     while (len--) {
         next = current->next;
 
-        zfree(current->zl);
+        zfree_tag(current->zl, QL_NODE_ZL_TAG(current));
         quicklist->count -= current->count;
 
         zfree(current);
@@ -304,7 +312,7 @@ quicklist *quicklistCreate::quicklistAppendValuesFromZiplist(quicklist *quicklis
         quicklistPushTail(quicklist, value, sz);
         p = ziplistCreateInstance->ziplistNext(zl, p);
     }
-    zfree(zl);
+    zfree_tag(zl, ZMALLOC_TAG_ZIPLIST);
     return quicklist;
 }
 
@@ -655,7 +663,7 @@ quicklist *quicklistCreate::quicklistDup(quicklist *orig)
             node->zl = static_cast<unsigned char*>(zmalloc(lzf_sz));
             memcpy(node->zl, current->zl, lzf_sz);
         } else if (current->encoding == QUICKLIST_NODE_ENCODING_RAW) {
-            node->zl = static_cast<unsigned char*>(zmalloc(current->sz));
+            node->zl = static_cast<unsigned char*>(zmalloc_tag(current->sz, ZMALLOC_TAG_ZIPLIST));
             memcpy(node->zl, current->zl, current->sz);
         }
 
@@ -902,6 +910,47 @@ unsigned long quicklistCreate::quicklistCount(const quicklist *ql)
     return ql->count;
 }
 
+/**
+ * 把 quicklist 的一段范围按 LRANGE 的回复格式追加到 rope
+ * 
+ * @param quicklist 目标 quicklist
+ * @param start     起始索引
+ * @param end       结束索引（包含）
+ * @param r         输出 rope
+ * @return 追加的元素数量
+ */
+long quicklistCreate::quicklistRangeToRope(const quicklist *quicklist, long start, long end, sdsrope *r)
+{
+    long llen = (long)quicklist->count;
+
+    /* Convert negative indexes */
+    if (start < 0) start = llen+start;
+    if (end < 0) end = llen+end;
+    if (start < 0) start = 0;
+
+    if (start > end || start >= llen) {
+        sdsCreatel.sdsropecatlenhdr(r, '*', 0);
+        return 0;
+    }
+    if (end >= llen) end = llen-1;
+    long rangelen = (end-start)+1;
+
+    sdsCreatel.sdsropecatlenhdr(r, '*', rangelen);
+    quicklistIter *iter = quicklistGetIteratorAtIdx(quicklist, AL_START_HEAD, start);
+    quicklistEntry entry;
+    char longstr[SDS_LLSTR_SIZE];
+    for (long j = 0; j < rangelen && quicklistNext(iter, &entry); j++) {
+        if (entry.value) {
+            sdsCreatel.sdsropecatbulk(r, entry.value, entry.sz);
+        } else {
+            int len = toolFunc::ll2string(longstr, sizeof(longstr), entry.longval);
+            sdsCreatel.sdsropecatbulk(r, longstr, len);
+        }
+    }
+    quicklistReleaseIterator(iter);
+    return rangelen;
+}
+
 /**
  * 比较两个 quicklist 节点的数据
  * 
@@ -1158,7 +1207,7 @@ int quicklistCreate::__quicklistCompressNode(quicklistNode *node)
         return 0;
     }
     lzf =static_cast<quicklistLZF*>(zrealloc(lzf, sizeof(*lzf) + lzf->sz));
-    zfree(node->zl);
+    zfree_tag(node->zl, ZMALLOC_TAG_ZIPLIST);
     node->zl = (unsigned char *)lzf;
     node->encoding = QUICKLIST_NODE_ENCODING_LZF;
     node->recompress = 0;
@@ -1232,11 +1281,11 @@ void quicklistCreate::quicklistDecompressNode(quicklistNode *_node)
  */
 int quicklistCreate::__quicklistDecompressNode(quicklistNode *node) 
 {
-    void *decompressed = zmalloc(node->sz);
+    void *decompressed = zmalloc_tag(node->sz, ZMALLOC_TAG_ZIPLIST);
     quicklistLZF *lzf = (quicklistLZF *)node->zl;
     if (toolFuncInstance->lzf_decompress(lzf->compressed, lzf->sz, decompressed, node->sz) == 0) {
         /* Someone requested decompress, but we can't decompress.  Not good. */
-        zfree(decompressed);
+        zfree_tag(decompressed, ZMALLOC_TAG_ZIPLIST);
         return 0;
     }
     zfree(lzf);
@@ -1466,7 +1515,7 @@ quicklistNode *quicklistCreate::_quicklistSplitNode(quicklistNode *node, int off
     size_t zl_sz = node->sz;
 
     quicklistNode *new_node = quicklistCreateNode();
-    new_node->zl = static_cast<unsigned char*>(zmalloc(zl_sz));
+    new_node->zl = static_cast<unsigned char*>(zmalloc_tag(zl_sz, ZMALLOC_TAG_ZIPLIST));
 
     /* Copy original ziplist so we can split it */
     memcpy(new_node->zl, node->zl, zl_sz);
@@ -1642,7 +1691,7 @@ void quicklistCreate::__quicklistDelNode(quicklist *quicklist,quicklistNode *nod
      * now have compressed nodes needing to be decompressed. */
     __quicklistCompress(quicklist, NULL);
 
-    zfree(node->zl);
+    zfree_tag(node->zl, QL_NODE_ZL_TAG(node));
     zfree(node);
 }
 /**
@@ -1800,7 +1849,7 @@ void *quicklistCreate::_quicklistSaver(unsigned char *data, unsigned int sz)
 {
     unsigned char *vstr;
     if (data) {
-        vstr =static_cast< unsigned char *>(zmalloc(sz));
+        vstr =static_cast< unsigned char *>(zmalloc_tag(sz, ZMALLOC_TAG_OTHER));
         memcpy(vstr, data, sz);
         return vstr;
     }
@@ -16,6 +16,7 @@ BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
 class ziplistCreate;
 class toolFunc;
+struct sdsrope;
 typedef struct quicklistNode {
     struct quicklistNode *prev;
     struct quicklistNode *next;
@@ -352,6 +353,19 @@ public:
      */
     unsigned long quicklistCount(const quicklist *ql);
 
+    /**
+     * 把 quicklist 中 [start, end] 范围内的元素按 LRANGE 的回复格式追加到 rope，
+     * 索引规则同 LRANGE（负数从尾部计数，越界截断）。元素总是拷贝，
+     * 因为压缩节点在迭代器离开后会重新压缩
+     * 
+     * @param quicklist 目标 quicklist
+     * @param start     起始索引
+     * @param end       结束索引（包含）
+     * @param r         输出 rope
+     * @return 追加的元素数量
+     */
+    long quicklistRangeToRope(const quicklist *quicklist, long start, long end, sdsrope *r);
+
     /**
      * 比较两个 quicklist 节点的数据
      * 
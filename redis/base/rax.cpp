@@ -4,6 +4,7 @@
  * All rights reserved. No one may copy or transfer.
  * Description: 基数树也称为 压缩前缀树（Compact Prefix Tree），是一种空间高效的前缀树变体，用于快速存储和检索字符串键。
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_RAX
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -634,7 +634,7 @@ void redisObjectCreate::freeZsetObject(robj *o)
         zfree(zs);
         break;
     case OBJ_ENCODING_ZIPLIST:
-        zfree(o->ptr);
+        zfree_tag(o->ptr, ZMALLOC_TAG_ZIPLIST);
         break;
     default:
         serverPanic("Unknown sorted set encoding");
@@ -653,7 +653,7 @@ void redisObjectCreate::freeHashObject(robj *o)
         dictionaryCreateInstance->dictRelease((dict*) o->ptr);
         break;
     case OBJ_ENCODING_ZIPLIST:
-        zfree(o->ptr);
+        zfree_tag(o->ptr, ZMALLOC_TAG_ZIPLIST);
         break;
     default:
         serverPanic("Unknown hash encoding type");
@@ -1593,6 +1593,8 @@ struct redisMemOverhead *redisObjectCreate::getMemoryOverheadData(void)
     mh->dataset_perc = (float)mh->dataset*100/net_usage;
     mh->bytes_per_key = mh->total_keys ? (net_usage / mh->total_keys) : 0;
 
+    zmalloc_get_tag_stats(mh->tags);
+
     return mh;
 }
 
@@ -1625,6 +1627,7 @@ sds redisObjectCreate::getMemoryDoctorReport(void)
     int big_slave_buf = 0;  /* Slave buffers are too big. */
     int big_client_buf = 0; /* Client buffers are too big. */
     int many_scripts = 0;   /* Script cache has too many scripts. */
+    int big_dict = 0;       /* Dict structures dominate the memory usage. */
     int num_reports = 0;
     struct redisMemOverhead *mh = getMemoryOverheadData();
 
@@ -1662,6 +1665,13 @@ sds redisObjectCreate::getMemoryDoctorReport(void)
             num_reports++;
         }
 
+        /* Dict tables and entries use more than 50% of memory and 10MB? */
+        long long dict_used = mh->tags[ZMALLOC_TAG_DICT].used;
+        if (dict_used > 10<<20 && (size_t)dict_used*2 > mh->total_allocated) {
+            big_dict = 1;
+            num_reports++;
+        }
+
         /* Clients using more than 200k each average? */
         // long numslaves = listLength(server.slaves);
         // long numclients = listLength(server.clients)-numslaves;
@@ -1721,8 +1731,22 @@ sds redisObjectCreate::getMemoryDoctorReport(void)
         if (many_scripts) {
             s = sdsCreateInstance->sdscat(s," * Many scripts: There seem to be many cached scripts in this instance (more than 1000). This may be because scripts are generated and `EVAL`ed, instead of being parameterized (with KEYS and ARGV), `SCRIPT LOAD`ed and `EVALSHA`ed. Unless `SCRIPT FLUSH` is called periodically, the scripts' caches may end up consuming most of your memory.\n\n");
         }
+        if (big_dict) {
+            s = sdsCreateInstance->sdscatprintf(s," * Big dict overhead: Hash table buckets and entries use %lld bytes, more than 50%% of the used memory. This usually means there are many small keys, or hash tables that grew and were never resized down. Consider using compact encodings (ziplist/listpack) for small collections.\n\n", mh->tags[ZMALLOC_TAG_DICT].used);
+        }
         s = sdsCreateInstance->sdscat(s,"I'm here to keep you safe, Sam. I want to help you.\n");
     }
+
+    /* Per subsystem breakdown, so the user can see where the memory goes. */
+    if (!empty) {
+        s = sdsCreateInstance->sdscat(s,"\nMemory by subsystem:\n");
+        for (int j = 0; j < ZMALLOC_TAG_COUNT; j++) {
+            if (mh->tags[j].count == 0 && mh->tags[j].used == 0) continue;
+            s = sdsCreateInstance->sdscatprintf(s,"  %-10s used:%lld blocks:%lld allocs:%lld\n",
+                zmalloc::zmalloc_tag_name(j),
+                mh->tags[j].used, mh->tags[j].count, mh->tags[j].allocs);
+        }
+    }
     freeMemoryOverheadData(mh);
     return s;
 }
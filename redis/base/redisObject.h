@@ -10,6 +10,7 @@
 #define REDIS_BASE_REDISOBJECT_H
 #include "define.h"
 #include "dict.h"
+#include "zmalloc.h"
 #include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -71,6 +72,7 @@ struct redisMemOverhead {
         size_t overhead_ht_main;
         size_t overhead_ht_expires;
     } *db;
+    zmallocTagStats tags[ZMALLOC_TAG_COUNT]; /* 按子系统（zmallocTag）统计的内存 */
 };
 typedef char *sds;
 class redisObjectCreate
@@ -682,7 +684,10 @@ public:
         NULL,                      /* val dup */
         dictSdsKeyCompare,         /* key compare */
         dictSdsDestructor,         /* key destructor */
-        NULL                       /* val destructor */
+        NULL,                      /* val destructor */
+        NULL,                      /* allow to expand */
+        DICT_TYPE_EMBED_KEYS|DICT_TYPE_NO_VALUE, /* 短成员内嵌进条目，不存值 */
+        NULL                       /* resize policy: default */
     };
 private:
     zskiplistCreate* zskiplistCreateInstance;
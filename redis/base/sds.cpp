@@ -3,6 +3,7 @@
  * Date: 2025/06/12
  * Description: A C dynamic strings library
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_SDS
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,12 @@
 #include <limits.h>
 #include "sds.h"
 #include "zmallocDf.h"
+#include "toolFunc.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
@@ -275,64 +282,15 @@ size_t sdsCreate::sdsTypeMaxSize(char type)
     return -1; /* this is equivalent to the max SDS_TYPE_64 or SDS_TYPE_32 */
 }
 
+/* 整数转十进制字符串，s至少SDS_LLSTR_SIZE字节，返回长度（不含结尾的'\0'）。
+ * 与ll2string共用按位数直接定位、两位一组输出的实现，不再逐位求余再反转 */
 int sdsll2str(char *s, long long value) {
-    char *p, aux;
-    unsigned long long v;
-    size_t l;
-
-    /* Generate the string representation, this method produces
-     * a reversed string. */
-    v = (value < 0) ? -value : value;
-    p = s;
-    do {
-        *p++ = '0'+(v%10);
-        v /= 10;
-    } while(v);
-    if (value < 0) *p++ = '-';
-
-    /* Compute length and add null term. */
-    l = p-s;
-    *p = '\0';
-
-    /* Reverse the string. */
-    p--;
-    while(s < p) {
-        aux = *s;
-        *s = *p;
-        *p = aux;
-        s++;
-        p--;
-    }
-    return l;
+    return toolFunc::ll2string(s,SDS_LLSTR_SIZE,value);
 }
 
 /* Identical sdsll2str(), but for unsigned long long type. */
 int sdsull2str(char *s, unsigned long long v) {
-    char *p, aux;
-    size_t l;
-
-    /* Generate the string representation, this method produces
-     * a reversed string. */
-    p = s;
-    do {
-        *p++ = '0'+(v%10);
-        v /= 10;
-    } while(v);
-
-    /* Compute length and add null term. */
-    l = p-s;
-    *p = '\0';
-
-    /* Reverse the string. */
-    p--;
-    while(s < p) {
-        aux = *s;
-        *s = *p;
-        *p = aux;
-        s++;
-        p--;
-    }
-    return l;
+    return toolFunc::ull2string(s,SDS_LLSTR_SIZE,v);
 }
 
 /* Create a new sds string with the content specified by the 'init' pointer
@@ -680,16 +638,13 @@ sds sdsCreate::sdscatfmt(sds s, char const *fmt, ...)
                     num = va_arg(ap,int);
                 else
                     num = va_arg(ap,long long);
-                {
-                    char buf[SDS_LLSTR_SIZE];
-                    l = sdsll2str(buf,num);
-                    if (sdsavail(s) < l) {
-                        s = sdsMakeRoomFor(s,l);
-                    }
-                    memcpy(s+i,buf,l);
-                    sdsinclen(s,l);
-                    i += l;
+                /* 直接写到s的空闲区，省掉中间缓冲区和一次拷贝 */
+                if (sdsavail(s) < SDS_LLSTR_SIZE) {
+                    s = sdsMakeRoomFor(s,SDS_LLSTR_SIZE);
                 }
+                l = sdsll2str(s+i,num);
+                sdsinclen(s,l);
+                i += l;
                 break;
             case 'u':
             case 'U':
@@ -697,16 +652,12 @@ sds sdsCreate::sdscatfmt(sds s, char const *fmt, ...)
                     unum = va_arg(ap,unsigned int);
                 else
                     unum = va_arg(ap,unsigned long long);
-                {
-                    char buf[SDS_LLSTR_SIZE];
-                    l = sdsull2str(buf,unum);
-                    if (sdsavail(s) < l) {
-                        s = sdsMakeRoomFor(s,l);
-                    }
-                    memcpy(s+i,buf,l);
-                    sdsinclen(s,l);
-                    i += l;
+                if (sdsavail(s) < SDS_LLSTR_SIZE) {
+                    s = sdsMakeRoomFor(s,SDS_LLSTR_SIZE);
                 }
+                l = sdsull2str(s+i,unum);
+                sdsinclen(s,l);
+                i += l;
                 break;
             default: /* Handle %% and generally %<unknown>. */
                 s[i++] = next;
@@ -848,6 +799,83 @@ int sdsCreate::sdscmp(const sds s1, const sds s2)
     if (cmp == 0) return l1>l2? 1: (l1<l2? -1: 0);
     return cmp;
 }
+/* 在[p,end)中查找分隔符，找不到返回NULL。
+ * 向量路径一次比较一整块起始位置：块内同时等于sep首字节、且seplen-1之后等于sep尾字节的
+ * 位置才是候选，再用memcmp确认中间部分，多字节分隔符不必在每个位置都做memcmp。
+ * 编译目标支持AVX2时一次32字节，否则SSE2一次16字节，尾部和其他平台走标量循环 */
+static const char *sdsFindSep(const char *p, const char *end, const char *sep, int seplen)
+{
+    const char first = sep[0], last = sep[seplen-1];
+
+    if (end - p < seplen) return NULL;
+#if defined(__AVX2__)
+    const __m256i vfirst32 = _mm256_set1_epi8(first), vlast32 = _mm256_set1_epi8(last);
+    while (end - p >= 32 + seplen - 1) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + seplen - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, vfirst32), _mm256_cmpeq_epi8(b, vlast32)));
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (seplen <= 2 || memcmp(p + i + 1, sep + 1, seplen - 2) == 0) return p + i;
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i vfirst = _mm_set1_epi8(first), vlast = _mm_set1_epi8(last);
+    while (end - p >= 16 + seplen - 1) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + seplen - 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(a, vfirst), _mm_cmpeq_epi8(b, vlast)));
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (seplen <= 2 || memcmp(p + i + 1, sep + 1, seplen - 2) == 0) return p + i;
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for (end -= seplen - 1; p < end; p++) {
+        if (*p == first && memcmp(p, sep, seplen) == 0) return p;
+    }
+    return NULL;
+}
+
+/* 返回[p,end)中第一个属于set的字节，没有则返回end。setlen不超过SDS_SPLIT_SET_MAX，
+ * sdssplitargs用它跳过一整段普通字符，成段追加到当前参数 */
+static const char *sdsFindAnyOf(const char *p, const char *end, const char *set, int setlen)
+{
+#if defined(__AVX2__)
+    __m256i vset32[SDS_SPLIT_SET_MAX];
+    for (int k = 0; k < setlen; k++) vset32[k] = _mm256_set1_epi8(set[k]);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_cmpeq_epi8(v, vset32[0]);
+        for (int k = 1; k < setlen; k++) hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, vset32[k]));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i vset[SDS_SPLIT_SET_MAX];
+    for (int k = 0; k < setlen; k++) vset[k] = _mm_set1_epi8(set[k]);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_cmpeq_epi8(v, vset[0]);
+        for (int k = 1; k < setlen; k++) hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, vset[k]));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; p++) {
+        for (int k = 0; k < setlen; k++)
+            if (*p == set[k]) return p;
+    }
+    return end;
+}
 /* Split 's' with separator in 'sep'. An array
  * of sds strings is returned. *count will be set
  * by reference to the number of tokens returned.
@@ -875,40 +903,31 @@ int sdsCreate::sdscmp(const sds s1, const sds s2)
  */
 sds *sdsCreate::sdssplitlen(const char *s, ssize_t len, const char *sep, int seplen, int *count)
 {
-    int elements = 0, slots = 5;
-    long start = 0, j;
+    int elements = 0, total = 1;
+    const char *start = s, *end = s + len, *q;
     sds *tokens;
 
     if (seplen < 1 || len < 0) return NULL;
 
-    tokens = static_cast<sds*>(zmalloc(sizeof(sds)*slots));
-    if (tokens == NULL) return NULL;
-
     if (len == 0) {
+        tokens = static_cast<sds*>(zmalloc(sizeof(sds)));
+        if (tokens == NULL) return NULL;
         *count = 0;
         return tokens;
     }
-    for (j = 0; j < (len-(seplen-1)); j++) {
-        /* make sure there is room for the next element and the final one */
-        if (slots < elements+2) {
-            sds *newtokens;
+    /* 先数出分隔符的个数，token数组只分配一次 */
+    for (q = s; (q = sdsFindSep(q, end, sep, seplen)) != NULL; q += seplen) total++;
+    tokens = static_cast<sds*>(zmalloc(sizeof(sds)*total));
+    if (tokens == NULL) return NULL;
 
-            slots *= 2;
-            newtokens = static_cast<sds *>(zrealloc(tokens,sizeof(sds)*slots));
-            if (newtokens == NULL) goto cleanup;
-            tokens = newtokens;
-        }
-        /* search the separator */
-        if ((seplen == 1 && *(s+j) == sep[0]) || (memcmp(s+j,sep,seplen) == 0)) {
-            tokens[elements] = sdsnewlen(s+start,j-start);
-            if (tokens[elements] == NULL) goto cleanup;
-            elements++;
-            start = j+seplen;
-            j = j+seplen-1; /* skip the separator */
-        }
+    while ((q = sdsFindSep(start, end, sep, seplen)) != NULL) {
+        tokens[elements] = sdsnewlen(start,q-start);
+        if (tokens[elements] == NULL) goto cleanup;
+        elements++;
+        start = q+seplen; /* skip the separator */
     }
     /* Add the final element. We are sure there is room in the tokens array. */
-    tokens[elements] = sdsnewlen(s+start,len-start);
+    tokens[elements] = sdsnewlen(start,end-start);
     if (tokens[elements] == NULL) goto cleanup;
     elements++;
     *count = elements;
@@ -1038,9 +1057,10 @@ sds sdsCreate::sdscatrepr(sds s, const char *p, size_t len)
  */
 sds *sdsCreate::sdssplitargs(const char *line, int *argc)
 {
-    const char *p = line;
+    const char *p = line, *end = line + strlen(line), *q;
     char *current = NULL;
     char **vector = NULL;
+    int slots = 0;
 
     *argc = 0;
     while(1) {
@@ -1054,6 +1074,14 @@ sds *sdsCreate::sdssplitargs(const char *line, int *argc)
 
             if (current == NULL) current = sdsempty();
             while(!done) {
+                /* 不需要特殊处理的字符整段追加，只在引号、转义和空白处进入下面的逐字符分支 */
+                if (inq) q = sdsFindAnyOf(p, end, "\\\"", 2);
+                else if (insq) q = sdsFindAnyOf(p, end, "\\'", 2);
+                else q = sdsFindAnyOf(p, end, " \n\r\t\"'", 6);
+                if (q != p) {
+                    current = sdscatlen(current,p,q-p);
+                    p = q;
+                }
                 if (inq) {
                     if (*p == '\\' && *(p+1) == 'x' &&
                                              is_hex_digit(*(p+2)) &&
@@ -1127,7 +1155,10 @@ sds *sdsCreate::sdssplitargs(const char *line, int *argc)
                 if (*p) p++;
             }
             /* add the token to the vector */
-            vector = static_cast<char**>(zrealloc(vector,((*argc)+1)*sizeof(char*)));
+            if (*argc == slots) {
+                slots = slots ? slots*2 : SDS_SPLITARGS_INIT_SLOTS;
+                vector = static_cast<char**>(zrealloc(vector,slots*sizeof(char*)));
+            }
             vector[*argc] = current;
             (*argc)++;
             current = NULL;
@@ -1280,6 +1311,46 @@ error:
     sdsfree(res);
     return NULL;
 }
+static const sdsGrowPolicy sds_default_grow_policy = {
+    SDS_MAX_PREALLOC, SDS_GROW_LARGE_DIV, SDS_BOUNDED_SLACK_DIV, SDS_SWEEP_MIN_FREE
+};
+static sdsGrowPolicy sds_grow_policy = sds_default_grow_policy;
+
+/* 新长度为newlen时按mode预留的额外空间。实际分配后分配器size class的富余
+ * 会通过zmalloc_usable记入alloc，这里不需要再按size class取整 */
+static inline size_t sdsGrowSlack(size_t newlen, int mode)
+{
+    const sdsGrowPolicy *p = &sds_grow_policy;
+    size_t slack;
+
+    switch (mode) {
+    case SDS_GROW_EXACT:
+        return 0;
+    case SDS_GROW_BOUNDED:
+        slack = p->bounded_div ? newlen / p->bounded_div : 0;
+        return slack < p->max_prealloc ? slack : p->max_prealloc;
+    default:
+        if (newlen < p->max_prealloc) return newlen;
+        slack = p->large_div ? newlen / p->large_div : 0;
+        return slack > p->max_prealloc ? slack : p->max_prealloc;
+    }
+}
+/**
+ * 设置进程内的sds增长策略
+ * @param policy 新策略，为NULL时恢复默认值
+ */
+void sdsCreate::sdsSetGrowPolicy(const sdsGrowPolicy *policy)
+{
+    sds_grow_policy = policy ? *policy : sds_default_grow_policy;
+}
+/**
+ * 获取当前的sds增长策略
+ * @param policy 输出参数
+ */
+void sdsCreate::sdsGetGrowPolicy(sdsGrowPolicy *policy)
+{
+    *policy = sds_grow_policy;
+}
 /* Enlarge the free space at the end of the sds string so that the caller
  * is sure that after calling this function can overwrite up to addlen
  * bytes after the end of the string, plus one more byte for nul term.
@@ -1297,12 +1368,23 @@ error:
  *   返回扩展后的 SDS 对象指针
  *   如果分配失败返回 NULL
  * 
- * 内存策略:
- *   - 如果需要的空间小于 1MB，则额外预分配相同大小的空间
- *   - 如果需要的空间大于 1MB，则额外预分配 1MB 空间
+ * 内存策略（SDS_GROW_GREEDY，阈值和比例见sdsGrowPolicy）:
+ *   - 如果需要的空间小于 max_prealloc（默认1MB），则额外预分配相同大小的空间
+ *   - 否则额外预分配 max(max_prealloc, 新长度/large_div)
  *   - 这种策略使 SDS 具有惰性释放特性，减少频繁内存分配
  */
 sds sdsCreate::sdsMakeRoomFor(sds s, size_t addlen)
+{
+    return sdsMakeRoomForMode(s, addlen, SDS_GROW_GREEDY);
+}
+/**
+ * 按指定的增长模式扩展空间
+ * @param s sds字符串
+ * @param addlen 需要额外容纳的字节数
+ * @param mode SDS_GROW_GREEDY、SDS_GROW_EXACT或SDS_GROW_BOUNDED
+ * @return 扩展后的sds，分配失败返回NULL
+ */
+sds sdsCreate::sdsMakeRoomForMode(sds s, size_t addlen, int mode)
 {
     void *sh, *newsh;
     size_t avail = sdsavail(s);
@@ -1318,10 +1400,8 @@ sds sdsCreate::sdsMakeRoomFor(sds s, size_t addlen)
     sh = (char*)s-sdsHdrSize(oldtype);
     reqlen = newlen = (len+addlen);
     assert(newlen > len);   /* Catch size_t overflow */
-    if (newlen < SDS_MAX_PREALLOC)
-        newlen *= 2;
-    else
-        newlen += SDS_MAX_PREALLOC;
+    newlen += sdsGrowSlack(newlen, mode);
+    if (newlen < reqlen) newlen = reqlen; /* Catch size_t overflow of the slack */
 
     type = sdsReqType(newlen);
 
@@ -1441,6 +1521,7 @@ sds sdsCreate::sdsRemoveFreeSpace(sds s)
     int hdrlen, oldhdrlen = sdsHdrSize(oldtype);
     size_t len = sdslen(s);
     size_t avail = sdsavail(s);
+    size_t usable;
     sh = (char*)s-oldhdrlen;
 
     /* Return ASAP if there is no space left. */
@@ -1456,11 +1537,13 @@ sds sdsCreate::sdsRemoveFreeSpace(sds s)
      * only if really needed. Otherwise if the change is huge, we manually
      * reallocate the string to use the different header type. */
     if (oldtype==type || type > SDS_TYPE_8) {
-        newsh = zrealloc(sh, oldhdrlen+len+1);
+        newsh = zrealloc_usable(sh, oldhdrlen+len+1, &usable);
         if (newsh == NULL) return NULL;
         s = (char*)newsh+oldhdrlen;
+        hdrlen = oldhdrlen;
+        type = oldtype;
     } else {
-        newsh = zmalloc(hdrlen+len+1);
+        newsh = zmalloc_usable(hdrlen+len+1, &usable);
         if (newsh == NULL) return NULL;
         memcpy((char*)newsh+hdrlen, s, len+1);
         zfree(sh);
@@ -1468,9 +1551,34 @@ sds sdsCreate::sdsRemoveFreeSpace(sds s)
         s[-1] = type;
         sdssetlen(s, len);
     }
-    sdssetalloc(s, len);
+    /* 分配器按size class取整的富余也记为可用空间 */
+    usable = usable-hdrlen-1;
+    if (usable > sdsTypeMaxSize(type))
+        usable = sdsTypeMaxSize(type);
+    sdssetalloc(s, usable);
     return s;
 }
+/**
+ * 回收一批字符串中较大的空闲空间
+ * @param strs sds指针数组，元素可为NULL，收缩后原地更新
+ * @param count 元素个数
+ * @return 回收的字节数
+ */
+size_t sdsCreate::sdsSweepFreeSpace(sds *strs, size_t count)
+{
+    size_t reclaimed = 0;
+
+    for (size_t j = 0; j < count; j++) {
+        sds s = strs[j];
+        if (s == NULL || sdsavail(s) < sds_grow_policy.sweep_min_free) continue;
+        size_t before = sdsAllocSize(s);
+        s = sdsRemoveFreeSpace(s);
+        if (s == NULL) continue;
+        strs[j] = s;
+        reclaimed += before - sdsAllocSize(s);
+    }
+    return reclaimed;
+}
 /**
  * 获取sds字符串的总分配大小（包括头部和字符串数据）
  * @param s sds字符串
@@ -1499,6 +1607,483 @@ void *sdsCreate::sdsAllocPtr(sds s)
 {
     return (void*) (s-sdsHdrSize(s[-1]));
 }
+/**
+ * 生成指向sds全部内容的视图
+ * @param s sds字符串
+ * @return 视图
+ */
+sdsview sdsCreate::sdsviewfromsds(const sds s)
+{
+    sdsview v = {s, sdslen(s)};
+    return v;
+}
+/**
+ * 生成指向任意缓冲区的视图
+ * @param p 缓冲区
+ * @param len 长度
+ * @return 视图
+ */
+sdsview sdsCreate::sdsviewlen(const void *p, size_t len)
+{
+    sdsview v = {static_cast<const char*>(p), len};
+    return v;
+}
+/**
+ * 截取视图的子串，越界处理与sdssubstr相同
+ * @param v 视图
+ * @param start 起始位置
+ * @param len 子串长度
+ * @return 子串视图
+ */
+sdsview sdsCreate::sdsviewsubstr(sdsview v, size_t start, size_t len)
+{
+    if (start >= v.len) start = len = 0;
+    if (len > v.len-start) len = v.len-start;
+    sdsview sub = {v.ptr+start, len};
+    return sub;
+}
+/**
+ * 按闭区间截取视图，下标计算与sdsrange相同
+ * @param v 视图
+ * @param start 起始下标
+ * @param end 结束下标（包含）
+ * @return 子串视图
+ */
+sdsview sdsCreate::sdsviewrange(sdsview v, ssize_t start, ssize_t end)
+{
+    size_t newlen;
+    if (v.len == 0) return v;
+    if (start < 0)
+        start = v.len + start;
+    if (end < 0)
+        end = v.len + end;
+    newlen = (start > end) ? 0 : (end-start)+1;
+    return sdsviewsubstr(v, start, newlen);
+}
+/**
+ * 比较两个视图
+ * @param a 视图
+ * @param b 视图
+ * @return 小于、等于、大于时分别返回负数、0、正数
+ */
+int sdsCreate::sdsviewcmp(sdsview a, sdsview b)
+{
+    size_t minlen = (a.len < b.len) ? a.len : b.len;
+    int cmp = minlen ? memcmp(a.ptr,b.ptr,minlen) : 0;
+    if (cmp == 0) return a.len>b.len? 1: (a.len<b.len? -1: 0);
+    return cmp;
+}
+/**
+ * 按分隔符把视图切成子视图，不分配内存
+ * @param v 视图
+ * @param sep 分隔符
+ * @param seplen 分隔符长度
+ * @param tokens 输出数组
+ * @param maxtokens tokens的容量
+ * @return token总数，参数错误返回-1
+ */
+int sdsCreate::sdssplitview(sdsview v, const char *sep, int seplen, sdsview *tokens, int maxtokens)
+{
+    const char *start = v.ptr, *end = v.ptr + v.len, *q;
+    int elements = 0;
+
+    if (seplen < 1) return -1;
+    if (v.len == 0) return 0;
+    while ((q = sdsFindSep(start, end, sep, seplen)) != NULL) {
+        if (elements < maxtokens) tokens[elements] = sdsviewlen(start, q-start);
+        elements++;
+        start = q+seplen;
+    }
+    if (elements < maxtokens) tokens[elements] = sdsviewlen(start, end-start);
+    return elements+1;
+}
+/**
+ * 用视图的内容创建新的sds
+ * @param v 视图
+ * @return 新的sds
+ */
+sds sdsCreate::sdsnewview(sdsview v)
+{
+    return sdsnewlen(v.ptr, v.len);
+}
+/**
+ * 把视图的内容追加到sds末尾
+ * @param s 目标sds
+ * @param v 视图
+ * @return 追加后的sds
+ */
+sds sdsCreate::sdscatview(sds s, sdsview v)
+{
+    return sdscatlen(s, v.ptr, v.len);
+}
+/**
+ * 用视图的内容覆盖sds
+ * @param s 目标sds
+ * @param v 视图
+ * @return 复制后的sds
+ */
+sds sdsCreate::sdscpyview(sds s, sdsview v)
+{
+    return sdscpylen(s, v.ptr, v.len);
+}
+/**
+ * 把sds变为共享缓冲区
+ * @param s sds字符串，之后归共享缓冲区所有
+ * @return 引用计数为1的共享缓冲区
+ */
+sdsshared *sdsCreate::sdssharednew(sds s)
+{
+    sdsshared *sh = static_cast<sdsshared*>(zmalloc(sizeof(*sh)));
+    sh->refcount = 1;
+    sh->buf = s;
+    return sh;
+}
+/**
+ * 增加共享缓冲区的引用
+ * @param sh 共享缓冲区
+ * @return sh
+ */
+sdsshared *sdsCreate::sdssharedretain(sdsshared *sh)
+{
+    __atomic_add_fetch(&sh->refcount, 1, __ATOMIC_RELAXED);
+    return sh;
+}
+/**
+ * 释放一个引用，计数归零时释放缓冲区
+ * @param sh 共享缓冲区
+ */
+void sdsCreate::sdssharedrelease(sdsshared *sh)
+{
+    if (sh == NULL) return;
+    /* 其他线程对buf的读取要在释放之前完成，所以这里用acq_rel */
+    if (__atomic_sub_fetch(&sh->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        sdsfree(sh->buf);
+        zfree(sh);
+    }
+}
+/**
+ * 在共享缓冲区上创建切片
+ * @param sh 共享缓冲区
+ * @param start 起始偏移
+ * @param len 长度
+ * @return 切片
+ */
+sdsslice sdsCreate::sdsslicenew(sdsshared *sh, size_t start, size_t len)
+{
+    sdsview v = sdsviewsubstr(sdsviewfromsds(sh->buf), start, len);
+    sdsslice sl = {sdssharedretain(sh), (size_t)(v.ptr - sh->buf), v.len};
+    return sl;
+}
+/**
+ * 在切片上再截取一段
+ * @param sl 原切片
+ * @param start 相对原切片的起始偏移
+ * @param len 长度
+ * @return 新切片，原切片为空时也为空
+ */
+sdsslice sdsCreate::sdsslicesub(const sdsslice *sl, size_t start, size_t len)
+{
+    sdsslice sub = {NULL, 0, 0};
+    if (sl->shared == NULL) return sub;
+    sdsview v = sdsviewsubstr(sdssliceview(sl), start, len);
+    sub.shared = sdssharedretain(sl->shared);
+    sub.offset = v.ptr - sl->shared->buf;
+    sub.len = v.len;
+    return sub;
+}
+/**
+ * 切片内容的视图
+ * @param sl 切片
+ * @return 视图
+ */
+sdsview sdsCreate::sdssliceview(const sdsslice *sl)
+{
+    if (sl->shared == NULL) return sdsviewlen("", 0);
+    return sdsviewlen(sl->shared->buf + sl->offset, sl->len);
+}
+/**
+ * 释放切片持有的引用
+ * @param sl 切片，释放后置空
+ */
+void sdsCreate::sdsslicefree(sdsslice *sl)
+{
+    sdssharedrelease(sl->shared);
+    sl->shared = NULL;
+    sl->offset = sl->len = 0;
+}
+/**
+ * 初始化空的rope
+ * @param r rope
+ */
+void sdsCreate::sdsropeinit(sdsrope *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+/**
+ * 释放rope持有的内存，之后r是空rope
+ * @param r rope
+ */
+void sdsCreate::sdsropefree(sdsrope *r)
+{
+    for (size_t j = 0; j < r->count; j++)
+        if (r->segs[j].own) sdsfree(r->segs[j].own);
+    zfree(r->segs);
+    sdsropeinit(r);
+}
+/**
+ * 在末尾追加一段，段数组按2倍增长
+ * @param r rope
+ * @param ptr 数据
+ * @param len 长度
+ * @param own 该段持有的sds（可为NULL）
+ * @return 新段
+ */
+sdsropeseg *sdsCreate::sdsRopePushSeg(sdsrope *r, const char *ptr, size_t len, sds own)
+{
+    if (r->count == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : SDS_ROPE_INIT_SEGS;
+        r->segs = static_cast<sdsropeseg*>(zrealloc(r->segs, sizeof(sdsropeseg) * r->cap));
+    }
+    sdsropeseg *seg = &r->segs[r->count++];
+    seg->ptr = ptr;
+    seg->len = len;
+    seg->own = own;
+    r->len += len;
+    return seg;
+}
+/**
+ * 在暂存块里占用len个字节（len小于SDS_ROPE_CHUNK）。当前块放不下时另起一块，
+ * 新块由追加的一个空段持有，紧接着写入的数据会并入这个段
+ * @param r rope
+ * @param len 长度
+ * @return 写入位置
+ */
+char *sdsCreate::sdsRopeScratch(sdsrope *r, size_t len)
+{
+    if (r->tail == NULL || sdsavail(r->tail) < len) {
+        size_t chunk = r->len / 4;
+        if (chunk < SDS_ROPE_CHUNK) chunk = SDS_ROPE_CHUNK;
+        if (chunk > SDS_ROPE_CHUNK_MAX) chunk = SDS_ROPE_CHUNK_MAX;
+        r->tail = sdsMakeRoomForMode(sdsempty(), chunk, SDS_GROW_EXACT);
+        sdsRopePushSeg(r, r->tail, 0, r->tail);
+    }
+    char *dst = r->tail + sdslen(r->tail);
+    sdsIncrLen(r->tail, len);
+    return dst;
+}
+/**
+ * 拷贝一段数据追加到rope末尾。与上一段在暂存块中相邻时直接并入上一段
+ * @param r rope
+ * @param p 数据
+ * @param len 长度
+ */
+void sdsCreate::sdsropecatlen(sdsrope *r, const void *p, size_t len)
+{
+    if (len == 0) return;
+    if (len >= SDS_ROPE_CHUNK) {
+        sds s = sdsnewlen(p, len);
+        sdsRopePushSeg(r, s, len, s);
+        return;
+    }
+    char *dst = sdsRopeScratch(r, len);
+    memcpy(dst, p, len);
+    sdsropeseg *last = &r->segs[r->count-1];
+    if (last->ptr + last->len == dst) {
+        last->len += len;
+        r->len += len;
+    } else {
+        sdsRopePushSeg(r, dst, len, NULL);
+    }
+}
+/**
+ * 追加一个借用的缓冲区，不拷贝
+ * @param r rope
+ * @param p 缓冲区
+ * @param len 长度
+ */
+void sdsCreate::sdsropecatborrow(sdsrope *r, const void *p, size_t len)
+{
+    if (len < SDS_ROPE_BORROW_MIN) {
+        sdsropecatlen(r, p, len);
+        return;
+    }
+    sdsRopePushSeg(r, static_cast<const char*>(p), len, NULL);
+}
+/**
+ * 追加一个sds并接管其所有权
+ * @param r rope
+ * @param s sds字符串
+ */
+void sdsCreate::sdsropecatsds(sdsrope *r, sds s)
+{
+    size_t len = sdslen(s);
+    if (len < SDS_ROPE_BORROW_MIN) {
+        sdsropecatlen(r, s, len);
+        sdsfree(s);
+        return;
+    }
+    sdsRopePushSeg(r, s, len, s);
+}
+/**
+ * 格式化RESP长度头
+ * @param buf 输出缓冲区，至少SDS_ROPE_LENHDR_MAX字节
+ * @param prefix 前缀字符
+ * @param n 长度
+ * @return 长度头的字节数
+ */
+static size_t sdsRopeFormatLenHdr(char *buf, char prefix, long long n)
+{
+    buf[0] = prefix;
+    size_t len = 1 + toolFunc::ll2string(buf + 1, SDS_ROPE_LENHDR_MAX - 3, n);
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+    return len;
+}
+/**
+ * 追加RESP长度头
+ * @param r rope
+ * @param prefix 前缀字符
+ * @param n 长度
+ */
+void sdsCreate::sdsropecatlenhdr(sdsrope *r, char prefix, long long n)
+{
+    char buf[SDS_ROPE_LENHDR_MAX];
+    sdsropecatlen(r, buf, sdsRopeFormatLenHdr(buf, prefix, n));
+}
+/**
+ * 追加一个RESP bulk string
+ * @param r rope
+ * @param p 数据
+ * @param len 长度
+ */
+void sdsCreate::sdsropecatbulk(sdsrope *r, const void *p, size_t len)
+{
+    sdsropecatlenhdr(r, '$', (long long)len);
+    sdsropecatlen(r, p, len);
+    sdsropecatlen(r, "\r\n", 2);
+}
+/**
+ * 预留一个长度头的位置
+ * @param r rope
+ * @return 预留段的下标
+ */
+size_t sdsCreate::sdsropedeferlen(sdsrope *r)
+{
+    sdsRopePushSeg(r, NULL, 0, NULL);
+    return r->count - 1;
+}
+/**
+ * 填写预留的长度头，内容写在当前暂存块里，预留段指向它
+ * @param r rope
+ * @param slot sdsropedeferlen的返回值
+ * @param prefix 前缀字符
+ * @param n 长度
+ */
+void sdsCreate::sdsropesetdeferredlen(sdsrope *r, size_t slot, char prefix, long long n)
+{
+    char buf[SDS_ROPE_LENHDR_MAX];
+    size_t len = sdsRopeFormatLenHdr(buf, prefix, n);
+    char *dst = sdsRopeScratch(r, len);   /* 可能追加段，之后再取slot */
+    memcpy(dst, buf, len);
+    sdsropeseg *seg = &r->segs[slot];
+    assert(seg->len == 0 && seg->own == NULL);
+    seg->ptr = dst;
+    seg->len = len;
+    r->len += len;
+}
+/**
+ * rope的总字节数
+ * @param r rope
+ * @return 字节数
+ */
+size_t sdsCreate::sdsropelen(const sdsrope *r)
+{
+    return r->len;
+}
+/**
+ * 尚未写出的字节数
+ * @param r rope
+ * @return 字节数
+ */
+size_t sdsCreate::sdsropepending(const sdsrope *r)
+{
+    size_t written = r->pos_off;
+    for (size_t j = 0; j < r->pos_seg; j++) written += r->segs[j].len;
+    return r->len - written;
+}
+/**
+ * 从已写出位置开始填充iovec数组，跳过空段
+ * @param r rope
+ * @param iov 输出数组
+ * @param iovmax iov的容量
+ * @return 填充的元素个数
+ */
+int sdsCreate::sdsropeiov(const sdsrope *r, struct iovec *iov, int iovmax)
+{
+    int cnt = 0;
+    size_t off = r->pos_off;
+
+    for (size_t j = r->pos_seg; j < r->count && cnt < iovmax; j++, off = 0) {
+        const sdsropeseg *seg = &r->segs[j];
+        if (seg->len == off) continue;
+        iov[cnt].iov_base = (void*)(seg->ptr + off);
+        iov[cnt].iov_len = seg->len - off;
+        cnt++;
+    }
+    return cnt;
+}
+/**
+ * 推进已写出位置
+ * @param r rope
+ * @param nwritten 写出的字节数
+ */
+void sdsCreate::sdsropeconsume(sdsrope *r, size_t nwritten)
+{
+    while (nwritten && r->pos_seg < r->count) {
+        size_t left = r->segs[r->pos_seg].len - r->pos_off;
+        if (nwritten < left) {
+            r->pos_off += nwritten;
+            return;
+        }
+        nwritten -= left;
+        r->pos_seg++;
+        r->pos_off = 0;
+    }
+    assert(nwritten == 0);
+}
+/**
+ * 把rope展开成一个sds，之后rope被清空
+ * @param r rope
+ * @return 包含全部内容的sds
+ */
+sds sdsCreate::sdsropeflatten(sdsrope *r)
+{
+    sdsropeseg *only = NULL;
+    sds s;
+
+    for (size_t j = 0; j < r->count; j++) {
+        if (r->segs[j].len == 0) continue;
+        if (only) {
+            only = NULL;
+            break;
+        }
+        only = &r->segs[j];
+    }
+    if (only && only->own == only->ptr && only->len == sdslen(only->own)) {
+        s = only->own;
+        only->own = NULL;
+    } else {
+        s = sdsnewlen(SDS_NOINIT, r->len);
+        char *p = s;
+        for (size_t j = 0; j < r->count; j++) {
+            if (r->segs[j].len == 0) continue;
+            memcpy(p, r->segs[j].ptr, r->segs[j].len);
+            p += r->segs[j].len;
+        }
+    }
+    sdsropefree(r);
+    return s;
+}
 //=====================================================================//
 END_NAMESPACE(REDIS_BASE)
 //=====================================================================//
@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <sys/uio.h>
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
@@ -71,6 +72,55 @@ struct __attribute__ ((__packed__)) sdshdr64 {
     char buf[];
 };
 
+/* sds的增长策略，进程内所有sds共用，应在启动时设置 */
+typedef struct sdsGrowPolicy {
+    size_t max_prealloc;      // 贪婪模式下翻倍的上限，也是有界模式的预留上限
+    size_t large_div;         // 超过max_prealloc后多分配新长度/large_div，0表示固定多分配max_prealloc
+    size_t bounded_div;       // 有界模式下预留新长度/bounded_div
+    size_t sweep_min_free;    // sdsSweepFreeSpace回收的空闲空间下限
+} sdsGrowPolicy;
+
+/* 不持有内存的字符串视图，指向别处缓冲区中的一段字节（不一定以'\0'结尾）。
+ * 视图按值传递，创建、截取都不分配内存，缓冲区的生命周期由所有者保证。 */
+typedef struct sdsview {
+    const char *ptr;
+    size_t len;
+} sdsview;
+
+/* 带引用计数的共享缓冲区，持有一个sds，最后一个引用释放时一起释放 */
+typedef struct sdsshared {
+    long refcount;            // 引用计数，原子增减
+    sds buf;                  // 被共享的sds
+} sdsshared;
+
+/* 共享缓冲区上的切片，每个切片持有一个引用。切片按值保存，
+ * 在切片上再切片只增加引用计数，不复制数据也不分配内存 */
+typedef struct sdsslice {
+    sdsshared *shared;        // 所属的共享缓冲区，空切片为NULL
+    size_t offset;            // 在buf中的起始偏移
+    size_t len;               // 长度
+} sdsslice;
+
+/* sdsrope的一段：指向暂存块、持有的sds或借用的缓冲区中的一段字节 */
+typedef struct sdsropeseg {
+    const char *ptr;
+    size_t len;
+    sds own;                  // 该段持有的sds，释放rope时一起释放；借用的段和暂存块的后续段为NULL
+} sdsropeseg;
+
+/* 只追加的分块构建器，用来拼装大的回复。小段拷贝进固定大小的暂存块，
+ * 大段直接挂上sds或借用的缓冲区，已追加的数据从不移动，总拷贝量是O(n)。
+ * 结果可以用sdsropeiov按iovec数组交给writev（支持部分写），或用sdsropeflatten一次性拼成sds */
+typedef struct sdsrope {
+    sdsropeseg *segs;         // 段数组
+    size_t count;             // 段数
+    size_t cap;               // 段数组容量
+    size_t len;               // 总字节数
+    sds tail;                 // 当前暂存块，由引用它的第一段持有
+    size_t pos_seg;           // 已写出位置：段下标
+    size_t pos_off;           // 已写出位置：段内偏移
+} sdsrope;
+
 class sdsCreate
 {
 public:
@@ -214,11 +264,37 @@ public:
     *   如果分配失败返回 NULL
     * 
     */
-    // 执行扩容策略：
+    // 执行扩容策略（SDS_GROW_GREEDY）：
     // 小字符串按 2 倍扩容
-    // 大字符串按固定比例扩容
+    // 大字符串按sdsGrowPolicy的比例扩容
     // 必要时升级 SDS 类型
     sds sdsMakeRoomFor(sds s, size_t addlen);
+    /**
+     * 按指定的增长模式扩展空间
+     * @param s sds字符串
+     * @param addlen 需要额外容纳的字节数
+     * @param mode SDS_GROW_GREEDY、SDS_GROW_EXACT或SDS_GROW_BOUNDED
+     * @return 扩展后的sds，分配失败返回NULL
+     */
+    sds sdsMakeRoomForMode(sds s, size_t addlen, int mode);
+    /**
+     * 设置进程内的sds增长策略，不是线程安全的，应在启动时调用
+     * @param policy 新策略，为NULL时恢复默认值
+     */
+    static void sdsSetGrowPolicy(const sdsGrowPolicy *policy);
+    /**
+     * 获取当前的sds增长策略
+     * @param policy 输出参数
+     */
+    static void sdsGetGrowPolicy(sdsGrowPolicy *policy);
+    /**
+     * 回收一批空闲大缓冲区的预留空间，供定时任务调用（例如对空闲客户端的查询缓冲区）。
+     * 空闲空间不少于sweep_min_free的字符串调用sdsRemoveFreeSpace，strs中的指针原地更新
+     * @param strs sds指针数组，元素可为NULL
+     * @param count 元素个数
+     * @return 回收的字节数
+     */
+    size_t sdsSweepFreeSpace(sds *strs, size_t count);
     /**
      * 直接调整 SDS 字符串的长度（高级底层操作）
      * 
@@ -429,6 +505,210 @@ public:
      * @param s sds字符串
      */
     void sdsclear(sds s);
+public:
+    /**
+     * 生成指向sds全部内容的视图
+     * @param s sds字符串
+     * @return 视图
+     */
+    sdsview sdsviewfromsds(const sds s);
+    /**
+     * 生成指向任意缓冲区的视图
+     * @param p 缓冲区
+     * @param len 长度
+     * @return 视图
+     */
+    sdsview sdsviewlen(const void *p, size_t len);
+    /**
+     * 截取视图的子串，语义同sdssubstr，但不修改也不复制原数据
+     * @param v 视图
+     * @param start 起始位置
+     * @param len 子串长度，超出部分截断
+     * @return 子串视图
+     */
+    sdsview sdsviewsubstr(sdsview v, size_t start, size_t len);
+    /**
+     * 按闭区间截取视图，下标语义同sdsrange（负数从末尾算起）
+     * @param v 视图
+     * @param start 起始下标
+     * @param end 结束下标（包含）
+     * @return 子串视图
+     */
+    sdsview sdsviewrange(sdsview v, ssize_t start, ssize_t end);
+    /**
+     * 比较两个视图，语义同sdscmp
+     * @return 小于、等于、大于时分别返回负数、0、正数
+     */
+    int sdsviewcmp(sdsview a, sdsview b);
+    /**
+     * 按分隔符把视图切成若干子视图，不分配内存，分割规则同sdssplitlen
+     * @param v 视图
+     * @param sep 分隔符
+     * @param seplen 分隔符长度
+     * @param tokens 输出数组，只写入前maxtokens个
+     * @param maxtokens tokens的容量
+     * @return token总数（可能大于maxtokens，此时可以换更大的数组重试），参数错误返回-1
+     */
+    int sdssplitview(sdsview v, const char *sep, int seplen, sdsview *tokens, int maxtokens);
+    /**
+     * 用视图的内容创建新的sds（需要长期持有时才复制）
+     * @param v 视图
+     * @return 新的sds
+     */
+    sds sdsnewview(sdsview v);
+    /**
+     * 把视图的内容追加到sds末尾
+     * @param s 目标sds
+     * @param v 视图
+     * @return 追加后的sds
+     */
+    sds sdscatview(sds s, sdsview v);
+    /**
+     * 用视图的内容覆盖sds
+     * @param s 目标sds
+     * @param v 视图
+     * @return 复制后的sds
+     */
+    sds sdscpyview(sds s, sdsview v);
+    /**
+     * 把sds变为共享缓冲区，之后由引用计数管理，调用者不能再直接释放或修改s
+     * @param s sds字符串
+     * @return 引用计数为1的共享缓冲区
+     */
+    sdsshared *sdssharednew(sds s);
+    /**
+     * 增加共享缓冲区的引用
+     * @param sh 共享缓冲区
+     * @return sh
+     */
+    sdsshared *sdssharedretain(sdsshared *sh);
+    /**
+     * 释放一个引用，计数归零时释放缓冲区
+     * @param sh 共享缓冲区
+     */
+    void sdssharedrelease(sdsshared *sh);
+    /**
+     * 在共享缓冲区上创建切片（持有一个引用），start/len越界时截断
+     * @param sh 共享缓冲区
+     * @param start 起始偏移
+     * @param len 长度
+     * @return 切片
+     */
+    sdsslice sdsslicenew(sdsshared *sh, size_t start, size_t len);
+    /**
+     * 在切片上再截取一段，新切片与原切片共享同一个缓冲区，各自释放
+     * @param sl 原切片
+     * @param start 相对原切片的起始偏移
+     * @param len 长度
+     * @return 新切片
+     */
+    sdsslice sdsslicesub(const sdsslice *sl, size_t start, size_t len);
+    /**
+     * 切片内容的视图，在切片释放前有效
+     * @param sl 切片
+     * @return 视图
+     */
+    sdsview sdssliceview(const sdsslice *sl);
+    /**
+     * 释放切片持有的引用，并把切片置空
+     * @param sl 切片
+     */
+    void sdsslicefree(sdsslice *sl);
+    /**
+     * 初始化空的rope，不分配内存
+     * @param r rope
+     */
+    void sdsropeinit(sdsrope *r);
+    /**
+     * 释放rope持有的所有sds和段数组，之后r是空rope，可以继续使用
+     * @param r rope
+     */
+    void sdsropefree(sdsrope *r);
+    /**
+     * 拷贝一段数据追加到rope末尾
+     * @param r rope
+     * @param p 数据
+     * @param len 长度
+     */
+    void sdsropecatlen(sdsrope *r, const void *p, size_t len);
+    /**
+     * 追加一个借用的缓冲区，不拷贝；缓冲区要在rope写出或展开之前保持有效且不被修改。
+     * 短于SDS_ROPE_BORROW_MIN时仍然拷贝
+     * @param r rope
+     * @param p 缓冲区
+     * @param len 长度
+     */
+    void sdsropecatborrow(sdsrope *r, const void *p, size_t len);
+    /**
+     * 追加一个sds并接管其所有权，调用者之后不能再使用s
+     * @param r rope
+     * @param s sds字符串
+     */
+    void sdsropecatsds(sdsrope *r, sds s);
+    /**
+     * 追加RESP长度头，例如"*3\r\n"、"$5\r\n"
+     * @param r rope
+     * @param prefix 前缀字符
+     * @param n 长度
+     */
+    void sdsropecatlenhdr(sdsrope *r, char prefix, long long n);
+    /**
+     * 追加一个RESP bulk string："$len\r\n" + 数据 + "\r\n"，数据按sdsropecatlen拷贝
+     * @param r rope
+     * @param p 数据
+     * @param len 长度
+     */
+    void sdsropecatbulk(sdsrope *r, const void *p, size_t len);
+    /**
+     * 预留一个长度头的位置，元素个数事先未知时使用，之后用sdsropesetdeferredlen填写
+     * @param r rope
+     * @return 预留段的下标
+     */
+    size_t sdsropedeferlen(sdsrope *r);
+    /**
+     * 填写sdsropedeferlen预留的长度头，必须在写出该段之前调用
+     * @param r rope
+     * @param slot sdsropedeferlen的返回值
+     * @param prefix 前缀字符
+     * @param n 长度
+     */
+    void sdsropesetdeferredlen(sdsrope *r, size_t slot, char prefix, long long n);
+    /**
+     * rope的总字节数
+     * @param r rope
+     * @return 字节数
+     */
+    size_t sdsropelen(const sdsrope *r);
+    /**
+     * 尚未写出的字节数
+     * @param r rope
+     * @return 字节数
+     */
+    size_t sdsropepending(const sdsrope *r);
+    /**
+     * 从已写出位置开始填充iovec数组，供writev使用
+     * @param r rope
+     * @param iov 输出数组
+     * @param iovmax iov的容量
+     * @return 填充的元素个数，全部写出后返回0
+     */
+    int sdsropeiov(const sdsrope *r, struct iovec *iov, int iovmax);
+    /**
+     * writev写出nwritten字节后推进已写出位置
+     * @param r rope
+     * @param nwritten 写出的字节数，不能超过sdsropepending
+     */
+    void sdsropeconsume(sdsrope *r, size_t nwritten);
+    /**
+     * 把rope展开成一个sds（一次分配、一次拷贝），之后rope被清空。
+     * 只有一段且该段就是持有的整个sds时直接返回它，不拷贝
+     * @param r rope
+     * @return 包含全部内容的sds
+     */
+    sds sdsropeflatten(sdsrope *r);
+private:
+    sdsropeseg *sdsRopePushSeg(sdsrope *r, const char *ptr, size_t len, sds own);
+    char *sdsRopeScratch(sdsrope *r, size_t len);
 };
 //=====================================================================//
 END_NAMESPACE(REDIS_BASE)
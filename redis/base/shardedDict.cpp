@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/28
+ * All rights reserved. No one may copy or transfer.
+ * Description: 分片字典（sharded dict），供多线程访问同一个键空间。
+ */
+#define ZMALLOC_TAG ZMALLOC_TAG_DICT
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include "shardedDict.h"
+#include "zmallocDf.h"
+//=====================================================================//
+BEGIN_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+static dictionaryCreate shardDictCrt;
+
+/* dictGetRandomKey/dictGetSomeKeys用的梅森旋转随机数是全局状态，不同分片的锁
+ * 互不排斥，所以随机取键在分片锁内再持这把锁（加锁顺序：分片锁 -> 随机数锁） */
+static pthread_mutex_t shard_random_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* 选择分片用的线程局部xorshift，不需要加锁 */
+static __thread uint64_t shard_rand_state = 0;
+
+static uint64_t shardRandom(void)
+{
+    uint64_t x = shard_rand_state;
+    if (x == 0) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        x = ((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec) ^ (uint64_t)(uintptr_t)&shard_rand_state;
+        if (x == 0) x = 0x9e3779b97f4a7c15ULL;
+    }
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    shard_rand_state = x;
+    return x;
+}
+
+shardedDictionaryCreate::shardedDictionaryCreate()
+{
+}
+
+shardedDictionaryCreate::~shardedDictionaryCreate()
+{
+}
+
+dictShard *shardedDictionaryCreate::shardedDictShardForKey(shardedDict *sd, const void *key)
+{
+    uint64_t h = sd->type->hashFunction(key);
+    return &sd->shards[shardedDictShardOf(sd, h)];
+}
+
+/* 不加锁读取分片的元素数：后台rehash线程和其他分片的持锁者可能同时在改 */
+unsigned long shardedDictionaryCreate::shardedDictShardSize(dictShard *sh)
+{
+    return __atomic_load_n(&sh->d->ht[0].used, __ATOMIC_RELAXED) +
+           __atomic_load_n(&sh->d->ht[1].used, __ATOMIC_RELAXED);
+}
+
+/**
+ * 创建分片字典
+ * @param type 字典类型
+ * @param privDataPtr 私有数据指针
+ * @param numshards 分片数
+ * @return 分片字典指针
+ */
+shardedDict *shardedDictionaryCreate::shardedDictCreate(dictType *type, void *privDataPtr, unsigned long numshards)
+{
+    shardedDict *sd = static_cast<shardedDict*>(zmalloc(sizeof(*sd)));
+    unsigned long n = 1;
+    int bits = 0;
+
+    if (numshards == 0) numshards = DICT_SHARDS_DEFAULT;
+    if (numshards > DICT_SHARDS_MAX) numshards = DICT_SHARDS_MAX;
+    while (n < numshards) {
+        n <<= 1;
+        bits++;
+    }
+    sd->type = type;
+    sd->numshards = n;
+    sd->shardbits = bits;
+    /* 多分配一个缓存行，把分片数组对齐到64字节 */
+    sd->shards_alloc = zmalloc(n * sizeof(dictShard) + 64);
+    sd->shards = reinterpret_cast<dictShard*>(((uintptr_t)sd->shards_alloc + 63) & ~(uintptr_t)63);
+    for (unsigned long j = 0; j < n; j++) {
+        pthread_mutex_init(&sd->shards[j].lock, NULL);
+        sd->shards[j].d = shardDictCrt.dictCreate(type, privDataPtr);
+    }
+    return sd;
+}
+
+/**
+ * 释放分片字典
+ * @param sd 分片字典指针
+ */
+void shardedDictionaryCreate::shardedDictRelease(shardedDict *sd)
+{
+    for (unsigned long j = 0; j < sd->numshards; j++) {
+        shardDictCrt.dictRelease(sd->shards[j].d);
+        pthread_mutex_destroy(&sd->shards[j].lock);
+    }
+    zfree(sd->shards_alloc);
+    zfree(sd);
+}
+
+/**
+ * 按总元素数预分配各分片的哈希表
+ * @param sd 分片字典指针
+ * @param size 预计的总元素数
+ * @return 所有分片都能容纳时返回DICT_OK，否则返回DICT_ERR
+ */
+int shardedDictionaryCreate::shardedDictExpand(shardedDict *sd, unsigned long size)
+{
+    unsigned long per = size / sd->numshards + 1;
+    int ret = DICT_OK;
+    for (unsigned long j = 0; j < sd->numshards; j++) {
+        dictShard *sh = &sd->shards[j];
+        pthread_mutex_lock(&sh->lock);
+        /* 已经足够大时dictExpand也返回DICT_ERR，不算失败 */
+        if (shardDictCrt.dictExpand(sh->d, per) == DICT_ERR && dictSlots(sh->d) < per)
+            ret = DICT_ERR;
+        pthread_mutex_unlock(&sh->lock);
+    }
+    return ret;
+}
+
+/**
+ * 添加键值对
+ * @param sd 分片字典指针
+ * @param key 键
+ * @param val 值
+ * @return 成功返回DICT_OK，键已存在返回DICT_ERR
+ */
+int shardedDictionaryCreate::shardedDictAdd(shardedDict *sd, void *key, void *val)
+{
+    dictShard *sh = shardedDictShardForKey(sd, key);
+    pthread_mutex_lock(&sh->lock);
+    int ret = shardDictCrt.dictAdd(sh->d, key, val);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+/**
+ * 添加或替换键值对
+ * @param sd 分片字典指针
+ * @param key 键
+ * @param val 值
+ * @return 新增返回1，替换返回0
+ */
+int shardedDictionaryCreate::shardedDictReplace(shardedDict *sd, void *key, void *val)
+{
+    dictShard *sh = shardedDictShardForKey(sd, key);
+    pthread_mutex_lock(&sh->lock);
+    int ret = shardDictCrt.dictReplace(sh->d, key, val);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+/**
+ * 删除键并释放条目
+ * @param sd 分片字典指针
+ * @param key 键
+ * @return 成功返回DICT_OK，键不存在返回DICT_ERR
+ */
+int shardedDictionaryCreate::shardedDictDelete(shardedDict *sd, const void *key)
+{
+    dictShard *sh = shardedDictShardForKey(sd, key);
+    pthread_mutex_lock(&sh->lock);
+    int ret = shardDictCrt.dictDelete(sh->d, key);
+    pthread_mutex_unlock(&sh->lock);
+    return ret;
+}
+
+/**
+ * 查找键并在分片锁内取出值
+ * @param sd 分片字典指针
+ * @param key 键
+ * @return 找到返回值，否则返回NULL
+ */
+void *shardedDictionaryCreate::shardedDictFetchValue(shardedDict *sd, const void *key)
+{
+    dictShard *sh = shardedDictShardForKey(sd, key);
+    pthread_mutex_lock(&sh->lock);
+    dictEntry *he = shardDictCrt.dictFind(sh->d, key);
+    void *val = he ? dictGetVal(he) : NULL;
+    pthread_mutex_unlock(&sh->lock);
+    return val;
+}
+
+/**
+ * 锁住键所在的分片
+ * @param sd 分片字典指针
+ * @param key 键
+ * @return 键所在分片的dict
+ */
+dict *shardedDictionaryCreate::shardedDictLockKey(shardedDict *sd, const void *key)
+{
+    dictShard *sh = shardedDictShardForKey(sd, key);
+    pthread_mutex_lock(&sh->lock);
+    return sh->d;
+}
+
+/**
+ * 释放shardedDictLockKey加的锁
+ * @param sd 分片字典指针
+ * @param key 键
+ */
+void shardedDictionaryCreate::shardedDictUnlockKey(shardedDict *sd, const void *key)
+{
+    pthread_mutex_unlock(&shardedDictShardForKey(sd, key)->lock);
+}
+
+/**
+ * 获取元素总数
+ * @param sd 分片字典指针
+ * @return 元素总数
+ */
+unsigned long shardedDictionaryCreate::shardedDictSize(shardedDict *sd)
+{
+    unsigned long size = 0;
+    for (unsigned long j = 0; j < sd->numshards; j++)
+        size += shardedDictShardSize(&sd->shards[j]);
+    return size;
+}
+
+/**
+ * 随机取一个条目，在分片锁内交给回调
+ * @param sd 分片字典指针
+ * @param fn 条目回调
+ * @param privdata 回调的私有数据
+ * @return 取到返回1，为空时返回0
+ */
+int shardedDictionaryCreate::shardedDictGetRandomKey(shardedDict *sd, dictScanFunction *fn, void *privdata)
+{
+    unsigned long total;
+
+    /* 按元素数加权选分片；计数是不加锁读的，选中的分片在加锁前被清空时重新选 */
+    while ((total = shardedDictSize(sd)) != 0) {
+        unsigned long r = shardRandom() % total;
+        for (unsigned long j = 0; j < sd->numshards; j++) {
+            dictShard *sh = &sd->shards[j];
+            unsigned long size = shardedDictShardSize(sh);
+            if (r >= size) {
+                r -= size;
+                continue;
+            }
+            pthread_mutex_lock(&sh->lock);
+            pthread_mutex_lock(&shard_random_mutex);
+            dictEntry *he = shardDictCrt.dictGetRandomKey(sh->d);
+            pthread_mutex_unlock(&shard_random_mutex);
+            if (he) fn(privdata, he);
+            pthread_mutex_unlock(&sh->lock);
+            if (he) return 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 随机采样若干条目，在分片锁内逐个交给回调
+ * @param sd 分片字典指针
+ * @param count 采样数
+ * @param fn 条目回调
+ * @param privdata 回调的私有数据
+ * @return 实际采到的条目数
+ */
+unsigned int shardedDictionaryCreate::shardedDictGetSomeKeys(shardedDict *sd, unsigned int count,
+                                                             dictScanFunction *fn, void *privdata)
+{
+    unsigned long total = shardedDictSize(sd);
+    unsigned long start = shardRandom() & (sd->numshards - 1);
+    unsigned int stored = 0;
+
+    if (total == 0 || count == 0) return 0;
+    if (total < count) count = total;
+    dictEntry **des = static_cast<dictEntry**>(zmalloc(sizeof(dictEntry*) * count));
+
+    /* 从随机分片开始，每个分片分到与元素数成比例的份额（向上取整） */
+    for (unsigned long j = 0; j < sd->numshards && stored < count; j++) {
+        dictShard *sh = &sd->shards[(start + j) & (sd->numshards - 1)];
+        unsigned long size = shardedDictShardSize(sh);
+        if (size == 0) continue;
+        unsigned long want = (count * size + total - 1) / total;
+        if (want > count - stored) want = count - stored;
+        pthread_mutex_lock(&sh->lock);
+        pthread_mutex_lock(&shard_random_mutex);
+        unsigned int got = shardDictCrt.dictGetSomeKeys(sh->d, des, want);
+        pthread_mutex_unlock(&shard_random_mutex);
+        for (unsigned int k = 0; k < got; k++) fn(privdata, des[k]);
+        pthread_mutex_unlock(&sh->lock);
+        stored += got;
+    }
+    zfree(des);
+    return stored;
+}
+
+/**
+ * 跨分片扫描
+ * @param sd 分片字典指针
+ * @param v 游标
+ * @param fn 元素回调
+ * @param bucketfn 桶回调
+ * @param privdata 回调的私有数据
+ * @return 下一次调用的游标，0表示结束
+ */
+unsigned long shardedDictionaryCreate::shardedDictScan(shardedDict *sd, unsigned long v, dictScanFunction *fn,
+                                                       dictScanBucketFunction *bucketfn, void *privdata)
+{
+    unsigned long s = v & (sd->numshards - 1);
+    unsigned long inner = v >> sd->shardbits;
+
+    while (s < sd->numshards) {
+        dictShard *sh = &sd->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        int empty = dictSize(sh->d) == 0;
+        inner = shardDictCrt.dictScan(sh->d, inner, fn, bucketfn, privdata);
+        pthread_mutex_unlock(&sh->lock);
+        if (inner) return (inner << sd->shardbits) | s;
+        s++;
+        /* 空分片直接跳过，访问过非空分片的最后一个桶就返回 */
+        if (!empty) break;
+    }
+    return s == sd->numshards ? 0 : s;
+}
+
+/**
+ * 逐个分片清空
+ * @param sd 分片字典指针
+ * @param callback 清空时调用的回调函数
+ */
+void shardedDictionaryCreate::shardedDictEmpty(shardedDict *sd, void(callback)(void*))
+{
+    for (unsigned long j = 0; j < sd->numshards; j++) {
+        dictShard *sh = &sd->shards[j];
+        pthread_mutex_lock(&sh->lock);
+        shardDictCrt.dictEmpty(sh->d, callback);
+        pthread_mutex_unlock(&sh->lock);
+    }
+}
+
+//=====================================================================//
+END_NAMESPACE(REDIS_BASE)
+//=====================================================================//
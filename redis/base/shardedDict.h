@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/28
+ * All rights reserved. No one may copy or transfer.
+ * Description: 分片字典（sharded dict），供多线程访问同一个键空间。
+ * 由N个互相独立的dict组成，每个分片一把互斥锁，键按哈希值的高位路由到分片
+ * （dict内部用低位选桶，两者互不相关）。单键操作只锁一个分片，不同分片上的
+ * 操作可以并行；跨分片的dictScan、dictGetSomeKeys、dictGetRandomKey逐个分片
+ * 加锁，语义与单个dict相同。条目只在分片锁内有效，所以不提供返回条目指针的接口：
+ * 单键用shardedDictFetchValue或shardedDictLockKey，采样和扫描在锁内回调。
+ */
+#ifndef REDIS_BASE_SHARDEDDICT_H
+#define REDIS_BASE_SHARDEDDICT_H
+#include "define.h"
+#include "dict.h"
+#include <pthread.h>
+//=====================================================================//
+BEGIN_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+
+/**
+ * 分片：一把锁和一个dict，按缓存行对齐，相邻分片的锁不会伪共享
+ */
+typedef struct dictShard {
+    pthread_mutex_t lock;     // 分片锁，保护d及其中的所有条目
+    dict *d;                  // 分片内的字典
+    char pad[64 - (sizeof(pthread_mutex_t) + sizeof(dict*)) % 64];
+} dictShard;
+
+/**
+ * 分片字典
+ */
+typedef struct shardedDict {
+    dictType *type;           // 所有分片共用的字典类型
+    dictShard *shards;        // 分片数组（按64字节对齐）
+    void *shards_alloc;       // 分片数组的原始分配地址
+    unsigned long numshards;  // 分片数（2的幂）
+    int shardbits;            // log2(numshards)，分片号取混合后哈希值的高shardbits位
+} shardedDict;
+
+class shardedDictionaryCreate
+{
+public:
+    shardedDictionaryCreate();
+    ~shardedDictionaryCreate();
+public:
+        /**
+         * 创建分片字典
+         * @param type 字典类型，hashFunction用于路由，所有分片共用
+         * @param privDataPtr 私有数据指针（传递给回调函数）
+         * @param numshards 分片数，向上取整到2的幂，0表示DICT_SHARDS_DEFAULT，不超过DICT_SHARDS_MAX
+         * @return 分片字典指针
+         */
+        shardedDict *shardedDictCreate(dictType *type, void *privDataPtr, unsigned long numshards);
+
+        /**
+         * 释放分片字典及其中的所有元素，调用时不能有其他线程在访问
+         * @param sd 分片字典指针
+         */
+        void shardedDictRelease(shardedDict *sd);
+
+        /**
+         * 按总元素数预分配各分片的哈希表
+         * @param sd 分片字典指针
+         * @param size 预计的总元素数
+         * @return 所有分片都能容纳时返回DICT_OK，否则返回DICT_ERR
+         */
+        int shardedDictExpand(shardedDict *sd, unsigned long size);
+
+        /**
+         * 添加键值对
+         * @param sd 分片字典指针
+         * @param key 键
+         * @param val 值
+         * @return 成功返回DICT_OK，键已存在返回DICT_ERR
+         */
+        int shardedDictAdd(shardedDict *sd, void *key, void *val);
+
+        /**
+         * 添加或替换键值对
+         * @param sd 分片字典指针
+         * @param key 键
+         * @param val 值
+         * @return 新增返回1，替换返回0
+         */
+        int shardedDictReplace(shardedDict *sd, void *key, void *val);
+
+        /**
+         * 删除键并释放条目
+         * @param sd 分片字典指针
+         * @param key 键
+         * @return 成功返回DICT_OK，键不存在返回DICT_ERR
+         */
+        int shardedDictDelete(shardedDict *sd, const void *key);
+
+        /**
+         * 查找键并在分片锁内取出值
+         * @param sd 分片字典指针
+         * @param key 键
+         * @return 找到返回值，否则返回NULL
+         */
+        void *shardedDictFetchValue(shardedDict *sd, const void *key);
+
+        /**
+         * 锁住键所在的分片并返回其中的dict，之后可以用dictionaryCreate的接口在该dict上
+         * 做复合操作，完成后调用shardedDictUnlockKey。条目指针（如dictFind的结果）
+         * 只在持锁期间有效，解锁后其他线程可能删除或替换它
+         * @param sd 分片字典指针
+         * @param key 键
+         * @return 键所在分片的dict
+         */
+        dict *shardedDictLockKey(shardedDict *sd, const void *key);
+
+        /**
+         * 释放shardedDictLockKey加的锁
+         * @param sd 分片字典指针
+         * @param key 键（与加锁时相同）
+         */
+        void shardedDictUnlockKey(shardedDict *sd, const void *key);
+
+        /**
+         * 获取元素总数。各分片的计数不加锁读取，并发修改时是近似值
+         * @param sd 分片字典指针
+         * @return 元素总数
+         */
+        unsigned long shardedDictSize(shardedDict *sd);
+
+        /**
+         * 随机取一个条目，按分片的元素数加权选择分片，每个元素被选中的概率与单个dict相同。
+         * 条目只在回调期间有效：回调在分片锁内执行，需要的键值在回调里拷贝出来，
+         * 不能再访问同一个分片字典
+         * @param sd 分片字典指针
+         * @param fn 条目回调
+         * @param privdata 回调的私有数据
+         * @return 取到返回1，为空时返回0
+         */
+        int shardedDictGetRandomKey(shardedDict *sd, dictScanFunction *fn, void *privdata);
+
+        /**
+         * 随机采样若干条目，count按元素数分摊到各分片，可能有重复，也可能少于count。
+         * 回调的约束同shardedDictGetRandomKey
+         * @param sd 分片字典指针
+         * @param count 采样数
+         * @param fn 条目回调，每个采到的条目调用一次
+         * @param privdata 回调的私有数据
+         * @return 实际采到的条目数
+         */
+        unsigned int shardedDictGetSomeKeys(shardedDict *sd, unsigned int count,
+                                            dictScanFunction *fn, void *privdata);
+
+        /**
+         * 跨分片扫描。游标低shardbits位是分片号，其余位是分片内dictScan的游标；
+         * 从0开始，返回0表示结束，保证整个扫描期间都存在的元素至少返回一次。
+         * 回调在分片锁内执行，不能再访问同一个分片字典
+         * @param sd 分片字典指针
+         * @param v 游标
+         * @param fn 元素回调
+         * @param bucketfn 桶回调（可为NULL）
+         * @param privdata 回调的私有数据
+         * @return 下一次调用的游标
+         */
+        unsigned long shardedDictScan(shardedDict *sd, unsigned long v, dictScanFunction *fn,
+                                      dictScanBucketFunction *bucketfn, void *privdata);
+
+        /**
+         * 逐个分片清空
+         * @param sd 分片字典指针
+         * @param callback 清空时调用的回调函数（可为NULL）
+         */
+        void shardedDictEmpty(shardedDict *sd, void(callback)(void*));
+private:
+        dictShard *shardedDictShardForKey(shardedDict *sd, const void *key);
+        unsigned long shardedDictShardSize(dictShard *sh);
+};
+
+//=====================================================================//
+END_NAMESPACE(REDIS_BASE)
+//=====================================================================//
+#endif
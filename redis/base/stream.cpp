@@ -4,6 +4,7 @@
  * All rights reserved. No one may copy or transfer.
  * Description: 久化的、有序的、支持多播的消息队列，适合用于实现消息队列（MQ）系统、事件溯源、实时数据分析等场景
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_STREAM
 #include "stream.h"
 #include "sds.h"
 #include "redisObject.h"
@@ -234,6 +235,75 @@ size_t streamCreate::streamReplyWithRange(client *c, stream *s, streamID *start,
     // return arraylen;
 }
 
+/**
+ * 追加一个RESP bulk string，内容不在迭代器的整数缓冲区里时可以借用
+ * 
+ * @param sc     sds接口
+ * @param r      输出rope
+ * @param p      数据
+ * @param len    长度
+ * @param intbuf 迭代器存放整数转换结果的缓冲区
+ * @param borrow 是否借用
+ */
+static void streamRopeCatBulk(sdsCreate *sc, sdsrope *r, const unsigned char *p, int64_t len,
+                              const unsigned char *intbuf, int borrow)
+{
+    sc->sdsropecatlenhdr(r, '$', len);
+    if (borrow && p != intbuf)
+        sc->sdsropecatborrow(r, p, len);
+    else
+        sc->sdsropecatlen(r, p, len);
+    sc->sdsropecatlen(r, "\r\n", 2);
+}
+
+/**
+ * 把Stream指定范围内的消息按XRANGE的回复格式追加到rope
+ * 
+ * @param s      Stream对象
+ * @param start  起始消息ID（包含，可为NULL）
+ * @param end    结束消息ID（包含，可为NULL）
+ * @param count  返回的最大消息数量，0表示不限
+ * @param rev    是否反向遍历
+ * @param r      输出rope
+ * @param borrow 是否借用listpack中的内存
+ * @return 追加的消息数量
+ */
+size_t streamCreate::streamRangeToRope(stream *s, streamID *start, streamID *end, size_t count, int rev,
+                                       sdsrope *r, int borrow)
+{
+    streamIterator si;
+    streamID id;
+    int64_t numfields;
+    size_t arraylen = 0;
+    char idbuf[SDS_LLSTR_SIZE*2];
+
+    size_t slot = sdsCreateInstance->sdsropedeferlen(r);
+    streamIteratorStart(&si,s,start,end,rev);
+    while (streamIteratorGetID(&si,&id,&numfields)) {
+        /* 与streamReplyWithRange相同：每条消息是[ID, [field, value, ...]] */
+        int idlen = toolFunc::ull2string(idbuf,SDS_LLSTR_SIZE,id.ms);
+        idbuf[idlen++] = '-';
+        idlen += toolFunc::ull2string(idbuf+idlen,SDS_LLSTR_SIZE,id.seq);
+        sdsCreateInstance->sdsropecatlenhdr(r,'*',2);
+        sdsCreateInstance->sdsropecatbulk(r,idbuf,idlen);
+        sdsCreateInstance->sdsropecatlenhdr(r,'*',numfields*2);
+
+        while (numfields--) {
+            unsigned char *key, *value;
+            int64_t key_len, value_len;
+            streamIteratorGetField(&si,&key,&value,&key_len,&value_len);
+            streamRopeCatBulk(sdsCreateInstance,r,key,key_len,si.field_buf,borrow);
+            streamRopeCatBulk(sdsCreateInstance,r,value,value_len,si.value_buf,borrow);
+        }
+
+        arraylen++;
+        if (count && count == arraylen) break;
+    }
+    streamIteratorStop(&si);
+    sdsCreateInstance->sdsropesetdeferredlen(r,slot,'*',(long long)arraylen);
+    return arraylen;
+}
+
 /**
  * 初始化一个Stream迭代器
  * 
@@ -760,7 +830,7 @@ robj *streamCreate::streamDup(robj *o)
     {
         lp =static_cast<unsigned char*>(ri.data);
         lp_bytes = listPackCreateInstance->lpBytes(lp);
-        unsigned char *new_lp =static_cast<unsigned char*>(zmalloc(lp_bytes));
+        unsigned char *new_lp =static_cast<unsigned char*>(zmalloc_tag(lp_bytes, ZMALLOC_TAG_LISTPACK));
         memcpy(new_lp, lp, lp_bytes);
         memcpy(rax_key, ri.key, sizeof(rax_key));
         raxCreateInstance->raxInsert(new_s->raxl, (unsigned char *)&rax_key, sizeof(rax_key),
@@ -1298,7 +1368,7 @@ void streamCreate::streamFreeCG(streamCG *cg)
  */
 void streamCreate::lpFree(unsigned char *lp)
 {
-    zfree(lp);
+    zfree_tag(lp, ZMALLOC_TAG_LISTPACK);
 }
 
 /**
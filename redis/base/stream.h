@@ -18,6 +18,7 @@ class redisObject;
 typedef class redisObject robj;
 class toolFunc;
 class redisObjectCreate;
+struct sdsrope;
 typedef struct streamID {
     uint64_t ms;        /* Unix time in milliseconds. */
     uint64_t seq;       /* Sequence number. */
@@ -164,6 +165,23 @@ public:
                             size_t count, int rev, streamCG *group, streamConsumer *consumer, 
                             int flags, streamPropInfo *spi);
 
+    /**
+     * 把Stream指定范围内的消息按XRANGE的回复格式追加到rope，数组长度先预留再回填。
+     * borrow非0时字符串形式的字段和值直接借用listpack中的内存，不拷贝，
+     * 此时在rope写出之前不能修改该Stream
+     * 
+     * @param s      Stream对象
+     * @param start  起始消息ID（包含，可为NULL）
+     * @param end    结束消息ID（包含，可为NULL）
+     * @param count  返回的最大消息数量，0表示不限
+     * @param rev    是否反向遍历
+     * @param r      输出rope
+     * @param borrow 是否借用listpack中的内存
+     * @return 追加的消息数量
+     */
+    size_t streamRangeToRope(stream *s, streamID *start, streamID *end, size_t count, int rev,
+                             sdsrope *r, int borrow);
+
     /**
      * 初始化一个Stream迭代器
      * 
@@ -392,31 +392,59 @@ char *toolFunc::memmapchars(char *s, size_t len, const char *from, const char *t
     return s;
 }
 
+/* 十进制两位一组的字符表，"00" "01" ... "99" */
+static const char toolDigitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t toolPow10[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* 把n（n < 10^len，len为1..8）按len位写到dst，高位补0。
+ * jeaiii的做法：n乘以2^48/100^k（向上取整）得到一个定点小数，整数部分是最高的一或两位，
+ * 之后每乘一次100，整数部分就是下一组两位数字。整个过程只有一次乘法加若干次乘100，
+ * 没有除法；n < 10^8时舍入误差小于1/100^3，不会影响最后一组 */
+static inline void toolWriteDigits(char *dst, uint32_t n, uint32_t len)
+{
+    static const uint64_t mask = (1ULL << 48) - 1;
+    static const uint64_t scale[4] = {
+        1ULL << 48, (1ULL << 48) / 100 + 1, (1ULL << 48) / 10000 + 1, (1ULL << 48) / 1000000 + 1
+    };
+    uint32_t pairs = (len - 1) / 2;
+    uint64_t t = (uint64_t)n * scale[pairs];
+
+    if (len & 1) {
+        *dst++ = '0' + (char)(t >> 48);
+    } else {
+        memcpy(dst, toolDigitPairs + (t >> 48) * 2, 2);
+        dst += 2;
+    }
+    while (pairs--) {
+        t = (t & mask) * 100;
+        memcpy(dst, toolDigitPairs + (t >> 48) * 2, 2);
+        dst += 2;
+    }
+}
+
 /* Return the number of digits of 'v' when converted to string in radix 10.
  * See ll2string() for more information. */
 /**
- * 计算无符号64位整数的十进制位数
+ * 计算无符号64位整数的十进制位数。
+ * 用最高有效位估算log10（bits*1233>>12约等于bits*log10(2)），再和10的幂比较一次修正
  * @param v 输入值
  * @return 十进制位数
  */
 uint32_t toolFunc::digits10(uint64_t v) {
-    if (v < 10) return 1;
-    if (v < 100) return 2;
-    if (v < 1000) return 3;
-    if (v < 1000000000000UL) {
-        if (v < 100000000UL) {
-            if (v < 1000000) {
-                if (v < 10000) return 4;
-                return 5 + (v >= 100000);
-            }
-            return 7 + (v >= 10000000UL);
-        }
-        if (v < 10000000000UL) {
-            return 9 + (v >= 1000000000UL);
-        }
-        return 11 + (v >= 100000000000UL);
-    }
-    return 12 + digits10(v / 1000000000000UL);
+    v |= 1; /* 0按1位计；10的幂都是偶数，或上1不改变比较结果 */
+    uint32_t t = ((64 - __builtin_clzll(v)) * 1233) >> 12;
+    return t + (v >= toolPow10[t]);
 }
 
 /* Like digits10() but for signed values. */
@@ -436,31 +464,40 @@ uint32_t toolFunc::sdigits10(int64_t v) {
     }
 }
 
+/**
+ * 把无符号整数写成十进制，按8位一段拆开（除以10^8是常数除法，编译成乘法），
+ * 每段用toolWriteDigits输出
+ * @param dst 输出缓冲区，至少digits10(value)+1字节
+ * @param value 输入值
+ * @param length digits10(value)
+ */
+static void toolUllToDigits(char *dst, uint64_t value, uint32_t length)
+{
+    if (length <= 8) {
+        toolWriteDigits(dst, (uint32_t)value, length);
+    } else if (length <= 16) {
+        toolWriteDigits(dst, (uint32_t)(value / 100000000), length - 8);
+        toolWriteDigits(dst + length - 8, (uint32_t)(value % 100000000), 8);
+    } else {
+        uint64_t high = value / 100000000;
+        toolWriteDigits(dst, (uint32_t)(high / 100000000), length - 16);
+        toolWriteDigits(dst + length - 16, (uint32_t)(high % 100000000), 8);
+        toolWriteDigits(dst + length - 8, (uint32_t)(value % 100000000), 8);
+    }
+    dst[length] = '\0';
+}
+
 /* Convert a long long into a string. Returns the number of
  * characters needed to represent the number.
- * If the buffer is not big enough to store the string, 0 is returned.
- *
- * Based on the following article (that apparently does not provide a
- * novel approach but only publicizes an already used technique):
- *
- * https://www.facebook.com/notes/facebook-engineering/three-optimization-tips-for-c/10151361643253920
- *
- * Modified in order to handle signed integers since the original code was
- * designed for unsigned integers. */
+ * If the buffer is not big enough to store the string, 0 is returned. */
 /**
  * 将long long类型整数转换为字符串
  * @param s 输出缓冲区
  * @param len 缓冲区长度
  * @param value 输入值
- * @return 写入的字符数，失败返回-1
+ * @return 写入的字符数，缓冲区不够返回0
  */
 int toolFunc::ll2string(char *dst, size_t dstlen, long long svalue) {
-    static const char digits[201] =
-        "0001020304050607080910111213141516171819"
-        "2021222324252627282930313233343536373839"
-        "4041424344454647484950515253545556575859"
-        "6061626364656667686970717273747576777879"
-        "8081828384858687888990919293949596979899";
     int negative;
     unsigned long long value;
 
@@ -479,32 +516,27 @@ int toolFunc::ll2string(char *dst, size_t dstlen, long long svalue) {
     }
 
     /* Check length. */
-    uint32_t const length = digits10(value)+negative;
+    uint32_t const digits = digits10(value);
+    uint32_t const length = digits+negative;
     if (length >= dstlen) return 0;
 
-    /* Null term. */
-    uint32_t next = length;
-    dst[next] = '\0';
-    next--;
-    while (value >= 100) {
-        int const i = (value % 100) * 2;
-        value /= 100;
-        dst[next] = digits[i + 1];
-        dst[next - 1] = digits[i];
-        next -= 2;
-    }
-
-    /* Handle last 1-2 digits. */
-    if (value < 10) {
-        dst[next] = '0' + (uint32_t) value;
-    } else {
-        int i = (uint32_t) value * 2;
-        dst[next] = digits[i + 1];
-        dst[next - 1] = digits[i];
-    }
-
     /* Add sign. */
     if (negative) dst[0] = '-';
+    toolUllToDigits(dst+negative, value, digits);
+    return length;
+}
+
+/**
+ * 将unsigned long long类型整数转换为字符串
+ * @param dst 输出缓冲区
+ * @param dstlen 缓冲区长度
+ * @param value 输入值
+ * @return 写入的字符数，缓冲区不够返回0
+ */
+int toolFunc::ull2string(char *dst, size_t dstlen, unsigned long long value) {
+    uint32_t const length = digits10(value);
+    if (length >= dstlen) return 0;
+    toolUllToDigits(dst, value, length);
     return length;
 }
 
@@ -707,17 +739,301 @@ int toolFunc::string2d(const char *s, size_t slen, double *dp) {
     return 1;
 }
 
+/* Grisu2（Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers"）：用64位整数运算求出落在舍入区间内的最短十进制数字串。
+ * 输出总能被strtod还原成同一个double；极少数情况下比最短表示多一位。
+ * 缓存的10的幂：10^(-348+8i) ≈ frac * 2^exp，frac规格化到最高位为1 */
+typedef struct toolDiyFp {
+    uint64_t frac;
+    int exp;
+} toolDiyFp;
+
+#define TOOL_GRISU_FIRST_POWER (-348)
+#define TOOL_GRISU_STEP_POWERS 8
+#define TOOL_GRISU_EXP_MIN (-60)
+#define TOOL_GRISU_EXP_MAX (-32)
+#define TOOL_DBL_FRAC_MASK 0x000FFFFFFFFFFFFFULL
+#define TOOL_DBL_EXP_MASK 0x7FF0000000000000ULL
+#define TOOL_DBL_HIDDEN_BIT 0x0010000000000000ULL
+#define TOOL_DBL_EXP_BIAS (1023 + 52)
+
+static const toolDiyFp toolCachedPow10[] = {
+    {0xfa8fd5a0081c0288ULL, -1220},
+    {0xbaaee17fa23ebf76ULL, -1193},
+    {0x8b16fb203055ac76ULL, -1166},
+    {0xcf42894a5dce35eaULL, -1140},
+    {0x9a6bb0aa55653b2dULL, -1113},
+    {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060},
+    {0xff77b1fcbebcdc4fULL, -1034},
+    {0xbe5691ef416bd60cULL, -1007},
+    {0x8dd01fad907ffc3cULL,  -980},
+    {0xd3515c2831559a83ULL,  -954},
+    {0x9d71ac8fada6c9b5ULL,  -927},
+    {0xea9c227723ee8bcbULL,  -901},
+    {0xaecc49914078536dULL,  -874},
+    {0x823c12795db6ce57ULL,  -847},
+    {0xc21094364dfb5637ULL,  -821},
+    {0x9096ea6f3848984fULL,  -794},
+    {0xd77485cb25823ac7ULL,  -768},
+    {0xa086cfcd97bf97f4ULL,  -741},
+    {0xef340a98172aace5ULL,  -715},
+    {0xb23867fb2a35b28eULL,  -688},
+    {0x84c8d4dfd2c63f3bULL,  -661},
+    {0xc5dd44271ad3cdbaULL,  -635},
+    {0x936b9fcebb25c996ULL,  -608},
+    {0xdbac6c247d62a584ULL,  -582},
+    {0xa3ab66580d5fdaf6ULL,  -555},
+    {0xf3e2f893dec3f126ULL,  -529},
+    {0xb5b5ada8aaff80b8ULL,  -502},
+    {0x87625f056c7c4a8bULL,  -475},
+    {0xc9bcff6034c13053ULL,  -449},
+    {0x964e858c91ba2655ULL,  -422},
+    {0xdff9772470297ebdULL,  -396},
+    {0xa6dfbd9fb8e5b88fULL,  -369},
+    {0xf8a95fcf88747d94ULL,  -343},
+    {0xb94470938fa89bcfULL,  -316},
+    {0x8a08f0f8bf0f156bULL,  -289},
+    {0xcdb02555653131b6ULL,  -263},
+    {0x993fe2c6d07b7facULL,  -236},
+    {0xe45c10c42a2b3b06ULL,  -210},
+    {0xaa242499697392d3ULL,  -183},
+    {0xfd87b5f28300ca0eULL,  -157},
+    {0xbce5086492111aebULL,  -130},
+    {0x8cbccc096f5088ccULL,  -103},
+    {0xd1b71758e219652cULL,   -77},
+    {0x9c40000000000000ULL,   -50},
+    {0xe8d4a51000000000ULL,   -24},
+    {0xad78ebc5ac620000ULL,     3},
+    {0x813f3978f8940984ULL,    30},
+    {0xc097ce7bc90715b3ULL,    56},
+    {0x8f7e32ce7bea5c70ULL,    83},
+    {0xd5d238a4abe98068ULL,   109},
+    {0x9f4f2726179a2245ULL,   136},
+    {0xed63a231d4c4fb27ULL,   162},
+    {0xb0de65388cc8ada8ULL,   189},
+    {0x83c7088e1aab65dbULL,   216},
+    {0xc45d1df942711d9aULL,   242},
+    {0x924d692ca61be758ULL,   269},
+    {0xda01ee641a708deaULL,   295},
+    {0xa26da3999aef774aULL,   322},
+    {0xf209787bb47d6b85ULL,   348},
+    {0xb454e4a179dd1877ULL,   375},
+    {0x865b86925b9bc5c2ULL,   402},
+    {0xc83553c5c8965d3dULL,   428},
+    {0x952ab45cfa97a0b3ULL,   455},
+    {0xde469fbd99a05fe3ULL,   481},
+    {0xa59bc234db398c25ULL,   508},
+    {0xf6c69a72a3989f5cULL,   534},
+    {0xb7dcbf5354e9beceULL,   561},
+    {0x88fcf317f22241e2ULL,   588},
+    {0xcc20ce9bd35c78a5ULL,   614},
+    {0x98165af37b2153dfULL,   641},
+    {0xe2a0b5dc971f303aULL,   667},
+    {0xa8d9d1535ce3b396ULL,   694},
+    {0xfb9b7cd9a4a7443cULL,   720},
+    {0xbb764c4ca7a44410ULL,   747},
+    {0x8bab8eefb6409c1aULL,   774},
+    {0xd01fef10a657842cULL,   800},
+    {0x9b10a4e5e9913129ULL,   827},
+    {0xe7109bfba19c0c9dULL,   853},
+    {0xac2820d9623bf429ULL,   880},
+    {0x80444b5e7aa7cf85ULL,   907},
+    {0xbf21e44003acdd2dULL,   933},
+    {0x8e679c2f5e44ff8fULL,   960},
+    {0xd433179d9c8cb841ULL,   986},
+    {0x9e19db92b4e31ba9ULL,  1013},
+    {0xeb96bf6ebadf77d9ULL,  1039},
+    {0xaf87023b9bf0ee6bULL,  1066},
+};
+
+static toolDiyFp toolFindCachedPow10(int exp, int *k)
+{
+    const double one_log_ten = 0.30102999566398114;
+    int approx = (int)(-(exp + 87) * one_log_ten);
+    int idx = (approx - TOOL_GRISU_FIRST_POWER) / TOOL_GRISU_STEP_POWERS;
+
+    while (1) {
+        int current = exp + toolCachedPow10[idx].exp + 64;
+        if (current < TOOL_GRISU_EXP_MIN) {
+            idx++;
+            continue;
+        }
+        if (current > TOOL_GRISU_EXP_MAX) {
+            idx--;
+            continue;
+        }
+        *k = TOOL_GRISU_FIRST_POWER + idx * TOOL_GRISU_STEP_POWERS;
+        return toolCachedPow10[idx];
+    }
+}
+
+/* 两个64位定点数相乘，保留高64位并四舍五入 */
+static inline toolDiyFp toolDiyFpMultiply(toolDiyFp a, toolDiyFp b)
+{
+    unsigned __int128 p = (unsigned __int128)a.frac * b.frac;
+    toolDiyFp r = {(uint64_t)(p >> 64) + ((uint64_t)p >> 63), a.exp + b.exp + 64};
+    return r;
+}
+
+/* 在不越出舍入区间的前提下，把最后一位往w靠近 */
+static void toolGrisuRound(char *digits, int ndigits, uint64_t delta, uint64_t rem, uint64_t kappa, uint64_t frac)
+{
+    while (rem < frac && delta - rem >= kappa &&
+           (rem + kappa < frac || frac - rem > rem + kappa - frac)) {
+        digits[ndigits - 1]--;
+        rem += kappa;
+    }
+}
+
+static int toolGrisuDigits(toolDiyFp w, toolDiyFp upper, toolDiyFp lower, char *digits, int *K)
+{
+    uint64_t wfrac = upper.frac - w.frac;
+    uint64_t delta = upper.frac - lower.frac;
+    int shift = -upper.exp;
+    uint64_t one = 1ULL << shift;
+    uint64_t part1 = upper.frac >> shift;
+    uint64_t part2 = upper.frac & (one - 1);
+    int idx = 0, kappa = 10;
+
+    /* 整数部分：part1 < 2^32，最多10位 */
+    for (const uint64_t *divp = toolPow10 + 9; kappa > 0; divp--) {
+        uint64_t div = *divp;
+        unsigned digit = (unsigned)(part1 / div);
+        if (digit || idx) digits[idx++] = (char)('0' + digit);
+        part1 -= digit * div;
+        kappa--;
+        uint64_t tmp = (part1 << shift) + part2;
+        if (tmp <= delta) {
+            *K += kappa;
+            toolGrisuRound(digits, idx, delta, tmp, div << shift, wfrac);
+            return idx;
+        }
+    }
+    /* 小数部分 */
+    const uint64_t *unit = toolPow10 + 1;
+    while (1) {
+        part2 *= 10;
+        delta *= 10;
+        kappa--;
+        unsigned digit = (unsigned)(part2 >> shift);
+        if (digit || idx) digits[idx++] = (char)('0' + digit);
+        part2 &= one - 1;
+        if (part2 < delta) {
+            *K += kappa;
+            toolGrisuRound(digits, idx, delta, part2, one, wfrac * *unit);
+            return idx;
+        }
+        unit++;
+    }
+}
+
+/* 把有限的非零正数v转成最短数字串，值为digits * 10^K，返回位数 */
+static int toolGrisu2(double v, char *digits, int *K)
+{
+    uint64_t bits;
+    toolDiyFp w, upper, lower, cp;
+    int k;
+
+    memcpy(&bits, &v, sizeof(bits));
+    w.frac = bits & TOOL_DBL_FRAC_MASK;
+    w.exp = (int)((bits & TOOL_DBL_EXP_MASK) >> 52);
+    if (w.exp) {
+        w.frac += TOOL_DBL_HIDDEN_BIT;
+        w.exp -= TOOL_DBL_EXP_BIAS;
+    } else {
+        w.exp = -TOOL_DBL_EXP_BIAS + 1;
+    }
+
+    /* 舍入区间的上下界m+、m-，规格化到同一个指数 */
+    upper.frac = (w.frac << 1) + 1;
+    upper.exp = w.exp - 1;
+    while ((upper.frac & (TOOL_DBL_HIDDEN_BIT << 1)) == 0) {
+        upper.frac <<= 1;
+        upper.exp--;
+    }
+    upper.frac <<= 64 - 52 - 2;
+    upper.exp -= 64 - 52 - 2;
+    int lshift = w.frac == TOOL_DBL_HIDDEN_BIT ? 2 : 1;
+    lower.frac = (w.frac << lshift) - 1;
+    lower.exp = w.exp - lshift;
+    lower.frac <<= lower.exp - upper.exp;
+    lower.exp = upper.exp;
+
+    while ((w.frac & TOOL_DBL_HIDDEN_BIT) == 0) {
+        w.frac <<= 1;
+        w.exp--;
+    }
+    w.frac <<= 64 - 52 - 1;
+    w.exp -= 64 - 52 - 1;
+
+    cp = toolFindCachedPow10(upper.exp, &k);
+    w = toolDiyFpMultiply(w, cp);
+    upper = toolDiyFpMultiply(upper, cp);
+    lower = toolDiyFpMultiply(lower, cp);
+    lower.frac++;
+    upper.frac--;
+    *K = -k;
+    return toolGrisuDigits(w, upper, lower, digits, K);
+}
+
+/* 按%.17g的版式输出digits * 10^K：十进制指数在[-4,17)内用定点表示，否则用科学计数法 */
+static int toolFormatShortest(char *dst, int negative, const char *digits, int ndigits, int K)
+{
+    char *p = dst;
+    int exp10 = ndigits + K - 1;
+
+    if (negative) *p++ = '-';
+    if (exp10 >= -4 && exp10 < 17) {
+        if (K >= 0) {
+            memcpy(p, digits, ndigits);
+            memset(p + ndigits, '0', K);
+            p += ndigits + K;
+        } else if (exp10 >= 0) {
+            memcpy(p, digits, exp10 + 1);
+            p += exp10 + 1;
+            *p++ = '.';
+            memcpy(p, digits + exp10 + 1, ndigits - exp10 - 1);
+            p += ndigits - exp10 - 1;
+        } else {
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -exp10 - 1);
+            p += -exp10 - 1;
+            memcpy(p, digits, ndigits);
+            p += ndigits;
+        }
+    } else {
+        *p++ = digits[0];
+        if (ndigits > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, ndigits - 1);
+            p += ndigits - 1;
+        }
+        *p++ = 'e';
+        *p++ = exp10 < 0 ? '-' : '+';
+        if (exp10 < 0) exp10 = -exp10;
+        if (exp10 >= 100) *p++ = (char)('0' + exp10 / 100);
+        memcpy(p, toolDigitPairs + (exp10 % 100) * 2, 2);
+        p += 2;
+    }
+    *p = '\0';
+    return (int)(p - dst);
+}
+
 /* Convert a double to a string representation. Returns the number of bytes
  * required. The representation should always be parsable by strtod(3).
  * This function does not support human-friendly formatting like ld2string
  * does. It is intended mainly to be used inside t_zset.c when writing scores
  * into a ziplist representing a sorted set. */
 /**
- * 将double类型浮点数转换为字符串
+ * 将double类型浮点数转换为字符串。
+ * 非整数用Grisu2输出能还原出同一个double的最短数字串（不再固定17位有效数字），
+ * 版式与%.17g一致
  * @param buf 输出缓冲区
  * @param len 缓冲区长度
  * @param value 输入值
- * @return 写入的字符数，失败返回-1
+ * @return 需要的字符数（不含结尾的'\0'），超过len时输出被截断，与snprintf相同
  */
 int toolFunc::d2string(char *buf, size_t len, double value) {
     if (isnan(value)) {
@@ -750,7 +1066,17 @@ int toolFunc::d2string(char *buf, size_t len, double value) {
             len = ll2string(buf,len,(long long)value);
         else
 #endif
-            len = snprintf(buf,len,"%.17g",value);
+        {
+            char digits[18], out[TOOL_D2STRING_MAX];
+            int K, ndigits = toolGrisu2(fabs(value), digits, &K);
+            int l = toolFormatShortest(out, value < 0, digits, ndigits, K);
+            if (len) {
+                size_t n = (size_t)l < len ? (size_t)l : len - 1;
+                memcpy(buf, out, n);
+                buf[n] = '\0';
+            }
+            len = l;
+        }
     }
 
     return len;
@@ -787,6 +1113,12 @@ int toolFunc::ld2string(char *buf, size_t len, long double value, ld2string_mode
             memcpy(buf,"-inf",4);
             l = 4;
         }
+    } else if (mode != LD_STR_HEX && value != 0 && value > -1e17L && value < 1e17L &&
+               value == (long double)(long long)value) {
+        /* 整数值（INCRBYFLOAT的常见结果）两种十进制模式输出都与ll2string相同：
+         * 不超过17位时%.17Lg不会切换到科学计数法，%.17Lf去掉小数部分后也一样 */
+        l = ll2string(buf,len,(long long)value);
+        if (l == 0) return 0; /* No room. */
     } else {
         switch (mode) {
         case LD_STR_AUTO:
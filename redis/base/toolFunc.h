@@ -13,6 +13,8 @@ BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
 
 #define MAX_LONG_DOUBLE_CHARS 5*1024
+/* d2string最长输出（含'\0'），例如"-2.2250738585072014e-308" */
+#define TOOL_D2STRING_MAX 32
 
 /* 
  * long double到字符串的转换模式选项
@@ -154,23 +156,32 @@ public:
      * @param v 输入值
      * @return 十进制位数
      */
-    uint32_t digits10(uint64_t v);
+    static uint32_t digits10(uint64_t v);
     
     /**
      * 计算有符号64位整数的十进制位数
      * @param v 输入值
      * @return 十进制位数(包括符号位)
      */
-    uint32_t sdigits10(int64_t v);
+    static uint32_t sdigits10(int64_t v);
     
     /**
      * 将long long类型整数转换为字符串
      * @param s 输出缓冲区
      * @param len 缓冲区长度
      * @param value 输入值
-     * @return 写入的字符数，失败返回-1
+     * @return 写入的字符数，缓冲区不够返回0
      */
-    int ll2string(char *s, size_t len, long long value);
+    static int ll2string(char *s, size_t len, long long value);
+
+    /**
+     * 将unsigned long long类型整数转换为字符串
+     * @param s 输出缓冲区
+     * @param len 缓冲区长度
+     * @param value 输入值
+     * @return 写入的字符数，缓冲区不够返回0
+     */
+    static int ull2string(char *s, size_t len, unsigned long long value);
     
     /**
      * 将字符串转换为long long类型整数
@@ -217,13 +228,13 @@ public:
     int string2d(const char *s, size_t slen, double *dp);
     
     /**
-     * 将double类型浮点数转换为字符串
-     * @param buf 输出缓冲区
+     * 将double类型浮点数转换为能还原的最短字符串
+     * @param buf 输出缓冲区，TOOL_D2STRING_MAX字节总是足够
      * @param len 缓冲区长度
      * @param value 输入值
-     * @return 写入的字符数，失败返回-1
+     * @return 需要的字符数，超过len时输出被截断
      */
-    int d2string(char *buf, size_t len, double value);
+    static int d2string(char *buf, size_t len, double value);
     
     /**
      * 将long double类型浮点数转换为字符串
@@ -11,8 +11,28 @@
 #include <assert.h>
 #include <string.h>
 #include <pthread.h>
+#include <math.h>
+#include <time.h>
 #include "atomicvar.h"
 #include "zmalloc.h"
+#ifdef HAVE_BACKTRACE
+#include <execinfo.h>
+#include <cxxabi.h>
+#endif
+#ifdef HAVE_ZMALLOC_HUGE
+#include <sys/mman.h>
+#endif
+
+/* Explicitly override malloc/free etc when using jemalloc, so that a
+ * vendored build configured with --with-jemalloc-prefix=je_ is used. */
+#if defined(USE_JEMALLOC)
+#define malloc(size) je_malloc(size)
+#define calloc(count,size) je_calloc(count,size)
+#define realloc(ptr,size) je_realloc(ptr,size)
+#define free(ptr) je_free(ptr)
+#define mallocx(size,flags) je_mallocx(size,flags)
+#define dallocx(ptr,flags) je_dallocx(ptr,flags)
+#endif
 
 #ifdef HAVE_MALLOC_SIZE
 #define PREFIX_SIZE (0)
@@ -33,14 +53,668 @@
 #define ASSERT_NO_SIZE_OVERFLOW(sz) assert((sz) + PREFIX_SIZE > (sz))
 #endif
 #define MALLOC_MIN_SIZE(x) ((x) > 0 ? (x) : sizeof(long))
-#define update_zmalloc_stat_alloc(__n) atomicIncr(used_memory,(__n))
-#define update_zmalloc_stat_free(__n) atomicDecr(used_memory,(__n))
+#define update_zmalloc_stat_alloc(__n,__tag) zmallocThreadStatUpdate((long long)(__n),(__tag),1)
+#define update_zmalloc_stat_free(__n,__tag) zmallocThreadStatUpdate(-(long long)(__n),(__tag),-1)
+#define update_zmalloc_stat_resize(__old,__new,__tag) \
+    zmallocThreadStatUpdate((long long)(__new)-(long long)(__old),(__tag),0)
+
+/* 共享库中的__thread变量默认走general-dynamic模型，每次访问都要调用
+ * __tls_get_addr，热路径上改用initial-exec。 */
+#if defined(__GNUC__)
+#define ZMALLOC_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+#define ZMALLOC_TLS_MODEL
+#endif
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
-zmalloc* zmalloc::instance = nullptr;
+zmalloc zmalloc::instance;
 static void (*zmalloc_oom_handler)(size_t) = zmalloc::zmalloc_default_oom;
 static redisAtomic size_t used_memory = 0;
+
+/* 线程本地状态：未合并的统计增量 + 按size class组织的空闲块链表。
+ * 空闲块的前8个字节用作链表指针（最小块也有sizeof(long)字节）。 */
+typedef struct zmallocThreadState {
+    long long stat_delta;       /* 尚未合并到used_memory的增量 */
+    int registered;             /* 是否已注册线程退出回调 */
+    int exiting;                /* 线程退出回调已执行，之后不再缓存 */
+    /* 标签计数只由本线程写入，读取方加锁遍历所有线程后求和。 */
+    zmallocTagStats tags[ZMALLOC_TAG_COUNT];
+    struct zmallocThreadState *prev, *next;
+    long long prof_countdown;   /* 距离下一次采样还需分配的字节数 */
+    long long prof_epoch;       /* 与zmalloc_prof_epoch不同时需重新抽取采样间隔 */
+    uint64_t prof_rng;          /* 采样间隔的随机数状态 */
+    int pressure_running;       /* 正在执行内存压力回调，回调里的分配不再触发检查 */
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    size_t cached_bytes;        /* 当前缓存的总字节数 */
+    void *bins[ZMALLOC_THREAD_CACHE_CLASSES];
+    unsigned int bin_count[ZMALLOC_THREAD_CACHE_CLASSES];
+#endif
+} zmallocThreadState;
+
+static __thread zmallocThreadState zmalloc_tls ZMALLOC_TLS_MODEL;
+static pthread_key_t zmalloc_tls_key;
+static pthread_once_t zmalloc_tls_key_once = PTHREAD_ONCE_INIT;
+
+/* 已注册线程链表，以及已退出线程合并下来的标签计数。 */
+static pthread_mutex_t zmalloc_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zmallocThreadState *zmalloc_threads = NULL;
+static zmallocTagStats zmalloc_retired_tags[ZMALLOC_TAG_COUNT];
+
+static const char *zmalloc_tag_names[ZMALLOC_TAG_COUNT] = {
+    "other", "dict", "sds", "ziplist", "listpack",
+    "quicklist", "skiplist", "rax", "stream"
+};
+
+/* 内存压力回调。used_memory不低于zmalloc_pressure_up（最低的未触发水位）或
+ * 低于zmalloc_pressure_down（已触发水位中最高的重新生效线）时才需要加锁判断，
+ * 没有设置软上限时两者分别为SIZE_MAX和0，合并统计时只多两次读。 */
+typedef struct zmallocPressureHook {
+    zmallocPressureCallback cb;     /* NULL表示空槽 */
+    void *privdata;
+    int watermark;                  /* 软上限的百分比 */
+    int flags;                      /* ZMALLOC_PRESSURE_xxx */
+    int fired;                      /* 本次越线已触发，回落后清零 */
+    int pending;                    /* 非同步回调等待zmalloc_pressure_poll()调用 */
+} zmallocPressureHook;
+
+static pthread_mutex_t zmalloc_pressure_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zmallocPressureHook zmalloc_pressure_hooks[ZMALLOC_PRESSURE_MAX_HOOKS];
+static redisAtomic size_t zmalloc_soft_limit = 0;
+static redisAtomic size_t zmalloc_pressure_up = SIZE_MAX;
+static redisAtomic size_t zmalloc_pressure_down = 0;
+
+static void zmallocPressureCheck(zmallocThreadState *ts, size_t um);
+
+static void zmallocThreadFlushDelta(zmallocThreadState *ts) {
+    size_t um, up, down;
+    if (ts->stat_delta == 0) return;
+    /* 负增量按size_t回绕相加，结果与atomicDecr等价。 */
+    atomicIncr(used_memory,(size_t)ts->stat_delta);
+    ts->stat_delta = 0;
+    atomicGet(zmalloc_pressure_up,up);
+    atomicGet(zmalloc_pressure_down,down);
+    if (__builtin_expect(up == SIZE_MAX && down == 0,1)) return;
+    atomicGet(used_memory,um);
+    if (um >= up || um < down) zmallocPressureCheck(ts,um);
+}
+
+/* 水位对应的字节数，以及触发后重新生效的字节数。 */
+static inline size_t zmallocPressureMark(size_t limit, int watermark) {
+    return (size_t)((double)limit * watermark / 100);
+}
+
+static inline size_t zmallocPressureRearm(size_t limit, int watermark) {
+    size_t mark = zmallocPressureMark(limit,watermark);
+    size_t slack = zmallocPressureMark(limit,ZMALLOC_PRESSURE_HYSTERESIS);
+    return mark > slack ? mark - slack : 0;
+}
+
+/* 根据各回调的触发状态重新计算快速判断用的上下界，调用方持有zmalloc_pressure_mutex。 */
+static void zmallocPressureUpdateBounds(void) {
+    size_t limit, up = SIZE_MAX, down = 0;
+    atomicGet(zmalloc_soft_limit,limit);
+    for (int j = 0; limit && j < ZMALLOC_PRESSURE_MAX_HOOKS; j++) {
+        zmallocPressureHook *h = &zmalloc_pressure_hooks[j];
+        if (h->cb == NULL) continue;
+        if (h->fired) {
+            size_t rearm = zmallocPressureRearm(limit,h->watermark);
+            if (rearm > down) down = rearm;
+        } else {
+            size_t mark = zmallocPressureMark(limit,h->watermark);
+            if (mark < up) up = mark;
+        }
+    }
+    atomicSet(zmalloc_pressure_up,up);
+    atomicSet(zmalloc_pressure_down,down);
+}
+
+/* 按used_memory更新各回调的触发状态：向上越线的同步回调拷贝到calls里
+ * 由调用方在锁外执行，非同步回调标记为待处理。调用方持有zmalloc_pressure_mutex。
+ * 返回需要同步调用的回调个数。 */
+static int zmallocPressureEvaluate(size_t um, zmallocPressureHook *calls) {
+    size_t limit;
+    int numcalls = 0;
+    atomicGet(zmalloc_soft_limit,limit);
+    for (int j = 0; limit && j < ZMALLOC_PRESSURE_MAX_HOOKS; j++) {
+        zmallocPressureHook *h = &zmalloc_pressure_hooks[j];
+        if (h->cb == NULL) continue;
+        if (!h->fired && um >= zmallocPressureMark(limit,h->watermark)) {
+            h->fired = 1;
+            if (h->flags & ZMALLOC_PRESSURE_SYNC) calls[numcalls++] = *h;
+            else h->pending = 1;
+        } else if (h->fired && um < zmallocPressureRearm(limit,h->watermark)) {
+            h->fired = 0;
+        }
+    }
+    zmallocPressureUpdateBounds();
+    return numcalls;
+}
+
+static void zmallocPressureRun(zmallocThreadState *ts, zmallocPressureHook *calls, int numcalls, size_t um) {
+    size_t limit;
+    atomicGet(zmalloc_soft_limit,limit);
+    ts->pressure_running = 1;
+    for (int j = 0; j < numcalls; j++)
+        calls[j].cb(calls[j].watermark,um,limit,calls[j].privdata);
+    ts->pressure_running = 0;
+}
+
+/* 合并统计时发现越过上下界后调用。回调内部的分配释放不会再次进入；
+ * 其他线程正在判断时直接返回，由它处理。 */
+static void zmallocPressureCheck(zmallocThreadState *ts, size_t um) {
+    zmallocPressureHook calls[ZMALLOC_PRESSURE_MAX_HOOKS];
+    int numcalls;
+    if (ts->pressure_running) return;
+    if (pthread_mutex_trylock(&zmalloc_pressure_mutex) != 0) return;
+    numcalls = zmallocPressureEvaluate(um,calls);
+    pthread_mutex_unlock(&zmalloc_pressure_mutex);
+    if (numcalls) zmallocPressureRun(ts,calls,numcalls,um);
+}
+
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+static void zmallocThreadCacheRelease(zmallocThreadState *ts) {
+    for (int j = 0; j < ZMALLOC_THREAD_CACHE_CLASSES; j++) {
+        void *p = ts->bins[j];
+        while (p) {
+            void *next = *((void**)p);
+            free(p);
+            p = next;
+        }
+        ts->bins[j] = NULL;
+        ts->bin_count[j] = 0;
+    }
+    ts->cached_bytes = 0;
+}
+#endif
+
+static void zmallocTagStatsAdd(zmallocTagStats *dst, const zmallocTagStats *src) {
+    for (int j = 0; j < ZMALLOC_TAG_COUNT; j++) {
+        long long v;
+        atomicGet(src[j].used,v); dst[j].used += v;
+        atomicGet(src[j].count,v); dst[j].count += v;
+        atomicGet(src[j].allocs,v); dst[j].allocs += v;
+    }
+}
+
+/* 线程退出回调：归还缓存块，合并统计增量，并把标签计数转入退出线程汇总。 */
+static void zmallocThreadExit(void *arg) {
+    zmallocThreadState *ts = static_cast<zmallocThreadState*>(arg);
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    zmallocThreadCacheRelease(ts);
+#endif
+    zmallocThreadFlushDelta(ts);
+    pthread_mutex_lock(&zmalloc_threads_mutex);
+    zmallocTagStatsAdd(zmalloc_retired_tags,ts->tags);
+    memset(ts->tags,0,sizeof(ts->tags));
+    if (ts->prev) ts->prev->next = ts->next;
+    else zmalloc_threads = ts->next;
+    if (ts->next) ts->next->prev = ts->prev;
+    ts->exiting = 1;
+    pthread_mutex_unlock(&zmalloc_threads_mutex);
+}
+
+static void zmallocThreadKeyCreate(void) {
+    pthread_key_create(&zmalloc_tls_key,zmallocThreadExit);
+}
+
+static void zmallocThreadRegister(zmallocThreadState *ts) {
+    pthread_once(&zmalloc_tls_key_once,zmallocThreadKeyCreate);
+    pthread_setspecific(zmalloc_tls_key,ts);
+    pthread_mutex_lock(&zmalloc_threads_mutex);
+    ts->prev = NULL;
+    ts->next = zmalloc_threads;
+    if (zmalloc_threads) zmalloc_threads->prev = ts;
+    zmalloc_threads = ts;
+    pthread_mutex_unlock(&zmalloc_threads_mutex);
+    ts->registered = 1;
+}
+
+/* 更新统计：bytes为used_memory增量，count为存活块数增量（分配+1，释放-1，realloc为0）。 */
+static inline void zmallocThreadStatUpdate(long long bytes, int tag, int count) {
+    zmallocThreadState *ts = &zmalloc_tls;
+    if (__builtin_expect(!ts->registered,0)) zmallocThreadRegister(ts);
+    ts->stat_delta += bytes;
+    if (__builtin_expect(ts->exiting,0)) {
+        /* 线程已退出链表，标签计数直接记到退出线程汇总里。 */
+        pthread_mutex_lock(&zmalloc_threads_mutex);
+        zmalloc_retired_tags[tag].used += bytes;
+        zmalloc_retired_tags[tag].count += count;
+        if (count > 0) zmalloc_retired_tags[tag].allocs++;
+        pthread_mutex_unlock(&zmalloc_threads_mutex);
+        zmallocThreadFlushDelta(ts);
+        return;
+    }
+    zmallocTagStats *t = &ts->tags[tag];
+    atomicSet(t->used,t->used+bytes);
+    if (count) {
+        atomicSet(t->count,t->count+count);
+        if (count > 0) atomicSet(t->allocs,t->allocs+1);
+    }
+    if (ts->stat_delta >= ZMALLOC_THREAD_STAT_BATCH ||
+        ts->stat_delta <= -ZMALLOC_THREAD_STAT_BATCH)
+        zmallocThreadFlushDelta(ts);
+}
+
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+/* size class划分：8..256每8字节一档（32档），256..4096每次翻倍再分4档（16档）。
+ * 返回能容纳size字节的最小class，超出缓存范围返回-1。 */
+static inline int zmallocThreadCacheClass(size_t size) {
+    if (size <= 256) return (int)((size+7)>>3) - 1;
+    if (size > ZMALLOC_THREAD_CACHE_MAX_SIZE) return -1;
+    size_t s = size-1;
+    int p = 63 - __builtin_clzll((unsigned long long)s);
+    return 32 + (p-8)*4 + (int)((s - ((size_t)1<<p)) >> (p-2));
+}
+
+/* 返回容量不超过usable的最大class，用于把释放的块放回缓存。 */
+static inline int zmallocThreadCacheFloorClass(size_t usable) {
+    if (usable < 8) return -1;
+    if (usable >= ZMALLOC_THREAD_CACHE_MAX_SIZE) {
+        /* 比最大class大太多的块不缓存，避免复用时浪费。 */
+        if (usable >= ZMALLOC_THREAD_CACHE_MAX_SIZE + ZMALLOC_THREAD_CACHE_MAX_SIZE/8)
+            return -1;
+        return ZMALLOC_THREAD_CACHE_CLASSES-1;
+    }
+    return zmallocThreadCacheClass(usable+1) - 1;
+}
+
+/* 命中时通过usable返回块的实际大小，调用方不必再查询一次。 */
+static inline void *zmallocThreadCachePop(size_t size, size_t *usable) {
+    zmallocThreadState *ts = &zmalloc_tls;
+    int cls = zmallocThreadCacheClass(size);
+    if (cls < 0) return NULL;
+    void *p = ts->bins[cls];
+    if (p == NULL) return NULL;
+    ts->bins[cls] = *((void**)p);
+    ts->bin_count[cls]--;
+    *usable = zmalloc_size(p);
+    ts->cached_bytes -= *usable;
+    return p;
+}
+
+/* 把usable字节的块放入缓存，成功返回1；缓存已满或不可缓存返回0。 */
+static inline int zmallocThreadCachePush(void *p, size_t usable) {
+    zmallocThreadState *ts = &zmalloc_tls;
+    if (ts->exiting) return 0;
+    int cls = zmallocThreadCacheFloorClass(usable);
+    if (cls < 0 || ts->bin_count[cls] >= ZMALLOC_THREAD_CACHE_SLOTS ||
+        ts->cached_bytes + usable > ZMALLOC_THREAD_CACHE_BYTES) return 0;
+    if (__builtin_expect(!ts->registered,0)) zmallocThreadRegister(ts);
+    *((void**)p) = ts->bins[cls];
+    ts->bins[cls] = p;
+    ts->bin_count[cls]++;
+    ts->cached_bytes += usable;
+    return 1;
+}
+#endif
+
+#ifdef HAVE_ZMALLOC_HUGE
+/* 大块登记表：以2MB粒度的地址为键的两级基数树，叶子存映射长度，0表示不是大块。
+ * 叶子在加锁插入时按需分配、从不释放，zmalloc_size查表只做两次原子读，不加锁。
+ * 叶子用底层calloc分配，不计入used_memory。 */
+#define ZMALLOC_HUGE_SHIFT 21   /* log2(ZMALLOC_HUGE_ALIGN) */
+#define ZMALLOC_HUGE_ROOT_BITS (ZMALLOC_HUGE_ADDR_BITS-ZMALLOC_HUGE_SHIFT-ZMALLOC_HUGE_LEAF_BITS)
+static_assert(((size_t)1 << ZMALLOC_HUGE_SHIFT) == ZMALLOC_HUGE_ALIGN, "ZMALLOC_HUGE_SHIFT mismatch");
+
+static pthread_mutex_t zmalloc_huge_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t *zmalloc_huge_root[(size_t)1 << ZMALLOC_HUGE_ROOT_BITS];
+static redisAtomic size_t zmalloc_huge_threshold = ZMALLOC_HUGE_DEFAULT_THRESHOLD;
+static redisAtomic int zmalloc_huge_thp = 1;
+static size_t zmalloc_huge_blocks = 0;      /* 存活大块数，受zmalloc_huge_mutex保护 */
+static size_t zmalloc_huge_bytes = 0;       /* 存活大块的映射字节数 */
+
+/* 查询ptr的映射长度，不是大块返回0。调用方持有ptr，它的登记项在查询期间不会变化。 */
+static inline size_t zmallocHugeLookup(void *ptr) {
+    uintptr_t key = (uintptr_t)ptr >> ZMALLOC_HUGE_SHIFT;
+    size_t *leaf, len;
+    if (((uintptr_t)ptr & (ZMALLOC_HUGE_ALIGN-1)) != 0 ||
+        (key >> (ZMALLOC_HUGE_ROOT_BITS+ZMALLOC_HUGE_LEAF_BITS)) != 0) return 0;
+    /* 叶子在发布之前已清零，这里需要与插入方的写同步 */
+    atomicGetWithSync(zmalloc_huge_root[key >> ZMALLOC_HUGE_LEAF_BITS],leaf);
+    if (leaf == NULL) return 0;
+    atomicGet(leaf[key & (((uintptr_t)1 << ZMALLOC_HUGE_LEAF_BITS)-1)],len);
+    return len;
+}
+
+/* 登记大块，叶子分配失败或地址超出登记表覆盖范围时返回-1。 */
+static int zmallocHugeInsert(void *ptr, size_t len) {
+    uintptr_t key = (uintptr_t)ptr >> ZMALLOC_HUGE_SHIFT;
+    if ((key >> (ZMALLOC_HUGE_ROOT_BITS+ZMALLOC_HUGE_LEAF_BITS)) != 0) return -1;
+    pthread_mutex_lock(&zmalloc_huge_mutex);
+    size_t *leaf = zmalloc_huge_root[key >> ZMALLOC_HUGE_LEAF_BITS];
+    if (leaf == NULL) {
+        leaf = (size_t*)calloc((size_t)1 << ZMALLOC_HUGE_LEAF_BITS,sizeof(size_t));
+        if (leaf == NULL) {
+            pthread_mutex_unlock(&zmalloc_huge_mutex);
+            return -1;
+        }
+        atomicSetWithSync(zmalloc_huge_root[key >> ZMALLOC_HUGE_LEAF_BITS],leaf);
+    }
+    atomicSet(leaf[key & (((uintptr_t)1 << ZMALLOC_HUGE_LEAF_BITS)-1)],len);
+    zmalloc_huge_blocks++;
+    zmalloc_huge_bytes += len;
+    pthread_mutex_unlock(&zmalloc_huge_mutex);
+    return 0;
+}
+
+/* 注销ptr，返回其映射长度，不是大块返回0。 */
+static size_t zmallocHugeRemove(void *ptr) {
+    size_t len = zmallocHugeLookup(ptr);
+    if (len == 0) return 0;
+    uintptr_t key = (uintptr_t)ptr >> ZMALLOC_HUGE_SHIFT;
+    pthread_mutex_lock(&zmalloc_huge_mutex);
+    atomicSet(zmalloc_huge_root[key >> ZMALLOC_HUGE_LEAF_BITS][key & (((uintptr_t)1 << ZMALLOC_HUGE_LEAF_BITS)-1)],(size_t)0);
+    zmalloc_huge_blocks--;
+    zmalloc_huge_bytes -= len;
+    pthread_mutex_unlock(&zmalloc_huge_mutex);
+    return len;
+}
+
+static inline int zmallocHugeWanted(size_t size) {
+    size_t threshold;
+    atomicGet(zmalloc_huge_threshold,threshold);
+    return threshold && size >= threshold;
+}
+
+static inline size_t zmallocHugeRound(size_t size) {
+    static size_t page = 0;
+    if (page == 0) page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+static void zmallocHugeAdvise(void *ptr, size_t len) {
+    int thp;
+    atomicGet(zmalloc_huge_thp,thp);
+#ifdef MADV_HUGEPAGE
+    if (thp) madvise(ptr,len,MADV_HUGEPAGE);
+#else
+    ((void)(ptr));
+    ((void)(len));
+    ((void)(thp));
+#endif
+}
+
+/* 映射len字节（已按页对齐），起始地址按ZMALLOC_HUGE_ALIGN对齐：
+ * 多映射一个对齐粒度，再把头尾多余的部分解除映射。 */
+static void *zmallocHugeMap(size_t len) {
+    size_t maplen = len + ZMALLOC_HUGE_ALIGN;
+    char *p = (char*)mmap(NULL,maplen,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+    if (p == MAP_FAILED) return NULL;
+    char *aligned = (char*)(((uintptr_t)p + ZMALLOC_HUGE_ALIGN - 1) & ~(uintptr_t)(ZMALLOC_HUGE_ALIGN - 1));
+    if (aligned > p) munmap(p,aligned-p);
+    if (p+maplen > aligned+len) munmap(aligned+len,(p+maplen)-(aligned+len));
+    zmallocHugeAdvise(aligned,len);
+    return aligned;
+}
+
+/* 分配一个大块，返回的长度即可用大小。失败返回NULL，由调用方退回malloc。 */
+static void *zmallocHugeAlloc(size_t size) {
+    size_t len = zmallocHugeRound(size);
+    void *ptr = zmallocHugeMap(len);
+    if (ptr == NULL) return NULL;
+    if (zmallocHugeInsert(ptr,len) == -1) {
+        munmap(ptr,len);
+        return NULL;
+    }
+    return ptr;
+}
+
+/* 调整大块的映射长度：缩小时解除尾部映射；增大时先尝试原地扩展，
+ * 否则预留一段新的对齐区域，用mremap把页表整体移过去，不拷贝数据。
+ * 失败返回NULL，原块保持不变。 */
+static void *zmallocHugeRemap(void *ptr, size_t oldlen, size_t newlen) {
+    void *newptr;
+    if (newlen <= oldlen) {
+        if (newlen < oldlen) munmap((char*)ptr+newlen,oldlen-newlen);
+        return ptr;
+    }
+    newptr = mremap(ptr,oldlen,newlen,0);
+    if (newptr == MAP_FAILED) {
+        void *reserved = zmallocHugeMap(newlen);
+        if (reserved == NULL) return NULL;
+        newptr = mremap(ptr,oldlen,newlen,MREMAP_MAYMOVE|MREMAP_FIXED,reserved);
+        if (newptr == MAP_FAILED) {
+            munmap(reserved,newlen);
+            return NULL;
+        }
+    }
+    zmallocHugeAdvise(newptr,newlen);
+    return newptr;
+}
+
+/* 释放路径：ptr是大块时完成统计并解除映射，返回1；否则返回0。 */
+static int zmallocHugeFree(void *ptr, size_t *usable, int tag);
+#endif
+
+/* 采样式堆分析。存活采样按内存块地址放进固定大小的哈希表，
+ * 表本身是静态数组，从不释放，释放路径可以无锁读取桶头判断是否需要加锁查找。
+ * 采样记录用底层malloc分配，不计入used_memory。 */
+typedef struct zmallocProfSample {
+    void *ptr;                  /* 被采样的内存块 */
+    size_t size;                /* 内存块大小 */
+    int tag;                    /* 内存归属标签 */
+    int depth;                  /* 栈深度 */
+    double weight;              /* 采样概率的倒数，即该采样代表的分配次数 */
+    void *stack[ZMALLOC_PROF_MAX_DEPTH];
+    struct zmallocProfSample *next;
+} zmallocProfSample;
+
+static redisAtomic size_t zmalloc_prof_rate = 0;        /* 平均采样间隔，0表示关闭 */
+static redisAtomic long long zmalloc_prof_epoch = 0;    /* 每次开启/关闭加一 */
+static redisAtomic long long zmalloc_prof_live = 0;     /* 存活采样数 */
+static pthread_mutex_t zmalloc_prof_mutex = PTHREAD_MUTEX_INITIALIZER;
+static zmallocProfSample *zmalloc_prof_table[ZMALLOC_PROF_TABLE_SIZE];
+static long long zmalloc_prof_total = 0;                /* 累计采样次数 */
+static double zmalloc_prof_live_bytes = 0;              /* 存活采样的估计字节数 */
+
+static inline unsigned long zmallocProfHash(uintptr_t addr) {
+    /* 内存块至少8字节对齐，低位没有区分度。 */
+    uint64_t h = (uint64_t)addr >> 4;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (unsigned long)(h >> 32) & (ZMALLOC_PROF_TABLE_SIZE-1);
+}
+
+/* 抽取下一个采样间隔：均值为rate的指数分布，使得每个字节被采中的概率相同。 */
+static long long zmallocProfNextInterval(zmallocThreadState *ts, size_t rate) {
+    if (ts->prof_rng == 0)
+        ts->prof_rng = ((uint64_t)(uintptr_t)ts ^ (uint64_t)time(NULL)) | 1;
+    /* xorshift64* */
+    ts->prof_rng ^= ts->prof_rng >> 12;
+    ts->prof_rng ^= ts->prof_rng << 25;
+    ts->prof_rng ^= ts->prof_rng >> 27;
+    double u = (double)((ts->prof_rng * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+    return (long long)(-log(1.0-u) * (double)rate) + 1;
+}
+
+static void zmallocProfFreeAll(void) {
+    for (int j = 0; j < ZMALLOC_PROF_TABLE_SIZE; j++) {
+        zmallocProfSample *s = zmalloc_prof_table[j];
+        while (s) {
+            zmallocProfSample *next = s->next;
+            free(s);
+            s = next;
+        }
+        atomicSet(zmalloc_prof_table[j],(zmallocProfSample*)NULL);
+    }
+    atomicSet(zmalloc_prof_live,0);
+    zmalloc_prof_live_bytes = 0;
+}
+
+/* 采样计数到期后的慢路径：抽取下一个间隔，记录调用栈并插入存活表。
+ * 不能内联，这样本函数的返回地址就是分配函数里的调用点，
+ * 保存的栈从这一帧开始（backtrace()可能被ASAN等拦截，前面的帧数不固定）。 */
+static void __attribute__((noinline)) zmallocProfRecord(zmallocThreadState *ts, void *ptr, size_t size, int tag) {
+    size_t rate;
+    long long epoch;
+    atomicGet(zmalloc_prof_rate,rate);
+    atomicGet(zmalloc_prof_epoch,epoch);
+    if (rate == 0) return;
+    ts->prof_countdown = zmallocProfNextInterval(ts,rate);
+    if (ts->prof_epoch != epoch) {
+        /* 开启后本线程的第一次到期只用来初始化间隔。 */
+        ts->prof_epoch = epoch;
+        return;
+    }
+#ifdef HAVE_BACKTRACE
+    zmallocProfSample *s = (zmallocProfSample*)malloc(sizeof(*s));
+    if (s == NULL) return;
+    s->ptr = ptr;
+    s->size = size;
+    s->tag = tag;
+    s->depth = backtrace(s->stack,ZMALLOC_PROF_MAX_DEPTH);
+    void *caller = __builtin_return_address(0);
+    for (int j = 0; j < s->depth; j++) {
+        if (s->stack[j] != caller) continue;
+        memmove(s->stack,s->stack+j,sizeof(void*)*(s->depth-j));
+        s->depth -= j;
+        break;
+    }
+    s->weight = 1.0 / (1.0 - exp(-(double)size/(double)rate));
+    unsigned long h = zmallocProfHash((uintptr_t)ptr);
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    atomicGet(zmalloc_prof_epoch,epoch);
+    if (ts->prof_epoch != epoch) {
+        /* 采栈期间分析器被关闭或重新开启。 */
+        pthread_mutex_unlock(&zmalloc_prof_mutex);
+        free(s);
+        return;
+    }
+    s->next = zmalloc_prof_table[h];
+    atomicSet(zmalloc_prof_table[h],s);
+    atomicIncr(zmalloc_prof_live,1);
+    zmalloc_prof_total++;
+    zmalloc_prof_live_bytes += s->weight * (double)size;
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+#else
+    ((void)(ptr));
+    ((void)(size));
+    ((void)(tag));
+#endif
+}
+
+/* 把addr的采样从存活表中摘下，统计保持不变，*epoch返回摘下时的分析器代数。
+ * 调用时内存块必须仍然存活，这样表中同一地址最多只有一条采样。 */
+static zmallocProfSample *zmallocProfDetach(uintptr_t addr, long long *epoch) {
+    unsigned long h = zmallocProfHash(addr);
+    zmallocProfSample *head;
+    atomicGet(zmalloc_prof_table[h],head);
+    if (head == NULL) return NULL;
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    zmallocProfSample **cur = &zmalloc_prof_table[h], *s;
+    while ((s = *cur) != NULL && (uintptr_t)s->ptr != addr) cur = &s->next;
+    if (s) atomicSet(*cur,s->next);
+    atomicGet(zmalloc_prof_epoch,*epoch);
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+    return s;
+}
+
+/* 处理摘下的采样：addr非0时挂回addr（原地址或搬迁后的地址），为0时内存块已释放，丢弃采样。
+ * 摘下之后分析器被关闭或重新开启过，表和统计已经清空，采样直接丢弃。 */
+static void zmallocProfReattach(zmallocProfSample *s, uintptr_t addr, long long epoch) {
+    long long now;
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    atomicGet(zmalloc_prof_epoch,now);
+    if (now == epoch && addr) {
+        unsigned long h = zmallocProfHash(addr);
+        s->ptr = (void*)addr;
+        s->next = zmalloc_prof_table[h];
+        atomicSet(zmalloc_prof_table[h],s);
+        s = NULL;
+    } else if (now == epoch) {
+        atomicDecr(zmalloc_prof_live,1);
+        zmalloc_prof_live_bytes -= s->weight * (double)s->size;
+    }
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+    free(s);
+}
+
+/* 分配路径钩子：关闭时只有一次全局读。强制内联，-O0下也不会在栈上多出一帧。 */
+static inline __attribute__((always_inline)) void zmallocProfOnAlloc(void *ptr, size_t size, int tag) {
+    size_t rate;
+    atomicGet(zmalloc_prof_rate,rate);
+    if (__builtin_expect(rate == 0,1)) return;
+    zmallocThreadState *ts = &zmalloc_tls;
+    ts->prof_countdown -= (long long)size;
+    if (__builtin_expect(ts->prof_countdown > 0,1)) return;
+    zmallocProfRecord(ts,ptr,size,tag);
+}
+
+/* 摘下ptr的采样，必须在内存块真正释放（或realloc）之前调用，否则地址可能已被其他线程复用。
+ * 没有存活采样时只有一次全局读。 */
+static inline zmallocProfSample *zmallocProfTake(void *ptr, long long *epoch) {
+    long long live;
+    atomicGet(zmalloc_prof_live,live);
+    if (__builtin_expect(live == 0,1)) return NULL;
+    return zmallocProfDetach((uintptr_t)ptr,epoch);
+}
+
+/* 释放路径钩子。 */
+static inline void zmallocProfOnFree(void *ptr) {
+    long long epoch;
+    zmallocProfSample *s = zmallocProfTake(ptr,&epoch);
+    if (s) zmallocProfReattach(s,0,epoch);
+}
+
+static inline void zmallocProfOnMove(void *ptr, void *newptr) {
+    long long epoch;
+    zmallocProfSample *s = zmallocProfTake(ptr,&epoch);
+    if (s) zmallocProfReattach(s,(uintptr_t)newptr,epoch);
+}
+#ifdef HAVE_ZMALLOC_HUGE
+static int zmallocHugeFree(void *ptr, size_t *usable, int tag) {
+    if (((uintptr_t)ptr & (ZMALLOC_HUGE_ALIGN-1)) != 0) return 0;
+    size_t len = zmallocHugeLookup(ptr);
+    if (len == 0) return 0;
+    zmallocProfOnFree(ptr);
+    zmallocHugeRemove(ptr);
+    update_zmalloc_stat_free(len,tag);
+    if (usable) *usable = len;
+    munmap(ptr,len);
+    return 1;
+}
+
+/* 涉及大块的realloc：大块之间用mremap，大块与普通块之间分配新块并拷贝。
+ * ptr可能只是恰好2MB对齐的普通块。失败返回NULL，原块保持不变。 */
+static void *zmallocHugeRealloc(void *ptr, size_t size, int tag) {
+    size_t oldlen = zmallocHugeLookup(ptr);
+    void *newptr;
+    if (oldlen && zmallocHugeWanted(size)) {
+        size_t newlen = zmallocHugeRound(size);
+        uintptr_t oldaddr = (uintptr_t)ptr;
+        long long prof_epoch;
+        zmallocProfSample *prof = zmallocProfTake(ptr,&prof_epoch);
+        zmallocHugeRemove(ptr);
+        newptr = zmallocHugeRemap(ptr,oldlen,newlen);
+        if (newptr == NULL) {
+            /* 原地址的叶子已经存在，重新登记不会失败 */
+            zmallocHugeInsert((void*)oldaddr,oldlen);
+            if (prof) zmallocProfReattach(prof,oldaddr,prof_epoch);
+            return NULL;
+        }
+        if (prof) zmallocProfReattach(prof,0,prof_epoch);
+        update_zmalloc_stat_resize(oldlen,newlen,tag);
+        if (zmallocHugeInsert(newptr,newlen) == -1) {
+            /* 新地址所在的叶子分配失败：映射已经移走，只能拷贝到普通块 */
+            void *p = malloc(size);
+            if (p == NULL) zmalloc_oom_handler(size);
+            memcpy(p,newptr,size);
+            munmap(newptr,newlen);
+            update_zmalloc_stat_resize(newlen,zmalloc_size(p),tag);
+            newptr = p;
+            newlen = zmalloc_size(p);
+        }
+        zmallocProfOnAlloc(newptr,newlen,tag);
+        return newptr;
+    }
+    size_t oldsize = oldlen ? oldlen : zmalloc_size(ptr);
+    newptr = zmalloc::ztrymalloc_usable(size,NULL,tag);
+    if (newptr == NULL) return NULL;
+    memcpy(newptr,ptr,oldsize < size ? oldsize : size);
+    zmalloc::zfree(ptr,tag);
+    return newptr;
+}
+#endif
 //程序终止回调
 void zmalloc::zmalloc_default_oom(size_t size) {
     fprintf(stderr, "zmalloc: Out of memory trying to allocate %zu bytes\n",
@@ -52,15 +726,16 @@ void zmalloc::zmalloc_default_oom(size_t size) {
 /**
  * zzmalloc - 分配指定大小的内存块
  * @size: 需要分配的字节数
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，不对内存内容进行初始化。
  * 如果分配失败，会调用内存不足处理函数(oom_handler)。
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void * zmalloc::zzmalloc(size_t size)
+void * zmalloc::zzmalloc(size_t size, int tag)
 {
-    void *ptr = ztrymalloc_usable(size, NULL);
+    void *ptr = ztrymalloc_usable(size, NULL, tag);
     if (!ptr) zmalloc_oom_handler(size);
     return ptr;
 }
@@ -68,6 +743,7 @@ void * zmalloc::zzmalloc(size_t size)
  * ztrymalloc_usable - 尝试分配内存并获取实际可用大小
  * @size: 需要分配的字节数
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，不对内存内容进行初始化，
  * 并通过usable参数返回实际分配的内存大小。
@@ -75,20 +751,31 @@ void * zmalloc::zzmalloc(size_t size)
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::ztrymalloc_usable(size_t size, size_t *usable) 
+void *zmalloc::ztrymalloc_usable(size_t size, size_t *usable, int tag) 
 {
     ASSERT_NO_SIZE_OVERFLOW(size);
-    void *ptr = malloc(MALLOC_MIN_SIZE(size)+PREFIX_SIZE);
+    void *ptr = NULL;
+    size_t real = 0;    /* 已知的块实际大小，0表示需要查询 */
+#ifdef HAVE_ZMALLOC_HUGE
+    if (__builtin_expect(zmallocHugeWanted(size),0)) ptr = zmallocHugeAlloc(size);
+#endif
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    if (!ptr) ptr = zmallocThreadCachePop(MALLOC_MIN_SIZE(size),&real);
+#endif
+    if (!ptr) ptr = malloc(MALLOC_MIN_SIZE(size)+PREFIX_SIZE);
 
     if (!ptr) return NULL;
 #ifdef HAVE_MALLOC_SIZE
-    size = zmalloc_size(ptr);
-    update_zmalloc_stat_alloc(size);
+    size = real ? real : zmalloc_size(ptr);
+    update_zmalloc_stat_alloc(size,tag);
+    zmallocProfOnAlloc(ptr,size,tag);
     if (usable) *usable = size;
     return ptr;
 #else
+    ((void)(real));
     *((size_t*)ptr) = size;
-    update_zmalloc_stat_alloc(size+PREFIX_SIZE);
+    update_zmalloc_stat_alloc(size+PREFIX_SIZE,tag);
+    zmallocProfOnAlloc((char*)ptr+PREFIX_SIZE,size,tag);
     if (usable) *usable = size;
     return (char*)ptr+PREFIX_SIZE;
 #endif
@@ -97,15 +784,16 @@ void *zmalloc::ztrymalloc_usable(size_t size, size_t *usable)
 /**
  * zcalloc - 分配并清零内存块
  * @size: 需要分配的字节数
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，并将所有字节初始化为0。
  * 如果分配失败，会调用oom_handler。
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::zcalloc(size_t size)
+void *zmalloc::zcalloc(size_t size, int tag)
 {
-    void *ptr = ztrycalloc_usable(size, NULL);
+    void *ptr = ztrycalloc_usable(size, NULL, tag);
     if (!ptr) zmalloc_oom_handler(size);
     return ptr;
 }
@@ -113,6 +801,7 @@ void *zmalloc::zcalloc(size_t size)
  * zrealloc - 调整已分配内存块的大小
  * @ptr: 指向需要调整大小的内存块的指针
  * @size: 新的大小（字节）
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 调整ptr指向的内存块大小为size字节。
  * 如果ptr为NULL，等效于调用zzmalloc(size)。
@@ -122,63 +811,67 @@ void *zmalloc::zcalloc(size_t size)
  *
  * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
  */
-void *zmalloc::zrealloc(void *ptr, size_t size)
+void *zmalloc::zrealloc(void *ptr, size_t size, int tag)
 {
-    ptr = ztryrealloc_usable(ptr, size, NULL);
+    ptr = ztryrealloc_usable(ptr, size, NULL, tag);
     if (!ptr && size != 0) zmalloc_oom_handler(size);
     return ptr;
 }
 /**
  * ztrymalloc - 尝试分配指定大小的内存块
  * @size: 需要分配的字节数
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，不对内存内容进行初始化。
  * 与zzmalloc不同，分配失败时不会调用oom_handler，而是直接返回NULL。
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::ztrymalloc(size_t size)
+void *zmalloc::ztrymalloc(size_t size, int tag)
 {
-    void *ptr = ztrymalloc_usable(size, NULL);
+    void *ptr = ztrymalloc_usable(size, NULL, tag);
     return ptr;
 }
 /**
  * ztrycalloc - 尝试分配并清零内存块
  * @size: 需要分配的字节数
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，并将所有字节初始化为0。
  * 分配失败时不调用oom_handler，直接返回NULL。
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::ztrycalloc(size_t size)
+void *zmalloc::ztrycalloc(size_t size, int tag)
 {
-    void *ptr = ztrycalloc_usable(size, NULL);
+    void *ptr = ztrycalloc_usable(size, NULL, tag);
     return ptr;
 }
 /**
  * ztryrealloc - 尝试调整已分配内存块的大小
  * @ptr: 指向需要调整大小的内存块的指针
  * @size: 新的大小（字节）
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 功能与zrealloc类似，但分配失败时不调用oom_handler，直接返回NULL，
  * 原内存块不会被释放。
  *
  * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
  */
-void *zmalloc::ztryrealloc(void *ptr, size_t size)
+void *zmalloc::ztryrealloc(void *ptr, size_t size, int tag)
 {
-    ptr = ztryrealloc_usable(ptr, size, NULL);
+    ptr = ztryrealloc_usable(ptr, size, NULL, tag);
     return ptr;
 }
 /**
  * zfree - 释放已分配的内存块
  * @ptr: 指向需要释放的内存块的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 释放ptr指向的内存块。如果ptr为NULL，不执行任何操作。
  * 释放后，ptr变为无效指针，不应再被使用。
  */
-void zmalloc::zfree(void *ptr)
+void zmalloc::zfree(void *ptr, int tag)
 {
     #ifndef HAVE_MALLOC_SIZE
     void *realptr;
@@ -186,13 +879,22 @@ void zmalloc::zfree(void *ptr)
 #endif
 
     if (ptr == NULL) return;
+#ifdef HAVE_ZMALLOC_HUGE
+    if (__builtin_expect(zmallocHugeFree(ptr,NULL,tag),0)) return;
+#endif
 #ifdef HAVE_MALLOC_SIZE
-    update_zmalloc_stat_free(zmalloc_size(ptr));
+    size_t size = zmalloc_size(ptr);
+    update_zmalloc_stat_free(size,tag);
+    zmallocProfOnFree(ptr);
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    if (zmallocThreadCachePush(ptr,size)) return;
+#endif
     free(ptr);
 #else
     realptr = (char*)ptr-PREFIX_SIZE;
     oldsize = *((size_t*)realptr);
-    update_zmalloc_stat_free(oldsize+PREFIX_SIZE);
+    update_zmalloc_stat_free(oldsize+PREFIX_SIZE,tag);
+    zmallocProfOnFree(ptr);
     free(realptr);
 #endif
 }
@@ -200,6 +902,7 @@ void zmalloc::zfree(void *ptr)
  * zmalloc_usable - 分配指定大小的内存块并获取实际可用大小
  * @size: 需要分配的字节数
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，不对内存内容进行初始化，
  * 并通过usable参数返回实际分配的内存大小（可能大于请求的大小）。
@@ -207,9 +910,9 @@ void zmalloc::zfree(void *ptr)
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::zmalloc_usable(size_t size, size_t *usable)
+void *zmalloc::zmalloc_usable(size_t size, size_t *usable, int tag)
 {
-    void *ptr = ztrymalloc_usable(size, usable);
+    void *ptr = ztrymalloc_usable(size, usable, tag);
     if (!ptr) zmalloc_oom_handler(size);
     return ptr;
 }
@@ -217,6 +920,7 @@ void *zmalloc::zmalloc_usable(size_t size, size_t *usable)
  * zcalloc_usable - 分配、清零内存并获取实际可用大小
  * @size: 需要分配的字节数
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，将所有字节初始化为0，
  * 并通过usable参数返回实际分配的内存大小。
@@ -224,9 +928,9 @@ void *zmalloc::zmalloc_usable(size_t size, size_t *usable)
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::zcalloc_usable(size_t size, size_t *usable)
+void *zmalloc::zcalloc_usable(size_t size, size_t *usable, int tag)
 {
-    void *ptr = ztrycalloc_usable(size, usable);
+    void *ptr = ztrycalloc_usable(size, usable, tag);
     if (!ptr) zmalloc_oom_handler(size);
     return ptr;
 }
@@ -235,15 +939,16 @@ void *zmalloc::zcalloc_usable(size_t size, size_t *usable)
  * @ptr: 指向需要调整大小的内存块的指针
  * @size: 新的大小（字节）
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 调整内存块大小并通过usable参数返回实际分配的内存大小。
  * 其他行为与zrealloc相同。
  *
  * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
  */
-void *zmalloc::zrealloc_usable(void *ptr, size_t size, size_t *usable)
+void *zmalloc::zrealloc_usable(void *ptr, size_t size, size_t *usable, int tag)
 {
-    ptr = ztryrealloc_usable(ptr, size, usable);
+    ptr = ztryrealloc_usable(ptr, size, usable, tag);
     if (!ptr && size != 0) zmalloc_oom_handler(size);
     return ptr;
 }
@@ -261,6 +966,7 @@ void *zmalloc::zrealloc_usable(void *ptr, size_t size, size_t *usable)
  * ztrycalloc_usable - 尝试分配、清零内存并获取可用大小
  * @size: 需要分配的字节数
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配指定大小的内存块，将所有字节初始化为0，
  * 并通过usable参数返回实际分配的内存大小。
@@ -268,20 +974,33 @@ void *zmalloc::zrealloc_usable(void *ptr, size_t size, size_t *usable)
  *
  * 返回值: 成功时返回分配内存的指针，失败时返回NULL
  */
-void *zmalloc::ztrycalloc_usable(size_t size, size_t *usable)
+void *zmalloc::ztrycalloc_usable(size_t size, size_t *usable, int tag)
 {
     ASSERT_NO_SIZE_OVERFLOW(size);
-    void *ptr = calloc(1, MALLOC_MIN_SIZE(size)+PREFIX_SIZE);
+    void *ptr = NULL;
+    size_t real = 0;    /* 已知的块实际大小，0表示需要查询 */
+#ifdef HAVE_ZMALLOC_HUGE
+    /* 新映射的匿名页本身就是全零。 */
+    if (__builtin_expect(zmallocHugeWanted(size),0)) ptr = zmallocHugeAlloc(size);
+#endif
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    if (!ptr && (ptr = zmallocThreadCachePop(MALLOC_MIN_SIZE(size),&real)) != NULL)
+        memset(ptr,0,real);
+#endif
+    if (!ptr) ptr = calloc(1, MALLOC_MIN_SIZE(size)+PREFIX_SIZE);
     if (ptr == NULL) return NULL;
 
 #ifdef HAVE_MALLOC_SIZE
-    size = zmalloc_size(ptr);
-    update_zmalloc_stat_alloc(size);
+    size = real ? real : zmalloc_size(ptr);
+    update_zmalloc_stat_alloc(size,tag);
+    zmallocProfOnAlloc(ptr,size,tag);
     if (usable) *usable = size;
     return ptr;
 #else
+    ((void)(real));
     *((size_t*)ptr) = size;
-    update_zmalloc_stat_alloc(size+PREFIX_SIZE);
+    update_zmalloc_stat_alloc(size+PREFIX_SIZE,tag);
+    zmallocProfOnAlloc((char*)ptr+PREFIX_SIZE,size,tag);
     if (usable) *usable = size;
     return (char*)ptr+PREFIX_SIZE;
 #endif
@@ -295,13 +1014,14 @@ void *zmalloc::ztrycalloc_usable(size_t size, size_t *usable)
  * @ptr: 指向需要调整大小的内存块的指针
  * @size: 新的大小（字节）
  * @usable: 用于存储实际分配内存大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 功能与zrealloc_usable类似，但分配失败时不调用oom_handler，
  * 直接返回NULL，原内存块不会被释放。
  *
  * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
  */
-void *zmalloc::ztryrealloc_usable(void *ptr, size_t size, size_t *usable)
+void *zmalloc::ztryrealloc_usable(void *ptr, size_t size, size_t *usable, int tag)
 {
     ASSERT_NO_SIZE_OVERFLOW(size);
 #ifndef HAVE_MALLOC_SIZE
@@ -309,42 +1029,67 @@ void *zmalloc::ztryrealloc_usable(void *ptr, size_t size, size_t *usable)
 #endif
     size_t oldsize;
     void *newptr;
+    uintptr_t oldaddr;
+    long long prof_epoch;
+    zmallocProfSample *prof;
 
     /* not allocating anything, just redirect to free. */
     if (size == 0 && ptr != NULL) {
-        zfree(ptr);
+        zfree(ptr,tag);
         if (usable) *usable = 0;
         return NULL;
     }
     /* Not freeing anything, just redirect to malloc. */
     if (ptr == NULL)
-        return ztrymalloc_usable(size, usable);
+        return ztrymalloc_usable(size, usable, tag);
 
+#ifdef HAVE_ZMALLOC_HUGE
+    if (__builtin_expect(zmallocHugeWanted(size) ||
+        ((uintptr_t)ptr & (ZMALLOC_HUGE_ALIGN-1)) == 0,0)) {
+        newptr = zmallocHugeRealloc(ptr,size,tag);
+        if (newptr == NULL) {
+            if (usable) *usable = 0;
+            return NULL;
+        }
+        if (usable) *usable = zmalloc_size(newptr);
+        return newptr;
+    }
+#endif
 #ifdef HAVE_MALLOC_SIZE
     oldsize = zmalloc_size(ptr);
+    /* realloc在采样上按"释放旧块+分配新块"处理，调用栈记到扩容点上。
+     * 旧块的采样在realloc之前摘下（之后旧地址可能已被复用），失败时旧块仍然存活，挂回原地址。 */
+    oldaddr = (uintptr_t)ptr;
+    prof = zmallocProfTake(ptr,&prof_epoch);
     newptr = realloc(ptr,size);
     if (newptr == NULL) {
+        if (prof) zmallocProfReattach(prof,oldaddr,prof_epoch);
         if (usable) *usable = 0;
         return NULL;
     }
+    if (prof) zmallocProfReattach(prof,0,prof_epoch);
 
-    update_zmalloc_stat_free(oldsize);
     size = zmalloc_size(newptr);
-    update_zmalloc_stat_alloc(size);
+    update_zmalloc_stat_resize(oldsize,size,tag);
+    zmallocProfOnAlloc(newptr,size,tag);
     if (usable) *usable = size;
     return newptr;
 #else
     realptr = (char*)ptr-PREFIX_SIZE;
     oldsize = *((size_t*)realptr);
+    oldaddr = (uintptr_t)ptr;
+    prof = zmallocProfTake(ptr,&prof_epoch);
     newptr = realloc(realptr,size+PREFIX_SIZE);
     if (newptr == NULL) {
+        if (prof) zmallocProfReattach(prof,oldaddr,prof_epoch);
         if (usable) *usable = 0;
         return NULL;
     }
+    if (prof) zmallocProfReattach(prof,0,prof_epoch);
 
     *((size_t*)newptr) = size;
-    update_zmalloc_stat_free(oldsize);
-    update_zmalloc_stat_alloc(size);
+    update_zmalloc_stat_resize(oldsize,size,tag);
+    zmallocProfOnAlloc((char*)newptr+PREFIX_SIZE,size,tag);
     if (usable) *usable = size;
     return (char*)newptr+PREFIX_SIZE;
 #endif
@@ -353,11 +1098,12 @@ void *zmalloc::ztryrealloc_usable(void *ptr, size_t size, size_t *usable)
  * zfree_usable - 释放已分配的内存块并获取可用大小
  * @ptr: 指向需要释放的内存块的指针
  * @usable: 用于存储内存块实际大小的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 释放ptr指向的内存块，并通过usable参数返回该内存块的实际大小。
  * 如果ptr为NULL，不执行任何操作，usable会被设置为0。
  */
-void zmalloc::zfree_usable(void *ptr, size_t *usable)
+void zmalloc::zfree_usable(void *ptr, size_t *usable, int tag)
 {
     #ifndef HAVE_MALLOC_SIZE
     void *realptr;
@@ -365,19 +1111,28 @@ void zmalloc::zfree_usable(void *ptr, size_t *usable)
 #endif
 
     if (ptr == NULL) return;
+#ifdef HAVE_ZMALLOC_HUGE
+    if (__builtin_expect(zmallocHugeFree(ptr,usable,tag),0)) return;
+#endif
 #ifdef HAVE_MALLOC_SIZE
-    update_zmalloc_stat_free(*usable = zmalloc_size(ptr));
+    update_zmalloc_stat_free(*usable = zmalloc_size(ptr),tag);
+    zmallocProfOnFree(ptr);
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    if (zmallocThreadCachePush(ptr,*usable)) return;
+#endif
     free(ptr);
 #else
     realptr = (char*)ptr-PREFIX_SIZE;
     *usable = oldsize = *((size_t*)realptr);
-    update_zmalloc_stat_free(oldsize+PREFIX_SIZE);
+    update_zmalloc_stat_free(oldsize+PREFIX_SIZE,tag);
+    zmallocProfOnFree(ptr);
     free(realptr);
 #endif
 }
 /**
  * zstrdup - 复制字符串
  * @s: 指向需要复制的字符串的指针
+ * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
  *
  * 分配足够的内存来存储字符串s的副本（包括终止符'\0'），
  * 并将s的内容复制到新分配的内存中。
@@ -388,10 +1143,10 @@ void zmalloc::zfree_usable(void *ptr, size_t *usable)
 // 复制输入字符串 s 到新分配的内存中
 // 返回指向新字符串的指针
 // 使用 Redis 自己的内存分配函数 zmalloc
-char *zmalloc::zstrdup(const char *s)
+char *zmalloc::zstrdup(const char *s, int tag)
 {
     size_t l = strlen(s)+1;
-    char *p = (char*)zzmalloc(l);
+    char *p = (char*)zzmalloc(l,tag);
     memcpy(p,s,l);
     return p;
 }
@@ -407,7 +1162,427 @@ size_t zmalloc::zmalloc_used_memory(void)
 {
     size_t um;
     atomicGet(used_memory,um);
-    return um;
+    /* 加上本线程尚未合并的增量，其他线程的误差不超过ZMALLOC_THREAD_STAT_BATCH。 */
+    return um + (size_t)zmalloc_tls.stat_delta;
+}
+
+/**
+ * zmalloc_thread_cache_flush - 清空当前线程的小对象缓存
+ *
+ * 把当前线程缓存的空闲块全部归还给底层分配器，并把线程本地
+ * 累积的used_memory增量合并到全局计数器。线程退出时会自动执行，
+ * 长期空闲的线程也可以主动调用以归还内存。
+ */
+void zmalloc::zmalloc_thread_cache_flush(void)
+{
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    zmallocThreadCacheRelease(&zmalloc_tls);
+#endif
+    zmallocThreadFlushDelta(&zmalloc_tls);
+}
+
+/**
+ * zmalloc_get_tag_stats - 获取各内存标签的统计值
+ * @stats: 输出数组，长度至少为ZMALLOC_TAG_COUNT
+ *
+ * 汇总已退出线程和所有存活线程的标签计数。各线程的计数是无锁写入的，
+ * 因此结果是近似快照，但同一线程内的分配与释放总是成对可见。
+ */
+void zmalloc::zmalloc_get_tag_stats(zmallocTagStats *stats)
+{
+    memset(stats,0,sizeof(zmallocTagStats)*ZMALLOC_TAG_COUNT);
+    pthread_mutex_lock(&zmalloc_threads_mutex);
+    zmallocTagStatsAdd(stats,zmalloc_retired_tags);
+    for (zmallocThreadState *ts = zmalloc_threads; ts; ts = ts->next)
+        zmallocTagStatsAdd(stats,ts->tags);
+    pthread_mutex_unlock(&zmalloc_threads_mutex);
+}
+
+/**
+ * zmalloc_tag_name - 获取内存标签的名称
+ * @tag: 内存标签（zmallocTag）
+ *
+ * 返回值: 标签名称，如"dict"、"sds"；非法标签返回"unknown"
+ */
+const char *zmalloc::zmalloc_tag_name(int tag)
+{
+    if (tag < 0 || tag >= ZMALLOC_TAG_COUNT) return "unknown";
+    return zmalloc_tag_names[tag];
+}
+
+#ifdef HAVE_BACKTRACE
+/* dump时的采样快照，相同调用栈的采样合并为一条。 */
+typedef struct zmallocProfEntry {
+    int tag;
+    int depth;
+    void *stack[ZMALLOC_PROF_MAX_DEPTH];
+    long long samples;          /* 原始采样数 */
+    long long bytes;            /* 原始采样字节数 */
+    double est_count;           /* 估计分配次数 */
+    double est_bytes;           /* 估计字节数 */
+} zmallocProfEntry;
+
+static int zmallocProfEntryCompare(const void *a, const void *b) {
+    const zmallocProfEntry *ea = (const zmallocProfEntry*)a, *eb = (const zmallocProfEntry*)b;
+    if (ea->tag != eb->tag) return ea->tag - eb->tag;
+    if (ea->depth != eb->depth) return ea->depth - eb->depth;
+    return memcmp(ea->stack,eb->stack,sizeof(void*)*ea->depth);
+}
+
+/* 从backtrace_symbols()的输出"模块(符号+偏移) [地址]"中取出可读的帧名：
+ * 有符号时反修饰并去掉参数列表，没有符号（静态函数或未导出）时用"模块名+偏移"。 */
+static void zmallocProfFrameName(const char *sym, char *buf, size_t buflen) {
+    const char *lp = strchr(sym,'(');
+    const char *rp = lp ? strchr(lp,')') : NULL;
+    const char *plus = lp ? strchr(lp,'+') : NULL;
+    if (!lp || !rp || !plus || plus > rp) {
+        snprintf(buf,buflen,"%s",sym);
+        return;
+    }
+    if (plus > lp+1) {
+        char mangled[512];
+        int status;
+        snprintf(mangled,sizeof(mangled),"%.*s",(int)(plus-lp-1),lp+1);
+        char *demangled = abi::__cxa_demangle(mangled,NULL,NULL,&status);
+        snprintf(buf,buflen,"%s",status == 0 ? demangled : mangled);
+        (free)(demangled);
+        for (char *p = buf; *p; p++) {
+            if (*p == '(' && p[1] != ')') {
+                *p = '\0';
+                break;
+            }
+            if (*p == '(') p++;
+        }
+    } else {
+        const char *base = lp;
+        while (base > sym && base[-1] != '/') base--;
+        snprintf(buf,buflen,"%.*s%.*s",(int)(lp-base),base,(int)(rp-plus),plus);
+    }
+    for (char *p = buf; *p; p++) if (*p == ';') *p = ':';
+}
+
+static int zmallocProfWriteCollapsed(FILE *fp, zmallocProfEntry *entries, long long count) {
+    char name[256];
+    for (long long j = 0; j < count; j++) {
+        zmallocProfEntry *e = &entries[j];
+        char **symbols = backtrace_symbols(e->stack,e->depth);
+        if (symbols == NULL) return -1;
+        /* 跳过zmalloc自身的帧，叶子落在调用方。 */
+        int leaf = 0;
+        while (leaf < e->depth-1) {
+            zmallocProfFrameName(symbols[leaf],name,sizeof(name));
+            if (strncmp(name,"REDIS_BASE::zmalloc::",21) != 0) break;
+            leaf++;
+        }
+        fprintf(fp,"%s",zmalloc_tag_names[e->tag]);
+        for (int k = e->depth-1; k >= leaf; k--) {
+            zmallocProfFrameName(symbols[k],name,sizeof(name));
+            fprintf(fp,";%s",name);
+        }
+        fprintf(fp," %lld\n",(long long)(e->est_bytes+0.5));
+        (free)(symbols);
+    }
+    return 0;
+}
+
+static int zmallocProfWritePprof(FILE *fp, zmallocProfEntry *entries, long long count, size_t rate) {
+    long long samples = 0, bytes = 0;
+    for (long long j = 0; j < count; j++) {
+        samples += entries[j].samples;
+        bytes += entries[j].bytes;
+    }
+    /* heap_v2格式写原始采样值，pprof按 1/(1-exp(-平均大小/rate)) 还原。 */
+    fprintf(fp,"heap profile: %lld: %lld [ %lld: %lld] @ heap_v2/%zu\n",
+        samples,bytes,samples,bytes,rate);
+    for (long long j = 0; j < count; j++) {
+        zmallocProfEntry *e = &entries[j];
+        fprintf(fp,"%lld: %lld [ %lld: %lld] @",e->samples,e->bytes,e->samples,e->bytes);
+        for (int k = 0; k < e->depth; k++) fprintf(fp," %p",e->stack[k]);
+        fprintf(fp,"\n");
+    }
+    fprintf(fp,"\nMAPPED_LIBRARIES:\n");
+#if defined(HAVE_PROC_MAPS)
+    FILE *maps = fopen("/proc/self/maps","r");
+    if (maps) {
+        char line[1024];
+        while (fgets(line,sizeof(line),maps) != NULL) fputs(line,fp);
+        fclose(maps);
+    }
+#endif
+    return 0;
+}
+#endif
+
+/**
+ * zmalloc_set_soft_limit - 设置内存软上限
+ * @bytes: 软上限（字节），0表示关闭压力回调
+ */
+void zmalloc::zmalloc_set_soft_limit(size_t bytes)
+{
+    pthread_mutex_lock(&zmalloc_pressure_mutex);
+    atomicSet(zmalloc_soft_limit,bytes);
+    for (int j = 0; j < ZMALLOC_PRESSURE_MAX_HOOKS; j++) {
+        zmalloc_pressure_hooks[j].fired = 0;
+        zmalloc_pressure_hooks[j].pending = 0;
+    }
+    zmallocPressureUpdateBounds();
+    pthread_mutex_unlock(&zmalloc_pressure_mutex);
+}
+
+/**
+ * zmalloc_get_soft_limit - 获取内存软上限
+ *
+ * 返回值: 软上限（字节），0表示未设置
+ */
+size_t zmalloc::zmalloc_get_soft_limit(void)
+{
+    size_t limit;
+    atomicGet(zmalloc_soft_limit,limit);
+    return limit;
+}
+
+/**
+ * zmalloc_register_pressure_callback - 注册内存压力回调
+ * @cb: 回调函数
+ * @privdata: 传给回调的私有数据
+ * @watermark: 水位，软上限的百分比
+ * @flags: ZMALLOC_PRESSURE_SYNC 或 0
+ *
+ * 返回值: 成功返回回调id（>=0），回调已满或参数非法返回-1
+ */
+int zmalloc::zmalloc_register_pressure_callback(zmallocPressureCallback cb, void *privdata, int watermark, int flags)
+{
+    int id = -1;
+    if (cb == NULL || watermark <= 0) return -1;
+    pthread_mutex_lock(&zmalloc_pressure_mutex);
+    for (int j = 0; j < ZMALLOC_PRESSURE_MAX_HOOKS; j++) {
+        zmallocPressureHook *h = &zmalloc_pressure_hooks[j];
+        if (h->cb) continue;
+        h->cb = cb;
+        h->privdata = privdata;
+        h->watermark = watermark;
+        h->flags = flags;
+        h->fired = h->pending = 0;
+        id = j;
+        break;
+    }
+    zmallocPressureUpdateBounds();
+    pthread_mutex_unlock(&zmalloc_pressure_mutex);
+    return id;
+}
+
+/**
+ * zmalloc_unregister_pressure_callback - 取消注册内存压力回调
+ * @id: 注册时返回的id
+ *
+ * 返回值: 成功返回0，id无效返回-1
+ */
+int zmalloc::zmalloc_unregister_pressure_callback(int id)
+{
+    if (id < 0 || id >= ZMALLOC_PRESSURE_MAX_HOOKS) return -1;
+    pthread_mutex_lock(&zmalloc_pressure_mutex);
+    zmallocPressureHook *h = &zmalloc_pressure_hooks[id];
+    int ret = h->cb ? 0 : -1;
+    memset(h,0,sizeof(*h));
+    zmallocPressureUpdateBounds();
+    pthread_mutex_unlock(&zmalloc_pressure_mutex);
+    return ret;
+}
+
+/**
+ * zmalloc_pressure_poll - 在安全点处理内存压力
+ *
+ * 返回值: 本次调用的回调个数
+ */
+int zmalloc::zmalloc_pressure_poll(void)
+{
+    zmallocThreadState *ts = &zmalloc_tls;
+    zmallocPressureHook calls[ZMALLOC_PRESSURE_MAX_HOOKS];
+    int numcalls;
+    size_t um;
+
+    if (ts->pressure_running) return 0;
+    zmallocThreadFlushDelta(ts);
+    atomicGet(used_memory,um);
+    pthread_mutex_lock(&zmalloc_pressure_mutex);
+    numcalls = zmallocPressureEvaluate(um,calls);
+    for (int j = 0; j < ZMALLOC_PRESSURE_MAX_HOOKS; j++) {
+        zmallocPressureHook *h = &zmalloc_pressure_hooks[j];
+        if (h->cb == NULL || !h->pending) continue;
+        h->pending = 0;
+        calls[numcalls++] = *h;
+    }
+    pthread_mutex_unlock(&zmalloc_pressure_mutex);
+    if (numcalls) zmallocPressureRun(ts,calls,numcalls,um);
+    return numcalls;
+}
+
+/**
+ * zmalloc_set_huge_pages - 配置大块mmap分配
+ * @threshold: 不小于该值的分配走mmap，0表示关闭
+ * @use_thp: 非0时对映射区域调用madvise(MADV_HUGEPAGE)
+ */
+void zmalloc::zmalloc_set_huge_pages(size_t threshold, int use_thp)
+{
+#ifdef HAVE_ZMALLOC_HUGE
+    atomicSet(zmalloc_huge_threshold,threshold);
+    atomicSet(zmalloc_huge_thp,use_thp ? 1 : 0);
+#else
+    ((void)(threshold));
+    ((void)(use_thp));
+#endif
+}
+
+/**
+ * zmalloc_get_huge_stats - 获取大块mmap分配的统计
+ * @blocks: 输出存活大块数
+ * @bytes: 输出存活大块的映射字节数
+ */
+void zmalloc::zmalloc_get_huge_stats(size_t *blocks, size_t *bytes)
+{
+#ifdef HAVE_ZMALLOC_HUGE
+    pthread_mutex_lock(&zmalloc_huge_mutex);
+    *blocks = zmalloc_huge_blocks;
+    *bytes = zmalloc_huge_bytes;
+    pthread_mutex_unlock(&zmalloc_huge_mutex);
+#else
+    *blocks = *bytes = 0;
+#endif
+}
+
+/**
+ * zmalloc_huge_size - 查询大块的映射长度
+ * @ptr: 内存块指针
+ *
+ * 返回值: ptr是mmap大块时返回其长度，否则返回0
+ */
+size_t zmalloc::zmalloc_huge_size(void *ptr)
+{
+#ifdef HAVE_ZMALLOC_HUGE
+    return zmallocHugeLookup(ptr);
+#else
+    ((void)(ptr));
+    return 0;
+#endif
+}
+
+/**
+ * zmalloc_prof_start - 开启采样式堆分析
+ * @sample_bytes: 平均采样间隔（字节），0表示使用ZMALLOC_PROF_DEFAULT_SAMPLE
+ *
+ * 返回值: 成功返回0，平台不支持backtrace()时返回-1
+ */
+int zmalloc::zmalloc_prof_start(size_t sample_bytes)
+{
+#ifdef HAVE_BACKTRACE
+    void *warmup[1];
+    /* 第一次调用backtrace()会加载libgcc并分配内存，提前在锁外完成。 */
+    backtrace(warmup,1);
+    if (sample_bytes == 0) sample_bytes = ZMALLOC_PROF_DEFAULT_SAMPLE;
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    zmallocProfFreeAll();
+    zmalloc_prof_total = 0;
+    atomicIncr(zmalloc_prof_epoch,1);
+    atomicSet(zmalloc_prof_rate,sample_bytes);
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+    return 0;
+#else
+    ((void)(sample_bytes));
+    return -1;
+#endif
+}
+
+/**
+ * zmalloc_prof_stop - 关闭堆分析并丢弃所有采样
+ */
+void zmalloc::zmalloc_prof_stop(void)
+{
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    atomicSet(zmalloc_prof_rate,0);
+    atomicIncr(zmalloc_prof_epoch,1);
+    zmallocProfFreeAll();
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+}
+
+/**
+ * zmalloc_prof_dump - 把存活采样写入文件
+ * @filename: 输出文件路径
+ * @format: ZMALLOC_PROF_FORMAT_COLLAPSED 或 ZMALLOC_PROF_FORMAT_PPROF
+ *
+ * 返回值: 成功返回0，未开启或写文件失败返回-1
+ */
+int zmalloc::zmalloc_prof_dump(const char *filename, int format)
+{
+#ifdef HAVE_BACKTRACE
+    size_t rate;
+    long long live, count = 0, merged = 0;
+    zmallocProfEntry *entries;
+
+    atomicGet(zmalloc_prof_rate,rate);
+    if (rate == 0) return -1;
+    /* 加锁期间只做拷贝。快照数组按当前存活数分配，锁内再次检查上界。 */
+    atomicGet(zmalloc_prof_live,live);
+    entries = (zmallocProfEntry*)malloc(sizeof(zmallocProfEntry)*(live+1));
+    if (entries == NULL) return -1;
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    for (int j = 0; j < ZMALLOC_PROF_TABLE_SIZE && count <= live; j++) {
+        for (zmallocProfSample *s = zmalloc_prof_table[j]; s && count <= live; s = s->next) {
+            zmallocProfEntry *e = &entries[count++];
+            e->tag = s->tag;
+            e->depth = s->depth;
+            memcpy(e->stack,s->stack,sizeof(void*)*s->depth);
+            e->samples = 1;
+            e->bytes = (long long)s->size;
+            e->est_count = s->weight;
+            e->est_bytes = s->weight * (double)s->size;
+        }
+    }
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
+
+    qsort(entries,count,sizeof(zmallocProfEntry),zmallocProfEntryCompare);
+    for (long long j = 0; j < count; j++) {
+        if (merged && zmallocProfEntryCompare(&entries[merged-1],&entries[j]) == 0) {
+            zmallocProfEntry *e = &entries[merged-1];
+            e->samples += entries[j].samples;
+            e->bytes += entries[j].bytes;
+            e->est_count += entries[j].est_count;
+            e->est_bytes += entries[j].est_bytes;
+        } else {
+            if (merged != j) entries[merged] = entries[j];
+            merged++;
+        }
+    }
+
+    int ret = -1;
+    FILE *fp = fopen(filename,"w");
+    if (fp) {
+        if (format == ZMALLOC_PROF_FORMAT_PPROF)
+            ret = zmallocProfWritePprof(fp,entries,merged,rate);
+        else
+            ret = zmallocProfWriteCollapsed(fp,entries,merged);
+        if (fclose(fp) != 0) ret = -1;
+    }
+    free(entries);
+    return ret;
+#else
+    ((void)(filename));
+    ((void)(format));
+    return -1;
+#endif
+}
+
+/**
+ * zmalloc_prof_get_stats - 获取堆分析器统计值
+ * @stats: 输出统计
+ */
+void zmalloc::zmalloc_prof_get_stats(zmallocProfStats *stats)
+{
+    pthread_mutex_lock(&zmalloc_prof_mutex);
+    atomicGet(zmalloc_prof_rate,stats->sample_bytes);
+    atomicGet(zmalloc_prof_live,stats->live_samples);
+    stats->samples = zmalloc_prof_total;
+    stats->live_bytes = (long long)(zmalloc_prof_live_bytes+0.5);
+    pthread_mutex_unlock(&zmalloc_prof_mutex);
 }
 // 允许调用者注册一个自定义的内存分配失败处理函数
 // 将传入的函数指针保存到全局变量中
@@ -831,26 +2006,99 @@ size_t zmalloc::zmalloc_get_memory_size(void) {
  */
 void zmalloc::zlibc_free(void *ptr)
 {
-     free(ptr);
+     (free)(ptr);
 }
 
 
 #ifdef HAVE_DEFRAG
-void zmalloc::zfree_no_tcache(void *ptr)
+void zmalloc::zfree_no_tcache(void *ptr, int tag)
 {
     if (ptr == NULL) return;
-    update_zmalloc_stat_free(zmalloc_size(ptr));
+    update_zmalloc_stat_free(zmalloc_size(ptr),tag);
     dallocx(ptr, MALLOCX_TCACHE_NONE);
 }
-void *zmalloc::zmalloc_no_tcache(size_t size)
+void *zmalloc::zmalloc_no_tcache(size_t size, int tag)
 {
     ASSERT_NO_SIZE_OVERFLOW(size);
     void *ptr = mallocx(size+PREFIX_SIZE, MALLOCX_TCACHE_NONE);
     if (!ptr) zmalloc_oom_handler(size);
-    update_zmalloc_stat_alloc(zmalloc_size(ptr));
+    update_zmalloc_stat_alloc(zmalloc_size(ptr),tag);
     return ptr;
 }
 #endif
+
+/**
+ * zmalloc_defrag_hint - 判断一个内存块是否值得搬迁
+ * @ptr: 已分配的内存块
+ *
+ * 返回值: 建议搬迁返回1，否则返回0
+ */
+int zmalloc::zmalloc_defrag_hint(void *ptr)
+{
+#if defined(HAVE_DEFRAG) && defined(JEMALLOC_FRAG_HINT)
+    /* Redis patched jemalloc: the hint is computed inside the allocator. */
+    return je_get_defrag_hint(ptr);
+#elif defined(HAVE_DEFRAG)
+    struct {
+        size_t nfree;       /* ptr所在slab的空闲region数 */
+        size_t nregs;       /* ptr所在slab的region总数 */
+        size_t size;        /* region大小 */
+        size_t bin_nfree;   /* 同一bin所有slab的空闲region数 */
+        size_t bin_nregs;   /* 同一bin所有slab的region总数 */
+        void *slabcur_addr; /* bin当前用于分配的slab */
+    } util;
+    size_t sz = sizeof(util);
+    if (je_mallctl("experimental.utilization.query", &util, &sz, &ptr, sizeof(ptr)))
+        return 0;
+    /* 大块（不在slab里）或slab已满，搬迁没有收益。 */
+    if (util.nregs <= 1 || util.nfree == 0) return 0;
+    /* 新分配会落在slabcur上，搬自己所在的slab没有意义。 */
+    if (util.slabcur_addr && (char*)ptr >= (char*)util.slabcur_addr &&
+        (char*)ptr < (char*)util.slabcur_addr + util.nregs*util.size) return 0;
+    /* slab使用率低于bin平均使用率时搬迁：
+     * (nregs-nfree)/nregs < (bin_nregs-bin_nfree)/bin_nregs */
+    return (util.nregs-util.nfree)*util.bin_nregs <
+           (util.bin_nregs-util.bin_nfree)*util.nregs;
+#else
+    ((void)(ptr));
+    return 0;
+#endif
+}
+
+/**
+ * zmalloc_defrag_move - 把内存块搬到新分配的位置
+ * @ptr: 已分配的内存块
+ * @tag: 内存归属标签（zmallocTag）
+ *
+ * 返回值: 新内存块指针，分配失败时返回NULL（旧块保持不变）
+ */
+void *zmalloc::zmalloc_defrag_move(void *ptr, int tag)
+{
+#if defined(HAVE_DEFRAG)
+    size_t size = zmalloc_size(ptr);
+    void *newptr = zmalloc_no_tcache(size,tag);
+    memcpy(newptr,ptr,size);
+    zmallocProfOnMove(ptr,newptr);
+    zfree_no_tcache(ptr,tag);
+    return newptr;
+#elif defined(HAVE_MALLOC_SIZE)
+    /* mmap大块独占自己的映射，搬迁没有意义。 */
+    if (zmalloc_huge_size(ptr)) return NULL;
+    /* 直接走底层malloc/free，不经过线程缓存，旧块会真正还给分配器。 */
+    size_t size = zmalloc_size(ptr);
+    void *newptr = malloc(size);
+    if (!newptr) return NULL;
+    memcpy(newptr,ptr,size);
+    update_zmalloc_stat_resize(size,zmalloc_size(newptr),tag);
+    zmallocProfOnMove(ptr,newptr);
+    free(ptr);
+    return newptr;
+#else
+    ((void)(ptr));
+    ((void)(tag));
+    return NULL;
+#endif
+}
 // [ size_t 类型的大小信息 | 用户数据 ]
 // <---- PREFIX_SIZE ----><-- 用户空间 -->
 #ifndef HAVE_MALLOC_SIZE
@@ -71,54 +71,149 @@ XSTR(FOO) // 会变成 "bar"
 /* We can enable the Redis defrag capabilities only if we are using Jemalloc
  * and the version used is our special version modified for Redis having
  * the ability to return per-allocation fragmentation hints. */
-#if defined(USE_JEMALLOC) && defined(JEMALLOC_FRAG_HINT)
+/* 未打补丁的jemalloc 5.1+可以通过 experimental.utilization.query 得到同样的
+ * 信息（所在slab与所在bin的使用率），因此也能启用碎片整理。 */
+#if defined(USE_JEMALLOC) && (defined(JEMALLOC_FRAG_HINT) || JEMALLOC_VERSION_MAJOR > 5 || \
+    (JEMALLOC_VERSION_MAJOR == 5 && JEMALLOC_VERSION_MINOR >= 1))
 #define HAVE_DEFRAG
 #endif
+
+/* 线程本地小对象缓存与used_memory批量统计。
+ * 每个线程把 <= ZMALLOC_THREAD_CACHE_MAX_SIZE 的已释放内存块按size class挂在
+ * 本地空闲链表上，下次同class的分配直接复用，避免进入malloc；used_memory的增减
+ * 先累积在线程本地，超过 ZMALLOC_THREAD_STAT_BATCH 再合并到全局原子计数器。
+ * 因此 zmalloc_used_memory() 的误差上界为 线程数 * ZMALLOC_THREAD_STAT_BATCH。
+ * 缓存需要通过块地址反查块大小，所以只在 HAVE_MALLOC_SIZE 时启用，
+ * 定义 NO_ZMALLOC_THREAD_CACHE 可关闭。jemalloc自带tcache，而且缓存块会
+ * 妨碍碎片整理，所以USE_JEMALLOC时不启用。 */
+#if defined(HAVE_MALLOC_SIZE) && !defined(NO_ZMALLOC_THREAD_CACHE) && !defined(USE_JEMALLOC)
+#define HAVE_ZMALLOC_THREAD_CACHE
+#endif
+#define ZMALLOC_THREAD_CACHE_MAX_SIZE 4096      /* 可缓存的最大块（字节） */
+#define ZMALLOC_THREAD_CACHE_CLASSES 48         /* 8..256每8字节一档，之后每次翻倍分4档 */
+#define ZMALLOC_THREAD_CACHE_SLOTS 64           /* 每个size class最多缓存的块数 */
+#define ZMALLOC_THREAD_CACHE_BYTES (256*1024)   /* 每个线程缓存的总字节上限 */
+#define ZMALLOC_THREAD_STAT_BATCH (16*1024)     /* 线程本地统计增量的合并阈值 */
+
+/* 采样式堆分析：平均每分配 sample_bytes 字节采样一次（间隔服从指数分布），
+ * 记录该次分配的调用栈，直到内存块被释放。关闭时热路径上只多一次全局读。 */
+#define ZMALLOC_PROF_DEFAULT_SAMPLE (512*1024)  /* 默认平均采样间隔（字节） */
+#define ZMALLOC_PROF_MAX_DEPTH 32               /* 每个采样保存的最大栈深度 */
+#define ZMALLOC_PROF_TABLE_SIZE 65536           /* 存活采样哈希表的桶数（2的幂） */
+#define ZMALLOC_PROF_FORMAT_COLLAPSED 0         /* 折叠栈格式，flamegraph.pl/speedscope可直接读取 */
+#define ZMALLOC_PROF_FORMAT_PPROF 1             /* gperftools legacy heap profile，pprof可读取 */
+
+/* 大块分配走mmap：不小于阈值的块单独映射，起始地址按2MB对齐并可用
+ * MADV_HUGEPAGE请求透明大页，减少探测大哈希表时的TLB miss；realloc用mremap
+ * 移动页表而不拷贝数据。默认关闭，由zmalloc_set_huge_pages()设置阈值开启。
+ * 块的映射长度登记在按地址索引的基数树里，zmalloc_size遇到2MB对齐的地址
+ * 才去查表，查表不加锁。jemalloc/tcmalloc自己管理大块和大页，不编译；
+ * 定义 NO_ZMALLOC_HUGE 可去掉。 */
+#if defined(__linux__) && defined(HAVE_MALLOC_SIZE) && !defined(USE_JEMALLOC) && \
+    !defined(USE_TCMALLOC) && !defined(NO_ZMALLOC_HUGE)
+#define HAVE_ZMALLOC_HUGE
+#undef zmalloc_size
+#define zmalloc_size(p) REDIS_BASE::zmalloc::zmalloc_block_size(p)
+#endif
+#define ZMALLOC_HUGE_ALIGN (2*1024*1024)                /* 大页大小，也是大块的对齐粒度 */
+#define ZMALLOC_HUGE_DEFAULT_THRESHOLD 0                /* 默认阈值，0表示关闭 */
+#define ZMALLOC_HUGE_SUGGESTED_THRESHOLD (2*1024*1024)  /* 开启时建议的最小块大小 */
+#define ZMALLOC_HUGE_ADDR_BITS 48                       /* 大块登记表覆盖的用户态地址位数 */
+#define ZMALLOC_HUGE_LEAF_BITS 13                       /* 登记表每个叶子覆盖2^13个2MB粒度 */
+
+/* 内存压力回调：设置软上限后，used_memory向上越过 上限*watermark% 时触发
+ * 注册的回调，回落到 watermark-ZMALLOC_PRESSURE_HYSTERESIS 以下后重新生效。
+ * 检查放在线程本地统计增量合并到全局计数器的时候，热路径没有额外开销，
+ * 检测粒度为 ZMALLOC_THREAD_STAT_BATCH。 */
+#define ZMALLOC_PRESSURE_MAX_HOOKS 16       /* 最多可注册的回调数 */
+#define ZMALLOC_PRESSURE_HYSTERESIS 5       /* 重新生效前需回落的百分比 */
+#define ZMALLOC_PRESSURE_SYNC (1<<0)        /* 在越线的分配中同步调用，否则等zmalloc_pressure_poll() */
 //=====================================================================//
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
+/* 内存归属标签：按子系统统计存活字节数与分配次数。
+ * 各模块的.cpp在包含zmallocDf.h之前定义ZMALLOC_TAG，该文件中的
+ * zmalloc/zfree等宏就会自动带上对应标签；跨模块释放的内存用
+ * zfree_tag等显式指定标签，保证分配和释放记在同一个标签上。 */
+typedef enum zmallocTag {
+    ZMALLOC_TAG_OTHER = 0,
+    ZMALLOC_TAG_DICT,
+    ZMALLOC_TAG_SDS,
+    ZMALLOC_TAG_ZIPLIST,
+    ZMALLOC_TAG_LISTPACK,
+    ZMALLOC_TAG_QUICKLIST,
+    ZMALLOC_TAG_SKIPLIST,
+    ZMALLOC_TAG_RAX,
+    ZMALLOC_TAG_STREAM,
+    ZMALLOC_TAG_COUNT
+} zmallocTag;
+
+/* 堆分析器统计值 */
+typedef struct zmallocProfStats {
+    size_t sample_bytes;        /* 平均采样间隔，0表示未开启 */
+    long long samples;          /* 本次开启以来的累计采样次数 */
+    long long live_samples;     /* 尚未释放的采样数 */
+    long long live_bytes;       /* 存活采样代表的估计字节数 */
+} zmallocProfStats;
+
+/* 内存压力回调
+ * @watermark: 注册时指定的水位（软上限的百分比）
+ * @used: 触发时的used_memory
+ * @limit: 软上限
+ * @privdata: 注册时传入的私有数据 */
+typedef void (*zmallocPressureCallback)(int watermark, size_t used, size_t limit, void *privdata);
+
+/* 单个标签的统计值。跨标签释放（误用）会让某个标签出现负数，所以用有符号类型。 */
+typedef struct zmallocTagStats {
+    long long used;         /* 当前存活字节数 */
+    long long count;        /* 当前存活的分配块数 */
+    long long allocs;       /* 累计分配次数 */
+} zmallocTagStats;
+
+/* zmalloc没有实例状态，所有接口都是静态成员函数，zmallocDf.h里的宏直接
+ * 调用 zmalloc::xxx()，热路径上没有单例判空和间接寻址。getInstance()
+ * 保留给旧代码，实例在编译期完成常量初始化，多线程下调用也是安全的。 */
 class  zmalloc
 {
     private:
-        zmalloc(){}
+        constexpr zmalloc(){}
         zmalloc(const zmalloc&) = delete;
         zmalloc& operator=(const zmalloc&) = delete;
-        static zmalloc* instance;
+        static zmalloc instance;
     public:
         static zmalloc* getInstance(){
-            if (instance == nullptr)
-            {
-                instance = new zmalloc();
-            }
-            return instance;
-        }  
+            return &instance;
+        }
     public:
         /**
          * zzmalloc - 分配指定大小的内存块
          * @size: 需要分配的字节数
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，不对内存内容进行初始化。
          * 如果分配失败，会调用内存不足处理函数(oom_handler)。
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *zzmalloc(size_t size);
+        static void *zzmalloc(size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztrymalloc - 尝试分配指定大小的内存块
          * @size: 需要分配的字节数
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，不对内存内容进行初始化。
          * 与zzmalloc不同，分配失败时不会调用oom_handler，而是直接返回NULL。
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *ztrymalloc(size_t size);
+        static void *ztrymalloc(size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zmalloc_usable - 分配指定大小的内存块并获取实际可用大小
          * @size: 需要分配的字节数
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，不对内存内容进行初始化，
          * 并通过usable参数返回实际分配的内存大小（可能大于请求的大小）。
@@ -126,12 +221,13 @@ class  zmalloc
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *zmalloc_usable(size_t size, size_t *usable);
+        static void *zmalloc_usable(size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztrymalloc_usable - 尝试分配内存并获取实际可用大小
          * @size: 需要分配的字节数
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，不对内存内容进行初始化，
          * 并通过usable参数返回实际分配的内存大小。
@@ -139,34 +235,37 @@ class  zmalloc
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *ztrymalloc_usable(size_t size, size_t *usable);
+        static void *ztrymalloc_usable(size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zcalloc - 分配并清零内存块
          * @size: 需要分配的字节数
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，并将所有字节初始化为0。
          * 如果分配失败，会调用oom_handler。
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *zcalloc(size_t size);
+        static void *zcalloc(size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztrycalloc - 尝试分配并清零内存块
          * @size: 需要分配的字节数
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，并将所有字节初始化为0。
          * 分配失败时不调用oom_handler，直接返回NULL。
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *ztrycalloc(size_t size);
+        static void *ztrycalloc(size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zcalloc_usable - 分配、清零内存并获取实际可用大小
          * @size: 需要分配的字节数
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，将所有字节初始化为0，
          * 并通过usable参数返回实际分配的内存大小。
@@ -174,12 +273,13 @@ class  zmalloc
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *zcalloc_usable(size_t size, size_t *usable);
+        static void *zcalloc_usable(size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztrycalloc_usable - 尝试分配、清零内存并获取可用大小
          * @size: 需要分配的字节数
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配指定大小的内存块，将所有字节初始化为0，
          * 并通过usable参数返回实际分配的内存大小。
@@ -187,12 +287,13 @@ class  zmalloc
          *
          * 返回值: 成功时返回分配内存的指针，失败时返回NULL
          */
-        void *ztrycalloc_usable(size_t size, size_t *usable);
+        static void *ztrycalloc_usable(size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zrealloc - 调整已分配内存块的大小
          * @ptr: 指向需要调整大小的内存块的指针
          * @size: 新的大小（字节）
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 调整ptr指向的内存块大小为size字节。
          * 如果ptr为NULL，等效于调用zzmalloc(size)。
@@ -202,68 +303,74 @@ class  zmalloc
          *
          * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
          */
-        void *zrealloc(void *ptr, size_t size);
+        static void *zrealloc(void *ptr, size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztryrealloc - 尝试调整已分配内存块的大小
          * @ptr: 指向需要调整大小的内存块的指针
          * @size: 新的大小（字节）
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 功能与zrealloc类似，但分配失败时不调用oom_handler，直接返回NULL，
          * 原内存块不会被释放。
          *
          * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
          */
-        void *ztryrealloc(void *ptr, size_t size);
+        static void *ztryrealloc(void *ptr, size_t size, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zrealloc_usable - 调整内存大小并获取实际可用大小
          * @ptr: 指向需要调整大小的内存块的指针
          * @size: 新的大小（字节）
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 调整内存块大小并通过usable参数返回实际分配的内存大小。
          * 其他行为与zrealloc相同。
          *
          * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
          */
-        void *zrealloc_usable(void *ptr, size_t size, size_t *usable);
+        static void *zrealloc_usable(void *ptr, size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * ztryrealloc_usable - 尝试调整内存大小并获取可用大小
          * @ptr: 指向需要调整大小的内存块的指针
          * @size: 新的大小（字节）
          * @usable: 用于存储实际分配内存大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 功能与zrealloc_usable类似，但分配失败时不调用oom_handler，
          * 直接返回NULL，原内存块不会被释放。
          *
          * 返回值: 成功时返回调整后内存的指针，失败时返回NULL
          */
-        void *ztryrealloc_usable(void *ptr, size_t size, size_t *usable);
+        static void *ztryrealloc_usable(void *ptr, size_t size, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zfree - 释放已分配的内存块
          * @ptr: 指向需要释放的内存块的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 释放ptr指向的内存块。如果ptr为NULL，不执行任何操作。
          * 释放后，ptr变为无效指针，不应再被使用。
          */
-        void zfree(void *ptr);
+        static void zfree(void *ptr, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zfree_usable - 释放已分配的内存块并获取可用大小
          * @ptr: 指向需要释放的内存块的指针
          * @usable: 用于存储内存块实际大小的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 释放ptr指向的内存块，并通过usable参数返回该内存块的实际大小。
          * 如果ptr为NULL，不执行任何操作，usable会被设置为0。
          */
-        void zfree_usable(void *ptr, size_t *usable);
+        static void zfree_usable(void *ptr, size_t *usable, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zstrdup - 复制字符串
          * @s: 指向需要复制的字符串的指针
+         * @tag: 内存归属标签（zmallocTag），默认ZMALLOC_TAG_OTHER
          *
          * 分配足够的内存来存储字符串s的副本（包括终止符'\0'），
          * 并将s的内容复制到新分配的内存中。
@@ -271,7 +378,7 @@ class  zmalloc
          *
          * 返回值: 成功时返回指向新字符串的指针，失败时返回NULL
          */
-        char *zstrdup(const char *s);
+        static char *zstrdup(const char *s, int tag = ZMALLOC_TAG_OTHER);
 
         /**
          * zmalloc_used_memory - 获取已使用的内存总量
@@ -281,7 +388,159 @@ class  zmalloc
          *
          * 返回值: 已使用的内存总量（字节）
          */
-        size_t zmalloc_used_memory(void);
+        static size_t zmalloc_used_memory(void);
+
+        /**
+         * zmalloc_thread_cache_flush - 清空当前线程的小对象缓存
+         *
+         * 把当前线程缓存的空闲块全部归还给底层分配器，并把线程本地
+         * 累积的used_memory增量合并到全局计数器。线程退出时会自动执行，
+         * 长期空闲的线程也可以主动调用以归还内存。
+         */
+        static void zmalloc_thread_cache_flush(void);
+
+        /**
+         * zmalloc_get_tag_stats - 获取各内存标签的统计值
+         * @stats: 输出数组，至少ZMALLOC_TAG_COUNT个元素
+         *
+         * 汇总所有线程本地的标签计数（以及已退出线程合并下来的部分），
+         * 按zmallocTag下标写入stats。读取时加锁遍历线程列表，不在热路径上调用。
+         */
+        static void zmalloc_get_tag_stats(zmallocTagStats *stats);
+
+        /**
+         * zmalloc_tag_name - 获取内存标签的名称
+         * @tag: 内存标签（zmallocTag）
+         *
+         * 返回值: 标签名称字符串，如"dict"、"sds"；非法标签返回"unknown"
+         */
+        static const char *zmalloc_tag_name(int tag);
+
+        /**
+         * zmalloc_prof_start - 开启采样式堆分析
+         * @sample_bytes: 平均采样间隔（字节），0表示使用ZMALLOC_PROF_DEFAULT_SAMPLE
+         *
+         * 清空之前的采样并开始采样。被采样的分配会记录调用栈、大小和标签，
+         * 释放时从存活表中删除，因此dump出来的是当前仍存活内存的分布。
+         * 大小为size的分配被采中的概率为 1-exp(-size/sample_bytes)，
+         * 输出时按该概率的倒数还原估计值。
+         *
+         * 返回值: 成功返回0，平台不支持backtrace()时返回-1
+         */
+        static int zmalloc_prof_start(size_t sample_bytes);
+
+        /**
+         * zmalloc_prof_stop - 关闭堆分析并丢弃所有采样
+         */
+        static void zmalloc_prof_stop(void);
+
+        /**
+         * zmalloc_prof_dump - 把存活采样写入文件
+         * @filename: 输出文件路径
+         * @format: ZMALLOC_PROF_FORMAT_COLLAPSED 或 ZMALLOC_PROF_FORMAT_PPROF
+         *
+         * 相同调用栈（及标签）的采样合并为一行。折叠栈格式每行为
+         * "标签;根帧;...;叶帧 估计字节数"；pprof格式写入原始采样值和
+         * /proc/self/maps，由pprof负责符号化和还原。
+         * 只在加锁时拷贝采样，符号化和写文件都在锁外进行。
+         *
+         * 返回值: 成功返回0，未开启或写文件失败返回-1
+         */
+        static int zmalloc_prof_dump(const char *filename, int format);
+
+        /**
+         * zmalloc_prof_get_stats - 获取堆分析器统计值
+         * @stats: 输出统计
+         */
+        static void zmalloc_prof_get_stats(zmallocProfStats *stats);
+
+        /**
+         * zmalloc_set_huge_pages - 配置大块mmap分配
+         * @threshold: 不小于该值的分配走mmap，0表示关闭（已分配的大块不受影响）
+         * @use_thp: 非0时对映射区域调用madvise(MADV_HUGEPAGE)
+         *
+         * 默认关闭（ZMALLOC_HUGE_DEFAULT_THRESHOLD为0），开启时建议使用
+         * ZMALLOC_HUGE_SUGGESTED_THRESHOLD。
+         * 没有HAVE_ZMALLOC_HUGE的构建中为空操作。
+         */
+        static void zmalloc_set_huge_pages(size_t threshold, int use_thp);
+
+        /**
+         * zmalloc_get_huge_stats - 获取大块mmap分配的统计
+         * @blocks: 输出存活大块数
+         * @bytes: 输出存活大块的映射字节数（已计入used_memory）
+         */
+        static void zmalloc_get_huge_stats(size_t *blocks, size_t *bytes);
+
+        /**
+         * zmalloc_huge_size - 查询大块的映射长度
+         * @ptr: 内存块指针
+         *
+         * 返回值: ptr是mmap大块时返回其长度，否则返回0
+         */
+        static size_t zmalloc_huge_size(void *ptr);
+
+        #ifdef HAVE_ZMALLOC_HUGE
+        /* zmalloc_size的实现：只有2MB对齐的地址才可能是大块，其余直接问malloc。 */
+        static inline size_t zmalloc_block_size(void *ptr) {
+            if (__builtin_expect(((uintptr_t)ptr & (ZMALLOC_HUGE_ALIGN-1)) == 0,0)) {
+                size_t len = zmalloc_huge_size(ptr);
+                if (len) return len;
+            }
+            return malloc_usable_size(ptr);
+        }
+        #endif
+
+        /**
+         * zmalloc_set_soft_limit - 设置内存软上限
+         * @bytes: 软上限（字节），0表示关闭压力回调
+         *
+         * 修改上限会让所有回调重新生效，下一次统计合并时按新上限重新判断。
+         */
+        static void zmalloc_set_soft_limit(size_t bytes);
+
+        /**
+         * zmalloc_get_soft_limit - 获取内存软上限
+         *
+         * 返回值: 软上限（字节），0表示未设置
+         */
+        static size_t zmalloc_get_soft_limit(void);
+
+        /**
+         * zmalloc_register_pressure_callback - 注册内存压力回调
+         * @cb: 回调函数
+         * @privdata: 传给回调的私有数据
+         * @watermark: 水位，软上限的百分比（1-100以上均可）
+         * @flags: ZMALLOC_PRESSURE_SYNC 表示在越线的分配/释放中同步调用。
+         *         同步回调运行在分配器内部，只能释放与当前操作无关的内存
+         *         （如压缩缓存），不能修改可能正被调用方修改的结构；
+         *         其余回调只标记为待处理，由 zmalloc_pressure_poll() 在安全点调用，
+         *         适合dictResize、淘汰等操作。
+         *
+         * 同一次越线每个回调只触发一次，used_memory回落到水位减
+         * ZMALLOC_PRESSURE_HYSTERESIS 以下后才会再次触发。
+         *
+         * 返回值: 成功返回回调id（>=0），回调已满或参数非法返回-1
+         */
+        static int zmalloc_register_pressure_callback(zmallocPressureCallback cb, void *privdata, int watermark, int flags);
+
+        /**
+         * zmalloc_unregister_pressure_callback - 取消注册内存压力回调
+         * @id: 注册时返回的id
+         *
+         * 返回值: 成功返回0，id无效返回-1
+         */
+        static int zmalloc_unregister_pressure_callback(int id);
+
+        /**
+         * zmalloc_pressure_poll - 在安全点处理内存压力
+         *
+         * 合并本线程的统计增量，按当前used_memory重新判断水位，
+         * 然后调用所有待处理的非同步回调。适合在事件循环或定时任务中调用。
+         *
+         * 返回值: 本次调用的回调个数
+         */
+        static int zmalloc_pressure_poll(void);
 
         /**
          * zmalloc_set_oom_handler - 设置内存不足处理函数
@@ -290,7 +549,7 @@ class  zmalloc
          * 设置当内存分配失败时调用的处理函数。
          * 传入NULL可恢复默认行为（打印错误信息并终止程序）。
          */
-        void zmalloc_set_oom_handler(void (*oom_handler)(size_t));
+        static void zmalloc_set_oom_handler(void (*oom_handler)(size_t));
 
         /**
          * zmalloc_get_rss - 获取常驻内存大小
@@ -300,7 +559,7 @@ class  zmalloc
          *
          * 返回值: 常驻内存大小（字节），失败时返回0
          */
-        size_t zmalloc_get_rss(void);
+        static size_t zmalloc_get_rss(void);
 
         /**
          * zmalloc_get_allocator_info - 获取内存分配器的详细信息
@@ -315,7 +574,7 @@ class  zmalloc
          *
          * 返回值: 成功时返回0，失败时返回-1
          */
-        int zmalloc_get_allocator_info(size_t *allocated, size_t *active, size_t *resident);
+        static int zmalloc_get_allocator_info(size_t *allocated, size_t *active, size_t *resident);
 
         /**
          * set_jemalloc_bg_thread - 启用或禁用jemalloc后台线程
@@ -324,7 +583,7 @@ class  zmalloc
          * 如果使用jemalloc作为内存分配器，此函数可控制是否启用其后台线程。
          * 后台线程用于执行内存碎片整理等维护任务。
          */
-        void set_jemalloc_bg_thread(int enable);
+        static void set_jemalloc_bg_thread(int enable);
 
         /**
          * jemalloc_purge - 强制jemalloc释放未使用的物理内存
@@ -334,7 +593,32 @@ class  zmalloc
          *
          * 返回值: 成功时返回0，失败时返回非零值
          */
-        int jemalloc_purge();
+        static int jemalloc_purge();
+
+        /**
+         * zmalloc_defrag_hint - 判断一个内存块是否值得搬迁
+         * @ptr: 已分配的内存块
+         *
+         * 根据分配器的碎片信息判断：ptr所在的slab使用率低于同一size class的
+         * 平均使用率时，把它搬到别处可以让这个slab尽快变空并归还。
+         * 只有HAVE_DEFRAG（jemalloc）时才有意义，其他分配器总是返回0。
+         *
+         * 返回值: 建议搬迁返回1，否则返回0
+         */
+        static int zmalloc_defrag_hint(void *ptr);
+
+        /**
+         * zmalloc_defrag_move - 把内存块搬到新分配的位置
+         * @ptr: 已分配的内存块
+         * @tag: 内存归属标签（zmallocTag）
+         *
+         * 分配同样大小的新块、拷贝内容并释放旧块。分配与释放都绕过线程缓存
+         * （jemalloc下也绕过tcache），保证旧块真正回到分配器、新块从最满的
+         * slab里取。调用方负责把所有指向旧块的指针改为返回值。
+         *
+         * 返回值: 新内存块指针，分配失败时返回NULL（旧块保持不变）
+         */
+        static void *zmalloc_defrag_move(void *ptr, int tag);
 
         /**
          * zmalloc_get_private_dirty - 获取进程的私有脏页内存大小
@@ -345,7 +629,7 @@ class  zmalloc
          *
          * 返回值: 私有脏页内存大小（字节），失败时返回0
          */
-        size_t zmalloc_get_private_dirty(long pid);
+        static size_t zmalloc_get_private_dirty(long pid);
 
         /**
          * zmalloc_get_smap_bytes_by_field - 从/proc/pid/smaps获取特定字段的内存信息
@@ -357,7 +641,7 @@ class  zmalloc
          *
          * 返回值: 指定字段的内存总量（字节），失败时返回0
          */
-        size_t zmalloc_get_smap_bytes_by_field(char *field, long pid);
+        static size_t zmalloc_get_smap_bytes_by_field(char *field, long pid);
 
         /**
          * zmalloc_get_memory_size - 获取系统总内存大小
@@ -366,7 +650,7 @@ class  zmalloc
          *
          * 返回值: 系统总内存大小（字节），失败时返回0
          */
-        size_t zmalloc_get_memory_size(void);
+        static size_t zmalloc_get_memory_size(void);
 
         /**
          * zlibc_free - 使用标准C库的free函数释放内存
@@ -376,18 +660,18 @@ class  zmalloc
          * 用于释放由标准C库的malloc、calloc、realloc等函数分配的内存。
          * 如果ptr为NULL，不执行任何操作。
          */
-        void zlibc_free(void *ptr);
+        static void zlibc_free(void *ptr);
         //程序终止回调
         static void zmalloc_default_oom(size_t size);
 
         #ifdef HAVE_DEFRAG
-        void zfree_no_tcache(void *ptr);
-        void *zmalloc_no_tcache(size_t size);
+        static void zfree_no_tcache(void *ptr, int tag = ZMALLOC_TAG_OTHER);
+        static void *zmalloc_no_tcache(size_t size, int tag = ZMALLOC_TAG_OTHER);
         #endif
 
         #ifndef HAVE_MALLOC_SIZE
-        size_t zmalloc_size(void *ptr);
-        size_t zmalloc_usable_size(void *ptr);
+        static size_t zmalloc_size(void *ptr);
+        static size_t zmalloc_usable_size(void *ptr);
         #else
         #define zmalloc_usable_size(p) zmalloc_size(p)
         #endif
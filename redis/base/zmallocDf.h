@@ -3,49 +3,92 @@
 BEGIN_NAMESPACE(REDIS_BASE)
 //=====================================================================//
 
+// 当前编译单元的默认内存标签，需在包含本文件前定义，例如：
+// #define ZMALLOC_TAG ZMALLOC_TAG_DICT
+#ifndef ZMALLOC_TAG
+#define ZMALLOC_TAG ZMALLOC_TAG_OTHER
+#endif
+
 // 基础内存分配宏（内部使用）
 #define __ZMALLOC_BASE(func, ...) \
     ({ \
         void* __restrict __zm_ptr = nullptr; \
-        __zm_ptr = zmalloc::getInstance()->func(__VA_ARGS__); \
+        __zm_ptr = zmalloc::func(__VA_ARGS__); \
         __zm_ptr; \
     })
 
 #define __ZMALLOC_BASE_PARAM(func, ...) \
     ({ \
-        auto __zm_ret = decltype(zmalloc::getInstance()->func(__VA_ARGS__)){}; \
-        __zm_ret = zmalloc::getInstance()->func(__VA_ARGS__); \
+        auto __zm_ret = decltype(zmalloc::func(__VA_ARGS__)){}; \
+        __zm_ret = zmalloc::func(__VA_ARGS__); \
         __zm_ret; \
     })
 
 // 内存分配宏
-#define zmalloc(a) __ZMALLOC_BASE(zzmalloc, (a))
-#define zrealloc(p, a) __ZMALLOC_BASE(zrealloc, (p), (a))
-#define ztrymalloc(a) __ZMALLOC_BASE(ztrymalloc, (a))
-#define ztryrealloc(p, a) __ZMALLOC_BASE(ztryrealloc, (p), (a))
-#define zcalloc(a) __ZMALLOC_BASE(zcalloc, (a))
-#define ztrycalloc(a) __ZMALLOC_BASE(ztrycalloc, (a))
+#define zmalloc(a) __ZMALLOC_BASE(zzmalloc, (a), ZMALLOC_TAG)
+#define zrealloc(p, a) __ZMALLOC_BASE(zrealloc, (p), (a), ZMALLOC_TAG)
+#define ztrymalloc(a) __ZMALLOC_BASE(ztrymalloc, (a), ZMALLOC_TAG)
+#define ztryrealloc(p, a) __ZMALLOC_BASE(ztryrealloc, (p), (a), ZMALLOC_TAG)
+#define zcalloc(a) __ZMALLOC_BASE(zcalloc, (a), ZMALLOC_TAG)
+#define ztrycalloc(a) __ZMALLOC_BASE(ztrycalloc, (a), ZMALLOC_TAG)
 #define ZMALLOC(type, bytes) static_cast<type*>(zmalloc(bytes))
 #define zmalloc_used_memory() __ZMALLOC_BASE_PARAM(zmalloc_used_memory, )
-#define zstrdup(a) __ZMALLOC_BASE_PARAM(zstrdup,(a))
+#define zstrdup(a) __ZMALLOC_BASE_PARAM(zstrdup,(a), ZMALLOC_TAG)
 
 // 带usable参数的版本
-#define zmalloc_usable(a, u) __ZMALLOC_BASE(zmalloc_usable, (a), (u))
-#define zrealloc_usable(p, a, u) __ZMALLOC_BASE(zrealloc_usable, (p), (a), (u))
-#define ztrymalloc_usable(a, u) __ZMALLOC_BASE(ztrymalloc_usable, (a), (u))
-#define ztryrealloc_usable(p, a, u) __ZMALLOC_BASE(ztryrealloc_usable, (p), (a), (u))
+#define zmalloc_usable(a, u) __ZMALLOC_BASE(zmalloc_usable, (a), (u), ZMALLOC_TAG)
+#define zrealloc_usable(p, a, u) __ZMALLOC_BASE(zrealloc_usable, (p), (a), (u), ZMALLOC_TAG)
+#define ztrymalloc_usable(a, u) __ZMALLOC_BASE(ztrymalloc_usable, (a), (u), ZMALLOC_TAG)
+#define ztryrealloc_usable(p, a, u) __ZMALLOC_BASE(ztryrealloc_usable, (p), (a), (u), ZMALLOC_TAG)
+
+// 显式指定标签的版本，用于跨模块分配/释放的内存（如quicklist节点里的ziplist）
+#define zmalloc_tag(a, t) __ZMALLOC_BASE(zzmalloc, (a), (t))
+#define zcalloc_tag(a, t) __ZMALLOC_BASE(zcalloc, (a), (t))
+#define zrealloc_tag(p, a, t) __ZMALLOC_BASE(zrealloc, (p), (a), (t))
+
+// 获取各内存标签的统计值
+#define zmalloc_get_tag_stats(s) \
+    do { \
+        zmalloc::zmalloc_get_tag_stats(s); \
+    } while(0)
+
+// 采样式堆分析：开启/关闭/写出存活采样
+#define zmalloc_prof_start(r) __ZMALLOC_BASE_PARAM(zmalloc_prof_start, (r))
+#define zmalloc_prof_dump(f, fmt) __ZMALLOC_BASE_PARAM(zmalloc_prof_dump, (f), (fmt))
+#define zmalloc_prof_stop() \
+    do { \
+        zmalloc::zmalloc_prof_stop(); \
+    } while(0)
+
+// 内存压力：在安全点调用已越线的非同步回调
+#define zmalloc_pressure_poll() __ZMALLOC_BASE_PARAM(zmalloc_pressure_poll, )
 
 // 内存不足(OOM)处理设置宏
 #define zmalloc_set_oom_handler(h) \
     do { \
-        zmalloc::getInstance()->zmalloc_set_oom_handler(h); \
+        zmalloc::zmalloc_set_oom_handler(h); \
+    } while(0)
+
+// 清空当前线程的小对象缓存并合并统计增量
+#define zmalloc_thread_cache_flush() \
+    do { \
+        zmalloc::zmalloc_thread_cache_flush(); \
     } while(0)
 
 // 特殊处理free函数（不返回指针）
 #define zfree(p) \
     do { \
         if (p) { \
-            zmalloc::getInstance()->zfree(p); \
+            zmalloc::zfree(p, ZMALLOC_TAG); \
+            p = nullptr; \
+        } \
+    } while(0)
+
+// 显式指定标签的free（成员函数名加括号，避免再次展开zfree宏）
+#define zfree_tag(p, t) \
+    do { \
+        if (p) { \
+            (zmalloc::zfree)(p, (t)); \
             p = nullptr; \
         } \
     } while(0)
@@ -54,7 +97,7 @@ BEGIN_NAMESPACE(REDIS_BASE)
 #define zfree_usable(p, u) \
     do { \
         if (p) { \
-            zmalloc::getInstance()->zfree_usable(p, u); \
+            zmalloc::zfree_usable(p, u, ZMALLOC_TAG); \
             p = nullptr; \
         } \
     } while(0)
@@ -407,7 +407,7 @@ void zsetCreate::zsetConvert(robj *zobj, int encoding)
             zzlNext(zl,&eptr,&sptr);
         }
 
-        zfree(zobj->ptr);
+        zfree_tag(zobj->ptr, ZMALLOC_TAG_ZIPLIST);
         zobj->ptr = zs;
         zobj->encoding = OBJ_ENCODING_SKIPLIST;
     } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
@@ -421,8 +421,8 @@ void zsetCreate::zsetConvert(robj *zobj, int encoding)
         zs = static_cast<zset *>(zobj->ptr);
         dictionaryCreateInstance->dictRelease(zs->dictl);
         node = zs->zsl->header->level[0].forward;
-        zfree(zs->zsl->header);
-        zfree(zs->zsl);
+        zfree_tag(zs->zsl->header, ZMALLOC_TAG_SKIPLIST);
+        zfree_tag(zs->zsl, ZMALLOC_TAG_SKIPLIST);
 
         while (node) {
             zl = zzlInsertAt(zl,NULL,node->ele,node->score);
@@ -716,10 +716,7 @@ int zsetCreate::zsetDel(robj *zobj, sds ele)
         }
     } else if (zobj->encoding == OBJ_ENCODING_SKIPLIST) {
         zset *zs = static_cast<zset*>(zobj->ptr);
-        if (zsetRemoveFromSkiplist(zs, ele)) {
-            if (htNeedsResize(zs->dictl)) dictionaryCreateInstance->dictResize(zs->dictl);
-            return 1;
-        }
+        if (zsetRemoveFromSkiplist(zs, ele)) return 1; /* dict删除后按策略自动缩容 */
     } else {
         serverPanic("Unknown sorted set encoding");   
     }
@@ -744,7 +741,7 @@ robj *zsetCreate::zsetDup(robj *o)
     {
         unsigned char *zl = static_cast<unsigned char*>(o->ptr);
         size_t sz = ziplistCreateInstance->ziplistBlobLen(zl);
-        unsigned char *new_zl = static_cast<unsigned char*>(zmalloc(sz));
+        unsigned char *new_zl = static_cast<unsigned char*>(zmalloc_tag(sz, ZMALLOC_TAG_ZIPLIST));
         memcpy(new_zl, zl, sz);
         zobj = redisObjectCreateInstance->createObject(OBJ_ZSET, new_zl);
         zobj->encoding = OBJ_ENCODING_ZIPLIST;
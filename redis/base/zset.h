@@ -408,6 +408,7 @@ public:
      * 有序集合使用的字典类型定义。
      * 定义了字典操作所需的回调函数，包括哈希函数、键比较函数等。
      * 注意：键和值的内存管理由跳跃表负责，因此dup和destructor回调为NULL。
+     * 键就是跳跃表节点的ele，整理内存时靠指针相同定位节点，所以不内嵌键（flags为0）。
      */
     dictType zsetDictType = {
         dictSdsHash,               /* 哈希函数 */
@@ -416,7 +417,9 @@ public:
         dictSdsKeyCompare,         /* 键比较函数 */
         NULL,                      /* 键销毁函数（由跳跃表管理） */
         NULL,                      /* 值销毁函数（由跳跃表管理） */
-        NULL                       /* 扩容判断函数（使用默认策略） */
+        NULL,                      /* 扩容判断函数（使用默认策略） */
+        0,                         /* 条目布局：不内嵌键 */
+        NULL                       /* 扩缩容策略：使用默认策略 */
     };
 
     /**
@@ -431,7 +434,9 @@ public:
             dictSdsKeyCompare,          /* 键比较函数：比较两个SDS字符串 */
             dictSdsDestructor,          /* 键析构函数：释放SDS内存 */
             dictSdsDestructor,          /* 值析构函数：释放SDS内存 */
-            NULL                        /* 扩展允许函数：使用默认扩展策略 */
+            NULL,                       /* 扩展允许函数：使用默认扩展策略 */
+            DICT_TYPE_EMBED_KEYS,       /* 条目布局：短字段名内嵌进条目 */
+            NULL                        /* 扩缩容策略：使用默认策略 */
         };
 
     /**
@@ -5,6 +5,7 @@
  * Description: 跳跃表（Skip List） 是有序集合（Sorted Set）的核心实现之一，
  * 它通过随机化的多层索引结构，在保持数据有序的同时支持高效的插入、删除和查找操作。
  */
+#define ZMALLOC_TAG ZMALLOC_TAG_SKIPLIST
 #include "dict.h"
 #include "zskiplist.h"
 #include "zmallocDf.h"
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2025, JakeeZhao <zhaojakee@gmail.com> All rights reserved.
+ * Date: 2025/07/20
+ * All rights reserved. No one may copy or transfer.
+ * Description: defrag test program
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <string.h>
+#include "zmallocDf.h"
+#include "sds.h"
+#include "dict.h"
+#include "quicklist.h"
+#include "zskiplist.h"
+#include "zset.h"
+#include "rax.h"
+#include "defrag.h"
+using namespace REDIS_BASE;
+
+
+// 定义测试宏
+int __failed_tests = 0;
+int __test_num = 0;
+#define test_cond(descr,_c) do { \
+    __test_num++; printf("%d - %s: ", __test_num, descr); \
+    if(_c) printf("PASSED\n"); else {printf("FAILED\n"); __failed_tests++;} \
+} while(0)
+
+#define test_report() do { \
+    printf("%d tests, %d passed, %d failed\n", __test_num, \
+                    __test_num-__failed_tests, __failed_tests); \
+    if (__failed_tests) { \
+        printf("=== WARNING === We have failed tests here...\n"); \
+        exit(1); \
+    } \
+} while(0)
+
+#define DEFRAG_TEST_ITEMS 2000
+
+static sdsCreate sdsCrt;
+static dictionaryCreate dictCrt;
+static quicklistCreate quicklistCrt;
+static zskiplistCreate zslCrt;
+static raxCreate raxCrt;
+
+// 用很小的预算反复执行，直到完成一轮完整遍历，返回调用次数
+static int runUntilPass(defragCreate *defrag, long long budget_us)
+{
+    int calls = 0;
+    while (calls < 1000000) {
+        calls++;
+        if (defrag->defragCycle(budget_us)) break;
+    }
+    return calls;
+}
+
+static void freeRaxVal(void *val)
+{
+    zfree(val);
+}
+
+int main()
+{
+    zsetCreate zsetCrt;
+    defragCreate defrag;
+    defragStats stats;
+    char buf[64];
+    size_t used_before = zmalloc_used_memory();
+
+    /* 非jemalloc构建没有碎片提示，强制搬迁所有内存块以验证指针修正。 */
+    defrag.defragSetForce(1);
+    printf("fragmentation: %.2f%%\n", defrag.defragGetFragmentation(NULL));
+
+    // dict: sds键和sds值
+    dict *d = dictCrt.dictCreate(&zsetCrt.hashDictType, NULL);
+    for (int j = 0; j < DEFRAG_TEST_ITEMS; j++) {
+        snprintf(buf, sizeof(buf), "key:%d", j);
+        dictCrt.dictAdd(d, sdsCrt.sdsnew(buf), sdsCrt.sdsfromlonglong(j));
+    }
+    dict *old_d = d;
+    test_cond("defragAddDict", defrag.defragAddDict(&d, DEFRAG_DICT_KEY_SDS|DEFRAG_DICT_VAL_SDS) == C_OK);
+    test_cond("defragAddDict twice is rejected",
+        defrag.defragAddDict(&d, DEFRAG_DICT_KEY_SDS) == C_ERR);
+
+    // quicklist: 小节点、两端之外压缩
+    quicklist *ql = quicklistCrt.quicklistNew(8, 1);
+    for (int j = 0; j < DEFRAG_TEST_ITEMS; j++) {
+        snprintf(buf, sizeof(buf), "quicklist value %d", j);
+        quicklistCrt.quicklistPushTail(ql, buf, strlen(buf));
+    }
+    test_cond("defragAddQuicklist", defrag.defragAddQuicklist(&ql) == C_OK);
+
+    // zset: dict和跳跃表共享元素sds
+    zset *zs = static_cast<zset*>(zmalloc(sizeof(*zs)));
+    zs->dictl = dictCrt.dictCreate(&zsetCrt.zsetDictType, NULL);
+    zs->zsl = zslCrt.zslCreate();
+    for (int j = 0; j < DEFRAG_TEST_ITEMS; j++) {
+        snprintf(buf, sizeof(buf), "member:%d", j);
+        sds ele = sdsCrt.sdsnew(buf);
+        zskiplistNode *node = zslCrt.zslInsert(zs->zsl, (double)(j % 97), ele);
+        dictCrt.dictAdd(zs->dictl, ele, &node->score);
+    }
+    test_cond("defragAddZset", defrag.defragAddZset(&zs) == C_OK);
+
+    // rax: 值为zmalloc分配的内存块
+    rax *rt = raxCrt.raxNew();
+    for (int j = 0; j < DEFRAG_TEST_ITEMS; j++) {
+        int len = snprintf(buf, sizeof(buf), "rax:%d", j);
+        long long *val = static_cast<long long*>(zmalloc(sizeof(long long)));
+        *val = j;
+        raxCrt.raxInsert(rt, (unsigned char*)buf, len, val, NULL);
+    }
+    test_cond("defragAddRax", defrag.defragAddRax(&rt, DEFRAG_RAX_VAL_PTR) == C_OK);
+
+    // 小预算多次执行，中途修改quicklist，验证书签断点
+    int calls = 0;
+    while (calls < 1000000) {
+        calls++;
+        if (defrag.defragCycle(20)) break;
+        if (calls == 3) {
+            quicklistCrt.quicklistPushHead(ql, (void*)"head", 4);
+            quicklistCrt.quicklistDelRange(ql, 100, 50);
+        }
+    }
+    defrag.defragGetStats(&stats);
+    printf("calls: %d, hits: %lld, misses: %lld, scanned: %lld, time: %lld us\n",
+        calls, stats.hits, stats.misses, stats.scanned, stats.time_used_us);
+    test_cond("defragCycle completes a pass", stats.passes == 1);
+    test_cond("defragCycle moved allocations", stats.hits > DEFRAG_TEST_ITEMS);
+    test_cond("dict struct moved", d != old_d);
+
+    // 再跑一轮，一次性完成
+    test_cond("second pass with large budget", runUntilPass(&defrag, 10*1000*1000) == 1);
+
+    // 校验dict
+    int ok = 1;
+    for (int j = 0; j < DEFRAG_TEST_ITEMS && ok; j++) {
+        snprintf(buf, sizeof(buf), "key:%d", j);
+        sds key = sdsCrt.sdsnew(buf);
+        sds val = static_cast<sds>(dictCrt.dictFetchValue(d, key));
+        ok = val && atoi(val) == j;
+        sdsCrt.sdsfree(key);
+    }
+    test_cond("dict content intact after defrag", ok && dictSize(d) == DEFRAG_TEST_ITEMS);
+
+    // 校验quicklist
+    quicklistEntry entry;
+    ok = quicklistCrt.quicklistCount(ql) == DEFRAG_TEST_ITEMS + 1 - 50;
+    ok = ok && quicklistCrt.quicklistIndex(ql, 0, &entry) && entry.sz == 4 && !memcmp(entry.value, "head", 4);
+    for (int j = 0; j < DEFRAG_TEST_ITEMS - 50 && ok; j++) {
+        int expect = j < 99 ? j : j + 50;
+        int len = snprintf(buf, sizeof(buf), "quicklist value %d", expect);
+        ok = quicklistCrt.quicklistIndex(ql, j + 1, &entry) && entry.sz == (unsigned int)len &&
+             !memcmp(entry.value, buf, len);
+    }
+    test_cond("quicklist content intact after defrag", ok);
+    test_cond("quicklist bookmark removed", ql->bookmark_count == 0);
+
+    // 校验zset：有序、backward正确、dict值指向节点的score
+    ok = zs->zsl->length == DEFRAG_TEST_ITEMS;
+    zskiplistNode *x = zs->zsl->header->level[0].forward, *prev = NULL;
+    unsigned long n = 0;
+    while (x && ok) {
+        dictEntry *de = dictCrt.dictFind(zs->dictl, x->ele);
+        ok = de && dictGetKey(de) == x->ele && dictGetVal(de) == &x->score &&
+             x->backward == prev && (!prev || prev->score <= x->score);
+        prev = x;
+        x = x->level[0].forward;
+        n++;
+    }
+    test_cond("zset skiplist and dict consistent after defrag",
+        ok && n == DEFRAG_TEST_ITEMS && zs->zsl->tail == prev);
+
+    // 校验rax
+    ok = rt->numele == DEFRAG_TEST_ITEMS;
+    for (int j = 0; j < DEFRAG_TEST_ITEMS && ok; j++) {
+        int len = snprintf(buf, sizeof(buf), "rax:%d", j);
+        long long *val = static_cast<long long*>(raxCrt.raxFind(rt, (unsigned char*)buf, len));
+        ok = val != raxNotFound && *val == j;
+    }
+    test_cond("rax content intact after defrag", ok);
+
+    // 释放
+    test_cond("defragRemove", defrag.defragRemove(&ql) == C_OK && defrag.defragRemove(&ql) == C_ERR);
+    defrag.defragRemove(&d);
+    defrag.defragRemove(&zs);
+    defrag.defragRemove(&rt);
+    test_cond("defragCycle with no jobs", defrag.defragCycle(100) == 0);
+
+    // 清空后再注册：作业数组释放后必须能重新分配，析构时不能重复释放
+    {
+        defragCreate again;
+        again.defragSetForce(1);
+        test_cond("add after remove-all",
+            again.defragAddDict(&d, DEFRAG_DICT_KEY_SDS|DEFRAG_DICT_VAL_SDS) == C_OK &&
+            again.defragRemove(&d) == C_OK &&
+            again.defragAddDict(&d, DEFRAG_DICT_KEY_SDS|DEFRAG_DICT_VAL_SDS) == C_OK &&
+            again.defragAddRax(&rt, DEFRAG_RAX_VAL_PTR) == C_OK);
+        test_cond("pass after re-add", runUntilPass(&again, 10*1000*1000) == 1);
+    }
+    dictCrt.dictRelease(d);
+    quicklistCrt.quicklistRelease(ql);
+    dictCrt.dictRelease(zs->dictl);
+    zslCrt.zslFree(zs->zsl);
+    zfree(zs);
+    raxCrt.raxFreeWithCallback(rt, freeRaxVal);
+    test_cond("used memory back to baseline", zmalloc_used_memory() == used_before);
+
+    test_report();
+    return 0;
+}
@@ -8,10 +8,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include "dict.h"
+#include "shardedDict.h"
+#include "sds.h"
+#include "zmalloc.h"
 #include "zmallocDf.h"
 #include "fmacros.h"
 #include "define.h"
+#include "defrag.h"
 int __failed_tests = 0;
 int __test_num = 0;
 #define test_cond(descr,_c) do { \
@@ -30,11 +35,18 @@ int __test_num = 0;
 using namespace REDIS_BASE;
 
 static dictionaryCreate dictCrt;
+static shardedDictionaryCreate shardedCrt;
+static sdsCreate sdsCrt;
 
 uint64_t hashCallback(const void *key) {
     return dictCrt.dictGenHashFunction((unsigned char*)key, strlen((char*)key));
 }
 
+/* 模拟只输出32位的哈希函数 */
+uint64_t narrowHashCallback(const void *key) {
+    return (uint32_t)hashCallback(key);
+}
+
 int compareCallback(void *privdata, const void *key1, const void *key2) {
     int l1,l2;
     DICT_NOTUSED(privdata);
@@ -70,6 +82,8 @@ dictType BenchmarkDictType = {
     compareCallback,
     freeCallback,
     NULL,
+    NULL,
+    0,
     NULL
 };
 
@@ -85,6 +99,1166 @@ dictType BenchmarkDictType = {
 void dummyCallback(void* data) {}
 void dummyScanFunction(void *privdata, const dictEntry *de) {}
 void dummyScanBucketFunction(void *privdata, dictEntry **bucket) {}
+
+// 扫描回调：值是插入时的下标，记录到标记数组
+void markScanFunction(void *privdata, const dictEntry *de) {
+    unsigned char *seen = static_cast<unsigned char*>(privdata);
+    seen[(long)dictGetVal(de)] = 1;
+}
+
+// 建一个含count个元素的字典，返回元素（键+值+表）占用的内存
+static size_t buildDict(dict *d, long count) {
+    size_t before = zmalloc_used_memory();
+    for (long j = 0; j < count; j++) dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j);
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    return zmalloc_used_memory() - before;
+}
+
+// dictFindBatch的结果必须与逐个dictFind一致：一半键存在、一半不存在，
+// 中途开始rehash时两张表都要查到
+static int checkFindBatch(dict *d, long count) {
+    char *strs[100];
+    const void *keys[100];
+    dictEntry *results[100];
+    int ok = 1;
+    for (long base = 0; base < count * 2; base += 100) {
+        for (int i = 0; i < 100; i++) keys[i] = strs[i] = stringFromLongLong(base + i);
+        unsigned long found = dictCrt.dictFindBatch(d, keys, 100, results), expect = 0;
+        for (int i = 0; i < 100; i++) {
+            dictEntry *de = dictCrt.dictFind(d, keys[i]);
+            if (de != results[i]) ok = 0;
+            if (de) expect++;
+            zfree(strs[i]);
+        }
+        if (found != expect) ok = 0;
+    }
+    return ok;
+}
+
+static void testFindBatch(void) {
+    long count = 3000;
+    dict *chained = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    dict *swiss = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    dictEntry *results[4];
+    test_cond("Find batch on empty dict", dictCrt.dictFindBatch(chained, NULL, 0, results) == 0);
+
+    buildDict(chained, count);
+    buildDict(swiss, count);
+    test_cond("Find batch matches dictFind (chained)", checkFindBatch(chained, count));
+    test_cond("Find batch matches dictFind (swiss)", checkFindBatch(swiss, count));
+
+    /* 继续插入直到进入rehash，再批量查找 */
+    long j = count;
+    while (!dictIsRehashing(chained)) {
+        dictCrt.dictAdd(chained, stringFromLongLong(j), (void*)j);
+        j++;
+    }
+    test_cond("Find batch matches dictFind while rehashing (chained)", checkFindBatch(chained, j));
+    j = count;
+    while (!dictIsRehashing(swiss)) {
+        dictCrt.dictAdd(swiss, stringFromLongLong(j), (void*)j);
+        j++;
+    }
+    test_cond("Find batch matches dictFind while rehashing (swiss)", checkFindBatch(swiss, j));
+    dictCrt.dictRelease(chained);
+    dictCrt.dictRelease(swiss);
+}
+
+// 后台rehash期间前台持续增删查，搬完后内容必须完整
+static void testBackgroundRehash(void) {
+    long j, count = 200000;
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    dictRehashStats before, after;
+    dictCrt.dictGetRehashStats(&before);
+    dictCrt.dictEnableBackgroundRehash(4096);
+    int metrics = dictCrt.dictEnableMetrics(d) == DICT_OK;
+
+    int sawbg = 0, ok = 1;
+    for (j = 0; j < count; j++) {
+        if (dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j) != DICT_OK) ok = 0;
+        if (dictIsBgRehashing(d)) {
+            sawbg = 1;
+            double p = dictCrt.dictRehashProgress(d);
+            if (p < 0 || p > 1) ok = 0;
+        }
+        /* 隔一个删掉前面的键，再查刚插入的键 */
+        if (j % 4 == 0 && j > 0) {
+            char *key = stringFromLongLong(j - 1);
+            if (dictCrt.dictDelete(d, key) != DICT_OK) ok = 0;
+            zfree(key);
+        }
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (de == NULL || (long)dictGetVal(de) != j) ok = 0;
+        zfree(key);
+    }
+    test_cond("Background rehash started", sawbg);
+    test_cond("Add/delete/find while rehashing in background", ok);
+
+    dictCrt.dictBackgroundRehashWait(d);
+    test_cond("Background rehash finished after wait",
+              !dictIsBgRehashing(d) && dictCrt.dictRehashProgress(d) == 1.0);
+    long expect = 0;
+    ok = 1;
+    for (j = 0; j < count; j++) {
+        int deleted = (j + 1) % 4 == 0 && j + 1 < count;
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (deleted ? de != NULL : de == NULL) ok = 0;
+        if (!deleted) expect++;
+        zfree(key);
+    }
+    test_cond("Background rehash keeps every key", ok && (long)dictSize(d) == expect);
+    if (metrics) {
+        /* 后台rehash期间走条带锁的查找也要计入指标 */
+        dictMetrics m;
+        dictCrt.dictGetMetrics(d, &m);
+        test_cond("Background rehash finds are counted in metrics",
+                  (long)m.find_hits == count + expect && (long)m.find_misses == count - expect);
+    }
+
+    dictCrt.dictGetRehashStats(&after);
+    test_cond("Background rehash stats", after.started > before.started &&
+              after.completed > before.completed && after.entries_moved > before.entries_moved &&
+              !after.active);
+    dictCrt.dictDisableBackgroundRehash();
+    dictCrt.dictRelease(d);
+}
+
+// 后台rehash进行中启动整理任务：dict结构体搬走前要等后台搬完，之后元素数和内容都不变
+static void testDefragDuringBackgroundRehash(void) {
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    long j, count = 0;
+    dictCrt.dictEnableBackgroundRehash(1 << 18);
+    while (!dictIsBgRehashing(d) && count < (1 << 20)) {
+        dictCrt.dictAdd(d, stringFromLongLong(count), (void*)count);
+        count++;
+    }
+    test_cond("Background rehash running before defrag", dictIsBgRehashing(d));
+
+    {
+        defragCreate defrag;
+        defrag.defragSetForce(1);
+        defrag.defragAddDict(&d, 0);
+        while (!defrag.defragCycle(1000));
+        defrag.defragRemove(&d);
+    }
+    long found = 0;
+    for (j = 0; j < count; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (de && (long)dictGetVal(de) == j) found++;
+        zfree(key);
+    }
+    test_cond("Defrag during background rehash keeps size and content",
+              !dictIsBgRehashing(d) && (long)dictSize(d) == count && found == count);
+    dictCrt.dictDisableBackgroundRehash();
+    dictCrt.dictRelease(d);
+}
+
+// 分片字典：每个线程在自己的键区间上增删查，结束后扫描、随机取键
+#define SHARDED_TEST_THREADS 8
+#define SHARDED_TEST_KEYS 20000
+
+typedef struct shardedTestArg {
+    shardedDict *sd;
+    long base;
+    int ok;
+} shardedTestArg;
+
+static void *shardedTestThread(void *arg) {
+    shardedTestArg *a = static_cast<shardedTestArg*>(arg);
+    a->ok = 1;
+    for (long j = a->base; j < a->base + SHARDED_TEST_KEYS; j++)
+        if (shardedCrt.shardedDictAdd(a->sd, stringFromLongLong(j), (void*)j) != DICT_OK) a->ok = 0;
+    /* 删掉区间里的奇数键，再检查所有键 */
+    for (long j = a->base + 1; j < a->base + SHARDED_TEST_KEYS; j += 2) {
+        char *key = stringFromLongLong(j);
+        if (shardedCrt.shardedDictDelete(a->sd, key) != DICT_OK) a->ok = 0;
+        zfree(key);
+    }
+    for (long j = a->base; j < a->base + SHARDED_TEST_KEYS; j++) {
+        char *key = stringFromLongLong(j);
+        void *val = shardedCrt.shardedDictFetchValue(a->sd, key);
+        if (j % 2 ? val != NULL : val != (void*)j) a->ok = 0;
+        zfree(key);
+    }
+    return NULL;
+}
+
+typedef struct sampledVals {
+    unsigned int n;
+    long vals[64];
+} sampledVals;
+
+/* 在分片锁内把值拷贝出来 */
+static void copyValScanFunction(void *privdata, const dictEntry *de) {
+    sampledVals *sv = static_cast<sampledVals*>(privdata);
+    if (sv && sv->n < 64) sv->vals[sv->n++] = (long)dictGetVal(de);
+}
+
+typedef struct shardedSampleArg {
+    shardedDict *sd;
+    volatile int stop;
+    int ok;
+} shardedSampleArg;
+
+static void *shardedSampleThread(void *arg) {
+    shardedSampleArg *a = static_cast<shardedSampleArg*>(arg);
+    a->ok = 1;
+    while (!a->stop) {
+        sampledVals sv = {0, {0}};
+        shardedCrt.shardedDictGetRandomKey(a->sd, copyValScanFunction, &sv);
+        shardedCrt.shardedDictGetSomeKeys(a->sd, 8, copyValScanFunction, &sv);
+        for (unsigned int j = 0; j < sv.n; j++)
+            if (sv.vals[j] % 2) a->ok = 0;
+    }
+    return NULL;
+}
+
+static void testShardedDict(void) {
+    shardedDict *sd = shardedCrt.shardedDictCreate(&BenchmarkDictType, NULL, 10);
+    test_cond("Sharded dict rounds shard count to a power of two",
+              shardedDictNumShards(sd) == 16 && shardedCrt.shardedDictSize(sd) == 0);
+    test_cond("Sharded dict random key on empty dict",
+              shardedCrt.shardedDictGetRandomKey(sd, copyValScanFunction, NULL) == 0);
+
+    pthread_t tids[SHARDED_TEST_THREADS];
+    shardedTestArg args[SHARDED_TEST_THREADS];
+    for (int t = 0; t < SHARDED_TEST_THREADS; t++) {
+        args[t].sd = sd;
+        args[t].base = (long)t * SHARDED_TEST_KEYS;
+        pthread_create(&tids[t], NULL, shardedTestThread, &args[t]);
+    }
+    int ok = 1;
+    for (int t = 0; t < SHARDED_TEST_THREADS; t++) {
+        pthread_join(tids[t], NULL);
+        if (!args[t].ok) ok = 0;
+    }
+    long total = (long)SHARDED_TEST_THREADS * SHARDED_TEST_KEYS;
+    test_cond("Concurrent add/delete/find on sharded dict",
+              ok && (long)shardedCrt.shardedDictSize(sd) == total / 2);
+
+    unsigned char *seen = static_cast<unsigned char*>(zcalloc(total));
+    unsigned long cursor = 0;
+    do {
+        cursor = shardedCrt.shardedDictScan(sd, cursor, markScanFunction, NULL, seen);
+    } while (cursor);
+    ok = 1;
+    for (long j = 0; j < total; j++)
+        if (seen[j] != (j % 2 == 0)) ok = 0;
+    test_cond("Sharded dict scan returns every key", ok);
+    zfree(seen);
+
+    sampledVals sv = {0, {0}};
+    test_cond("Sharded dict random key",
+              shardedCrt.shardedDictGetRandomKey(sd, copyValScanFunction, &sv) == 1 &&
+              sv.n == 1 && sv.vals[0] % 2 == 0);
+    sv.n = 0;
+    unsigned int n = shardedCrt.shardedDictGetSomeKeys(sd, 64, copyValScanFunction, &sv);
+    ok = n > 0 && n <= 64 && sv.n == n;
+    for (unsigned int j = 0; j < n; j++)
+        if (sv.vals[j] % 2) ok = 0;
+    test_cond("Sharded dict get some keys", ok);
+
+    /* 采样与删除并发：条目在锁内交给回调，删除线程释放的条目不会被采样方读到 */
+    shardedSampleArg sa = {sd, 0, 0};
+    pthread_t sampler;
+    pthread_create(&sampler, NULL, shardedSampleThread, &sa);
+    for (long j = 0; j < total; j += 2) {
+        char *key = stringFromLongLong(j);
+        shardedCrt.shardedDictDelete(sd, key);
+        zfree(key);
+    }
+    sa.stop = 1;
+    pthread_join(sampler, NULL);
+    test_cond("Sharded dict sampling races with deletes safely",
+              sa.ok && shardedCrt.shardedDictSize(sd) == 0);
+
+    shardedCrt.shardedDictEmpty(sd, NULL);
+    test_cond("Sharded dict empty", shardedCrt.shardedDictSize(sd) == 0 &&
+              shardedCrt.shardedDictScan(sd, 0, markScanFunction, NULL, NULL) == 0);
+    shardedCrt.shardedDictRelease(sd);
+
+    /* 只有低32位的哈希函数，键也要分散到所有分片 */
+    dictType narrowType = BenchmarkDictType;
+    narrowType.hashFunction = narrowHashCallback;
+    sd = shardedCrt.shardedDictCreate(&narrowType, NULL, 16);
+    for (long j = 0; j < 16 * 256; j++) shardedCrt.shardedDictAdd(sd, stringFromLongLong(j), (void*)j);
+    unsigned long minshard = ULONG_MAX, maxshard = 0;
+    for (unsigned long j = 0; j < shardedDictNumShards(sd); j++) {
+        unsigned long size = dictSize(sd->shards[j].d);
+        if (size < minshard) minshard = size;
+        if (size > maxshard) maxshard = size;
+    }
+    test_cond("Sharded dict spreads 32-bit hashes over every shard", minshard > 128 && maxshard < 512);
+    shardedCrt.shardedDictRelease(sd);
+}
+
+// 哈希算法：XXH3与xxHash的参考值一致；每种算法都受种子影响、大小写不敏感版本一致，
+// 并且切换后字典仍然可用
+static void testHashBackends(void) {
+    uint8_t oldseed[16], zero[16] = {0}, seed[16];
+    memcpy(oldseed, dictCrt.dictGetHashFunctionSeed(), sizeof(oldseed));
+    for (int j = 0; j < 16; j++) seed[j] = (uint8_t)(j * 37 + 1);
+    char longkey[1000];
+    for (int j = 0; j < 1000; j++) longkey[j] = 'a' + j % 26;
+
+    dictCrt.dictSetHashFunctionSeed(zero);
+    dictCrt.dictSetHashBackend(DICT_HASH_XXH3);
+    test_cond("XXH3 matches reference vectors",
+              dictCrt.dictGenHashFunction("", 0) == 0x2d06800538d394c2ULL &&
+              dictCrt.dictGenHashFunction("abc", 3) == 0x78af5f94892f3950ULL &&
+              dictCrt.dictGenHashFunction("hello world!", 12) == 0xe155d613728f4b18ULL &&
+              dictCrt.dictGenHashFunction("The quick brown fox jumps over the lazy dog", 43) == 0xce7d19a5418fb365ULL &&
+              dictCrt.dictGenHashFunction(longkey, 1000) == 0xe153425558d7da5dULL);
+    test_cond("Unknown hash backend is rejected",
+              dictCrt.dictSetHashBackend(42) == DICT_ERR && dictCrt.dictGetHashBackend() == DICT_HASH_XXH3);
+
+    int backends[] = {DICT_HASH_SIPHASH, DICT_HASH_WYHASH, DICT_HASH_XXH3};
+    const char *names[] = {"siphash", "wyhash", "xxh3"};
+    for (int b = 0; b < 3; b++) {
+        char descr[128];
+        dictCrt.dictSetHashBackend(backends[b]);
+        int seeded = 1, nocase = 1;
+        for (int len = 0; len <= 300; len++) {
+            dictCrt.dictSetHashFunctionSeed(zero);
+            uint64_t h0 = dictCrt.dictGenHashFunction(longkey, len);
+            dictCrt.dictSetHashFunctionSeed(seed);
+            uint64_t h1 = dictCrt.dictGenHashFunction(longkey, len);
+            if (h0 == h1) seeded = 0;
+
+            char upper[300];
+            for (int j = 0; j < len; j++) upper[j] = (j % 3) ? longkey[j] - 'a' + 'A' : longkey[j];
+            if (dictCrt.dictGenCaseHashFunction((const unsigned char*)upper, len) !=
+                dictCrt.dictGenCaseHashFunction((const unsigned char*)longkey, len)) nocase = 0;
+        }
+        /* 覆盖所有字节值，'@'、'['和高位字节不能被改写 */
+        unsigned char bytes[512], lower[512];
+        for (int j = 0; j < 512; j++) {
+            bytes[j] = (unsigned char)(j * 7);
+            lower[j] = (bytes[j] >= 'A' && bytes[j] <= 'Z') ? bytes[j] + 32 : bytes[j];
+        }
+        for (int len = 0; len <= 512; len += 13)
+            if (dictCrt.dictGenCaseHashFunction(bytes, len) != dictCrt.dictGenHashFunction(lower, len)) nocase = 0;
+        snprintf(descr, sizeof(descr), "Hash backend %s depends on the seed", names[b]);
+        test_cond(descr, seeded);
+        snprintf(descr, sizeof(descr), "Hash backend %s case-insensitive hash", names[b]);
+        test_cond(descr, nocase);
+
+        dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+        buildDict(d, 10000);
+        int found = 1;
+        for (long j = 0; j < 10000; j++) {
+            char *key = stringFromLongLong(j);
+            dictEntry *de = dictCrt.dictFind(d, key);
+            if (de == NULL || (long)dictGetVal(de) != j) found = 0;
+            zfree(key);
+        }
+        snprintf(descr, sizeof(descr), "Dict works with hash backend %s", names[b]);
+        test_cond(descr, found);
+        dictCrt.dictRelease(d);
+    }
+    dictCrt.dictSetHashBackend(DICT_HASH_SIPHASH);
+    dictCrt.dictSetHashFunctionSeed(oldseed);
+}
+
+uint64_t sdsHashCallback(const void *key) {
+    return dictCrt.dictGenHashFunction(key, sdsCrt.sdslen((const char*)key));
+}
+
+int sdsCompareCallback(void *privdata, const void *key1, const void *key2) {
+    DICT_NOTUSED(privdata);
+    size_t l1 = sdsCrt.sdslen((const char*)key1), l2 = sdsCrt.sdslen((const char*)key2);
+    return l1 == l2 && memcmp(key1, key2, l1) == 0;
+}
+
+void sdsFreeCallback(void *privdata, void *val) {
+    DICT_NOTUSED(privdata);
+    sdsCrt.sdsfree((sds)val);
+}
+
+// 长度为len的sds键，内容由j决定
+static sds embedKey(long j, int len) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%ld", j);
+    sds key = sdsCrt.sdsnewlen(NULL, len);
+    memset(key, 'k', len);
+    memcpy(key + len - (n < len ? n : len), buf, n < len ? n : len);
+    return key;
+}
+
+static int key_frees;
+
+static void countingSdsFree(void *privdata, void *key) {
+    (void)privdata;
+    key_frees++;
+    sdsCrt.sdsfree(static_cast<sds>(key));
+}
+
+static void *sdsDupCallback(void *privdata, const void *key) {
+    (void)privdata;
+    return sdsCrt.sdsdup(static_cast<sds>(const_cast<void*>(key)));
+}
+
+// 向d里加count个长度为len的键（值为下标），再逐个查找、删除一半，返回每个键占用的字节数
+static double checkEmbedDict(dict *d, long count, int len, int *ok) {
+    size_t before = zmalloc_used_memory();
+    for (long j = 0; j < count; j++)
+        if (dictCrt.dictAdd(d, embedKey(j, len), (void*)j) != DICT_OK) *ok = 0;
+    double bytes = (double)(zmalloc_used_memory() - before) / count;
+    for (long j = 0; j < count; j++) {
+        sds key = embedKey(j, len);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (de == NULL || sdsCrt.sdslen((sds)dictGetKey(de)) != (size_t)len ||
+            memcmp(dictGetKey(de), key, len) != 0) *ok = 0;
+        else if (!(d->type->flags & DICT_TYPE_NO_VALUE) && (long)dictGetVal(de) != j) *ok = 0;
+        if (j % 2 == 0 && dictCrt.dictDelete(d, key) != DICT_OK) *ok = 0;
+        sdsCrt.sdsfree(key);
+    }
+    for (long j = 0; j < count; j++) {
+        sds key = embedKey(j, len);
+        if ((dictCrt.dictFind(d, key) == NULL) != (j % 2 == 0)) *ok = 0;
+        sdsCrt.sdsfree(key);
+    }
+    return bytes;
+}
+
+// 内嵌键：只在合并分配不多占内存时把键复制进条目，其余照旧单独分配，每个键占用的字节数不超过普通布局；
+// 增删查、rehash、释放的结果与普通布局一致且不泄漏；
+// 不存值的集合类字典里6字节以内的键放在值字段里，每个键只占一个24字节的条目
+static void testEmbeddedKeys(void) {
+    dictType plainType = {sdsHashCallback, NULL, NULL, sdsCompareCallback, sdsFreeCallback, NULL, NULL, 0, NULL};
+    dictType embedType = plainType, setType = plainType;
+    embedType.flags = DICT_TYPE_EMBED_KEYS;
+    setType.flags = DICT_TYPE_EMBED_KEYS|DICT_TYPE_NO_VALUE;
+    size_t used = zmalloc_used_memory();
+    int ok;
+
+    int lens[] = {6, 16, DICT_EMBED_KEY_MAX, DICT_EMBED_KEY_MAX + 1, 100};
+    for (int i = 0; i < 5; i++) {
+        char descr[128];
+        int len = lens[i];
+        dict *plain = dictCrt.dictCreate(&plainType, NULL);
+        dict *embed = dictCrt.dictCreate(&embedType, NULL);
+        dict *set = dictCrt.dictCreate(&setType, NULL);
+        ok = 1;
+        double plain_bytes = checkEmbedDict(plain, 5000, len, &ok);
+        double embed_bytes = checkEmbedDict(embed, 5000, len, &ok);
+        double set_bytes = checkEmbedDict(set, 5000, len, &ok);
+        snprintf(descr, sizeof(descr), "Embedded keys of length %d add/find/delete", len);
+        test_cond(descr, ok);
+
+        /* 是否内嵌取决于分配器的档位：内嵌时不多占内存；不内嵌时布局与普通字典相同，
+         * 只差分配器状态带来的零头 */
+        dictEntry *de = dictCrt.dictGetRandomKey(embed);
+        dictEntry *sde = dictCrt.dictGetRandomKey(set);
+        int embedded = dictEntryKeyIsEmbedded(embed, de);
+        snprintf(descr, sizeof(descr), "Keys of length %d are embedded only when it saves memory", len);
+        test_cond(descr, (len <= DICT_EMBED_KEY_MAX || !embedded) &&
+                         embed_bytes < plain_bytes + 1 && (!embedded || embed_bytes <= plain_bytes) &&
+                         (len <= DICT_EMBED_VAL_KEY_MAX || dictEntryKeyIsEmbedded(set, sde) == embedded) &&
+                         set_bytes < embed_bytes + 1 &&
+                         !dictEntryKeyIsEmbedded(plain, dictCrt.dictGetRandomKey(plain)));
+        if (len <= DICT_EMBED_VAL_KEY_MAX)
+            test_cond("Short set keys live in the value field",
+                      (char*)dictGetKey(sde) == (char*)&sde->v + 1 && set_bytes < embed_bytes);
+        dictCrt.dictRelease(plain);
+        dictCrt.dictRelease(embed);
+        dictCrt.dictRelease(set);
+    }
+
+    /* 没有keyDestructor时键不归字典所有，内嵌只复制，调用者的键保持可用 */
+    dictType borrowType = {sdsHashCallback, NULL, NULL, sdsCompareCallback, NULL, NULL, NULL, DICT_TYPE_EMBED_KEYS, NULL};
+    dict *d = dictCrt.dictCreate(&borrowType, NULL);
+    sds key = sdsCrt.sdsnew("borrowed");
+    dictCrt.dictAdd(d, key, NULL);
+    dictEntry *de = dictCrt.dictFind(d, key);
+    test_cond("Borrowed keys are copied, not freed",
+              de && dictGetKey(de) != key && sdsCrt.sdslen(key) == 8 &&
+              sdsCrt.sdslen((sds)dictGetKey(de)) == 8);
+    dictCrt.dictRelease(d);
+    sdsCrt.sdsfree(key);
+
+    /* 字典拥有键：新增时内嵌的键随即释放（是否内嵌取决于分配器档位），不内嵌的键直接存进条目；
+     * 键已存在时传入的键不被动，仍由调用者释放；有keyDup时只复制 */
+    dictType ownType = plainType;
+    ownType.keyDestructor = countingSdsFree;
+    ownType.flags = DICT_TYPE_EMBED_KEYS;
+    d = dictCrt.dictCreate(&ownType, NULL);
+    key_frees = 0;
+    key = sdsCrt.sdsnew("owned");
+    ok = dictCrt.dictAdd(d, key, NULL) == DICT_OK;
+    de = dictCrt.dictGetRandomKey(d);
+    int embedded = dictEntryKeyIsEmbedded(d, de);
+    ok = ok && key_frees == embedded && (embedded || dictGetKey(de) == key);
+    sds dup = sdsCrt.sdsnew("owned");
+    ok = ok && dictCrt.dictAdd(d, dup, NULL) == DICT_ERR && key_frees == embedded && sdsCrt.sdslen(dup) == 5;
+    sdsCrt.sdsfree(dup);
+    sds longkey = embedKey(1, DICT_EMBED_KEY_MAX + 1);
+    ok = ok && dictCrt.dictAdd(d, longkey, NULL) == DICT_OK && key_frees == embedded;
+    de = dictCrt.dictFind(d, longkey);
+    ok = ok && de && dictGetKey(de) == longkey;
+    test_cond("Owned keys are consumed only when a new entry embeds them", ok);
+    dictCrt.dictRelease(d);
+    test_cond("Owned keys are freed exactly once", key_frees == 2);
+
+    ownType.keyDup = sdsDupCallback;
+    d = dictCrt.dictCreate(&ownType, NULL);
+    key_frees = 0;
+    key = sdsCrt.sdsnew("duped");
+    dictCrt.dictAdd(d, key, NULL);
+    de = dictCrt.dictFind(d, key);
+    test_cond("keyDup keeps the caller's key", de && dictGetKey(de) != key && key_frees == 0 &&
+              sdsCrt.sdslen(key) == 5);
+    dictCrt.dictRelease(d);
+    sdsCrt.sdsfree(key);
+
+    /* swiss引擎忽略布局标志 */
+    d = dictCrt.dictCreateSwiss(&setType, NULL);
+    ok = 1;
+    checkEmbedDict(d, 5000, 16, &ok);
+    test_cond("Swiss dict ignores entry layout flags", ok);
+    dictCrt.dictRelease(d);
+    test_cond("Embedded key dicts free everything", zmalloc_used_memory() == used);
+}
+
+// 条目池：条目从slab分配，删空的slab归还，unlink/empty/release都不泄漏；
+// 没有析构函数时dictRelease按slab整块释放；内嵌键的变长条目与池内条目混用
+static void testEntryPool(void) {
+    dictType poolType = BenchmarkDictType;
+    poolType.flags = DICT_TYPE_ENTRY_POOL;
+    dictEntryPoolStats st;
+    size_t used = zmalloc_used_memory();
+    long count = 100000;
+
+    dict *d = dictCrt.dictCreate(&poolType, NULL);
+    dictCrt.dictGetEntryPoolStats(d, &st);
+    test_cond("Entry pool is created lazily", d->entrypool == NULL && st.slabs == 0);
+    buildDict(d, count);
+    dictCrt.dictGetEntryPoolStats(d, &st);
+    test_cond("Entry pool holds every entry",
+              st.used == (unsigned long)count && st.capacity >= st.used &&
+              st.capacity - st.used < DICT_POOL_SLAB_MAX && st.slabs > 1);
+    printf("entry pool: %lu slabs, %lu/%lu entries, %.1f bytes/entry\n",
+           st.slabs, st.used, st.capacity, (double)st.bytes / st.used);
+
+    long found = 0;
+    for (long j = 0; j < count; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (de && (long)dictGetVal(de) == j) found++;
+        zfree(key);
+    }
+    test_cond("Pooled entries are found", found == count);
+
+    /* 删掉大部分键，空slab归还 */
+    for (long j = 0; j < count; j++) {
+        char *key = stringFromLongLong(j);
+        if (j % 1000) {
+            if (j % 2) dictCrt.dictDelete(d, key);
+            else dictCrt.dictFreeUnlinkedEntry(d, dictCrt.dictUnlink(d, key));
+        }
+        zfree(key);
+    }
+    unsigned long slabs = st.slabs;
+    dictCrt.dictGetEntryPoolStats(d, &st);
+    test_cond("Empty slabs are returned",
+              st.used == dictSize(d) && dictSize(d) == (unsigned long)(count / 1000) && st.slabs < slabs);
+
+    found = 0;
+    for (long j = 0; j < count; j += 1000) {
+        char *key = stringFromLongLong(j);
+        if (dictCrt.dictFind(d, key)) found++;
+        zfree(key);
+    }
+    test_cond("Survivors are intact after slab release", found == count / 1000);
+
+    dictCrt.dictEmpty(d, NULL);
+    dictCrt.dictGetEntryPoolStats(d, &st);
+    test_cond("dictEmpty releases the pool", st.slabs == 0 && dictSize(d) == 0);
+    buildDict(d, 1000);
+    test_cond("Pool is reused after dictEmpty", dictSize(d) == 1000);
+    dictCrt.dictRelease(d);
+
+    /* 没有析构函数：释放时不遍历条目 */
+    dictType rawType = {hashCallback, NULL, NULL, compareCallback, NULL, NULL, NULL, DICT_TYPE_ENTRY_POOL, NULL};
+    static const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    d = dictCrt.dictCreate(&rawType, NULL);
+    for (int j = 0; j < 5; j++) dictCrt.dictAdd(d, (void*)words[j], (void*)(long)j);
+    dictCrt.dictRelease(d);
+
+    /* 内嵌键：内嵌的短键随条目单独分配，其余条目在池里 */
+    dictType sdsType = {sdsHashCallback, NULL, NULL, sdsCompareCallback, sdsFreeCallback, NULL, NULL,
+                        DICT_TYPE_EMBED_KEYS|DICT_TYPE_ENTRY_POOL, NULL};
+    d = dictCrt.dictCreate(&sdsType, NULL);
+    int ok = 1;
+    checkEmbedDict(d, 3000, 16, &ok);
+    checkEmbedDict(d, 3000, DICT_EMBED_KEY_MAX + 8, &ok);
+    dictCrt.dictGetEntryPoolStats(d, &st);
+    unsigned long pooled = 0;
+    dictIterator *iter = dictCrt.dictGetIterator(d);
+    dictEntry *de;
+    while ((de = dictCrt.dictNext(iter)) != NULL)
+        if (!dictEntryKeyIsEmbedded(d, de)) pooled++;
+    dictCrt.dictReleaseIterator(iter);
+    test_cond("Embedded and pooled entries mix", ok && st.used == pooled && pooled >= 1500);
+    dictCrt.dictRelease(d);
+    test_cond("Entry pool dicts free everything", zmalloc_used_memory() == used);
+}
+
+// 扩缩容策略：删掉大部分键后自动缩容并留出滞后区间，策略可按字典类型关闭缩容、调整扩容装载率，
+// 内存吃紧或dictDisableResize时推迟扩容
+static void testResizePolicy(void) {
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 10000);
+    unsigned long full = dictSlots(d);
+    for (long j = 10; j < 10000; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    test_cond("Dict shrinks after losing most keys", full == 16384 && dictSlots(d) < full);
+    /* 缩容rehash期间不再触发缩容，rehash完成后再检查一次就收到约50%装载率 */
+    dictCrt.dictShrinkIfNeeded(d);
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    test_cond("Shrink targets half fill", dictSize(d) == 10 && dictSlots(d) == 32);
+
+    /* 装载率约31%，在10%和100%之间增删不触发扩缩容 */
+    for (long j = 10; j < 20; j++) dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j);
+    for (long j = 10; j < 17; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    test_cond("Shrink leaves a hysteresis band", !dictIsRehashing(d) && dictSlots(d) == 32);
+    dictCrt.dictRelease(d);
+
+    /* 关闭自动缩容、装载率200%才扩容 */
+    dictResizePolicy policy = {200, 500, 0, 50, 0};
+    dictType type = BenchmarkDictType;
+    type.resizePolicy = &policy;
+    d = dictCrt.dictCreate(&type, NULL);
+    buildDict(d, 2000);
+    test_cond("grow_fill controls the load factor", dictSlots(d) == 1024);
+    for (long j = 0; j < 1900; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    test_cond("shrink_fill 0 disables automatic shrinking",
+              !dictIsRehashing(d) && dictSlots(d) == 1024 && dictSize(d) == 100);
+    dictCrt.dictRelease(d);
+
+    /* 内存吃紧：软上限远低于当前用量，装载率超过force_grow_fill才扩容，一次扩到能装下used */
+    zmalloc::zmalloc_set_soft_limit(1024);
+    d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    dictCrt.dictExpand(d, 64);
+    long added = 0;
+    int deferred = 1;
+    while ((unsigned long long)dictSize(d) * 100 <= 64ULL * DICT_FORCE_GROW_FILL) {
+        dictCrt.dictAdd(d, stringFromLongLong(added), (void*)added);
+        added++;
+        if (dictIsRehashing(d) || dictSlots(d) != 64) deferred = 0;
+    }
+    test_cond("Memory pressure defers growth up to force_grow_fill", deferred);
+    dictCrt.dictAdd(d, stringFromLongLong(added), (void*)added);
+    test_cond("Forced growth under memory pressure fits all keys",
+              dictIsRehashing(d) && dictSlots(d) == 64 + 512);
+    zmalloc::zmalloc_set_soft_limit(0);
+    dictCrt.dictRelease(d);
+
+    /* dictDisableResize期间不缩容 */
+    d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 1000);
+    dictCrt.dictDisableResize();
+    for (long j = 0; j < 1000; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    test_cond("No shrinking while resize is disabled", dictSlots(d) == 1024 && dictSize(d) == 0);
+    dictCrt.dictEnableResize();
+    test_cond("dictShrinkIfNeeded shrinks on demand",
+              dictCrt.dictShrinkIfNeeded(d) == DICT_OK);
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    test_cond("Empty dict shrinks to the initial size", dictSlots(d) == DICT_HT_INITIAL_SIZE);
+    dictCrt.dictRelease(d);
+}
+
+typedef struct bulkSource {
+    long next, end;
+} bulkSource;
+
+static int bulkNext(void *privdata, void **key, void **val) {
+    bulkSource *src = static_cast<bulkSource*>(privdata);
+    if (src->next == src->end) return 0;
+    *key = stringFromLongLong(src->next);
+    *val = (void*)src->next++;
+    return 1;
+}
+
+static int checkBulkDict(dict *d, long start, long end) {
+    if (dictSize(d) != (unsigned long)(end - start)) return 0;
+    for (long j = start; j < end; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        zfree(key);
+        if (de == NULL || dictGetVal(de) != (void*)j) return 0;
+    }
+    return 1;
+}
+
+// 批量加载：按count一次扩到位，多线程算哈希，重复键按析构函数释放，count偏小时按批追加扩容
+static void testBulkLoad(void) {
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    bulkSource src = {0, 100000};
+    unsigned long added = dictCrt.dictBulkLoad(d, 100000, bulkNext, &src, DICT_BULK_UNIQUE, 4);
+    test_cond("Bulk load sizes the table once",
+              added == 100000 && !dictIsRehashing(d) && dictSlots(d) == 131072);
+    test_cond("Bulk loaded keys are all found", checkBulkDict(d, 0, 100000));
+    dictCrt.dictRelease(d);
+
+    /* 与已有的键重叠一半，重复的键值对由字典释放 */
+    d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 500);
+    src = {250, 1250};
+    added = dictCrt.dictBulkLoad(d, 1000, bulkNext, &src, 0, 1);
+    test_cond("Bulk load drops duplicate keys", added == 750 && checkBulkDict(d, 0, 1250));
+    dictCrt.dictRelease(d);
+
+    /* swiss引擎，count远小于实际个数，跨多批 */
+    d = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    src = {0, DICT_BULK_CHUNK + 5000};
+    added = dictCrt.dictBulkLoad(d, 10, bulkNext, &src, 0, 4);
+    test_cond("Bulk load grows past the count hint (swiss)",
+              added == DICT_BULK_CHUNK + 5000 && !dictIsRehashing(d) && checkBulkDict(d, 0, DICT_BULK_CHUNK + 5000));
+    dictCrt.dictRelease(d);
+
+    /* 安全迭代器暂停rehash期间逐个插入 */
+    d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 100);
+    dictIterator *iter = dictCrt.dictGetSafeIterator(d);
+    dictCrt.dictNext(iter);
+    src = {50, 5000};
+    added = dictCrt.dictBulkLoad(d, 4950, bulkNext, &src, 0, 4);
+    dictCrt.dictReleaseIterator(iter);
+    test_cond("Bulk load falls back to dictAdd while rehash is paused",
+              added == 4900 && checkBulkDict(d, 0, 5000));
+    dictCrt.dictRelease(d);
+}
+
+typedef struct scanCounter {
+    unsigned char *seen;    // 按值（即键的序号）计数
+    long visited;
+} scanCounter;
+
+static void scanCountCallback(void *privdata, const dictEntry *de) {
+    scanCounter *c = static_cast<scanCounter*>(privdata);
+    c->seen[(long)dictGetVal(de)]++;
+    c->visited++;
+}
+
+static int checkSeen(const unsigned char *seen, long start, long end, int exact) {
+    for (long j = start; j < end; j++)
+        if (seen[j] == 0 || (exact && seen[j] != 1)) return 0;
+    return 1;
+}
+
+// 分区扫描各分区交错推进，期间扩容或缩容也不漏掉一直存在的键；并行扫描每个键恰好返回一次
+static void testScanPartition(void) {
+    const long count = 20000;
+    unsigned char *seen = static_cast<unsigned char*>(zcalloc(count));
+    scanCounter c = {seen, 0};
+    unsigned long cursors[8];
+    int active;
+
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 1000);
+    for (int p = 0; p < 8; p++) cursors[p] = p;
+    do {
+        active = 0;
+        for (int p = 0; p < 8; p++) {
+            if (cursors[p] == (unsigned long)-1) continue;
+            cursors[p] = dictCrt.dictScanPartition(d, cursors[p], 8, scanCountCallback, NULL, &c);
+            if (cursors[p] == 0) cursors[p] = (unsigned long)-1;
+            else active++;
+        }
+    } while (active);
+    test_cond("Partitions cover every key exactly once", checkSeen(seen, 0, 1000, 1) && c.visited == 1000);
+
+    /* 扫描中途扩容到原来的十几倍 */
+    memset(seen, 0, count);
+    long added = 1000;
+    for (int p = 0; p < 8; p++) cursors[p] = p;
+    do {
+        active = 0;
+        for (int p = 0; p < 8; p++) {
+            if (cursors[p] == (unsigned long)-1) continue;
+            cursors[p] = dictCrt.dictScanPartition(d, cursors[p], 8, scanCountCallback, NULL, &c);
+            if (cursors[p] == 0) cursors[p] = (unsigned long)-1;
+            else active++;
+        }
+        for (int k = 0; k < 100 && added < count; k++, added++)
+            dictCrt.dictAdd(d, stringFromLongLong(added), (void*)added);
+    } while (active);
+    test_cond("Partitioned scan survives growth", checkSeen(seen, 0, 1000, 0));
+
+    /* 扫描中途删掉大部分键，自动缩容 */
+    memset(seen, 0, count);
+    long deleted = count;
+    for (int p = 0; p < 8; p++) cursors[p] = p;
+    do {
+        active = 0;
+        for (int p = 0; p < 8; p++) {
+            if (cursors[p] == (unsigned long)-1) continue;
+            cursors[p] = dictCrt.dictScanPartition(d, cursors[p], 8, scanCountCallback, NULL, &c);
+            if (cursors[p] == 0) cursors[p] = (unsigned long)-1;
+            else active++;
+        }
+        for (int k = 0; k < 1000 && deleted > 500; k++) {
+            char *key = stringFromLongLong(--deleted);
+            dictCrt.dictDelete(d, key);
+            zfree(key);
+        }
+    } while (active);
+    test_cond("Partitioned scan survives shrinking", checkSeen(seen, 0, 500, 0));
+    dictCrt.dictRelease(d);
+
+    /* 并行扫描：链式字典rehash中途、swiss字典 */
+    scanCounter counters[4];
+    void *privdata[4];
+    for (int t = 0; t < 4; t++) {
+        counters[t].seen = seen;
+        counters[t].visited = 0;
+        privdata[t] = &counters[t];
+    }
+    memset(seen, 0, count);
+    d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    buildDict(d, 16384);
+    for (long j = 16384; j < count; j++) dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j);
+    int rehashing = dictIsRehashing(d);
+    int threads = dictCrt.dictScanParallel(d, 4, scanCountCallback, privdata);
+    long visited = 0;
+    for (int t = 0; t < threads; t++) visited += counters[t].visited;
+    test_cond("Parallel scan visits every key once (rehashing)",
+              rehashing && threads == 4 && visited == count && checkSeen(seen, 0, count, 1) &&
+              d->pauserehash == 0);
+    dictCrt.dictRelease(d);
+
+    memset(seen, 0, count);
+    for (int t = 0; t < 4; t++) counters[t].visited = 0;
+    d = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    buildDict(d, count);
+    threads = dictCrt.dictScanParallel(d, 4, scanCountCallback, privdata);
+    visited = 0;
+    for (int t = 0; t < threads; t++) visited += counters[t].visited;
+    test_cond("Parallel scan visits every key once (swiss)",
+              threads == 4 && visited == count && checkSeen(seen, 0, count, 1));
+    dictCrt.dictRelease(d);
+    zfree(seen);
+}
+
+static unsigned long long probeHistTotal(const dictMetrics *m) {
+    unsigned long long total = 0;
+    for (int j = 0; j < DICT_METRICS_PROBE_BUCKETS; j++) total += m->probe_hist[j];
+    return total;
+}
+
+// 运行指标：查找命中率与探测长度、rehash步数、扩缩容次数、暂停次数，以及JSON导出
+static void testMetrics(void) {
+    dict *d = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    dictMetrics m;
+    char buf[1024];
+
+    if (dictCrt.dictEnableMetrics(d) != DICT_OK) {
+        /* 编译时关闭了指标：只有表形态 */
+        buildDict(d, 100);
+        dictCrt.dictGetMetrics(d, &m);
+        test_cond("Metrics compiled out report only the shape",
+                  m.keys == 100 && m.find_hits == 0 && m.expands == 0);
+        dictCrt.dictRelease(d);
+        return;
+    }
+
+    /* 4 -> 8 -> ... -> 1024，第一次分配不算扩容 */
+    buildDict(d, 1000);
+    for (long j = 0; j < 1100; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictFind(d, key);
+        zfree(key);
+    }
+    dictCrt.dictGetMetrics(d, &m);
+    test_cond("Metrics count expansions and rehash steps",
+              m.expands == 8 && m.shrinks == 0 && m.rehash_steps > 0 && m.keys == 1000 && m.slots == 1024);
+    test_cond("Metrics count find hits, misses and probes",
+              m.find_hits == 1000 && m.find_misses == 100 && probeHistTotal(&m) == 1100 &&
+              m.probe_sum >= 1000 && m.probe_hist[0] > 0);
+
+    /* 安全迭代器期间rehash暂停 */
+    dictCrt.dictResetMetrics(d);
+    dictIterator *iter = dictCrt.dictGetSafeIterator(d);
+    dictCrt.dictNext(iter);
+    for (long j = 1000; j < 1100; j++) dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j);
+    dictCrt.dictReleaseIterator(iter);
+    dictCrt.dictGetMetrics(d, &m);
+    test_cond("Metrics count rehash pauses", m.rehash_pauses == 1 && m.rehash_steps_paused > 0 &&
+              m.rehash_steps == 0 && m.expands == 1 && m.rehashing);
+
+    for (long j = 0; j < 1080; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    dictCrt.dictGetMetrics(d, &m);
+    test_cond("Metrics count shrinks", m.shrinks >= 1);
+
+    size_t len = dictCrt.dictFormatMetrics(d, "db0\"", buf, sizeof(buf));
+    char expect[64];
+    snprintf(expect, sizeof(expect), "\"shrinks\":%llu,", m.shrinks);
+    test_cond("Metrics export as one JSON line",
+              len == strlen(buf) && buf[len - 1] == '\n' &&
+              strncmp(buf, "{\"name\":\"db0\",\"engine\":\"chained\",\"keys\":20,", 43) == 0 &&
+              strstr(buf, expect) != NULL && strstr(buf, "\"probe_hist\":[") != NULL);
+
+    dictCrt.dictResetMetrics(d);
+    dictCrt.dictGetMetrics(d, &m);
+    test_cond("Metrics reset clears the counters",
+              m.find_hits == 0 && m.shrinks == 0 && m.rehash_pauses == 0 && m.keys == 20);
+    dictCrt.dictRelease(d);
+
+    /* swiss引擎按组计探测长度 */
+    d = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    dictCrt.dictEnableMetrics(d);
+    buildDict(d, 1000);
+    for (long j = 0; j < 1100; j++) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictFind(d, key);
+        zfree(key);
+    }
+    dictCrt.dictGetMetrics(d, &m);
+    test_cond("Swiss metrics count finds by probed groups",
+              m.find_hits == 1000 && m.find_misses == 100 && probeHistTotal(&m) == 1100 &&
+              m.probe_hist[0] == 0 && m.probe_sum >= 1100 && m.expands > 0 && m.engine == DICT_ENGINE_SWISS);
+    dictCrt.dictRelease(d);
+}
+
+static void testSwissDict(void) {
+    long j, count = 20000, found, missing;
+    dict *d = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    test_cond("Swiss dictionary creation", d != nullptr && dictIsSwiss(d) && dictSize(d) == 0);
+
+    int sawrehash = 0, lookupok = 1;
+    for (j = 0; j < count; j++) {
+        if (dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j) != DICT_OK) lookupok = 0;
+        if (dictIsRehashing(d)) {
+            /* rehash过程中两张表里的元素都要能找到 */
+            sawrehash = 1;
+            char *key = stringFromLongLong(j / 2);
+            dictEntry *de = dictCrt.dictFind(d, key);
+            if (de == NULL || (long)dictGetVal(de) != j / 2) lookupok = 0;
+            zfree(key);
+        }
+    }
+    test_cond("Swiss add grows with incremental rehash", sawrehash && lookupok);
+    test_cond("Swiss size after add", (long)dictSize(d) == count);
+
+    char *dup = stringFromLongLong(7);
+    test_cond("Swiss add of existing key fails", dictCrt.dictAdd(d, dup, (void*)1) == DICT_ERR);
+    dictEntry *existing = NULL;
+    test_cond("Swiss addRaw reports existing entry",
+        dictCrt.dictAddRaw(d, dup, &existing) == NULL && existing && (long)dictGetVal(existing) == 7);
+    zfree(dup);
+
+    found = missing = 0;
+    for (j = 0; j < count; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (de && (long)dictGetVal(de) == j) found++;
+        key[0] = 'X';
+        if (dictCrt.dictFind(d, key) == NULL) missing++;
+        zfree(key);
+    }
+    test_cond("Swiss find all existing keys", found == count);
+    test_cond("Swiss find misses absent keys", missing == count);
+
+    /* 删除偶数键，之后墓碑不能截断奇数键的探测序列 */
+    for (j = 0; j < count; j += 2) {
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    found = missing = 0;
+    for (j = 0; j < count; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *de = dictCrt.dictFind(d, key);
+        if (j % 2 && de && (long)dictGetVal(de) == j) found++;
+        if (j % 2 == 0 && de == NULL) missing++;
+        zfree(key);
+    }
+    test_cond("Swiss delete keeps other keys reachable",
+        found == count / 2 && missing == count / 2 && (long)dictSize(d) == count / 2);
+
+    /* 反复增删同一批键，墓碑被复用或清理，表不会无限增长 */
+    unsigned long slots = dictSlots(d);
+    for (int round = 0; round < 8; round++) {
+        for (j = 0; j < count; j += 2) dictCrt.dictAdd(d, stringFromLongLong(j), (void*)j);
+        for (j = 0; j < count; j += 2) {
+            char *key = stringFromLongLong(j);
+            dictCrt.dictDelete(d, key);
+            zfree(key);
+        }
+    }
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+    test_cond("Swiss churn does not grow the table", dictSlots(d) <= slots && (long)dictSize(d) == count / 2);
+
+    char *rkey = stringFromLongLong(1);
+    test_cond("Swiss replace existing key", dictCrt.dictReplace(d, rkey, (void*)100) == 0);
+    dictEntry *de = dictCrt.dictFind(d, rkey);
+    test_cond("Swiss replace updates value", de && (long)dictGetVal(de) == 100);
+    dictSetVal(d, de, (void*)1);
+    de = dictCrt.dictUnlink(d, rkey);
+    test_cond("Swiss unlink returns the entry", de && (long)dictGetVal(de) == 1 &&
+        dictCrt.dictFind(d, rkey) == NULL && (long)dictSize(d) == count / 2 - 1);
+    dictCrt.dictFreeUnlinkedEntry(d, de);
+    dictCrt.dictAdd(d, rkey, (void*)1);
+
+    long iterated = 0, sum = 0;
+    dictIterator *iter = dictCrt.dictGetSafeIterator(d);
+    while ((de = dictCrt.dictNext(iter)) != NULL) {
+        iterated++;
+        sum += (long)dictGetVal(de);
+    }
+    dictCrt.dictReleaseIterator(iter);
+    test_cond("Swiss iterator visits every entry once",
+        iterated == count / 2 && sum == (count / 2) * (count / 2));
+
+    /* 安全迭代器期间持续插入，ht[1]装不下时也不能搬ht[0]，原有元素各访问恰好一次 */
+    dict *paused = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    long base = 1000, added = base;
+    for (j = 0; j < base; j++) dictCrt.dictAdd(paused, stringFromLongLong(j), (void*)j);
+    while (dictIsRehashing(paused)) dictCrt.dictRehash(paused, 100);
+    unsigned char *seen = static_cast<unsigned char*>(zcalloc(base));
+    iter = dictCrt.dictGetSafeIterator(paused);
+    while ((de = dictCrt.dictNext(iter)) != NULL) {
+        if ((long)dictGetVal(de) < base) seen[(long)dictGetVal(de)]++;
+        for (int k = 0; k < 16 && added < base * 10; k++, added++)
+            dictCrt.dictAdd(paused, stringFromLongLong(added), (void*)added);
+    }
+    dictCrt.dictReleaseIterator(iter);
+    found = 0;
+    for (j = 0; j < added; j++) {
+        char *key = stringFromLongLong(j);
+        dictEntry *fe = dictCrt.dictFind(paused, key);
+        if (fe && (long)dictGetVal(fe) == j) found++;
+        zfree(key);
+    }
+    test_cond("Swiss add under safe iterator does not move entries",
+        checkSeen(seen, 0, base, 1) && added == base * 10 && found == added &&
+        (long)dictSize(paused) == added);
+    zfree(seen);
+    dictCrt.dictRelease(paused);
+
+    /* 扫描过程中持续插入，触发rehash，原有元素仍全部被扫到 */
+    seen = static_cast<unsigned char*>(zcalloc(count * 2));
+    unsigned long cursor = 0;
+    added = count;
+    sawrehash = 0;
+    do {
+        cursor = dictCrt.dictScan(d, cursor, markScanFunction, dummyScanBucketFunction, seen);
+        if (added < count * 2) {
+            for (int k = 0; k < 64 && added < count * 2; k++, added++)
+                dictCrt.dictAdd(d, stringFromLongLong(added), (void*)added);
+        }
+        if (dictIsRehashing(d)) sawrehash = 1;
+    } while (cursor != 0);
+    found = 0;
+    for (j = 1; j < count; j += 2) found += seen[j];
+    test_cond("Swiss scan returns all elements across rehash", sawrehash && found == count / 2);
+    zfree(seen);
+
+    dictEntry *some[32];
+    test_cond("Swiss random key", dictCrt.dictGetRandomKey(d) != NULL && dictCrt.dictGetFairRandomKey(d) != NULL);
+    test_cond("Swiss get some keys", dictCrt.dictGetSomeKeys(d, some, 32) > 0);
+
+    char stats[4096];
+    dictCrt.dictGetStats(stats, sizeof(stats), d);
+    test_cond("Swiss stats", strstr(stats, "swiss") != NULL && strstr(stats, "probe length") != NULL);
+
+    dictCrt.dictEmpty(d, NULL);
+    test_cond("Swiss empty", dictSize(d) == 0 && dictSlots(d) == 0 && dictIsSwiss(d));
+    dictCrt.dictAdd(d, stringFromLongLong(1), (void*)1);
+    test_cond("Swiss reuse after empty", dictSize(d) == 1);
+    dictCrt.dictRelease(d);
+
+    /* 同样的键，swiss表每个元素的内存应明显少于链式表 */
+    dict *chained = dictCrt.dictCreate(&BenchmarkDictType, NULL);
+    dict *swiss = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    size_t chainedmem = buildDict(chained, 100000);
+    size_t swissmem = buildDict(swiss, 100000);
+    printf("memory for 100000 entries: chained %zu bytes, swiss %zu bytes\n", chainedmem, swissmem);
+    test_cond("Swiss uses less memory than chained", swissmem < chainedmem);
+    dictCrt.dictRelease(chained);
+    dictCrt.dictRelease(swiss);
+}
+static int denyExpand(size_t moreMem, double usedRatio) {
+    (void)moreMem;
+    (void)usedRatio;
+    return 0;
+}
+
+/* 新键换旧键：活元素数不变，只留下墓碑 */
+static void swissChurn(dict *d, long live, long rounds) {
+    for (long j = 0; j < rounds; j++) {
+        dictCrt.dictAdd(d, stringFromLongLong(live + j), (void*)(live + j));
+        char *key = stringFromLongLong(j);
+        dictCrt.dictDelete(d, key);
+        zfree(key);
+    }
+    while (dictIsRehashing(d)) dictCrt.dictRehash(d, 100);
+}
+
+// swiss字典的扩容与链式字典一样受dictDisableResize和expandAllowed限制，
+// 被拒绝时靠清理墓碑腾出空间，活元素占满时仍然被迫翻倍
+static void testSwissResizeLimits(void) {
+    long live = 1500, rounds = 8000;
+    dict *d = dictCrt.dictCreateSwiss(&BenchmarkDictType, NULL);
+    buildDict(d, live);
+    unsigned long slots = dictSlots(d);
+    dictCrt.dictDisableResize();
+    swissChurn(d, live, rounds);
+    dictCrt.dictEnableResize();
+    test_cond("Swiss churn does not double while resize is disabled",
+              dictSlots(d) == slots && (long)dictSize(d) == live);
+    dictCrt.dictRelease(d);
+
+    dictType type = BenchmarkDictType;
+    type.expandAllowed = denyExpand;
+    d = dictCrt.dictCreateSwiss(&type, NULL);
+    buildDict(d, live);
+    slots = dictSlots(d);
+    swissChurn(d, live, rounds);
+    test_cond("Swiss churn honours expandAllowed", dictSlots(d) == slots && (long)dictSize(d) == live);
+
+    /* 不删只加：墓碑腾不出空间后被迫翻倍 */
+    long added = live + rounds;
+    while (dictSlots(d) == slots) {
+        dictCrt.dictAdd(d, stringFromLongLong(added), (void*)added);
+        added++;
+    }
+    long found = 0;
+    for (long j = rounds; j < added; j++) {
+        char *key = stringFromLongLong(j);
+        if (dictCrt.dictFind(d, key)) found++;
+        zfree(key);
+    }
+    test_cond("Swiss forced growth when live entries fill the table",
+              found == added - rounds && (long)dictSize(d) == found);
+    dictCrt.dictRelease(d);
+}
+
 int main(int argc,char* argv[])
 {
     long j;
@@ -193,7 +1367,20 @@ int main(int argc,char* argv[])
     
     dictCrt.dictRelease(dict);
 
-
+    testSwissDict();
+    testSwissResizeLimits();
+    testFindBatch();
+    testBackgroundRehash();
+    testDefragDuringBackgroundRehash();
+    testShardedDict();
+    testHashBackends();
+    testEmbeddedKeys();
+    testEntryPool();
+    testResizePolicy();
+    testBulkLoad();
+    testScanPartition();
+    testMetrics();
+    test_report();
     return 0; 
 }
 
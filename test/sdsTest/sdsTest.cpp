@@ -43,6 +43,270 @@ static sds sdsTestTemplateCallback(sds varname, void *arg) {
 }
 
 
+/* 与sdssplitlen语义相同的逐字节参考实现，用来核对向量化查找的结果 */
+static int sdsTestSplitRef(const char *s, int len, const char *sep, int seplen, sds *out)
+{
+    int n = 0, start = 0;
+    for (int j = 0; j <= len - seplen; j++) {
+        if (memcmp(s + j, sep, seplen) == 0) {
+            out[n++] = sdsC.sdsnewlen(s + start, j - start);
+            start = j + seplen;
+            j += seplen - 1;
+        }
+    }
+    out[n++] = sdsC.sdsnewlen(s + start, len - start);
+    return n;
+}
+
+static void testSplit(void)
+{
+    int count, argc;
+    sds *tokens;
+
+    /* 跨越多个16/32字节块的长行，分隔符落在块边界两侧 */
+    sds line = sdsC.sdsempty();
+    for (int j = 0; j < 200; j++) line = sdsC.sdscatprintf(line, "%s%d", j ? "," : "", j * 37);
+    tokens = sdsC.sdssplitlen(line, sdsC.sdslen(line), ",", 1, &count);
+    int ok = tokens != NULL && count == 200;
+    for (int j = 0; ok && j < count; j++) ok = strtol(tokens[j], NULL, 10) == j * 37;
+    test_cond("sdssplitlen() long line with single-byte separator", ok);
+    sdsC.sdsfreesplitres(tokens, count);
+    sdsC.sdsfree(line);
+
+    tokens = sdsC.sdssplitlen("foo_-_bar__-_baz_-__-_", 22, "_-_", 3, &count);
+    test_cond("sdssplitlen() multi-byte separator and empty tokens",
+        tokens != NULL && count == 5 && strcmp(tokens[0], "foo") == 0 && strcmp(tokens[1], "bar_") == 0 &&
+        strcmp(tokens[2], "baz") == 0 && sdsC.sdslen(tokens[3]) == 0 && sdsC.sdslen(tokens[4]) == 0);
+    sdsC.sdsfreesplitres(tokens, count);
+
+    tokens = sdsC.sdssplitlen("ab", 2, "abc", 3, &count);
+    test_cond("sdssplitlen() separator longer than input", tokens != NULL && count == 1 && strcmp(tokens[0], "ab") == 0);
+    sdsC.sdsfreesplitres(tokens, count);
+
+    /* 随机内容与参考实现逐个比较，字母表很小，分隔符的首尾字节候选会频繁出现 */
+    unsigned int seed = 12345;
+    ok = 1;
+    for (int round = 0; ok && round < 500; round++) {
+        char buf[200], sep[5];
+        int len = rand_r(&seed) % (int)sizeof(buf), seplen = 1 + rand_r(&seed) % 4;
+        for (int j = 0; j < len; j++) buf[j] = "ab-"[rand_r(&seed) % 3];
+        for (int j = 0; j < seplen; j++) sep[j] = "ab-"[rand_r(&seed) % 3];
+        sds ref[sizeof(buf) + 1];
+        int refcount = sdsTestSplitRef(buf, len, sep, seplen, ref);
+        tokens = sdsC.sdssplitlen(buf, len, sep, seplen, &count);
+        if (len == 0) ok = tokens != NULL && count == 0;
+        else ok = tokens != NULL && count == refcount;
+        for (int j = 0; ok && len && j < count; j++) ok = sdsC.sdscmp(tokens[j], ref[j]) == 0;
+        for (int j = 0; j < refcount; j++) sdsC.sdsfree(ref[j]);
+        sdsC.sdsfreesplitres(tokens, count);
+    }
+    test_cond("sdssplitlen() matches the byte-by-byte reference", ok);
+
+    tokens = sdsC.sdssplitargs("  set averyveryveryverylongkeyname\t\"quoted value with \\\"escapes\\\" and \\x41\\x42\\n\""
+                               " 'single \\'quoted\\' value spanning several blocks' mid\"dle\" ", &argc);
+    test_cond("sdssplitargs() long tokens with quotes and escapes",
+        tokens != NULL && argc == 5 && strcmp(tokens[0], "set") == 0 &&
+        strcmp(tokens[1], "averyveryveryverylongkeyname") == 0 &&
+        strcmp(tokens[2], "quoted value with \"escapes\" and AB\n") == 0 &&
+        strcmp(tokens[3], "single 'quoted' value spanning several blocks") == 0 &&
+        strcmp(tokens[4], "middle") == 0);
+    sdsC.sdsfreesplitres(tokens, argc);
+
+    line = sdsC.sdsempty();
+    for (int j = 0; j < 100; j++) line = sdsC.sdscatprintf(line, "arg%d ", j);
+    tokens = sdsC.sdssplitargs(line, &argc);
+    ok = tokens != NULL && argc == 100;
+    for (int j = 0; ok && j < argc; j++) ok = strtol(tokens[j] + 3, NULL, 10) == j;
+    test_cond("sdssplitargs() many arguments", ok);
+    sdsC.sdsfreesplitres(tokens, argc);
+    sdsC.sdsfree(line);
+
+    tokens = sdsC.sdssplitargs("foo \"unterminated quote with a long tail", &argc);
+    test_cond("sdssplitargs() unbalanced quotes", tokens == NULL && argc == 0);
+    tokens = sdsC.sdssplitargs("\"foo\"bar", &argc);
+    test_cond("sdssplitargs() closing quote followed by a non space", tokens == NULL && argc == 0);
+    tokens = sdsC.sdssplitargs("   ", &argc);
+    test_cond("sdssplitargs() empty input", tokens != NULL && argc == 0);
+    sdsC.sdsfreesplitres(tokens, argc);
+}
+
+static void testViews(void)
+{
+    sds x = sdsC.sdsnew("[member:1234");
+    sdsview v = sdsC.sdsviewfromsds(x);
+    sdsview sub = sdsC.sdsviewrange(v, 1, -1);
+    test_cond("sdsviewrange() strips the prefix without copying",
+        sub.ptr == x + 1 && sub.len == 11 && memcmp(sub.ptr, "member:1234", 11) == 0);
+    sub = sdsC.sdsviewrange(v, -4, -1);
+    test_cond("sdsviewrange() negative indexes", sub.len == 4 && memcmp(sub.ptr, "1234", 4) == 0);
+    sub = sdsC.sdsviewrange(v, 5, 2);
+    test_cond("sdsviewrange() start > end", sub.len == 0);
+    sub = sdsC.sdsviewsubstr(v, 8, 100);
+    test_cond("sdsviewsubstr() clamps like sdssubstr", sub.len == 4 && sub.ptr == x + 8);
+    sub = sdsC.sdsviewsubstr(v, 100, 1);
+    test_cond("sdsviewsubstr() start past the end", sub.len == 0);
+    test_cond("sdsviewcmp()",
+        sdsC.sdsviewcmp(sdsC.sdsviewlen("abc", 3), sdsC.sdsviewlen("abd", 3)) < 0 &&
+        sdsC.sdsviewcmp(sdsC.sdsviewlen("abc", 3), sdsC.sdsviewlen("ab", 2)) > 0 &&
+        sdsC.sdsviewcmp(sdsC.sdsviewlen("ab", 2), sdsC.sdsviewlen("ab", 2)) == 0);
+
+    sds y = sdsC.sdscatview(sdsC.sdsnew(">"), sdsC.sdsviewrange(v, 1, 6));
+    test_cond("sdscatview()", sdsC.sdslen(y) == 7 && memcmp(y, ">member\0", 8) == 0);
+    y = sdsC.sdscpyview(y, sdsC.sdsviewrange(v, -4, -1));
+    test_cond("sdscpyview()", sdsC.sdslen(y) == 4 && memcmp(y, "1234\0", 5) == 0);
+    sdsC.sdsfree(y);
+    sdsC.sdsfree(x);
+
+    sdsview tokens[4];
+    const char *line = "a,bb,,ccc,dddd,e";
+    int count = sdsC.sdssplitview(sdsC.sdsviewlen(line, strlen(line)), ",", 1, tokens, 4);
+    test_cond("sdssplitview() reports the full count and fills the first tokens",
+        count == 6 && tokens[0].len == 1 && tokens[1].len == 2 && tokens[2].len == 0 &&
+        tokens[3].ptr == line + 6 && tokens[3].len == 3);
+    count = sdsC.sdssplitview(sdsC.sdsviewlen("", 0), ",", 1, tokens, 4);
+    test_cond("sdssplitview() empty input", count == 0);
+
+    sdsshared *sh = sdsC.sdssharednew(sdsC.sdsnew("GET key:0001 key:0002"));
+    sdsslice first = sdsC.sdsslicenew(sh, 4, 8);
+    sdsslice second = sdsC.sdsslicenew(sh, 13, 100);
+    sdsslice inner = sdsC.sdsslicesub(&first, 4, 4);
+    sdsC.sdssharedrelease(sh);
+    test_cond("sdsslice holds references on the shared buffer", sh->refcount == 3);
+    sdsview fv = sdsC.sdssliceview(&first), sv = sdsC.sdssliceview(&second), iv = sdsC.sdssliceview(&inner);
+    test_cond("sdsslice content",
+        fv.len == 8 && memcmp(fv.ptr, "key:0001", 8) == 0 &&
+        sv.len == 8 && memcmp(sv.ptr, "key:0002", 8) == 0 &&
+        iv.len == 4 && memcmp(iv.ptr, "0001", 4) == 0 && iv.ptr == fv.ptr + 4);
+    sdsC.sdsslicefree(&first);
+    sdsC.sdsslicefree(&second);
+    test_cond("sdsslicefree() clears the slice", first.shared == NULL && sdsC.sdssliceview(&first).len == 0);
+    iv = sdsC.sdssliceview(&inner);
+    test_cond("sdsslice outlives its parent slice", iv.len == 4 && memcmp(iv.ptr, "0001", 4) == 0);
+    sdsC.sdsslicefree(&inner);
+}
+
+static void testGrowPolicy(void)
+{
+    sdsGrowPolicy saved, policy;
+    sdsC.sdsGetGrowPolicy(&saved);
+    test_cond("sdsGetGrowPolicy() defaults",
+        saved.max_prealloc == SDS_MAX_PREALLOC && saved.large_div == SDS_GROW_LARGE_DIV &&
+        saved.bounded_div == SDS_BOUNDED_SLACK_DIV && saved.sweep_min_free == SDS_SWEEP_MIN_FREE);
+
+    sds x = sdsC.sdsnewlen(NULL, 100);
+    x = sdsC.sdsMakeRoomForMode(x, 1000, SDS_GROW_EXACT);
+    test_cond("sdsMakeRoomForMode() exact keeps only allocator slack",
+        sdsC.sdsavail(x) >= 1000 && sdsC.sdsalloc(x) < 1100 + 64 &&
+        sdsC.sdsAllocSize(x) == zmalloc_size(sdsC.sdsAllocPtr(x)));
+    sdsC.sdsfree(x);
+
+    x = sdsC.sdsnewlen(NULL, 100);
+    x = sdsC.sdsMakeRoomForMode(x, 7900, SDS_GROW_BOUNDED);
+    test_cond("sdsMakeRoomForMode() bounded slack",
+        sdsC.sdsalloc(x) >= 8000 + 8000 / SDS_BOUNDED_SLACK_DIV && sdsC.sdsalloc(x) < 8000 * 2);
+    sdsC.sdsfree(x);
+
+    x = sdsC.sdsnewlen(NULL, 100);
+    x = sdsC.sdsMakeRoomFor(x, 900);
+    test_cond("sdsMakeRoomFor() doubles small strings", sdsC.sdsalloc(x) >= 2000);
+    sdsC.sdsfree(x);
+
+    size_t big = 8 * SDS_MAX_PREALLOC;
+    x = sdsC.sdsnewlen(NULL, big);
+    x = sdsC.sdsMakeRoomFor(x, sdsC.sdsavail(x) + 1);
+    test_cond("sdsMakeRoomFor() large strings grow by len/large_div",
+        sdsC.sdslen(x) + sdsC.sdsavail(x) >= big + big / SDS_GROW_LARGE_DIV &&
+        sdsC.sdsavail(x) < big / 2);
+    policy = saved;
+    policy.large_div = 0;
+    sdsC.sdsSetGrowPolicy(&policy);
+    sds y = sdsC.sdsnewlen(NULL, big);
+    y = sdsC.sdsMakeRoomFor(y, sdsC.sdsavail(y) + 1);
+    test_cond("sdsSetGrowPolicy() large_div 0 keeps linear growth",
+        sdsC.sdslen(y) + sdsC.sdsavail(y) >= big + SDS_MAX_PREALLOC &&
+        sdsC.sdsavail(y) < SDS_MAX_PREALLOC + 16384);
+    sdsC.sdsSetGrowPolicy(NULL);
+
+    sds strs[4];
+    strs[0] = x;
+    strs[1] = NULL;
+    strs[2] = sdsC.sdsMakeRoomFor(sdsC.sdsnew("small"), 100);
+    strs[3] = y;
+    size_t avail_small = sdsC.sdsavail(strs[2]);
+    size_t reclaimed = sdsC.sdsSweepFreeSpace(strs, 4);
+    test_cond("sdsSweepFreeSpace() shrinks only large idle buffers",
+        reclaimed >= big / SDS_GROW_LARGE_DIV + SDS_MAX_PREALLOC &&
+        sdsC.sdsavail(strs[0]) < SDS_SWEEP_MIN_FREE && sdsC.sdslen(strs[0]) == big &&
+        sdsC.sdsavail(strs[3]) < SDS_SWEEP_MIN_FREE && sdsC.sdsavail(strs[2]) == avail_small);
+    test_cond("sdsRemoveFreeSpace() records the usable size",
+        sdsC.sdsAllocSize(strs[0]) == zmalloc_size(sdsC.sdsAllocPtr(strs[0])));
+    for (int j = 0; j < 4; j++)
+        if (strs[j]) sdsC.sdsfree(strs[j]);
+}
+
+static void testRope(void)
+{
+    sdsrope r;
+    sdsC.sdsropeinit(&r);
+    sdsC.sdsropecatlen(&r, "*2\r\n", 4);
+    sdsC.sdsropecatbulk(&r, "foo", 3);
+    test_cond("sdsropecatlen() merges adjacent scratch writes",
+        sdsC.sdsropelen(&r) == 13 && r.count == 1 && memcmp(r.segs[0].ptr, "*2\r\n$3\r\nfoo\r\n", 13) == 0);
+
+    char big[200];
+    memset(big, 'b', sizeof(big));
+    sds owned = sdsC.sdsnewlen(NULL, 100);
+    memset(owned, 'o', 100);
+    sdsC.sdsropecatborrow(&r, big, sizeof(big));
+    sdsC.sdsropecatsds(&r, owned);
+    sdsC.sdsropecatborrow(&r, "tiny", 4);
+    test_cond("sdsropecatborrow()/sdsropecatsds() do not copy large buffers",
+        r.count == 4 && r.segs[1].ptr == big && r.segs[2].ptr == owned && r.segs[2].own == owned &&
+        sdsC.sdsropelen(&r) == 13 + 200 + 100 + 4);
+
+    size_t slot = sdsC.sdsropedeferlen(&r);
+    sdsC.sdsropecatlen(&r, "x", 1);
+    sdsC.sdsropesetdeferredlen(&r, slot, '*', 12345);
+    test_cond("sdsropesetdeferredlen() fills the reserved slot",
+        r.segs[slot].len == 8 && memcmp(r.segs[slot].ptr, "*12345\r\n", 8) == 0 &&
+        sdsC.sdsropelen(&r) == 13 + 200 + 100 + 4 + 8 + 1);
+
+    struct iovec iov[3];
+    int cnt = sdsC.sdsropeiov(&r, iov, 3);
+    test_cond("sdsropeiov() fills up to iovmax",
+        cnt == 3 && iov[0].iov_len == 13 && iov[1].iov_base == big && iov[2].iov_len == 100);
+    sdsC.sdsropeconsume(&r, 13 + 150);
+    cnt = sdsC.sdsropeiov(&r, iov, 3);
+    test_cond("sdsropeconsume() resumes inside a segment after a partial write",
+        cnt == 3 && iov[0].iov_base == big + 150 && iov[0].iov_len == 50 &&
+        sdsC.sdsropepending(&r) == sdsC.sdsropelen(&r) - 163);
+    sdsC.sdsropeconsume(&r, sdsC.sdsropepending(&r));
+    test_cond("sdsropeiov() returns 0 when everything is written",
+        sdsC.sdsropeiov(&r, iov, 3) == 0 && sdsC.sdsropepending(&r) == 0);
+
+    size_t total = sdsC.sdsropelen(&r);
+    sds flat = sdsC.sdsropeflatten(&r);
+    test_cond("sdsropeflatten() concatenates every segment",
+        sdsC.sdslen(flat) == total && memcmp(flat, "*2\r\n$3\r\nfoo\r\nbbb", 16) == 0 &&
+        flat[13 + 200] == 'o' && memcmp(flat + 313, "tiny*12345\r\nx", 14) == 0 &&
+        r.count == 0 && r.segs == NULL);
+    sdsC.sdsfree(flat);
+
+    owned = sdsC.sdsnewlen(NULL, 100);
+    sdsC.sdsropecatsds(&r, owned);
+    flat = sdsC.sdsropeflatten(&r);
+    test_cond("sdsropeflatten() hands back a single owned sds without copying", flat == owned);
+    sdsC.sdsfree(flat);
+
+    sds large = sdsC.sdsnewlen(NULL, SDS_ROPE_CHUNK * 3);
+    for (int j = 0; j < 4; j++) sdsC.sdsropecatlen(&r, large, sdsC.sdslen(large));
+    for (int j = 0; j < 10000; j++) sdsC.sdsropecatbulk(&r, "value", 5);
+    test_cond("sdsrope grows chunk by chunk",
+        sdsC.sdsropelen(&r) == SDS_ROPE_CHUNK * 12 + 10000 * 11 && r.segs[0].own != NULL);
+    sdsC.sdsropefree(&r);
+    test_cond("sdsropefree() leaves an empty rope", r.count == 0 && sdsC.sdsropelen(&r) == 0);
+    sdsC.sdsfree(large);
+}
 
 int main(int argc, char **argv)
 {   
@@ -215,6 +479,10 @@ int main(int argc, char **argv)
     x = sdsC.sdstemplate("v1={{{variable1}} {{} v2={variable2}", sdsTestTemplateCallback, NULL);
     test_cond("sdstemplate() with quoting",memcmp(x,"v1={value1} {} v2=value2",24) == 0);
     sdsC.sdsfree(x);
-    
+
+    testSplit();
+    testViews();
+    testGrowPolicy();
+    testRope();
     return 0;
 }
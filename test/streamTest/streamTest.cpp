@@ -78,6 +78,43 @@ int main(int argc, char **argv)
     // 释放资源
     creator.freeStream(s);
 
+    // 测试 streamRangeToRope 函数：两条消息字段相同，第二条的值较长（可借用），"100"以整数形式存储
+    redisObjectCreate objC;
+    stream *rs = creator.streamNew();
+    char longval[101];
+    memset(longval, 'x', 100);
+    longval[100] = '\0';
+    const char *vals[2][2] = {{"a", "100"}, {longval, "7"}};
+    for (int j = 0; j < 2; j++) {
+        robj *argv[4] = {objC.createStringObject("f", 1), objC.createStringObject(vals[j][0], strlen(vals[j][0])),
+                         objC.createStringObject("n", 1), objC.createStringObject(vals[j][1], strlen(vals[j][1]))};
+        streamID use = {1, (uint64_t)j + 1}, added;
+        creator.streamAppendItem(rs, argv, 2, &added, &use);
+        for (int k = 0; k < 4; k++) objC.decrRefCount(argv[k]);
+    }
+    sds expect = sdsC.sdsnew("*2\r\n*2\r\n$3\r\n1-1\r\n*4\r\n$1\r\nf\r\n$1\r\na\r\n$1\r\nn\r\n$3\r\n100\r\n"
+                             "*2\r\n$3\r\n1-2\r\n*4\r\n$1\r\nf\r\n$100\r\n");
+    expect = sdsC.sdscat(expect, longval);
+    expect = sdsC.sdscat(expect, "\r\n$1\r\nn\r\n$1\r\n7\r\n");
+    for (int borrow = 0; borrow <= 1; borrow++) {
+        sdsrope rope;
+        sdsC.sdsropeinit(&rope);
+        size_t n = creator.streamRangeToRope(rs, NULL, NULL, 0, 0, &rope, borrow);
+        sds out = sdsC.sdsropeflatten(&rope);
+        test_cond(borrow ? "Test streamRangeToRope borrowing listpack values" : "Test streamRangeToRope function",
+            n == 2 && sdsC.sdscmp(out, expect) == 0);
+        sdsC.sdsfree(out);
+    }
+    sdsrope rope;
+    sdsC.sdsropeinit(&rope);
+    size_t n = creator.streamRangeToRope(rs, NULL, NULL, 1, 1, &rope, 0);
+    sds out = sdsC.sdsropeflatten(&rope);
+    test_cond("Test streamRangeToRope with count and rev",
+        n == 1 && strncmp(out, "*1\r\n*2\r\n$3\r\n1-2\r\n", 17) == 0);
+    sdsC.sdsfree(out);
+    sdsC.sdsfree(expect);
+    creator.freeStream(rs);
+
     // 输出测试报告
     test_report();
 
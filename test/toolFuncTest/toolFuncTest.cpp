@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
 #include "zmalloc.h"
 #include "sds.h"
 #include "toolFunc.h"
@@ -161,10 +162,105 @@ static void test_ll2string(void) {
     assert(!strcmp(buf, "9223372036854775807"));
 }
 
+static void test_digits10(void) {
+    char buf[32], ref[32];
+    unsigned long long v = 1;
+
+    /* 10的幂及其前后 */
+    assert(tool.digits10(0) == 1);
+    for (int d = 1; d <= 19; d++) {
+        v *= 10;
+        assert(tool.digits10(v - 1) == (uint32_t)d);
+        assert(tool.digits10(v) == (uint32_t)d + 1);
+    }
+    assert(tool.digits10(ULLONG_MAX) == 20);
+    assert(tool.sdigits10(LLONG_MIN) == 20);
+
+    /* 各种位数的随机值与snprintf对比 */
+    unsigned long long seed = 0x9e3779b97f4a7c15ULL;
+    for (int j = 0; j < 200000; j++) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        unsigned long long u = seed >> (seed % 64);
+        int sz = tool.ull2string(buf, sizeof buf, u);
+        snprintf(ref, sizeof ref, "%llu", u);
+        assert(sz == (int)strlen(ref) && !strcmp(buf, ref));
+        sz = tool.ll2string(buf, sizeof buf, -(long long)(u >> 1));
+        snprintf(ref, sizeof ref, "%lld", -(long long)(u >> 1));
+        assert(sz == (int)strlen(ref) && !strcmp(buf, ref));
+    }
+    assert(tool.ull2string(buf, sizeof buf, ULLONG_MAX) == 20 && !strcmp(buf, "18446744073709551615"));
+    assert(tool.ull2string(buf, 20, ULLONG_MAX) == 0);
+}
+
+static void test_d2string(void) {
+    char buf[TOOL_D2STRING_MAX];
+    int sz;
+
+    sz = tool.d2string(buf, sizeof buf, 0.1);
+    assert(sz == 3 && !strcmp(buf, "0.1"));
+    sz = tool.d2string(buf, sizeof buf, -1.5);
+    assert(sz == 4 && !strcmp(buf, "-1.5"));
+    sz = tool.d2string(buf, sizeof buf, 3.14);
+    assert(sz == 4 && !strcmp(buf, "3.14"));
+    sz = tool.d2string(buf, sizeof buf, 1e21);
+    assert(!strcmp(buf, "1e+21"));
+    sz = tool.d2string(buf, sizeof buf, 1.5e-7);
+    assert(!strcmp(buf, "1.5e-07"));
+    sz = tool.d2string(buf, sizeof buf, 0.00012);
+    assert(!strcmp(buf, "0.00012"));
+    sz = tool.d2string(buf, sizeof buf, 1e16);
+    assert(!strcmp(buf, "10000000000000000"));
+    sz = tool.d2string(buf, sizeof buf, 1.7976931348623157e308);
+    assert(!strcmp(buf, "1.7976931348623157e+308"));
+    sz = tool.d2string(buf, sizeof buf, 5e-324);
+    assert(!strcmp(buf, "5e-324"));
+    sz = tool.d2string(buf, sizeof buf, 12345);
+    assert(sz == 5 && !strcmp(buf, "12345"));
+    sz = tool.d2string(buf, 4, 3.14159);
+    assert(sz == 7 && !strcmp(buf, "3.1"));
+
+    /* 随机位模式：输出必须能还原成同一个double，且不长于%.17g */
+    unsigned long long seed = 0x2545f4914f6cdd1dULL;
+    for (int j = 0; j < 200000; j++) {
+        double d, back;
+        char ref[64];
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        memcpy(&d, &seed, sizeof(d));
+        if (isnan(d) || isinf(d)) continue;
+        sz = tool.d2string(buf, sizeof buf, d);
+        back = strtod(buf, NULL);
+        assert(sz == (int)strlen(buf));
+        assert(memcmp(&back, &d, sizeof(d)) == 0);
+        snprintf(ref, sizeof ref, "%.17g", d);
+        assert(sz <= (int)strlen(ref));
+    }
+}
+
+static void test_ld2string(void) {
+    char buf[MAX_LONG_DOUBLE_CHARS];
+    int sz;
+
+    sz = tool.ld2string(buf, sizeof buf, 42.0L, LD_STR_AUTO);
+    assert(sz == 2 && !strcmp(buf, "42"));
+    sz = tool.ld2string(buf, sizeof buf, -42.0L, LD_STR_HUMAN);
+    assert(sz == 3 && !strcmp(buf, "-42"));
+    sz = tool.ld2string(buf, sizeof buf, 1e17L, LD_STR_AUTO);
+    assert(!strcmp(buf, "1e+17"));
+    sz = tool.ld2string(buf, sizeof buf, 1.5L, LD_STR_HUMAN);
+    assert(sz == 3 && !strcmp(buf, "1.5"));
+    sz = tool.ld2string(buf, sizeof buf, -0.0L, LD_STR_HUMAN);
+    assert(sz == 1 && !strcmp(buf, "0"));
+    sz = tool.ld2string(buf, 3, 123.0L, LD_STR_AUTO);
+    assert(sz == 0);
+}
+
 int main(int argc, char **argv)
 {
     test_string2ll();
     test_string2l();
     test_ll2string();
+    test_digits10();
+    test_d2string();
+    test_ld2string();
     return 0;
 }
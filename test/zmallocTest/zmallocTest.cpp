@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include "zmalloc.h"
 #include "define.h"
 #ifdef HAVE_MALLOC_SIZE
@@ -50,6 +51,66 @@ void print_memory(const char* label, size_t bytes) {
     printf("%-20s: %s\n", label, buffer);
 }
 using namespace REDIS_BASE;
+
+// 线程本地缓存测试：每个线程反复分配/释放小对象，退出时缓存和统计增量应全部归还
+#define TCACHE_TEST_THREADS 4
+#define TCACHE_TEST_ROUNDS 20000
+static void *tcacheWorker(void *arg) {
+    UNUSED(arg);
+    void *slots[64] = {0};
+    unsigned int seed = (unsigned int)(uintptr_t)pthread_self();
+    for (int j = 0; j < TCACHE_TEST_ROUNDS; j++) {
+        int idx = rand_r(&seed) % 64;
+        if (slots[idx]) {
+            zmalloc::getInstance()->zfree(slots[idx]);
+            slots[idx] = NULL;
+        } else {
+            slots[idx] = zmalloc::getInstance()->zzmalloc(1 + rand_r(&seed) % 4096);
+            memset(slots[idx], 'x', 1);
+        }
+    }
+    for (int j = 0; j < 64; j++) zmalloc::getInstance()->zfree(slots[j]);
+    return NULL;
+}
+
+// 采样堆分析测试：用较小的采样间隔，分配足够多的块使估计值稳定
+#define PROF_TEST_SAMPLE 8192
+#define PROF_TEST_BLOCKS 4000
+#define PROF_TEST_BLOCK_SIZE 1000
+#define PROF_TEST_FAIL_SIZE ((size_t)1 << 50)   /* 超出地址空间，realloc必然失败 */
+static void * __attribute__((noinline)) profAllocBlock(size_t size) {
+    return zmalloc::getInstance()->zzmalloc(size, ZMALLOC_TAG_DICT);
+}
+// 大块mmap分配测试：超过默认阈值，且是2MB的整数倍
+#define HUGE_TEST_SIZE (8*1024*1024)
+// 内存压力回调测试：软上限比当前用量多10MB，逐块分配越过水位
+#define PRESSURE_TEST_HEADROOM (10*1024*1024)
+#define PRESSURE_TEST_BLOCK (64*1024)
+#define PRESSURE_TEST_MAX_BLOCKS 1024
+typedef struct pressureTestState {
+    int sync_calls;
+    int deferred_calls;
+    void *cache;        // 同步回调里释放，模拟淘汰缓存
+} pressureTestState;
+static void pressureSyncCallback(int watermark, size_t used, size_t limit, void *privdata) {
+    pressureTestState *state = static_cast<pressureTestState*>(privdata);
+    printf("同步回调: 水位%d%%, used %zu, limit %zu\n", watermark, used, limit);
+    state->sync_calls++;
+    zmalloc::getInstance()->zfree(state->cache);
+    state->cache = NULL;
+}
+static void pressureDeferredCallback(int watermark, size_t used, size_t limit, void *privdata) {
+    pressureTestState *state = static_cast<pressureTestState*>(privdata);
+    printf("延迟回调: 水位%d%%, used %zu, limit %zu\n", watermark, used, limit);
+    state->deferred_calls++;
+}
+// 分配到软上限的96%以上，返回分配的块数
+static int pressureFill(void **blocks, size_t limit) {
+    int n = 0;
+    while (n < PRESSURE_TEST_MAX_BLOCKS && zmalloc::getInstance()->zmalloc_used_memory() < limit/100*96)
+        blocks[n++] = zmalloc::getInstance()->zzmalloc(PRESSURE_TEST_BLOCK);
+    return n;
+}
 int main(int argc, char **argv)
 {
 
@@ -151,5 +212,236 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    printf("========================05 线程本地缓存================================\n");
+    zmalloc::getInstance()->zmalloc_thread_cache_flush();
+    size_t before = zmalloc::getInstance()->zmalloc_used_memory();
+    pthread_t tids[TCACHE_TEST_THREADS];
+    for (int j = 0; j < TCACHE_TEST_THREADS; j++)
+        pthread_create(&tids[j], NULL, tcacheWorker, NULL);
+    for (int j = 0; j < TCACHE_TEST_THREADS; j++)
+        pthread_join(tids[j], NULL);
+    size_t after = zmalloc::getInstance()->zmalloc_used_memory();
+    printf("线程退出前后used_memory: %zu -> %zu\n", before, after);
+    if (before != after) {
+        printf("错误: 线程退出后used_memory没有回到初始值\n");
+        return 1;
+    }
+    // 同一线程内释放后再分配同样大小，应命中缓存
+    void *p1 = zmalloc::getInstance()->zzmalloc(24);
+    zmalloc::getInstance()->zfree(p1);
+    void *p2 = zmalloc::getInstance()->zzmalloc(24);
+    printf("释放后再分配是否复用缓存块: %s\n", p1 == p2 ? "是" : "否");
+#ifdef HAVE_ZMALLOC_THREAD_CACHE
+    if (p1 != p2) {
+        printf("错误: 线程本地缓存没有复用刚释放的块\n");
+        return 1;
+    }
+#endif
+    zmalloc::getInstance()->zfree(p2);
+    zmalloc::getInstance()->zmalloc_thread_cache_flush();
+    if (zmalloc::getInstance()->zmalloc_used_memory() != before) {
+        printf("错误: 清空缓存后used_memory不一致\n");
+        return 1;
+    }
+
+    printf("========================06 内存标签统计================================\n");
+    zmallocTagStats tag_before[ZMALLOC_TAG_COUNT], tag_after[ZMALLOC_TAG_COUNT];
+    zmalloc::getInstance()->zmalloc_get_tag_stats(tag_before);
+    size_t used_before = zmalloc::getInstance()->zmalloc_used_memory();
+    void *blocks[10];
+    for (int j = 0; j < 10; j++)
+        blocks[j] = zmalloc::getInstance()->zzmalloc(100, ZMALLOC_TAG_DICT);
+    blocks[0] = zmalloc::getInstance()->zrealloc(blocks[0], 1000, ZMALLOC_TAG_DICT);
+    zmalloc::getInstance()->zmalloc_get_tag_stats(tag_after);
+    long long dict_used = tag_after[ZMALLOC_TAG_DICT].used - tag_before[ZMALLOC_TAG_DICT].used;
+    long long dict_count = tag_after[ZMALLOC_TAG_DICT].count - tag_before[ZMALLOC_TAG_DICT].count;
+    long long dict_allocs = tag_after[ZMALLOC_TAG_DICT].allocs - tag_before[ZMALLOC_TAG_DICT].allocs;
+    printf("%s: used +%lld, blocks +%lld, allocs +%lld\n",
+        zmalloc::getInstance()->zmalloc_tag_name(ZMALLOC_TAG_DICT), dict_used, dict_count, dict_allocs);
+    if (dict_count != 10 || dict_allocs != 10 ||
+        dict_used != (long long)(zmalloc::getInstance()->zmalloc_used_memory() - used_before)) {
+        printf("错误: dict标签统计不正确\n");
+        return 1;
+    }
+    for (int j = 0; j < 10; j++)
+        zmalloc::getInstance()->zfree(blocks[j], ZMALLOC_TAG_DICT);
+    zmalloc::getInstance()->zmalloc_get_tag_stats(tag_after);
+    if (tag_after[ZMALLOC_TAG_DICT].used != tag_before[ZMALLOC_TAG_DICT].used ||
+        tag_after[ZMALLOC_TAG_DICT].count != tag_before[ZMALLOC_TAG_DICT].count) {
+        printf("错误: 释放后dict标签统计没有回到初始值\n");
+        return 1;
+    }
+    // 已退出线程的计数合并到汇总里，所有标签的used之和应等于used_memory
+    long long tag_total = 0;
+    for (int j = 0; j < ZMALLOC_TAG_COUNT; j++) tag_total += tag_after[j].used;
+    printf("各标签used之和: %lld, used_memory: %zu\n", tag_total, zmalloc::getInstance()->zmalloc_used_memory());
+
+    printf("========================07 内存压力回调================================\n");
+    pressureTestState pressure = {0, 0, NULL};
+    void *pressure_blocks[PRESSURE_TEST_MAX_BLOCKS];
+    size_t pressure_limit = zmalloc::getInstance()->zmalloc_used_memory() + PRESSURE_TEST_HEADROOM;
+    // 同步回调释放的缓存块小于回落区间，释放后不会马上重新生效
+    pressure.cache = zmalloc::getInstance()->zzmalloc(PRESSURE_TEST_HEADROOM/100);
+    zmalloc::getInstance()->zmalloc_set_soft_limit(pressure_limit);
+    int sync_id = zmalloc::getInstance()->zmalloc_register_pressure_callback(
+        pressureSyncCallback, &pressure, 80, ZMALLOC_PRESSURE_SYNC);
+    int deferred_id = zmalloc::getInstance()->zmalloc_register_pressure_callback(
+        pressureDeferredCallback, &pressure, 95, 0);
+    if (sync_id < 0 || deferred_id < 0 ||
+        zmalloc::getInstance()->zmalloc_register_pressure_callback(pressureSyncCallback, NULL, 0, 0) != -1) {
+        printf("错误: 注册压力回调失败\n");
+        return 1;
+    }
+    int pressure_n = pressureFill(pressure_blocks, pressure_limit);
+    printf("分配%d块后 used: %zu, limit: %zu\n", pressure_n, zmalloc::getInstance()->zmalloc_used_memory(), pressure_limit);
+    int pressure_ok = pressure.sync_calls == 1 && pressure.cache == NULL && pressure.deferred_calls == 0;
+    // 延迟回调只在安全点调用，且只调用一次
+    pressure_ok = pressure_ok && zmalloc::getInstance()->zmalloc_pressure_poll() == 1 && pressure.deferred_calls == 1;
+    pressure_ok = pressure_ok && zmalloc::getInstance()->zmalloc_pressure_poll() == 0 && pressure.deferred_calls == 1;
+    // 回落到水位以下后重新生效，再次越线再次触发
+    for (int j = 0; j < pressure_n; j++) zmalloc::getInstance()->zfree(pressure_blocks[j]);
+    pressure_n = pressureFill(pressure_blocks, pressure_limit);
+    pressure_ok = pressure_ok && pressure.sync_calls == 2 &&
+        zmalloc::getInstance()->zmalloc_pressure_poll() == 1 && pressure.deferred_calls == 2;
+    for (int j = 0; j < pressure_n; j++) zmalloc::getInstance()->zfree(pressure_blocks[j]);
+    // 取消注册、关闭软上限后不再触发
+    pressure_ok = pressure_ok && zmalloc::getInstance()->zmalloc_unregister_pressure_callback(sync_id) == 0 &&
+        zmalloc::getInstance()->zmalloc_unregister_pressure_callback(sync_id) == -1 &&
+        zmalloc::getInstance()->zmalloc_unregister_pressure_callback(deferred_id) == 0;
+    zmalloc::getInstance()->zmalloc_set_soft_limit(0);
+    pressure_ok = pressure_ok && zmalloc::getInstance()->zmalloc_get_soft_limit() == 0;
+    pressure_n = pressureFill(pressure_blocks, pressure_limit);
+    pressure_ok = pressure_ok && zmalloc::getInstance()->zmalloc_pressure_poll() == 0 && pressure.sync_calls == 2;
+    for (int j = 0; j < pressure_n; j++) zmalloc::getInstance()->zfree(pressure_blocks[j]);
+    if (!pressure_ok) {
+        printf("错误: 压力回调次数不正确 (同步%d次, 延迟%d次)\n", pressure.sync_calls, pressure.deferred_calls);
+        return 1;
+    }
+
+    printf("========================08 采样堆分析================================\n");
+    zmallocProfStats prof;
+    if (zmalloc::getInstance()->zmalloc_prof_start(PROF_TEST_SAMPLE) != 0) {
+        printf("当前平台不支持backtrace()，跳过\n");
+        return 0;
+    }
+    void **prof_blocks = static_cast<void**>(zmalloc::getInstance()->zzmalloc(sizeof(void*)*PROF_TEST_BLOCKS));
+    for (int j = 0; j < PROF_TEST_BLOCKS; j++)
+        prof_blocks[j] = profAllocBlock(PROF_TEST_BLOCK_SIZE);
+    zmalloc::getInstance()->zmalloc_prof_get_stats(&prof);
+    long long expect_bytes = (long long)PROF_TEST_BLOCKS*PROF_TEST_BLOCK_SIZE;
+    printf("采样次数: %lld, 存活采样: %lld, 估计存活字节: %lld (实际约%lld)\n",
+        prof.samples, prof.live_samples, prof.live_bytes, expect_bytes);
+    if (prof.live_samples == 0 || prof.live_bytes < expect_bytes/2 || prof.live_bytes > expect_bytes*2) {
+        printf("错误: 采样估计值偏差过大\n");
+        return 1;
+    }
+#if !defined(__SANITIZE_ADDRESS__)
+    // realloc失败时旧块仍然存活，采样不能丢（关闭大块mmap，走普通realloc路径）
+    zmalloc::getInstance()->zmalloc_set_huge_pages(0, 0);
+    for (int j = 0; j < PROF_TEST_BLOCKS; j++) {
+        if (zmalloc::getInstance()->ztryrealloc_usable(prof_blocks[j], PROF_TEST_FAIL_SIZE, NULL, ZMALLOC_TAG_DICT) != NULL) {
+            printf("错误: 超大realloc没有失败\n");
+            return 1;
+        }
+    }
+    zmalloc::getInstance()->zmalloc_set_huge_pages(ZMALLOC_HUGE_DEFAULT_THRESHOLD, 1);
+    long long live_before = prof.live_samples;
+    zmalloc::getInstance()->zmalloc_prof_get_stats(&prof);
+    printf("realloc失败后存活采样: %lld -> %lld\n", live_before, prof.live_samples);
+    if (prof.live_samples != live_before) {
+        printf("错误: realloc失败丢失了旧块的采样\n");
+        return 1;
+    }
+#endif
+    const char *collapsed_file = "/tmp/zmalloc_prof_test.collapsed";
+    const char *pprof_file = "/tmp/zmalloc_prof_test.heap";
+    if (zmalloc::getInstance()->zmalloc_prof_dump(collapsed_file, ZMALLOC_PROF_FORMAT_COLLAPSED) != 0 ||
+        zmalloc::getInstance()->zmalloc_prof_dump(pprof_file, ZMALLOC_PROF_FORMAT_PPROF) != 0) {
+        printf("错误: 写出采样文件失败\n");
+        return 1;
+    }
+    // 折叠栈每行以标签开头，以估计字节数结尾；pprof文件以heap profile头开始
+    char line[4096];
+    int dict_lines = 0;
+    FILE *fp = fopen(collapsed_file, "r");
+    while (fp && fgets(line, sizeof(line), fp)) {
+        if (!strncmp(line, "dict;", 5)) dict_lines++;
+        if (dict_lines == 1) printf("折叠栈示例: %s", line);
+    }
+    if (fp) fclose(fp);
+    fp = fopen(pprof_file, "r");
+    int pprof_ok = fp && fgets(line, sizeof(line), fp) && !strncmp(line, "heap profile:", 13);
+    if (fp) fclose(fp);
+    unlink(collapsed_file);
+    unlink(pprof_file);
+    if (dict_lines == 0 || !pprof_ok) {
+        printf("错误: 采样文件内容不正确\n");
+        return 1;
+    }
+    // 释放后存活采样清零
+    for (int j = 0; j < PROF_TEST_BLOCKS; j++)
+        zmalloc::getInstance()->zfree(prof_blocks[j], ZMALLOC_TAG_DICT);
+    zmalloc::getInstance()->zmalloc_prof_get_stats(&prof);
+    printf("释放后存活采样: %lld\n", prof.live_samples);
+    zmalloc::getInstance()->zmalloc_prof_stop();
+    zmalloc::getInstance()->zfree(prof_blocks);
+    if (prof.live_samples != 0) {
+        printf("错误: 释放后仍有存活采样\n");
+        return 1;
+    }
+
+    printf("========================09 大块mmap分配================================\n");
+    size_t huge_blocks, huge_bytes, huge_blocks0, huge_bytes0;
+    zmalloc::getInstance()->zmalloc_get_huge_stats(&huge_blocks0, &huge_bytes0);
+    used_before = zmalloc::getInstance()->zmalloc_used_memory();
+    // 默认关闭，需要调用方显式开启
+    char *huge = static_cast<char*>(zmalloc::getInstance()->zzmalloc(HUGE_TEST_SIZE));
+    if (zmalloc::getInstance()->zmalloc_huge_size(huge) != 0) {
+        printf("错误: 大块mmap分配默认应关闭\n");
+        return 1;
+    }
+    zmalloc::getInstance()->zfree(huge);
+    zmalloc::getInstance()->zmalloc_set_huge_pages(ZMALLOC_HUGE_SUGGESTED_THRESHOLD, 1);
+    huge = static_cast<char*>(zmalloc::getInstance()->zzmalloc(HUGE_TEST_SIZE));
+    memset(huge, 'h', HUGE_TEST_SIZE);
+    zmalloc::getInstance()->zmalloc_get_huge_stats(&huge_blocks, &huge_bytes);
+    print_memory("AnonHugePages", zmalloc::getInstance()->zmalloc_get_smap_bytes_by_field("AnonHugePages:", -1));
+    if (zmalloc::getInstance()->zmalloc_huge_size(huge) == 0) {
+        printf("当前构建没有启用大块mmap分配，跳过\n");
+        zmalloc::getInstance()->zfree(huge);
+        zmalloc::getInstance()->zmalloc_set_huge_pages(ZMALLOC_HUGE_DEFAULT_THRESHOLD, 1);
+        return 0;
+    }
+    printf("大块地址: %p, 大块数: %zu, 映射字节: %zu\n", (void*)huge, huge_blocks - huge_blocks0, huge_bytes - huge_bytes0);
+    if (((uintptr_t)huge & (ZMALLOC_HUGE_ALIGN-1)) != 0 || huge_blocks != huge_blocks0 + 1 ||
+        zmalloc::getInstance()->zmalloc_used_memory() - used_before != HUGE_TEST_SIZE) {
+        printf("错误: 大块分配的对齐或统计不正确\n");
+        return 1;
+    }
+    // 扩大走mremap，缩小到阈值以下回到malloc，内容都应保留
+    huge = static_cast<char*>(zmalloc::getInstance()->zrealloc(huge, HUGE_TEST_SIZE*3));
+    memset(huge + HUGE_TEST_SIZE, 'g', HUGE_TEST_SIZE*2);
+    int huge_ok = zmalloc::getInstance()->zmalloc_huge_size(huge) == HUGE_TEST_SIZE*3 &&
+        huge[0] == 'h' && huge[HUGE_TEST_SIZE-1] == 'h' && huge[HUGE_TEST_SIZE*3-1] == 'g' &&
+        zmalloc::getInstance()->zmalloc_used_memory() - used_before == HUGE_TEST_SIZE*3;
+    huge = static_cast<char*>(zmalloc::getInstance()->zrealloc(huge, 1024));
+    huge_ok = huge_ok && zmalloc::getInstance()->zmalloc_huge_size(huge) == 0 && huge[1023] == 'h';
+    zmalloc::getInstance()->zfree(huge);
+    char *zeroed = static_cast<char*>(zmalloc::getInstance()->zcalloc(HUGE_TEST_SIZE));
+    huge_ok = huge_ok && zeroed[0] == 0 && zeroed[HUGE_TEST_SIZE-1] == 0;
+    zmalloc::getInstance()->zfree(zeroed);
+    // 阈值为0时关闭
+    zmalloc::getInstance()->zmalloc_set_huge_pages(0, 1);
+    huge = static_cast<char*>(zmalloc::getInstance()->zzmalloc(HUGE_TEST_SIZE));
+    huge_ok = huge_ok && zmalloc::getInstance()->zmalloc_huge_size(huge) == 0;
+    zmalloc::getInstance()->zfree(huge);
+    zmalloc::getInstance()->zmalloc_set_huge_pages(ZMALLOC_HUGE_DEFAULT_THRESHOLD, 1);
+    zmalloc::getInstance()->zmalloc_get_huge_stats(&huge_blocks, &huge_bytes);
+    if (!huge_ok || huge_blocks != huge_blocks0 || huge_bytes != huge_bytes0 ||
+        zmalloc::getInstance()->zmalloc_used_memory() != used_before) {
+        printf("错误: 大块realloc/calloc/释放不正确\n");
+        return 1;
+    }
+
     return 0;
 }